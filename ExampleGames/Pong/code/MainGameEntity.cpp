@@ -2,6 +2,7 @@
 #include "PongGame.h"
 #include "Utils.h"
 #include "UtilMath.h"
+#include <cassert>
 #include <ctime>
 #include <cstdlib>
 #include "../core/HComponent.h"
@@ -42,6 +43,7 @@ namespace PongGame
         g_pGuiManager->AddOrUpdateCommandGenerator(&m_exitGameCommandGenerator);
         
         eventManager.RegisterListener("IMGUI_INPUT", GetEntityHandle());
+        EnableTicks(true, false);
         m_ballSpeed = 4.f;
         RandomGenerateBallDir();
     }
@@ -55,7 +57,7 @@ namespace PongGame
     void HMainGameEntity::Deseralize(YAML::Node& node, const std::string& name, Hedge::HEntity* pThis)
     {
         HMainGameEntity* pMainGameEntity = dynamic_cast<HMainGameEntity*>(pThis);
-        pMainGameEntity->m_customName = name;
+        pMainGameEntity->SetEntityInstName(name);
     }
 
     // ================================================================================================================
@@ -65,41 +67,21 @@ namespace PongGame
         if (m_playerBoardHandle == 0 || m_opponentBoardHandle == 0 || m_ballHandle == 0)
         {
             HScene& scene = g_pFrameListener->GetActiveScene();
-            std::vector<std::pair<std::string, uint32_t>> entities;
-            scene.GetAllEntitiesNamesHashes(entities);
 
-            for (auto& entity : entities)
-            {
-                if (std::strcmp(entity.first.c_str(), "PlayerBoardInst") == 0)
-                {
-                    std::cout << "Player Board Entity: " << entity.first << std::endl;
-                    m_playerBoardHandle = entity.second;
-                }
-
-                if (std::strcmp(entity.first.c_str(), "OpponentBoardInst") == 0)
-                {
-                    std::cout << "Opponent Board Entity: " << entity.first << std::endl;
-                    m_opponentBoardHandle = entity.second;
-                }
-
-                if (std::strcmp(entity.first.c_str(), "PongBallInst") == 0)
-                {
-                    std::cout << "PongBallInst Entity: " << entity.first << std::endl;
-                    m_ballHandle = entity.second;
-                }
-
-                if (std::strcmp(entity.first.c_str(), "TopWallInst") == 0)
+            // The scene indexes the names, so each lookup is a hash table probe instead of a scan of the scene.
+            auto findHandle = [&scene](const char* pName, uint32_t& oHandle) {
+                HEntity* pEntity = scene.FindEntityByName(pName);
+                if (pEntity)
                 {
-                    std::cout << "Upper Wall Entity: " << entity.first << std::endl;
-                    m_upperWallHandle = entity.second;
+                    oHandle = pEntity->GetEntityHandle();
                 }
+            };
 
-                if (std::strcmp(entity.first.c_str(), "BottomWallInst") == 0)
-                {
-                    std::cout << "Lower Wall Entity: " << entity.first << std::endl;
-                    m_lowerWallHandle = entity.second;
-                }
-            }
+            findHandle("PlayerBoardInst", m_playerBoardHandle);
+            findHandle("OpponentBoardInst", m_opponentBoardHandle);
+            findHandle("PongBallInst", m_ballHandle);
+            findHandle("TopWallInst", m_upperWallHandle);
+            findHandle("BottomWallInst", m_lowerWallHandle);
         }
     }
 
@@ -107,70 +89,30 @@ namespace PongGame
     void HMainGameEntity::CalBoundingBox()
     {
         HScene& scene = g_pFrameListener->GetActiveScene();
-        HEntity* pPlayerBoard = scene.GetEntity(m_playerBoardHandle);
-        HEntity* pOpponentBoard = scene.GetEntity(m_opponentBoardHandle);
-        HEntity* pUpperWall = scene.GetEntity(m_upperWallHandle);
-        HEntity* pLowerWall = scene.GetEntity(m_lowerWallHandle);
-
-        TransformComponent& playerTransComponent = pPlayerBoard->GetComponent<TransformComponent>();
-        TransformComponent& opponentTransComponent = pOpponentBoard->GetComponent<TransformComponent>();
-        TransformComponent& upperWallTransComponent = pUpperWall->GetComponent<TransformComponent>();
-        TransformComponent& lowerWallTransComponent = pLowerWall->GetComponent<TransformComponent>();
 
         float modelSpaceMin[4] = { -1.f, -1.f, -1.f, 1.f };
         float modelSpaceMax[4] = {  1.f,  1.f,  1.f, 1.f };
 
+        // The scene caches the world matrices and only recomputes the moved ones.
         // Player board bounding box
-        HMat4x4 playerBoardModelMat{};
-
-        GenModelMat(playerTransComponent.m_pos,
-            playerTransComponent.m_rot[2],
-            playerTransComponent.m_rot[0],
-            playerTransComponent.m_rot[1],
-            playerTransComponent.m_scale,
-            playerBoardModelMat.eles);
-
-        MatMulVec(playerBoardModelMat.eles, modelSpaceMin, 4, m_playerBoundingBoxMin);
-        MatMulVec(playerBoardModelMat.eles, modelSpaceMax, 4, m_playerBoundingBoxMax);
+        const float* pPlayerBoardModelMat = scene.GetEntityWorldMat(m_playerBoardHandle);
+        MatMulVec(pPlayerBoardModelMat, modelSpaceMin, 4, m_playerBoundingBoxMin);
+        MatMulVec(pPlayerBoardModelMat, modelSpaceMax, 4, m_playerBoundingBoxMax);
 
         // Opponent board bounding box
-        HMat4x4 opponentBoardModelMat{};
-
-        GenModelMat(opponentTransComponent.m_pos,
-            opponentTransComponent.m_rot[2],
-            opponentTransComponent.m_rot[0],
-            opponentTransComponent.m_rot[1],
-            opponentTransComponent.m_scale,
-            opponentBoardModelMat.eles);
-
-        MatMulVec(opponentBoardModelMat.eles, modelSpaceMin, 4, m_opponentBoundingBoxMin);
-        MatMulVec(opponentBoardModelMat.eles, modelSpaceMax, 4, m_opponentBoundingBoxMax);
+        const float* pOpponentBoardModelMat = scene.GetEntityWorldMat(m_opponentBoardHandle);
+        MatMulVec(pOpponentBoardModelMat, modelSpaceMin, 4, m_opponentBoundingBoxMin);
+        MatMulVec(pOpponentBoardModelMat, modelSpaceMax, 4, m_opponentBoundingBoxMax);
 
         // Upper wall bounding box
-        HMat4x4 upperWallModelMat{};
-
-        GenModelMat(upperWallTransComponent.m_pos,
-            upperWallTransComponent.m_rot[2],
-            upperWallTransComponent.m_rot[0],
-            upperWallTransComponent.m_rot[1],
-            upperWallTransComponent.m_scale,
-            upperWallModelMat.eles);
-
-        MatMulVec(upperWallModelMat.eles, modelSpaceMin, 4, m_upperWallBoundingBoxMin);
-        MatMulVec(upperWallModelMat.eles, modelSpaceMax, 4, m_upperWallBoundingBoxMax);
+        const float* pUpperWallModelMat = scene.GetEntityWorldMat(m_upperWallHandle);
+        MatMulVec(pUpperWallModelMat, modelSpaceMin, 4, m_upperWallBoundingBoxMin);
+        MatMulVec(pUpperWallModelMat, modelSpaceMax, 4, m_upperWallBoundingBoxMax);
 
         // Lower wall bounding box
-        HMat4x4 lowerWallModelMat{};
-
-        GenModelMat(lowerWallTransComponent.m_pos,
-            lowerWallTransComponent.m_rot[2],
-            lowerWallTransComponent.m_rot[0],
-            lowerWallTransComponent.m_rot[1],
-            lowerWallTransComponent.m_scale,
-            lowerWallModelMat.eles);
-
-        MatMulVec(lowerWallModelMat.eles, modelSpaceMin, 4, m_lowerWallBoundingBoxMin);
-        MatMulVec(lowerWallModelMat.eles, modelSpaceMax, 4, m_lowerWallBoundingBoxMax);
+        const float* pLowerWallModelMat = scene.GetEntityWorldMat(m_lowerWallHandle);
+        MatMulVec(pLowerWallModelMat, modelSpaceMin, 4, m_lowerWallBoundingBoxMin);
+        MatMulVec(pLowerWallModelMat, modelSpaceMax, 4, m_lowerWallBoundingBoxMax);
     }
 
     // ================================================================================================================
@@ -180,7 +122,7 @@ namespace PongGame
 
         HScene& scene = g_pFrameListener->GetActiveScene();
         HEntity* pBall = scene.GetEntity(m_ballHandle);
-        TransformComponent& transComponent = pBall->GetComponent<TransformComponent>();
+        const TransformComponent& transComponent = pBall->ReadComponent<TransformComponent>();
 
         float nearPoint[3] = {};
 
@@ -224,7 +166,7 @@ namespace PongGame
 
         HScene& scene = g_pFrameListener->GetActiveScene();
         HEntity* pBall = scene.GetEntity(m_ballHandle);
-        TransformComponent& transComponent = pBall->GetComponent<TransformComponent>();
+        const TransformComponent& transComponent = pBall->ReadComponent<TransformComponent>();
 
         float nearPoint[3] = {};
 
@@ -254,7 +196,7 @@ namespace PongGame
     {
         HScene& scene = g_pFrameListener->GetActiveScene();
         HEntity* pBall = scene.GetEntity(m_ballHandle);
-        TransformComponent& transComponent = pBall->GetComponent<TransformComponent>();
+        const TransformComponent& transComponent = pBall->ReadComponent<TransformComponent>();
         
         oIsPlayerWin = false;
 
@@ -322,16 +264,9 @@ namespace PongGame
         HScene& scene = g_pFrameListener->GetActiveScene();
         GetBoardsHandles();
 
-        std::cout << "Delta Time: " << std::to_string(deltaTime) << std::endl;
-
         // Update the ball physics
         if (m_ballHandle != 0)
         {
-            if (deltaTime > 1.f)
-            {
-                deltaTime = 0.f;
-            }
-
             HEntity* pBall = scene.GetEntity(m_ballHandle);
             TransformComponent& transComponent = pBall->GetComponent<TransformComponent>();
 
@@ -405,6 +340,40 @@ namespace PongGame
         }
     }
 
+    // ================================================================================================================
+    void HMainGameEntity::SaveSnapshotState(
+        std::vector<uint8_t>& oState) const
+    {
+        HPongSnapshotState state{};
+        {
+            state.playerScore = m_playerScore;
+            state.opponentScore = m_opponentScore;
+            state.ballSpeed = m_ballSpeed;
+            memcpy(state.ballVecDir, m_ballVecDir, sizeof(m_ballVecDir));
+            state.lastCollisionType = m_lastCollisionType;
+        }
+
+        const uint8_t* pState = reinterpret_cast<const uint8_t*>(&state);
+        oState.insert(oState.end(), pState, pState + sizeof(HPongSnapshotState));
+    }
+
+    // ================================================================================================================
+    void HMainGameEntity::RestoreSnapshotState(
+        const uint8_t* pState,
+        uint32_t       size)
+    {
+        assert(size == sizeof(HPongSnapshotState));
+
+        HPongSnapshotState state{};
+        memcpy(&state, pState, sizeof(HPongSnapshotState));
+
+        m_playerScore = state.playerScore;
+        m_opponentScore = state.opponentScore;
+        m_ballSpeed = state.ballSpeed;
+        memcpy(m_ballVecDir, state.ballVecDir, sizeof(m_ballVecDir));
+        m_lastCollisionType = state.lastCollisionType;
+    }
+
     // ================================================================================================================
     bool HMainGameEntity::OnEvent(HEvent& ievent)
     {
@@ -461,7 +430,7 @@ namespace PongGame
             if (m_ballHandle != 0)
             {
                 HEntity* pBall = scene.GetEntity(m_ballHandle);
-                TransformComponent& ballTransComponent = pBall->GetComponent<TransformComponent>();
+                const TransformComponent& ballTransComponent = pBall->ReadComponent<TransformComponent>();
 
                 float dist = std::abs(ballTransComponent.m_pos[1] - transComponent.m_pos[1]);
 
@@ -15,11 +15,16 @@ namespace PongGame
         virtual void OnDefineEntity(HEventManager& eventManager);
         virtual void PreRenderTick(float deltaTime) override;
         virtual bool OnEvent(HEvent& ievent) override;
+
+        // The ball's motion and the scores for the rollback. The boards and the ball are in the scene's components.
+        virtual void SaveSnapshotState(std::vector<uint8_t>& oState) const override;
+        virtual void RestoreSnapshotState(const uint8_t* pState, uint32_t size) override;
         
         // Seralization
         static void Seralize(YAML::Emitter& emitter, Hedge::HEntity* pThis);
         static void Deseralize(YAML::Node& node, const std::string& name, Hedge::HEntity* pThis);
         static HEntity* CreateEntity() { return new HMainGameEntity(); };
+        static HEntity* CreateEntityInPlace(void* pMem) { return new (pMem) HMainGameEntity(); };
 
     protected:
         virtual void InitComponentsNamesHashes() override {}
@@ -139,6 +144,16 @@ namespace PongGame
 
         CollisionType m_lastCollisionType = CollisionType::NONE;
 
+        // The members copied by the scene's snapshots.
+        struct HPongSnapshotState
+        {
+            uint32_t      playerScore;
+            uint32_t      opponentScore;
+            float         ballSpeed;
+            float         ballVecDir[3];
+            CollisionType lastCollisionType;
+        };
+
         bool m_pauseGame = false;
     };
 }
\ No newline at end of file
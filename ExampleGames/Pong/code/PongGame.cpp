@@ -15,6 +15,7 @@ Hedge::HRenderManager* g_pRenderManager = g_raiiManager.GetGameRenderManager();
 Hedge::HGpuRsrcManager* g_pGpuRsrcManager = g_raiiManager.GetGpuRsrcManager();
 Hedge::HAssetRsrcManager* g_pAssetRsrcManager = g_raiiManager.GetAssetRsrcManager();
 Hedge::HBaseGuiManager* g_pGuiManager = g_raiiManager.GetGameGuiManager();
+Hedge::HJobSystem* g_pJobSystem = g_raiiManager.GetJobSystem();
 
 namespace Hedge
 {
@@ -39,7 +40,10 @@ namespace Hedge
         HSerializer& serializer = GetSerializer();
         serializer.RegisterAClass(crc32("HMainGameEntity"), { PongGame::HMainGameEntity::Seralize,
                                                               PongGame::HMainGameEntity::Deseralize,
-                                                              PongGame::HMainGameEntity::CreateEntity });
+                                                              PongGame::HMainGameEntity::CreateEntity,
+                                                              PongGame::HMainGameEntity::CreateEntityInPlace,
+                                                              sizeof(PongGame::HMainGameEntity),
+                                                              alignof(PongGame::HMainGameEntity) });
     }
 
     // ================================================================================================================
@@ -248,9 +252,10 @@ namespace Hedge
 
     // ================================================================================================================
     HGameRenderManager::HGameRenderManager(
-        HBaseGuiManager* pGuiManager,
-        HGpuRsrcManager* pGpuRsrcManager)
-        : HRenderManager(pGuiManager, pGpuRsrcManager)
+        HBaseGuiManager*           pGuiManager,
+        HGpuRsrcManager*           pGpuRsrcManager,
+        const HHeadlessRenderInfo* pHeadlessInfo)
+        : HRenderManager(pGuiManager, pGpuRsrcManager, pHeadlessInfo)
     {}
 
     // ================================================================================================================
@@ -289,15 +294,50 @@ namespace Hedge
 
         delete m_pGpuRsrcManager;
         g_pGpuRsrcManager = nullptr;
+
+        delete m_pJobSystem;
+        g_pJobSystem = nullptr;
     }
 
     // ================================================================================================================
     void GlobalVariablesRAIIManager::CreateCustomGlobalVariables()
     {
+        // The other managers' threads are jobs, so the job system is the first one in and the last one out.
+        m_pJobSystem = new HJobSystem();
+        m_pJobSystem->Init(0);
+
         m_pGameTemplate = new HPongGame();
+
+        // The ball and the boards move in 120 Hz steps on any display. The hitches are absorbed by the steps' limit.
+        m_pGameTemplate->SetFixedTimestep(120.0);
+
         m_pGameGuiManager = new HGameGuiManager();
         m_pGpuRsrcManager = new HGpuRsrcManager();
-        m_pGameRenderManager = new HGameRenderManager(m_pGameGuiManager, m_pGpuRsrcManager);
+
+        // The game runs headless on the machines without a display. E.g. The automated performance tests.
+        HHeadlessRenderInfo headlessInfo{};
+        bool isHeadless = HRenderManager::GetHeadlessRenderInfoFromEnv(&headlessInfo);
+        m_pGameRenderManager = new HGameRenderManager(m_pGameGuiManager,
+                                                      m_pGpuRsrcManager,
+                                                      isHeadless ? &headlessInfo : nullptr);
+
+        // Hold 60 FPS on the weaker GPUs by lowering the scene's resolution. The headless captures keep the full
+        // resolution, so they are comparable between machines.
+        if (isHeadless == false)
+        {
+            HDynamicResolutionInfo dynamicResolutionInfo{};
+            {
+                dynamicResolutionInfo.targetFrameMs = 1000.f / 60.f;
+                dynamicResolutionInfo.minScale = 0.5f;
+                dynamicResolutionInfo.maxScale = 1.f;
+            }
+            m_pGameRenderManager->SetDynamicResolutionInfo(dynamicResolutionInfo);
+            m_pGameRenderManager->SetDynamicResolutionEnabled(true);
+        }
+
+        // Pong's entities only touch the scene, so the scene can be recorded while the next frame is simulated.
+        m_pGameRenderManager->SetPipelinedFramesEnabled(true);
+
         m_pAssetRsrcManager = new HAssetRsrcManager();
 
         std::string exePathName = GetExePath();
@@ -2,6 +2,7 @@
 
 #include "../core/HFrameListener.h"
 #include "../core/HGpuRsrcManager.h"
+#include "../core/HJobSystem.h"
 #include "../render/HRenderManager.h"
 #include "../render/HBaseGuiManager.h"
 #include "../scene/HScene.h"
@@ -25,7 +26,7 @@ namespace Hedge
 
         virtual HScene& GetActiveScene() override { return *m_pScene; }
         virtual HScene* GetActiveScenePtr() { return m_pScene; }
-        virtual SceneRenderInfo GetActiveSceneRenderInfo() override { return m_pScene->GetSceneRenderInfo(); }
+        virtual const SceneRenderInfo& GetActiveSceneRenderInfo() override { return m_pScene->GetSceneRenderInfo(); }
 
     protected:
         virtual void RegisterCustomSerializeClass() override;
@@ -77,7 +78,9 @@ namespace Hedge
     class HGameRenderManager : public HRenderManager
     {
     public:
-        HGameRenderManager(HBaseGuiManager* pGuiManager, HGpuRsrcManager* pGpuRsrcManager);
+        HGameRenderManager(HBaseGuiManager*           pGuiManager,
+                           HGpuRsrcManager*           pGpuRsrcManager,
+                           const HHeadlessRenderInfo* pHeadlessInfo = nullptr);
         virtual ~HGameRenderManager();
 
         virtual void DrawHud(HFrameListener* pFrameListener) override;
@@ -94,6 +97,7 @@ namespace Hedge
         HGameGuiManager* GetGameGuiManager() { return m_pGameGuiManager; }
         HGpuRsrcManager* GetGpuRsrcManager() { return m_pGpuRsrcManager; }
         HAssetRsrcManager* GetAssetRsrcManager() { return m_pAssetRsrcManager; }
+        HJobSystem* GetJobSystem() { return m_pJobSystem; }
 
     protected:
         virtual void CreateCustomGlobalVariables();
@@ -104,5 +108,6 @@ namespace Hedge
         HGameGuiManager*    m_pGameGuiManager;
         HGpuRsrcManager*    m_pGpuRsrcManager;
         HAssetRsrcManager*  m_pAssetRsrcManager;
+        HJobSystem*         m_pJobSystem;
     };
 }
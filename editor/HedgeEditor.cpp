@@ -18,6 +18,7 @@ Hedge::HRenderManager* g_pRenderManager = g_raiiManager.GetHedgeEditorRenderMana
 Hedge::HGpuRsrcManager* g_pGpuRsrcManager = g_raiiManager.GetGpuRsrcManager();
 Hedge::HAssetRsrcManager* g_pAssetRsrcManager = g_raiiManager.GetAssetRsrcManager();
 Hedge::HBaseGuiManager* g_pGuiManager = g_raiiManager.GetHedgeEditorGuiManager();
+Hedge::HJobSystem* g_pJobSystem = g_raiiManager.GetJobSystem();
 
 namespace Hedge
 {
@@ -271,7 +272,7 @@ namespace Hedge
     }
 
     // ================================================================================================================
-    SceneRenderInfo HedgeEditor::GetActiveSceneRenderInfo()
+    const SceneRenderInfo& HedgeEditor::GetActiveSceneRenderInfo()
     {
         return m_pScenes[m_activeScene]->GetSceneRenderInfo();
     }
@@ -279,6 +280,10 @@ namespace Hedge
     // ================================================================================================================
     GlobalVariablesRAIIManager::GlobalVariablesRAIIManager()
     {
+        // The other managers' threads are jobs, so the job system is the first one in and the last one out.
+        m_pJobSystem                = new HJobSystem();
+        m_pJobSystem->Init(0);
+
         m_pHedgeEditor              = new HedgeEditor();
         m_pHedgeEditorGuiManager    = new HedgeEditorGuiManager();
         m_pGpuRsrcManager           = new HGpuRsrcManager();
@@ -295,5 +300,7 @@ namespace Hedge
         delete m_pHedgeEditor;
         delete m_pAssetRsrcManager;
         delete m_pGpuRsrcManager;
+
+        delete m_pJobSystem;
     }
 }
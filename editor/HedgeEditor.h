@@ -4,6 +4,7 @@
 #include "HedgeEditorGuiManager.h"
 #include "HedgeEditorRenderManager.h"
 #include "core/HGpuRsrcManager.h"
+#include "core/HJobSystem.h"
 #include <vector>
 
 namespace Hedge
@@ -35,7 +36,7 @@ namespace Hedge
         virtual void AppStarts() override;
 
         virtual HScene& GetActiveScene() override;
-        virtual SceneRenderInfo GetActiveSceneRenderInfo() override;
+        virtual const SceneRenderInfo& GetActiveSceneRenderInfo() override;
 
         std::string GetProjectDir() { return m_rootDir; }
 
@@ -70,6 +71,7 @@ namespace Hedge
         HedgeEditorGuiManager* GetHedgeEditorGuiManager() { return m_pHedgeEditorGuiManager; }
         HGpuRsrcManager* GetGpuRsrcManager() { return m_pGpuRsrcManager; }
         HAssetRsrcManager* GetAssetRsrcManager() { return m_pAssetRsrcManager; }
+        HJobSystem* GetJobSystem() { return m_pJobSystem; }
 
     private:
         HedgeEditor*              m_pHedgeEditor;
@@ -77,5 +79,6 @@ namespace Hedge
         HedgeEditorRenderManager* m_pHedgeEditorRenderManager;
         HGpuRsrcManager*          m_pGpuRsrcManager;
         HAssetRsrcManager*        m_pAssetRsrcManager;
+        HJobSystem*               m_pJobSystem;
     };
 }
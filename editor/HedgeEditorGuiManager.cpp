@@ -459,7 +459,8 @@ namespace Hedge
         {
             HScene& scene = g_pFrameListener->GetActiveScene();
 
-            TransformComponent transComponent = scene.EntityGetComponent<TransformComponent>(pEntity->GetEntityHandle());
+            const TransformComponent& transComponent =
+                scene.EntityReadComponent<TransformComponent>(pEntity->GetEntityHandle());
 
             std::string posStr;
             posStr += ("(" + std::to_string(transComponent.m_pos[0]) + ", " +
@@ -3,7 +3,10 @@
 #include "Utils.h"
 #include "yaml-cpp/yaml.h"
 #include "HGpuRsrcManager.h"
+#include "../scene/HOcclusionRasterizer.h"
 #include <filesystem>
+#include <algorithm>
+#include <cmath>
 
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -16,6 +19,10 @@
 
 extern Hedge::HGpuRsrcManager* g_pGpuRsrcManager;
 
+// The occluder proxy merges the vertices in each cell of a grid over the mesh's AABB. Occluders are rasterized at a low
+// resolution, so a coarse grid is enough.
+#define OCCLUDER_PROXY_GRID_RES 8
+
 namespace Hedge
 {
     // ================================================================================================================
@@ -287,6 +294,16 @@ namespace Hedge
             float* pPosData = new float[3 * posAccessor.count];
             memcpy(pPosData, &pBufferData[posBufferOffset], posBufferByteCnt);
 
+            CalMeshBounds(m_meshes[i], pPosData, posAccessor.count);
+
+            HOcclusionRasterizer::GenOccluderMesh(pPosData,
+                                                  posAccessor.count,
+                                                  m_meshes[i].idxData.data(),
+                                                  m_meshes[i].idxData.size(),
+                                                  OCCLUDER_PROXY_GRID_RES,
+                                                  m_meshes[i].occluderVerts,
+                                                  m_meshes[i].occluderIdx);
+
             // Assmue the data and element type of the normal is float3.
             int normalBufferOffset = normalAccessorByteOffset + normalBufferView.byteOffset;
             int normalBufferByteCnt = sizeof(float) * 3 * normalAccessor.count;
@@ -341,10 +358,11 @@ namespace Hedge
             // Create the VkBuffer for the idx and vert buffer -- NOTE: For optimization, we may want to use the mesh
             // files' to manage GPU rsrc so that different static meshs that share the same raw geometry mesh can also
             // share the same GPU idx and vert buffer.
+            // The GPU driven renderer copies the meshes into its merged buffers, so they are also transfer sources.
             {
                 uint32_t idxDataBytesCnt = m_meshes[i].idxData.size() * sizeof(uint16_t);
                 m_meshes[i].pIdxDataGpuBuffer = g_pGpuRsrcManager->CreateGpuBuffer(
-                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                     VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
                     idxDataBytesCnt, "IdxBuffer");
 
@@ -352,7 +370,7 @@ namespace Hedge
 
                 uint32_t vertDataBytesCnt = m_meshes[i].vertData.size() * sizeof(float);
                 m_meshes[i].pVertDataGpuBuffer = g_pGpuRsrcManager->CreateGpuBuffer(
-                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                     VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
                     vertDataBytesCnt, "VertBuffer"
                 );
@@ -362,6 +380,49 @@ namespace Hedge
         }
     }
 
+    // ================================================================================================================
+    void HStaticMeshAsset::CalMeshBounds(
+        Mesh&        mesh,
+        const float* pPosData,
+        uint32_t     vertCnt)
+    {
+        if (vertCnt == 0)
+        {
+            memset(mesh.aabbMin, 0, sizeof(mesh.aabbMin));
+            memset(mesh.aabbMax, 0, sizeof(mesh.aabbMax));
+            memset(mesh.boundingSphere, 0, sizeof(mesh.boundingSphere));
+            return;
+        }
+
+        memcpy(mesh.aabbMin, pPosData, sizeof(float) * 3);
+        memcpy(mesh.aabbMax, pPosData, sizeof(float) * 3);
+
+        for (uint32_t vertIdx = 1; vertIdx < vertCnt; vertIdx++)
+        {
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                mesh.aabbMin[j] = std::min(mesh.aabbMin[j], pPosData[3 * vertIdx + j]);
+                mesh.aabbMax[j] = std::max(mesh.aabbMax[j], pPosData[3 * vertIdx + j]);
+            }
+        }
+
+        // The sphere is centered at the AABB's center. It's not the tightest one but it's good enough for culling.
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            mesh.boundingSphere[j] = 0.5f * (mesh.aabbMin[j] + mesh.aabbMax[j]);
+        }
+
+        float maxDistSq = 0.f;
+        for (uint32_t vertIdx = 0; vertIdx < vertCnt; vertIdx++)
+        {
+            float dx = pPosData[3 * vertIdx]     - mesh.boundingSphere[0];
+            float dy = pPosData[3 * vertIdx + 1] - mesh.boundingSphere[1];
+            float dz = pPosData[3 * vertIdx + 2] - mesh.boundingSphere[2];
+            maxDistSq = std::max(maxDistSq, dx * dx + dy * dy + dz * dz);
+        }
+        mesh.boundingSphere[3] = sqrtf(maxDistSq);
+    }
+
     // ================================================================================================================
     void HStaticMeshAsset::LoadObjRawGeo(const std::string& namePath)
     {
@@ -709,7 +770,9 @@ namespace Hedge
         m_baseColorTextureGUID(0),
         m_normalMapGUID(0),
         m_metallicRoughnessGUID(0),
-        m_occlusionGUID(0)
+        m_occlusionGUID(0),
+        m_hasNormalMap(true),
+        m_hasOcclusionMap(true)
     {}
 
     // ================================================================================================================
@@ -776,6 +839,9 @@ namespace Hedge
                                   std::to_string(normal[3]) + ".vta";
 
             m_normalMapGUID = m_pAssetRsrcManager->LoadAsset(m_normalMapPathName);
+
+            // A constant normal map pointing at the tangent space's z axis is the vertex normal.
+            m_hasNormalMap = (normal[0] != 0.5f) || (normal[1] != 0.5f) || (normal[2] != 1.f);
         }
         else
         {
@@ -819,6 +885,8 @@ namespace Hedge
                                   std::to_string(occlusion[3]) + ".vta";
 
             m_occlusionGUID = m_pAssetRsrcManager->LoadAsset(m_occlusionPathName);
+
+            m_hasOcclusionMap = (occlusion[0] != 1.f);
         }
         else
         {
@@ -45,6 +45,15 @@ namespace Hedge
 
         std::string materialPathName;
         uint64_t    materialGUID;
+
+        // Model space bounds. They are calculated from the vertices' positions when we load the mesh.
+        float aabbMin[3];
+        float aabbMax[3];
+        float boundingSphere[4]; // Center xyz and radius.
+
+        // The low poly proxy for the CPU occlusion culling. Model space xyz positions. It's generated at import.
+        std::vector<float>    occluderVerts;
+        std::vector<uint16_t> occluderIdx;
     };
 
     // Static mesh has raw geometry data and a material.
@@ -67,10 +76,19 @@ namespace Hedge
         uint32_t GetIdxCnt(uint32_t i) { return m_meshes[i].idxData.size(); }
         uint32_t GetVertCnt(uint32_t i) { return m_meshes[i].vertData.size() / 12; }
 
+        const float* GetAabbMin(uint32_t i) { return m_meshes[i].aabbMin; }
+        const float* GetAabbMax(uint32_t i) { return m_meshes[i].aabbMax; }
+        const float* GetBoundingSphere(uint32_t i) { return m_meshes[i].boundingSphere; }
+
+        const std::vector<float>&    GetOccluderVerts(uint32_t i) { return m_meshes[i].occluderVerts; }
+        const std::vector<uint16_t>& GetOccluderIdx(uint32_t i) { return m_meshes[i].occluderIdx; }
+
     private:
         void LoadGltfRawGeo(const std::string& namePath);
         void LoadObjRawGeo(const std::string& namePath);
 
+        void CalMeshBounds(Mesh& mesh, const float* pPosData, uint32_t vertCnt);
+
         // Note: for a model, it's possible that it has multiple sections or sub-models.
         //       (Helmet's glass, top and mouth cover, etc)
         std::vector<Mesh> m_meshes;
@@ -93,6 +111,10 @@ namespace Hedge
         uint64_t GetMetallicRoughnessGUID() { return m_metallicRoughnessGUID; }
         uint64_t GetOcclusionGUID() { return m_occlusionGUID; }
 
+        // A flat normal map or a white occlusion doesn't change the shading. The renderers skip them.
+        bool HasNormalMap() const { return m_hasNormalMap; }
+        bool HasOcclusionMap() const { return m_hasOcclusionMap; }
+
     private:
         std::string m_baseColorTexturePathName;
         uint64_t    m_baseColorTextureGUID;
@@ -105,6 +127,9 @@ namespace Hedge
 
         std::string m_occlusionPathName;
         uint64_t    m_occlusionGUID;
+
+        bool m_hasNormalMap;
+        bool m_hasOcclusionMap;
     };
 
     /*
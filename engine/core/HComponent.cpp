@@ -9,7 +9,7 @@ namespace Hedge
 {
     // ================================================================================================================
     void TransformComponent::Seralize(
-        YAML::Emitter& emitter)
+        YAML::Emitter& emitter) const
     {
         emitter << YAML::Key << "TransformComponent";
         emitter << YAML::Value;
@@ -46,7 +46,7 @@ namespace Hedge
 
     // ================================================================================================================
     void StaticMeshComponent::Seralize(
-        YAML::Emitter& emitter)
+        YAML::Emitter& emitter) const
     {
         emitter << YAML::Key << "StaticMeshComponent";
         emitter << YAML::Value;
@@ -56,6 +56,9 @@ namespace Hedge
         emitter << YAML::Key << "Mesh Asset Name Path";
         emitter << YAML::Value << m_meshAssetPathName;
 
+        emitter << YAML::Key << "Occluder";
+        emitter << YAML::Value << m_isOccluder;
+
         emitter << YAML::EndMap;
     }
 
@@ -66,11 +69,17 @@ namespace Hedge
         // Load the static mesh asset (geometry data + material) into RAM
         std::string assetName = node["Asset Name"].as<std::string>();
         m_meshAssetGuid = g_pAssetRsrcManager->LoadAsset(assetName);
+
+        // Older scenes don't have it.
+        if (node["Occluder"])
+        {
+            m_isOccluder = node["Occluder"].as<bool>();
+        }
     }
 
     // ================================================================================================================
     void CameraComponent::Seralize(
-        YAML::Emitter& emitter)
+        YAML::Emitter& emitter) const
     {
         emitter << YAML::Key << "CameraComponent";
         emitter << YAML::Value;
@@ -141,7 +150,7 @@ namespace Hedge
 
     // ================================================================================================================
     void PointLightComponent::Seralize(
-        YAML::Emitter& emitter)
+        YAML::Emitter& emitter) const
     {
         emitter << YAML::Key << "CameraComponent";
         emitter << YAML::Value;
@@ -33,7 +33,7 @@ namespace Hedge
             memcpy(m_scale, pScale, 3 * sizeof(float));
         }
 
-        void Seralize(YAML::Emitter& emitter);
+        void Seralize(YAML::Emitter& emitter) const;
         void Deseralize(YAML::Node& node);
 
         float m_pos[3];
@@ -46,17 +46,30 @@ namespace Hedge
     {
     public:
         StaticMeshComponent()
-            : m_meshAssetGuid(0)
+            : m_meshAssetGuid(0),
+              m_isOccluder(false)
         {}
 
         ~StaticMeshComponent()
         {}
 
-        void Seralize(YAML::Emitter& emitter);
+        void Seralize(YAML::Emitter& emitter) const;
         void Deseralize(YAML::Node& node);
 
+        // The snapshots' restore only replaces the components that differ.
+        bool operator==(const StaticMeshComponent& other) const
+        {
+            return (m_meshAssetGuid == other.m_meshAssetGuid) &&
+                   (m_isOccluder == other.m_isOccluder) &&
+                   (m_meshAssetPathName == other.m_meshAssetPathName);
+        }
+
         std::string m_meshAssetPathName;
         uint64_t    m_meshAssetGuid;
+
+        // The mesh's low poly proxy is rasterized by the CPU occlusion culling to hide other meshes behind it.
+        // E.g. Walls, terrains and large buildings.
+        bool m_isOccluder;
     };
 
     class CameraComponent
@@ -79,7 +92,7 @@ namespace Hedge
             m_aspect = aspect;
         }
 
-        void Seralize(YAML::Emitter& emitter);
+        void Seralize(YAML::Emitter& emitter) const;
         void Deseralize(YAML::Node& node);
         void GetRight(float* oRight);
         void GetNearPlane(float& width, float& height, float& near);
@@ -104,7 +117,7 @@ namespace Hedge
             memcpy(m_color, pColor, 3 * sizeof(float));
         }
 
-        void Seralize(YAML::Emitter& emitter);
+        void Seralize(YAML::Emitter& emitter) const;
         void Deseralize(YAML::Node& node);
 
         float m_color[3];
@@ -118,9 +131,14 @@ namespace Hedge
             m_iblGUID(0)
         {}
 
-        void Seralize(YAML::Emitter& emitter) {}
+        void Seralize(YAML::Emitter& emitter) const {}
         void Deseralize(YAML::Node& node);
 
+        bool operator==(const ImageBasedLightingComponent& other) const
+        {
+            return (m_iblGUID == other.m_iblGUID) && (m_iblAssetNamePath == other.m_iblAssetNamePath);
+        }
+
         uint64_t    m_iblGUID;
         std::string m_iblAssetNamePath;
 
@@ -143,9 +161,14 @@ namespace Hedge
             m_cubemapGUID(0)
         {}
 
-        void Seralize(YAML::Emitter& emitter) {}
+        void Seralize(YAML::Emitter& emitter) const {}
         void Deseralize(YAML::Node& node);
 
+        bool operator==(const BackgroundCubemapComponent& other) const
+        {
+            return (m_cubemapGUID == other.m_cubemapGUID) && (m_cubemapAssetNamePath == other.m_cubemapAssetNamePath);
+        }
+
         uint64_t m_cubemapGUID;
         std::string m_cubemapAssetNamePath;
     };
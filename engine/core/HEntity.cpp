@@ -27,7 +27,13 @@ namespace Hedge
         : m_pScene(nullptr),
           m_entityHandle(0),
           m_entityClassNameHash(crc32(className.c_str())),
-          m_customName(instName)
+          m_customName(instName),
+          m_isPreRenderTickEnabled(false),
+          m_isPostRenderTickEnabled(false),
+          m_pPool(nullptr),
+          m_classIdx(UINT32_MAX),
+          m_preRenderTickIdx(UINT32_MAX),
+          m_postRenderTickIdx(UINT32_MAX)
     {
         // NOTE: We cannot call virutal function in the constructor.
         // InitComponentsNamesHashes();
@@ -47,6 +53,19 @@ namespace Hedge
         InitComponentsNamesHashes();
     }
 
+    // ================================================================================================================
+    void HEntity::SetEntityInstName(
+        const std::string& name)
+    {
+        std::string oldName = m_customName;
+        m_customName = name;
+
+        if (m_pScene)
+        {
+            m_pScene->OnEntityRenamed(this, oldName);
+        }
+    }
+
     // ================================================================================================================
     template<typename Type, typename... Args>
     void HEntity::AddComponent(
@@ -62,10 +81,17 @@ namespace Hedge
         return m_pScene->EntityGetComponent<T>(m_entityHandle);
     }
 
+    // ================================================================================================================
+    template<typename T>
+    const T& HEntity::ReadComponent() const
+    {
+        return m_pScene->EntityReadComponent<T>(m_entityHandle);
+    }
+
     // ================================================================================================================
     HCubeEntity::~HCubeEntity()
     {
-        StaticMeshComponent& meshComponent = GetComponent<StaticMeshComponent>();
+        const StaticMeshComponent& meshComponent = ReadComponent<StaticMeshComponent>();
         g_pAssetRsrcManager->ReleaseAsset(meshComponent.m_meshAssetGuid);
     }
 
@@ -102,11 +128,11 @@ namespace Hedge
             {
                 emitter << YAML::BeginMap;
                 // Transform Component
-                TransformComponent& transComponent = pCubeEntity->GetComponent<TransformComponent>();
+                const TransformComponent& transComponent = pCubeEntity->ReadComponent<TransformComponent>();
                 transComponent.Seralize(emitter);
 
                 // Static Mesh Component
-                StaticMeshComponent& meshComponent = pCubeEntity->GetComponent<StaticMeshComponent>();
+                const StaticMeshComponent& meshComponent = pCubeEntity->ReadComponent<StaticMeshComponent>();
                 meshComponent.Seralize(emitter);
                 emitter << YAML::EndMap;
             }
@@ -130,7 +156,7 @@ namespace Hedge
         StaticMeshComponent& meshComponent = pCubeEntity->GetComponent<StaticMeshComponent>();
         meshComponent.Deseralize(node["StaticMeshComponent"]);
 
-        pCubeEntity->m_customName = name;
+        pCubeEntity->SetEntityInstName(name);
     }
 
     // ================================================================================================================
@@ -224,7 +250,7 @@ namespace Hedge
             {
                 // First hold:
                 m_holdStartPos = std::any_cast<HFVec2>(args[crc32("POS")]);
-                CameraComponent& cam = GetComponent<CameraComponent>();
+                const CameraComponent& cam = ReadComponent<CameraComponent>();
                 memcpy(m_holdStartView, cam.m_view, 3 * sizeof(float));
                 memcpy(m_holdStartUp, cam.m_up, 3 * sizeof(float));
 
@@ -363,11 +389,11 @@ namespace Hedge
             {
                 emitter << YAML::BeginMap;
                 // Transform Component
-                TransformComponent& transComponent = pCameraEntity->GetComponent<TransformComponent>();
+                const TransformComponent& transComponent = pCameraEntity->ReadComponent<TransformComponent>();
                 transComponent.Seralize(emitter);
 
                 // Camera Component
-                CameraComponent& camComponent = pCameraEntity->GetComponent<CameraComponent>();
+                const CameraComponent& camComponent = pCameraEntity->ReadComponent<CameraComponent>();
                 camComponent.Seralize(emitter);
                 emitter << YAML::EndMap;
             }
@@ -391,7 +417,7 @@ namespace Hedge
         auto& camComponent = pCameraEntity->GetComponent<CameraComponent>();
         camComponent.Deseralize(node["CameraComponent"]);
 
-        pCameraEntity->m_customName = name;
+        pCameraEntity->SetEntityInstName(name);
     }
 
     // ================================================================================================================
@@ -435,7 +461,7 @@ namespace Hedge
             {
                 emitter << YAML::BeginMap;
                 // Transform Component
-                TransformComponent& transComponent = pPtLightEntity->GetComponent<TransformComponent>();
+                const TransformComponent& transComponent = pPtLightEntity->ReadComponent<TransformComponent>();
                 transComponent.Seralize(emitter);
                 emitter << YAML::EndMap;
             }            
@@ -459,7 +485,7 @@ namespace Hedge
         auto& pointLightComponent = pPtLightEntity->GetComponent<PointLightComponent>();
         pointLightComponent.Deseralize(node["PointLightComponent"]);
 
-        pPtLightEntity->m_customName = name;
+        pPtLightEntity->SetEntityInstName(name);
     }
 
     // ================================================================================================================
@@ -493,7 +519,7 @@ namespace Hedge
         auto& bgCubemapComponent = pBgCubemapEntity->GetComponent<BackgroundCubemapComponent>();
         bgCubemapComponent.Deseralize(node["BackgroundCubemapComponent"]);
 
-        pBgCubemapEntity->m_customName = name;
+        pBgCubemapEntity->SetEntityInstName(name);
     }
 
     // ================================================================================================================
@@ -520,6 +546,6 @@ namespace Hedge
         auto& iblComponent = pIblEntity->GetComponent<ImageBasedLightingComponent>();
         iblComponent.Deseralize(node["ImageBasedLightingComponent"]);
 
-        pIblEntity->m_customName = name;
+        pIblEntity->SetEntityInstName(name);
     }
 }
\ No newline at end of file
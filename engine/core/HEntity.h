@@ -1,6 +1,9 @@
 #pragma once
+#include <cstdint>
+#include <new>
 #include <vector>
 #include <string>
+#include <utility>
 #include "UtilMath.h"
 
 namespace YAML
@@ -12,6 +15,7 @@ namespace YAML
 namespace Hedge
 {
     class HScene;
+    class HEntityPool;
     class HComponent;
     class HRenderManager;
     class HEvent;
@@ -34,30 +38,65 @@ namespace Hedge
         // Add components to entity to define an entity.
         virtual void OnDefineEntity(HEventManager& eventManager) = 0;
 
+        // The scene's snapshots copy the components. An entity keeping gameplay state in its members appends it to
+        // the oState and reads the same bytes back in the restore. (See the HScene::SaveSnapshot(...))
+        virtual void SaveSnapshotState(std::vector<uint8_t>& oState) const {};
+        virtual void RestoreSnapshotState(const uint8_t* pState, uint32_t size) {};
+
         uint32_t GetClassNameHash() { return m_entityClassNameHash; }
-        std::string& GetEntityInstName() { return m_customName; }
+        const std::string& GetEntityInstName() const { return m_customName; }
+
+        // The scene's name index follows the new name.
+        void SetEntityInstName(const std::string& name);
 
         void GetComponentsNamesHashes(std::vector<uint32_t>& output) { output = m_componentsNamesHashes; }
 
         uint32_t GetEntityHandle() { return m_entityHandle; }
 
+        bool IsPreRenderTickEnabled() const { return m_isPreRenderTickEnabled; }
+        bool IsPostRenderTickEnabled() const { return m_isPostRenderTickEnabled; }
+
+        // Use the ReadComponent() if the component isn't modified. The GetComponent() marks it as updated.
         template<typename T>
         T& GetComponent();
 
+        template<typename T>
+        const T& ReadComponent() const;
+
     protected:
         template<typename Type, typename... Args>
         void AddComponent(Args &&...args);
         
         virtual void InitComponentsNamesHashes() = 0;
+
+        // The virtual ticks are opt-in. The scene only calls the ticks enabled before the end of the
+        // OnDefineEntity(...), so entities without per-frame logic cost nothing. Data parallel logic should be a
+        // scene system instead. (See the HScene::RegisterSystem(...))
+        void EnableTicks(bool preRender, bool postRender)
+        {
+            m_isPreRenderTickEnabled = preRender;
+            m_isPostRenderTickEnabled = postRender;
+        }
         
         std::vector<uint32_t> m_componentsNamesHashes;
         
         std::string m_customName;
 
     private:
+        // The scene keeps where the entity is in its lists, so destroying the entity doesn't search them.
+        friend class HScene;
+
         uint32_t m_entityClassNameHash;
         uint32_t m_entityHandle;
         HScene*  m_pScene;
+        bool     m_isPreRenderTickEnabled;
+        bool     m_isPostRenderTickEnabled;
+
+        HEntityPool*                               m_pPool;             // Null if the entity isn't in a pool.
+        uint32_t                                   m_classIdx;          // In the scene's entities of the class.
+        uint32_t                                   m_preRenderTickIdx;  // UINT32_MAX if it doesn't tick.
+        uint32_t                                   m_postRenderTickIdx; // UINT32_MAX if it doesn't tick.
+        std::vector<std::pair<uint32_t, uint32_t>> m_tagsIdx;           // Tag hash -> Idx in the tag's entities.
     };
 
     class HCubeEntity : public HEntity
@@ -73,6 +112,7 @@ namespace Hedge
         static void Seralize(YAML::Emitter& emitter, Hedge::HEntity* pThis);
         static void Deseralize(YAML::Node& node, const std::string& name, Hedge::HEntity* pThis);
         static HEntity* CreateEntity() { return new HCubeEntity(); };
+        static HEntity* CreateEntityInPlace(void* pMem) { return new (pMem) HCubeEntity(); };
 
     protected:
         virtual void InitComponentsNamesHashes() override;
@@ -99,6 +139,7 @@ namespace Hedge
         static void Seralize(YAML::Emitter& emitter, Hedge::HEntity* pThis);
         static void Deseralize(YAML::Node& node, const std::string& name, Hedge::HEntity* pThis);
         static HEntity* CreateEntity() { return new HCameraEntity(); };
+        static HEntity* CreateEntityInPlace(void* pMem) { return new (pMem) HCameraEntity(); };
 
     protected:
         virtual void InitComponentsNamesHashes() override;
@@ -130,6 +171,7 @@ namespace Hedge
         static void Seralize(YAML::Emitter& emitter, Hedge::HEntity* pThis);
         static void Deseralize(YAML::Node& node, const std::string& name, Hedge::HEntity* pThis);
         static HEntity* CreateEntity() { return new HPointLightEntity(); };
+        static HEntity* CreateEntityInPlace(void* pMem) { return new (pMem) HPointLightEntity(); };
 
     protected:
         virtual void InitComponentsNamesHashes() override;
@@ -150,6 +192,7 @@ namespace Hedge
         static void Seralize(YAML::Emitter& emitter, Hedge::HEntity* pThis) {}
         static void Deseralize(YAML::Node& node, const std::string& name, Hedge::HEntity* pThis);
         static HEntity* CreateEntity() { return new HImageBasedLightingEntity(); };
+        static HEntity* CreateEntityInPlace(void* pMem) { return new (pMem) HImageBasedLightingEntity(); };
 
     protected:
         virtual void InitComponentsNamesHashes() override;
@@ -170,6 +213,7 @@ namespace Hedge
         static void Seralize(YAML::Emitter& emitter, Hedge::HEntity* pThis) {}
         static void Deseralize(YAML::Node& node, const std::string& name, Hedge::HEntity* pThis);
         static HEntity* CreateEntity() { return new HBackgroundCubemapEntity(); };
+        static HEntity* CreateEntityInPlace(void* pMem) { return new (pMem) HBackgroundCubemapEntity(); };
 
         protected:
             virtual void InitComponentsNamesHashes() override;
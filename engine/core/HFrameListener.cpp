@@ -2,13 +2,20 @@
 #include "HEntity.h"
 #include "Utils.h"
 #include "../scene/HScene.h"
+#include <cassert>
+#include <cmath>
 
 namespace Hedge
 {
     // ================================================================================================================
     HFrameListener::HFrameListener()
         :m_eventManager(),
-         m_elapsedSec(-1.0)
+         m_elapsedSec(-1.0),
+         m_isFixedTimestepEnabled(false),
+         m_fixedStepSec(1.0 / 60.0),
+         m_maxFixedStepsPerFrame(HFIXED_TIMESTEP_DEFAULT_MAX_STEPS),
+         m_fixedAccumulatorSec(0.0),
+         m_lastFixedStepsCnt(0)
     {}
 
     // ================================================================================================================
@@ -21,19 +28,35 @@ namespace Hedge
         // Register all engine entity classes
         m_serializer.RegisterAClass(crc32("HCubeEntity"), { HCubeEntity::Seralize,
                                                             HCubeEntity::Deseralize,
-                                                            HCubeEntity::CreateEntity });
+                                                            HCubeEntity::CreateEntity,
+                                                            HCubeEntity::CreateEntityInPlace,
+                                                            sizeof(HCubeEntity),
+                                                            alignof(HCubeEntity) });
         m_serializer.RegisterAClass(crc32("HCameraEntity"), { HCameraEntity::Seralize,
                                                               HCameraEntity::Deseralize,
-                                                              HCameraEntity::CreateEntity });
+                                                              HCameraEntity::CreateEntity,
+                                                              HCameraEntity::CreateEntityInPlace,
+                                                              sizeof(HCameraEntity),
+                                                              alignof(HCameraEntity) });
         m_serializer.RegisterAClass(crc32("HPointLightEntity"), { HPointLightEntity::Seralize,
                                                                   HPointLightEntity::Deseralize,
-                                                                  HPointLightEntity::CreateEntity });
-        m_serializer.RegisterAClass(crc32("HImageBasedLightingEntity"), { HImageBasedLightingEntity::Seralize,
-                                                                          HImageBasedLightingEntity::Deseralize,
-                                                                          HImageBasedLightingEntity::CreateEntity });
+                                                                  HPointLightEntity::CreateEntity,
+                                                                  HPointLightEntity::CreateEntityInPlace,
+                                                                  sizeof(HPointLightEntity),
+                                                                  alignof(HPointLightEntity) });
+        m_serializer.RegisterAClass(crc32("HImageBasedLightingEntity"),
+                                    { HImageBasedLightingEntity::Seralize,
+                                      HImageBasedLightingEntity::Deseralize,
+                                      HImageBasedLightingEntity::CreateEntity,
+                                      HImageBasedLightingEntity::CreateEntityInPlace,
+                                      sizeof(HImageBasedLightingEntity),
+                                      alignof(HImageBasedLightingEntity) });
         m_serializer.RegisterAClass(crc32("HBackgroundCubemapEntity"), { HBackgroundCubemapEntity::Seralize,
                                                                          HBackgroundCubemapEntity::Deseralize,
-                                                                         HBackgroundCubemapEntity::CreateEntity });
+                                                                         HBackgroundCubemapEntity::CreateEntity,
+                                                                         HBackgroundCubemapEntity::CreateEntityInPlace,
+                                                                         sizeof(HBackgroundCubemapEntity),
+                                                                         alignof(HBackgroundCubemapEntity) });
         // Register custom entity classes
         RegisterCustomSerializeClass();
     }
@@ -54,10 +77,49 @@ namespace Hedge
             m_elapsedSec = elapsed_seconds.count();
         }
         
-        activeScene.PreRenderTick(m_elapsedSec);
+        if (m_isFixedTimestepEnabled)
+        {
+            m_fixedAccumulatorSec += m_elapsedSec;
+
+            m_lastFixedStepsCnt = 0;
+            while ((m_fixedAccumulatorSec >= m_fixedStepSec) && (m_lastFixedStepsCnt < m_maxFixedStepsPerFrame))
+            {
+                activeScene.FixedStepTick(m_fixedStepSec);
+                m_fixedAccumulatorSec -= m_fixedStepSec;
+                m_lastFixedStepsCnt++;
+            }
+
+            // The simulation cannot catch up (E.g. A hitch or a breakpoint). The game slows down instead of spending
+            // more and more steps on the later frames.
+            if (m_fixedAccumulatorSec >= m_fixedStepSec)
+            {
+                m_fixedAccumulatorSec = std::fmod(m_fixedAccumulatorSec, m_fixedStepSec);
+            }
+
+            activeScene.SetRenderInterpolationAlpha(static_cast<float>(m_fixedAccumulatorSec / m_fixedStepSec));
+        }
+        else
+        {
+            activeScene.PreRenderTick(m_elapsedSec);
+        }
+
         m_lastTimeStamp = currentTimeStamp;
     }
 
+    // ================================================================================================================
+    void HFrameListener::SetFixedTimestep(
+        double   hz,
+        uint32_t maxStepsPerFrame)
+    {
+        assert(hz > 0.0);
+        assert(maxStepsPerFrame > 0);
+
+        m_isFixedTimestepEnabled = true;
+        m_fixedStepSec = 1.0 / hz;
+        m_maxFixedStepsPerFrame = maxStepsPerFrame;
+        m_fixedAccumulatorSec = 0.0;
+    }
+
     // ================================================================================================================
     void HFrameListener::EntitiesPostRenderTick()
     {
@@ -7,6 +7,9 @@
 #define HEDGE_ENGINE_MAJOR_VERSION 0
 #define HEDGE_ENGINE_MINOR_VERSION 1
 
+// The fixed timestep runs at most this many steps in a frame by default. The time beyond them is dropped.
+#define HFIXED_TIMESTEP_DEFAULT_MAX_STEPS 4
+
 namespace Hedge
 {
     class HScene;
@@ -23,13 +26,24 @@ namespace Hedge
         virtual void FrameStarted() = 0;
         virtual void FrameEnded()   = 0;
         virtual HScene& GetActiveScene() = 0;
-        virtual SceneRenderInfo GetActiveSceneRenderInfo() = 0;
+        virtual const SceneRenderInfo& GetActiveSceneRenderInfo() = 0;
         virtual void AppStarts() = 0;
         virtual bool GameShouldClose() { return m_gameShouldClose; }
 
         void EntitiesPreRenderTick();
         void EntitiesPostRenderTick();
 
+        // Simulate the scene's pre-render ticks in fixed steps of 1/hz seconds instead of the frame's delta. The frame
+        // time is accumulated and at most maxStepsPerFrame steps run in a frame, so the simulation cost is bounded and
+        // doesn't grow with the display's refresh rate. The render info is interpolated between the last two steps.
+        // The post-render ticks still run once per frame with the frame's delta. It's off by default.
+        void SetFixedTimestep(double hz, uint32_t maxStepsPerFrame = HFIXED_TIMESTEP_DEFAULT_MAX_STEPS);
+        void DisableFixedTimestep() { m_isFixedTimestepEnabled = false; }
+        bool IsFixedTimestepEnabled() const { return m_isFixedTimestepEnabled; }
+
+        // The number of fixed steps run in the last frame.
+        uint32_t GetLastFixedStepsCnt() const { return m_lastFixedStepsCnt; }
+
         void SetCloseGame() { m_gameShouldClose = true; }
 
         HEventManager& GetEventManager() { return m_eventManager; }
@@ -50,5 +64,11 @@ namespace Hedge
 
         std::chrono::time_point<std::chrono::high_resolution_clock> m_lastTimeStamp;
         double m_elapsedSec;
+
+        bool     m_isFixedTimestepEnabled;
+        double   m_fixedStepSec;
+        uint32_t m_maxFixedStepsPerFrame;
+        double   m_fixedAccumulatorSec; // The frame time that isn't simulated yet.
+        uint32_t m_lastFixedStepsCnt;
     };
 }
@@ -3,6 +3,8 @@
 #include <iostream>
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <mutex>
 #include <GLFW/glfw3.h>
 #include "Utils.h"
 #include "../logging/HLogger.h"
@@ -99,6 +101,16 @@ namespace Hedge
           m_gfxCmdPool(VK_NULL_HANDLE),
           m_descriptorPool(VK_NULL_HANDLE),
           m_vmaAllocator(VK_NULL_HANDLE),
+          m_bindlessSupported(false),
+          m_bindlessSlotsCnt(0),
+          m_nextBindlessSlot(0),
+          m_bindlessDescriptorSetLayout(VK_NULL_HANDLE),
+          m_bindlessDescriptorPool(VK_NULL_HANDLE),
+          m_bindlessDescriptorSet(VK_NULL_HANDLE),
+          m_drawIndirectCountSupported(false),
+          m_pipelineStatisticsSupported(false),
+          m_timestampPeriod(0.f),
+          m_timestampValidBits(0),
           m_gfxQueueFamilyIdx(0),
           m_computeQueueFamilyIdx(0),
           m_presentQueueFamilyIdx(0),
@@ -119,6 +131,12 @@ namespace Hedge
 
         vkDestroyDescriptorPool(m_vkDevice, m_descriptorPool, nullptr);
 
+        if (m_bindlessDescriptorPool != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorPool(m_vkDevice, m_bindlessDescriptorPool, nullptr);
+            vkDestroyDescriptorSetLayout(m_vkDevice, m_bindlessDescriptorSetLayout, nullptr);
+        }
+
         vmaDestroyAllocator(m_vmaAllocator);
 
         vkDestroyCommandPool(m_vkDevice, m_gfxCmdPool, nullptr);
@@ -155,6 +173,8 @@ namespace Hedge
     void HGpuRsrcManager::ReferGpuBufferImg(
         void* pGpuBufferImg)
     {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
         if (m_gpuBuffersImgs.count(pGpuBufferImg) > 0)
         {
             uint32_t dbgRefCnt = std::get<0>(m_gpuBuffersImgs[pGpuBufferImg]) + 1;
@@ -170,6 +190,8 @@ namespace Hedge
     void HGpuRsrcManager::DereferGpuBuffer(
         HGpuBuffer* pGpuBuffer)
     {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
         if (m_gpuBuffersImgs.count(pGpuBuffer) > 0)
         {
             std::get<0>(m_gpuBuffersImgs[pGpuBuffer]) = std::get<0>(m_gpuBuffersImgs[pGpuBuffer]) - 1;
@@ -237,6 +259,149 @@ namespace Hedge
         VK_CHECK(vkCreateDescriptorPool(m_vkDevice, &pool_info, nullptr, &m_descriptorPool));
     }
 
+    // ================================================================================================================
+    // All sampled 2D images live in one large update-after-bind combined image sampler array, so the renderers only
+    // need to bind this set once per frame and index textures by push constants.
+    void HGpuRsrcManager::CreateBindlessDescriptorSet()
+    {
+        if (m_bindlessSupported == false)
+        {
+            HDG_CORE_INFO("Descriptor indexing is not supported. Bindless textures are disabled.");
+            return;
+        }
+
+        VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProps{};
+        {
+            descriptorIndexingProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+        }
+
+        VkPhysicalDeviceProperties2 phyDeviceProps{};
+        {
+            phyDeviceProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            phyDeviceProps.pNext = &descriptorIndexingProps;
+        }
+        vkGetPhysicalDeviceProperties2(m_vkPhyDevice, &phyDeviceProps);
+
+        m_bindlessSlotsCnt = std::min(HGPU_MAX_BINDLESS_TEXTURES,
+                                      descriptorIndexingProps.maxDescriptorSetUpdateAfterBindSampledImages);
+        m_bindlessSlotsCnt = std::min(m_bindlessSlotsCnt,
+                                      descriptorIndexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages);
+        m_bindlessSlotsCnt = std::min(m_bindlessSlotsCnt,
+                                      descriptorIndexingProps.maxPerStageDescriptorUpdateAfterBindSamplers);
+
+        VkDescriptorSetLayoutBinding bindlessTexBinding{};
+        {
+            bindlessTexBinding.binding = 0;
+            bindlessTexBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            bindlessTexBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            bindlessTexBinding.descriptorCount = m_bindlessSlotsCnt;
+        }
+
+        VkDescriptorBindingFlags bindlessBindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                                        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                                        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        {
+            bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            bindingFlagsInfo.bindingCount = 1;
+            bindingFlagsInfo.pBindingFlags = &bindlessBindingFlags;
+        }
+
+        VkDescriptorSetLayoutCreateInfo bindlessSetLayoutInfo{};
+        {
+            bindlessSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            bindlessSetLayoutInfo.pNext = &bindingFlagsInfo;
+            bindlessSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+            bindlessSetLayoutInfo.bindingCount = 1;
+            bindlessSetLayoutInfo.pBindings = &bindlessTexBinding;
+        }
+        VK_CHECK(vkCreateDescriptorSetLayout(m_vkDevice, &bindlessSetLayoutInfo, nullptr, &m_bindlessDescriptorSetLayout));
+
+        VkDescriptorPoolSize bindlessPoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_bindlessSlotsCnt };
+        VkDescriptorPoolCreateInfo bindlessPoolInfo{};
+        {
+            bindlessPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            bindlessPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+            bindlessPoolInfo.maxSets = 1;
+            bindlessPoolInfo.poolSizeCount = 1;
+            bindlessPoolInfo.pPoolSizes = &bindlessPoolSize;
+        }
+        VK_CHECK(vkCreateDescriptorPool(m_vkDevice, &bindlessPoolInfo, nullptr, &m_bindlessDescriptorPool));
+
+        VkDescriptorSetAllocateInfo bindlessSetAllocInfo{};
+        {
+            bindlessSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            bindlessSetAllocInfo.descriptorPool = m_bindlessDescriptorPool;
+            bindlessSetAllocInfo.descriptorSetCount = 1;
+            bindlessSetAllocInfo.pSetLayouts = &m_bindlessDescriptorSetLayout;
+        }
+        VK_CHECK(vkAllocateDescriptorSets(m_vkDevice, &bindlessSetAllocInfo, &m_bindlessDescriptorSet));
+
+        HDG_CORE_INFO("Bindless texture slots: {}", m_bindlessSlotsCnt);
+    }
+
+    // ================================================================================================================
+    void HGpuRsrcManager::RegisterBindlessImg(
+        HGpuImg* pGpuImg)
+    {
+        pGpuImg->bindlessIdx = HGPU_INVALID_BINDLESS_IDX;
+
+        // Only 2D textures that can be sampled go into the bindless array. Cubemaps are still bound per frame.
+        // Depth images are sampled by compute passes (E.g. The Hi-Z building), but they are never material textures.
+        if ((m_bindlessDescriptorSet == VK_NULL_HANDLE) ||
+            (pGpuImg->gpuImgSampler == VK_NULL_HANDLE) ||
+            ((pGpuImg->imgSubresRange.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) == 0) ||
+            ((pGpuImg->imgInfo.usage & VK_IMAGE_USAGE_SAMPLED_BIT) == 0) ||
+            (pGpuImg->imgInfo.flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT))
+        {
+            return;
+        }
+
+        uint32_t slotIdx = HGPU_INVALID_BINDLESS_IDX;
+        if (m_freeBindlessSlots.empty() == false)
+        {
+            slotIdx = m_freeBindlessSlots.back();
+            m_freeBindlessSlots.pop_back();
+        }
+        else if (m_nextBindlessSlot < m_bindlessSlotsCnt)
+        {
+            slotIdx = m_nextBindlessSlot;
+            m_nextBindlessSlot++;
+        }
+        else
+        {
+            HDG_CORE_INFO("Run out of bindless texture slots.");
+            return;
+        }
+
+        VkWriteDescriptorSet writeDescriptorSet{};
+        {
+            writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSet.dstSet = m_bindlessDescriptorSet;
+            writeDescriptorSet.dstBinding = 0;
+            writeDescriptorSet.dstArrayElement = slotIdx;
+            writeDescriptorSet.descriptorCount = 1;
+            writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writeDescriptorSet.pImageInfo = &pGpuImg->gpuImgDescriptorInfo;
+        }
+        vkUpdateDescriptorSets(m_vkDevice, 1, &writeDescriptorSet, 0, nullptr);
+
+        pGpuImg->bindlessIdx = slotIdx;
+    }
+
+    // ================================================================================================================
+    // NOTE: The slot is released only after the image is dereferred by all frames, so no pending command buffer can
+    //       still access it. That's why we can overwrite it later with the UPDATE_UNUSED_WHILE_PENDING flag.
+    void HGpuRsrcManager::ReleaseBindlessSlot(
+        uint32_t slotIdx)
+    {
+        if (slotIdx != HGPU_INVALID_BINDLESS_IDX)
+        {
+            m_freeBindlessSlots.push_back(slotIdx);
+        }
+    }
+
     // ================================================================================================================
     void HGpuRsrcManager::CreateVmaObjects()
     {
@@ -259,7 +424,8 @@ namespace Hedge
     }
 
     // ================================================================================================================
-    void HGpuRsrcManager::CreateVulkanAppInstDebugger()
+    void HGpuRsrcManager::CreateVulkanAppInstDebugger(
+        bool isHeadless)
     {
         // Initialize instance and application
         VkApplicationInfo appInfo{};
@@ -273,12 +439,16 @@ namespace Hedge
         }
 
         // Init glfw and get the glfw required extension. NOTE: Initialize GLFW before calling any function that
-        // requires initialization.
-        glfwInit();
-        uint32_t glfwExtCnt = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtCnt);
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtCnt);
+        // requires initialization. The headless mode doesn't have a window, so the host may not have a display.
+        std::vector<const char*> extensions;
+        if (isHeadless == false)
+        {
+            glfwInit();
+            uint32_t glfwExtCnt = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtCnt);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtCnt);
+        }
 
 #ifndef NDEBUG
         ValidateDebugExtAndValidationLayer();
@@ -324,16 +494,71 @@ namespace Hedge
     }
 
     // ================================================================================================================
-    void HGpuRsrcManager::CreateVulkanPhyLogicalDevice(
+    VkPhysicalDevice HGpuRsrcManager::PickPhysicalDevice(
         VkSurfaceKHR* pSurface)
     {
-        // Enumerate the physicalDevices, select the first one and display the name of it.
         uint32_t phyDeviceCount;
         VK_CHECK(vkEnumeratePhysicalDevices(m_vkInst, &phyDeviceCount, nullptr));
         assert(phyDeviceCount >= 1);
         std::vector<VkPhysicalDevice> phyDeviceVec(phyDeviceCount);
         VK_CHECK(vkEnumeratePhysicalDevices(m_vkInst, &phyDeviceCount, phyDeviceVec.data()));
-        m_vkPhyDevice = phyDeviceVec[0];
+
+        // Prefer real GPUs. The CPU device (E.g. lavapipe on a build machine) is the last choice.
+        auto deviceTypeRank = [](VkPhysicalDeviceType type) {
+            switch (type)
+            {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   return 4;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    return 2;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU:            return 1;
+            default:                                     return 0;
+            }
+        };
+
+        VkPhysicalDevice pickedDevice = VK_NULL_HANDLE;
+        int pickedRank = -1;
+        for (VkPhysicalDevice phyDevice : phyDeviceVec)
+        {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(phyDevice, &properties);
+            if (properties.apiVersion < VK_API_VERSION_1_3)
+            {
+                continue;
+            }
+
+            // The device must be able to present to the surface if we have one.
+            uint32_t queueFamilyPropCount;
+            vkGetPhysicalDeviceQueueFamilyProperties(phyDevice, &queueFamilyPropCount, nullptr);
+            bool canPresent = (pSurface == nullptr);
+            for (uint32_t i = 0; (i < queueFamilyPropCount) && (canPresent == false); i++)
+            {
+                VkBool32 supportPresentSurface = VK_FALSE;
+                vkGetPhysicalDeviceSurfaceSupportKHR(phyDevice, i, *pSurface, &supportPresentSurface);
+                canPresent = (supportPresentSurface == VK_TRUE);
+            }
+
+            if (canPresent && (deviceTypeRank(properties.deviceType) > pickedRank))
+            {
+                pickedDevice = phyDevice;
+                pickedRank = deviceTypeRank(properties.deviceType);
+            }
+        }
+
+        if (pickedDevice == VK_NULL_HANDLE)
+        {
+            HDG_CORE_ERROR("Cannot find a Vulkan 1.3 device.");
+            exit(1);
+        }
+
+        return pickedDevice;
+    }
+
+    // ================================================================================================================
+    void HGpuRsrcManager::CreateVulkanPhyLogicalDevice(
+        VkSurfaceKHR* pSurface)
+    {
+        // Select a device and display the name of it.
+        m_vkPhyDevice = PickPhysicalDevice(pSurface);
         VkPhysicalDeviceProperties physicalDevProperties;
         vkGetPhysicalDeviceProperties(m_vkPhyDevice, &physicalDevProperties);
         HDG_CORE_INFO("Selected device name: {}", physicalDevProperties.deviceName);
@@ -346,8 +571,9 @@ namespace Hedge
         std::vector<VkQueueFamilyProperties> queueFamilyProps(queueFamilyPropCount);
         vkGetPhysicalDeviceQueueFamilyProperties(m_vkPhyDevice, &queueFamilyPropCount, queueFamilyProps.data());
 
+        // Nothing is presented without a surface. The present queue is just the graphics queue.
         bool foundGraphics = false;
-        bool foundPresent = false;
+        bool foundPresent = (pSurface == nullptr);
         bool foundCompute = false;
         for (uint32_t i = 0; i < queueFamilyPropCount; ++i)
         {
@@ -356,12 +582,16 @@ namespace Hedge
                 m_gfxQueueFamilyIdx = i;
                 foundGraphics = true;
             }
-            VkBool32 supportPresentSurface;
-            vkGetPhysicalDeviceSurfaceSupportKHR(m_vkPhyDevice, i, *pSurface, &supportPresentSurface);
-            if (supportPresentSurface)
+
+            if (pSurface != nullptr)
             {
-                m_presentQueueFamilyIdx = i;
-                foundPresent = true;
+                VkBool32 supportPresentSurface;
+                vkGetPhysicalDeviceSurfaceSupportKHR(m_vkPhyDevice, i, *pSurface, &supportPresentSurface);
+                if (supportPresentSurface)
+                {
+                    m_presentQueueFamilyIdx = i;
+                    foundPresent = true;
+                }
             }
 
             if (queueFamilyProps[i].queueFlags & VK_QUEUE_COMPUTE_BIT)
@@ -377,6 +607,15 @@ namespace Hedge
         }
         assert(foundGraphics && foundPresent && foundCompute);
 
+        // The graphics queue's timestamps measure the GPU frame time for the dynamic resolution.
+        m_timestampValidBits = queueFamilyProps[m_gfxQueueFamilyIdx].timestampValidBits;
+        m_timestampPeriod = (m_timestampValidBits != 0) ? physicalDevProperties.limits.timestampPeriod : 0.f;
+
+        if (pSurface == nullptr)
+        {
+            m_presentQueueFamilyIdx = m_gfxQueueFamilyIdx;
+        }
+
         // Use the queue family index to initialize the queue create info.
         float queue_priorities[1] = { 0.0 };
 
@@ -396,14 +635,82 @@ namespace Hedge
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
-        // We need the swap chain device extension
-        const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, 
-                                                            VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
-                                                            VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME };
+        // We need the swap chain device extension if we render to a surface.
+        std::vector<const char*> deviceExtensions = { VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+                                                      VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME };
+        if (pSurface != nullptr)
+        {
+            deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+
+        // The draw indirect count is optional. The GPU driven renderer is only available when it's supported.
+        uint32_t devExtCnt = 0;
+        VK_CHECK(vkEnumerateDeviceExtensionProperties(m_vkPhyDevice, nullptr, &devExtCnt, nullptr));
+        std::vector<VkExtensionProperties> devExtProps(devExtCnt);
+        VK_CHECK(vkEnumerateDeviceExtensionProperties(m_vkPhyDevice, nullptr, &devExtCnt, devExtProps.data()));
+
+        for (const VkExtensionProperties& extProp : devExtProps)
+        {
+            if (strcmp(extProp.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+            {
+                m_drawIndirectCountSupported = true;
+                deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+                break;
+            }
+        }
+
+        // Check whether the device supports the descriptor indexing features that we need for bindless textures.
+        VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexingFeatures{};
+        {
+            supportedIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+        }
+
+        VkPhysicalDeviceFeatures2 supportedFeatures{};
+        {
+            supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            supportedFeatures.pNext = &supportedIndexingFeatures;
+        }
+        vkGetPhysicalDeviceFeatures2(m_vkPhyDevice, &supportedFeatures);
+
+        m_bindlessSupported = supportedIndexingFeatures.runtimeDescriptorArray &&
+                              supportedIndexingFeatures.descriptorBindingPartiallyBound &&
+                              supportedIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+                              supportedIndexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+                              supportedIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+
+        // The render manager measures the passes with pipeline statistics queries. The scene pass may execute
+        // secondary command buffers while its query is active, so the inherited queries are also needed.
+        m_pipelineStatisticsSupported = supportedFeatures.features.pipelineStatisticsQuery &&
+                                        supportedFeatures.features.inheritedQueries;
+
+        VkPhysicalDeviceFeatures enabledFeatures{};
+        {
+            enabledFeatures.pipelineStatisticsQuery = m_pipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+            enabledFeatures.inheritedQueries = m_pipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+        }
+
+        VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
+        {
+            descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+            descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+            descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        }
+
+        // The render graph uses the vkCmdPipelineBarrier2(...). It's a core feature of Vulkan 1.3.
+        VkPhysicalDeviceSynchronization2Features synchronization2Features{};
+        {
+            synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+            synchronization2Features.pNext = m_bindlessSupported ? &descriptorIndexingFeatures : nullptr;
+            synchronization2Features.synchronization2 = VK_TRUE;
+        }
 
         VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_feature{};
         {
             dynamic_rendering_feature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+            dynamic_rendering_feature.pNext = &synchronization2Features;
             dynamic_rendering_feature.dynamicRendering = VK_TRUE;
         }
 
@@ -416,6 +723,7 @@ namespace Hedge
             deviceInfo.pQueueCreateInfos = queueCreateInfos.data();
             deviceInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
             deviceInfo.ppEnabledExtensionNames = deviceExtensions.data();
+            deviceInfo.pEnabledFeatures = &enabledFeatures;
         }
 
         // Create the logical device
@@ -434,6 +742,8 @@ namespace Hedge
         uint32_t                 bytesNum,
         std::string              dbgMsg)
     {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
         // Create Buffer and allocate memory for vertex buffer, index buffer and render target.
         VmaAllocationCreateInfo bufAllocInfo = {};
         {
@@ -461,11 +771,12 @@ namespace Hedge
                                  &(pGpuBuffer->gpuBufferAlloc),
                                  nullptr));
 
-        if (usage == VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+        // A storage buffer can also be used as other types of buffers. E.g. The indirect draw commands buffer.
+        if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
         {
             pGpuBuffer->gpuBufferDescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         }
-        else if (usage == VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+        else if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
         {
             pGpuBuffer->gpuBufferDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
         }
@@ -482,6 +793,8 @@ namespace Hedge
     // ================================================================================================================
     void HGpuRsrcManager::CleanupAllRsrc()
     {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
         for (auto& itr : m_gpuBuffersImgs)
         {
             if (std::get<2>(itr.second) == HGPU_BUFFER)
@@ -507,10 +820,26 @@ namespace Hedge
         vmaUnmapMemory(m_vmaAllocator, pGpuBuffer->gpuBufferAlloc);
     }
 
+    // ================================================================================================================
+    void HGpuRsrcManager::ReadDataFromBuffer(
+        const HGpuBuffer* const pGpuBuffer,
+        void*                   pData,
+        uint32_t                bytes)
+    {
+        // The memory may not be host coherent. E.g. The HOST_ACCESS_RANDOM readback buffers.
+        void* mapped = nullptr;
+        VK_CHECK(vmaInvalidateAllocation(m_vmaAllocator, pGpuBuffer->gpuBufferAlloc, 0, VK_WHOLE_SIZE));
+        VK_CHECK(vmaMapMemory(m_vmaAllocator, pGpuBuffer->gpuBufferAlloc, &mapped));
+        memcpy(pData, mapped, bytes);
+        vmaUnmapMemory(m_vmaAllocator, pGpuBuffer->gpuBufferAlloc);
+    }
+
     // ================================================================================================================
     void HGpuRsrcManager::DereferGpuImg(
         HGpuImg* pGpuImg)
     {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
         if (m_gpuBuffersImgs.count(pGpuImg) > 0)
         {
             std::get<0>(m_gpuBuffersImgs[pGpuImg]) = std::get<0>(m_gpuBuffersImgs[pGpuImg]) - 1;
@@ -540,6 +869,8 @@ namespace Hedge
 
                 vkDestroySampler(m_vkDevice, pGpuImg->gpuImgSampler, nullptr);
 
+                ReleaseBindlessSlot(pGpuImg->bindlessIdx);
+
                 m_gpuBuffersImgs.erase((void*)pGpuImg);
                 delete pGpuImg;
             }
@@ -559,6 +890,8 @@ namespace Hedge
         HGpuImg*      pTargetImg,
         VkImageLayout targetLayout)
     {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
         if (targetLayout == pTargetImg->curImgLayout)
         {
             return;
@@ -608,6 +941,8 @@ namespace Hedge
         HGpuImg* pTargetImg,
         VkClearColorValue* pClearColorVal)
     {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
         if (m_gpuBuffersImgs.count(pTargetImg) > 0)
         {
             HCommandBuffer hCmdBuffer(m_vkDevice, m_gfxCmdPool, m_gfxQueue);
@@ -663,6 +998,8 @@ namespace Hedge
         HGpuImgCreateInfo createInfo,
         std::string       dbgMsg)
     {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
         VmaAllocationCreateInfo imgAllocInfo = {};
         {
             imgAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
@@ -673,6 +1010,89 @@ namespace Hedge
         HGpuImg* pGpuImg = new HGpuImg();
         memset(pGpuImg, 0, sizeof(HGpuImg));
 
+        VkImageCreateInfo imgInfo = GenVkImgCreateInfo(createInfo);
+
+        VK_CHECK(vmaCreateImage(m_vmaAllocator,
+                                &imgInfo,
+                                &imgAllocInfo,
+                                &(pGpuImg->gpuImg),
+                                &(pGpuImg->gpuImgAlloc),
+                                nullptr));
+
+        InitGpuImgViewSampler(pGpuImg, createInfo, imgInfo, dbgMsg);
+
+        return pGpuImg;
+    }
+
+    // ================================================================================================================
+    HGpuImg* HGpuRsrcManager::CreateAliasingGpuImage(
+        HGpuImgCreateInfo createInfo,
+        VmaAllocation     memory,
+        std::string       dbgMsg)
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
+        HGpuImg* pGpuImg = new HGpuImg();
+        memset(pGpuImg, 0, sizeof(HGpuImg));
+
+        VkImageCreateInfo imgInfo = GenVkImgCreateInfo(createInfo);
+        VK_CHECK(vkCreateImage(m_vkDevice, &imgInfo, nullptr, &(pGpuImg->gpuImg)));
+
+        // The image doesn't own the memory, so the gpuImgAlloc is null and destroying the image doesn't free it.
+        VK_CHECK(vmaBindImageMemory(m_vmaAllocator, memory, pGpuImg->gpuImg));
+
+        InitGpuImgViewSampler(pGpuImg, createInfo, imgInfo, dbgMsg);
+
+        return pGpuImg;
+    }
+
+    // ================================================================================================================
+    VkMemoryRequirements HGpuRsrcManager::GetGpuImgMemoryRequirements(
+        HGpuImgCreateInfo createInfo)
+    {
+        VkImageCreateInfo imgInfo = GenVkImgCreateInfo(createInfo);
+
+        VkDeviceImageMemoryRequirements imgMemReqInfo{};
+        {
+            imgMemReqInfo.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+            imgMemReqInfo.pCreateInfo = &imgInfo;
+        }
+
+        VkMemoryRequirements2 memReq{};
+        {
+            memReq.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        }
+        vkGetDeviceImageMemoryRequirements(m_vkDevice, &imgMemReqInfo, &memReq);
+
+        return memReq.memoryRequirements;
+    }
+
+    // ================================================================================================================
+    VmaAllocation HGpuRsrcManager::AllocateGpuImgMemory(
+        const VkMemoryRequirements& memReq)
+    {
+        VmaAllocationCreateInfo allocInfo{};
+        {
+            allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+            allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        }
+
+        VmaAllocation alloc = VK_NULL_HANDLE;
+        VK_CHECK(vmaAllocateMemory(m_vmaAllocator, &memReq, &allocInfo, &alloc, nullptr));
+        return alloc;
+    }
+
+    // ================================================================================================================
+    void HGpuRsrcManager::FreeGpuImgMemory(
+        VmaAllocation memory)
+    {
+        vmaFreeMemory(m_vmaAllocator, memory);
+    }
+
+    // ================================================================================================================
+    VkImageCreateInfo HGpuRsrcManager::GenVkImgCreateInfo(
+        const HGpuImgCreateInfo& createInfo)
+    {
         VkImageCreateInfo imgInfo{};
         {
             imgInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -687,16 +1107,16 @@ namespace Hedge
             imgInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             imgInfo.flags = createInfo.imgCreateFlags;
         }
+        return imgInfo;
+    }
 
-
-
-        VK_CHECK(vmaCreateImage(m_vmaAllocator,
-                                &imgInfo,
-                                &imgAllocInfo,
-                                &(pGpuImg->gpuImg),
-                                &(pGpuImg->gpuImgAlloc),
-                                nullptr));
-
+    // ================================================================================================================
+    void HGpuRsrcManager::InitGpuImgViewSampler(
+        HGpuImg*                 pGpuImg,
+        const HGpuImgCreateInfo& createInfo,
+        const VkImageCreateInfo& imgInfo,
+        const std::string&       dbgMsg)
+    {
         // Create VkImageView -- Currently, we only assume a 2D image. We may need a cubemap or a 3D image.
         VkImageViewCreateInfo imgViewInfo{};
         {
@@ -724,11 +1144,11 @@ namespace Hedge
         pGpuImg->gpuImgDescriptorInfo.imageView = pGpuImg->gpuImgView;
         pGpuImg->curImgLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
+        RegisterBindlessImg(pGpuImg);
+
         // std::cout << "Gpu Img Addr: " << pGpuImg->gpuImg << ". Dbg Msg: " << dbgMsg << std::endl;
 
         m_gpuBuffersImgs.insert({ (void*)pGpuImg, {1, dbgMsg, HGPU_IMG} });
-
-        return pGpuImg;
     }
 
     // ================================================================================================================
@@ -770,6 +1190,8 @@ namespace Hedge
         void*             pData,        
         uint32_t          bytes)
     {
+        std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+
         HCommandBuffer hCmdBuffer(m_vkDevice, m_gfxCmdPool, m_gfxQueue);
         VkCommandBuffer cmdBuffer = hCmdBuffer.GetVkCmdBuffer();
 
@@ -1,6 +1,8 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 #include <tuple>
 #include <string>
 
@@ -14,6 +16,12 @@ namespace Hedge
         HGPU_IMG
     };
 
+    // Slot id of an image that isn't in the bindless descriptor array (E.g. render targets, cubemaps).
+    constexpr uint32_t HGPU_INVALID_BINDLESS_IDX = UINT32_MAX;
+
+    // Upper bound of the bindless texture array. It is clamped by the device limits when the set is created.
+    constexpr uint32_t HGPU_MAX_BINDLESS_TEXTURES = 4096;
+
     struct HGpuBuffer
     {
         VkBuffer      gpuBuffer;
@@ -45,6 +53,10 @@ namespace Hedge
         VkImageSubresourceRange  imgSubresRange;
 
         VkImageLayout curImgLayout;
+
+        // Stable slot in the bindless texture array. Assigned at the image creation and is valid until the image is
+        // destroyed. It's HGPU_INVALID_BINDLESS_IDX if the image is not sampled as a 2D texture.
+        uint32_t bindlessIdx;
     };
 
     struct HGpuImgCreateInfo
@@ -79,13 +91,16 @@ namespace Hedge
         ~HGpuRsrcManager();
 
         // Init functions
-        void CreateVulkanAppInstDebugger();
+        // A headless instance doesn't init the GLFW or enable the surface extensions. A null pSurface creates a device
+        // without the present queue and the swapchain, which can be a software rasterizer like the lavapipe.
+        void CreateVulkanAppInstDebugger(bool isHeadless = false);
         void CreateVulkanPhyLogicalDevice(VkSurfaceKHR* pSurface);
 
         // Create basic and shared graphics widgets
         void CreateCommandPool();
         void CreateDescriptorPool();
         void CreateVmaObjects();
+        void CreateBindlessDescriptorSet();
 
         // Getting interface
         VkInstance* GetVkInstance() { return &m_vkInst; }
@@ -99,9 +114,29 @@ namespace Hedge
         VkCommandPool* GetGfxCmdPool() { return &m_gfxCmdPool; }
         // VmaAllocator* GetVmaAllocator() { return &m_vmaAllocator; }
 
-        void WaitDeviceIdle() { vkDeviceWaitIdle(m_vkDevice); };
+        // Bindless: One update-after-bind descriptor set holds all sampled 2D images indexed by HGpuImg::bindlessIdx.
+        bool IsBindlessSupported() { return m_bindlessSupported; }
+        VkDescriptorSetLayout GetBindlessDescriptorSetLayout() { return m_bindlessDescriptorSetLayout; }
+        VkDescriptorSet GetBindlessDescriptorSet() { return m_bindlessDescriptorSet; }
+
+        // VK_KHR_draw_indirect_count is used by the GPU driven renderer.
+        bool IsDrawIndirectCountSupported() { return m_drawIndirectCountSupported; }
+
+        // The pipelineStatisticsQuery and the inheritedQueries features.
+        bool IsPipelineStatisticsSupported() { return m_pipelineStatisticsSupported; }
+
+        // Nanoseconds per timestamp tick. 0 means the graphics queue doesn't support timestamps.
+        float GetTimestampPeriod() { return m_timestampPeriod; }
+        uint32_t GetTimestampValidBits() { return m_timestampValidBits; }
+
+        void WaitDeviceIdle()
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_rsrcMutex);
+            vkDeviceWaitIdle(m_vkDevice);
+        }
 
         // GPU resource manage functions. The users should derefer the buffer or image when it is not needed.
+        // They can be called from the scene recording job and the game thread at the same time.
         // Add one more refer counter of this buffer or image
         void ReferGpuBufferImg(void* pGpuBufferImg);
 
@@ -113,9 +148,18 @@ namespace Hedge
         // HGpuBuffer* CreateGpuBuffer(VkBufferUsageFlags usage, VmaAllocationCreateFlags vmaFlags, uint32_t bytesNum);
         HGpuBuffer* CreateGpuBuffer(VkBufferUsageFlags usage, VmaAllocationCreateFlags vmaFlags, uint32_t bytesNum, std::string dbgMsg);
         void SendDataToBuffer(const HGpuBuffer* const pGpuBuffer, void* pData, uint32_t bytes);
+        void ReadDataFromBuffer(const HGpuBuffer* const pGpuBuffer, void* pData, uint32_t bytes);
 
         // HGpuImg* CreateGpuImage(HGpuImgCreateInfo createInfo);
         HGpuImg* CreateGpuImage(HGpuImgCreateInfo createInfo, std::string dbgMsg);
+
+        // Aliasing images are bound to a memory allocated by the AllocateGpuImgMemory(...). Images that are not used at
+        // the same time can share the memory. Destroying the image doesn't free the memory.
+        HGpuImg* CreateAliasingGpuImage(HGpuImgCreateInfo createInfo, VmaAllocation memory, std::string dbgMsg);
+        VkMemoryRequirements GetGpuImgMemoryRequirements(HGpuImgCreateInfo createInfo);
+        VmaAllocation AllocateGpuImgMemory(const VkMemoryRequirements& memReq);
+        void FreeGpuImgMemory(VmaAllocation memory);
+
         void SendDataToImage(HGpuImg* pGpuImg, VkBufferImageCopy bufToImgCopyInfo, void* pData, uint32_t bytes);
 
         void CleanColorGpuImage(HGpuImg* pTargetImg, VkClearColorValue* pClearColorVal);
@@ -129,9 +173,22 @@ namespace Hedge
         void CleanupAllRsrc();
 
     private:
+        VkPhysicalDevice PickPhysicalDevice(VkSurfaceKHR* pSurface);
+
         void DestroyGpuBufferResource(const HGpuBuffer* const pGpuBuffer);
         void DestroyGpuImgResource(const HGpuImg* const pGpuImg);
 
+        VkImageCreateInfo GenVkImgCreateInfo(const HGpuImgCreateInfo& createInfo);
+
+        // Create the view and the sampler of a created image and start its refer counting.
+        void InitGpuImgViewSampler(HGpuImg*                 pGpuImg,
+                                   const HGpuImgCreateInfo& createInfo,
+                                   const VkImageCreateInfo& imgInfo,
+                                   const std::string&       dbgMsg);
+
+        void RegisterBindlessImg(HGpuImg* pGpuImg);
+        void ReleaseBindlessSlot(uint32_t slotIdx);
+
         // Vulkan core objects
         VkInstance       m_vkInst;
         VkPhysicalDevice m_vkPhyDevice;
@@ -142,6 +199,21 @@ namespace Hedge
         VkDescriptorPool m_descriptorPool; // The descriptor pool is still needed for the imgui.
         VmaAllocator     m_vmaAllocator;
 
+        // Bindless textures
+        bool                  m_bindlessSupported;
+        uint32_t              m_bindlessSlotsCnt;
+        uint32_t              m_nextBindlessSlot;
+        std::vector<uint32_t> m_freeBindlessSlots;
+        VkDescriptorSetLayout m_bindlessDescriptorSetLayout;
+        VkDescriptorPool      m_bindlessDescriptorPool;
+        VkDescriptorSet       m_bindlessDescriptorSet;
+
+        bool m_drawIndirectCountSupported;
+        bool m_pipelineStatisticsSupported;
+
+        float    m_timestampPeriod;
+        uint32_t m_timestampValidBits;
+
         // Logical and physical devices context
         uint32_t m_gfxQueueFamilyIdx;
         uint32_t m_computeQueueFamilyIdx;
@@ -152,6 +224,11 @@ namespace Hedge
 
         // std::unordered_map<void*, uint32_t> m_gpuBuffersImgs;
         std::unordered_map<void*, std::tuple<uint32_t, std::string, HGpuRsrcType>> m_gpuBuffersImgs;
+
+        // The pipelined frames record the scene on a job while the game thread creates and releases resources. So, the
+        // refer counters, the bindless slots and the one-shot commands on the m_gfxCmdPool and the m_gfxQueue are
+        // serialized. It's recursive because releasing or creating a resource can call other locked functions.
+        std::recursive_mutex m_rsrcMutex;
 #ifndef NDEBUG
         // Debug mode
         void ValidateDebugExtAndValidationLayer();
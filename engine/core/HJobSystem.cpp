@@ -0,0 +1,499 @@
+#include "HJobSystem.h"
+#include <algorithm>
+#include <cassert>
+
+namespace Hedge
+{
+    struct HJob
+    {
+        HJobFunc     func;
+        HJobCounter* pCounter;
+    };
+
+    static thread_local uint32_t t_threadIdx = HJOB_INVALID_THREAD_IDX;
+
+    // Nested jobs run inside of the jobs waiting on them, so only the outermost jobs are timed.
+    static thread_local uint32_t t_jobsDepth = 0;
+
+    // ================================================================================================================
+    HJobSystem::HJobDeque::HJobDeque()
+        : m_top(0),
+          m_bottom(0)
+    {}
+
+    // ================================================================================================================
+    bool HJobSystem::HJobDeque::Push(
+        HJob* pJob)
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        if (bottom - top >= HJOB_DEQUE_CAPACITY)
+        {
+            return false;
+        }
+
+        m_jobs[bottom & (HJOB_DEQUE_CAPACITY - 1)].store(pJob, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // ================================================================================================================
+    HJob* HJobSystem::HJobDeque::Pop()
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // Empty.
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        HJob* pJob = m_jobs[bottom & (HJOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            // The last job. The thieves may be taking it at the same time.
+            bool isTaken = m_top.compare_exchange_strong(top,
+                                                         top + 1,
+                                                         std::memory_order_seq_cst,
+                                                         std::memory_order_relaxed);
+            if (isTaken == false)
+            {
+                pJob = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return pJob;
+    }
+
+    // ================================================================================================================
+    HJob* HJobSystem::HJobDeque::Steal()
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+        {
+            return nullptr;
+        }
+
+        // The slot can only be reused after the top moves on, which fails the exchange below.
+        HJob* pJob = m_jobs[top & (HJOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed) == false)
+        {
+            return nullptr;
+        }
+        return pJob;
+    }
+
+    // ================================================================================================================
+    HJobSystem::HJobSystem()
+        : m_threadsCnt(0),
+          m_queuedJobsCnt(0),
+          m_sleepingCnt(0),
+          m_exit(false)
+    {}
+
+    // ================================================================================================================
+    HJobSystem::~HJobSystem()
+    {
+        Cleanup();
+    }
+
+    // ================================================================================================================
+    uint32_t HJobSystem::GetCurThreadIdx()
+    {
+        return t_threadIdx;
+    }
+
+    // ================================================================================================================
+    void HJobSystem::Init(
+        uint32_t threadsCnt)
+    {
+        assert(m_threadsCnt == 0);
+
+        if (threadsCnt == 0)
+        {
+            threadsCnt = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        m_threadsCnt = threadsCnt;
+        m_queuedJobsCnt = 0;
+        m_sleepingCnt = 0;
+        m_exit = false;
+
+        for (uint32_t thread = 0; thread < threadsCnt; thread++)
+        {
+            m_threadsData.push_back(std::make_unique<HThreadData>());
+            m_threadsData.back()->rngState = 0x9E3779B9u * (thread + 1);
+        }
+        ResetStats();
+
+        // The calling thread is the thread 0.
+        t_threadIdx = 0;
+        for (uint32_t thread = 1; thread < threadsCnt; thread++)
+        {
+            m_workers.push_back(std::thread(&HJobSystem::WorkerLoop, this, thread));
+        }
+    }
+
+    // ================================================================================================================
+    void HJobSystem::Cleanup()
+    {
+        if (m_threadsCnt == 0)
+        {
+            return;
+        }
+        assert(GetCurThreadIdx() == 0);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_exit = true;
+        }
+        m_jobCv.notify_all();
+
+        for (std::thread& worker : m_workers)
+        {
+            worker.join();
+        }
+        m_workers.clear();
+
+        // The workers drained all deques, but the main thread jobs may still be queued.
+        ProcessMainThreadJobs();
+
+        m_threadsData.clear();
+        m_threadsCnt = 0;
+        t_threadIdx = HJOB_INVALID_THREAD_IDX;
+    }
+
+    // ================================================================================================================
+    void HJobSystem::Run(
+        HJobFunc     func,
+        HJobCounter* pCounter,
+        HJobCounter* pDependency)
+    {
+        HJob* pJob = new HJob{ std::move(func), pCounter };
+        if (pCounter != nullptr)
+        {
+            pCounter->m_pendingCnt.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (pDependency != nullptr)
+        {
+            // The dependency's last job takes the continuations under the same lock.
+            std::lock_guard<std::mutex> lock(pDependency->m_mutex);
+            if (pDependency->m_pendingCnt.load(std::memory_order_acquire) != 0)
+            {
+                pDependency->m_continuations.push_back(pJob);
+                return;
+            }
+        }
+
+        Schedule(pJob);
+    }
+
+    // ================================================================================================================
+    void HJobSystem::RunOnMainThread(
+        HJobFunc     func,
+        HJobCounter* pCounter)
+    {
+        HJob* pJob = new HJob{ std::move(func), pCounter };
+        if (pCounter != nullptr)
+        {
+            pCounter->m_pendingCnt.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Nobody would process the queue before the Init(...).
+        if (m_threadsCnt == 0)
+        {
+            Execute(pJob, HJOB_INVALID_THREAD_IDX);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+        m_mainThreadJobs.push_back(pJob);
+    }
+
+    // ================================================================================================================
+    void HJobSystem::Schedule(
+        HJob* pJob)
+    {
+        uint32_t threadIdx = GetCurThreadIdx();
+
+        // Run it on the spot before the Init(...), on the foreign threads or when the deque is full.
+        if ((m_threadsCnt == 0) ||
+            (threadIdx == HJOB_INVALID_THREAD_IDX) ||
+            (m_threadsData[threadIdx]->deque.Push(pJob) == false))
+        {
+            Execute(pJob, threadIdx);
+            return;
+        }
+
+        m_queuedJobsCnt.fetch_add(1, std::memory_order_seq_cst);
+        if (m_sleepingCnt.load(std::memory_order_seq_cst) != 0)
+        {
+            // A worker between its check and its wait holds the mutex, so it can't miss the notification.
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+            }
+            m_jobCv.notify_one();
+        }
+    }
+
+    // ================================================================================================================
+    HJob* HJobSystem::FindJob(
+        uint32_t threadIdx)
+    {
+        if (m_threadsCnt == 0)
+        {
+            return nullptr;
+        }
+
+        HJob* pJob = nullptr;
+        uint32_t firstVictim = 0;
+        if (threadIdx != HJOB_INVALID_THREAD_IDX)
+        {
+            HThreadData& threadData = *m_threadsData[threadIdx];
+            pJob = threadData.deque.Pop();
+
+            // Xorshift. Random victims keep the thieves from hitting the same deque.
+            uint32_t rng = threadData.rngState;
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            threadData.rngState = rng;
+            firstVictim = rng % m_threadsCnt;
+        }
+
+        for (uint32_t i = 0; (i < m_threadsCnt) && (pJob == nullptr); i++)
+        {
+            uint32_t victim = (firstVictim + i) % m_threadsCnt;
+            if (victim == threadIdx)
+            {
+                continue;
+            }
+
+            pJob = m_threadsData[victim]->deque.Steal();
+            if ((pJob != nullptr) && (threadIdx != HJOB_INVALID_THREAD_IDX))
+            {
+                m_threadsData[threadIdx]->stolenJobsCnt.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        if (pJob != nullptr)
+        {
+            m_queuedJobsCnt.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return pJob;
+    }
+
+    // ================================================================================================================
+    void HJobSystem::Execute(
+        HJob*    pJob,
+        uint32_t threadIdx)
+    {
+        auto beginTime = std::chrono::steady_clock::now();
+
+        t_jobsDepth++;
+        pJob->func();
+        t_jobsDepth--;
+
+        HJobCounter* pCounter = pJob->pCounter;
+        delete pJob;
+
+        if (pCounter != nullptr)
+        {
+            // The waiters may destroy the counter as soon as the lock is released.
+            std::vector<HJob*> continuations;
+            {
+                std::lock_guard<std::mutex> lock(pCounter->m_mutex);
+                if (pCounter->m_pendingCnt.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    continuations.swap(pCounter->m_continuations);
+                }
+            }
+
+            for (HJob* pContinuation : continuations)
+            {
+                Schedule(pContinuation);
+            }
+        }
+
+        if ((threadIdx != HJOB_INVALID_THREAD_IDX) && (threadIdx < m_threadsData.size()))
+        {
+            HThreadData& threadData = *m_threadsData[threadIdx];
+            threadData.jobsCnt.fetch_add(1, std::memory_order_relaxed);
+            if (t_jobsDepth == 0)
+            {
+                auto busyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                   beginTime);
+                threadData.busyNs.fetch_add(busyNs.count(), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // ================================================================================================================
+    bool HJobSystem::ExecuteMainThreadJob()
+    {
+        HJob* pJob = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+            if (m_mainThreadJobs.empty())
+            {
+                return false;
+            }
+            pJob = m_mainThreadJobs.front();
+            m_mainThreadJobs.pop_front();
+        }
+
+        Execute(pJob, 0);
+        return true;
+    }
+
+    // ================================================================================================================
+    void HJobSystem::ProcessMainThreadJobs()
+    {
+        assert(GetCurThreadIdx() == 0);
+
+        // The jobs queued by these jobs wait for the next call, so it always returns.
+        std::deque<HJob*> jobs;
+        {
+            std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+            jobs.swap(m_mainThreadJobs);
+        }
+
+        for (HJob* pJob : jobs)
+        {
+            Execute(pJob, 0);
+        }
+    }
+
+    // ================================================================================================================
+    void HJobSystem::Wait(
+        HJobCounter& counter)
+    {
+        uint32_t threadIdx = GetCurThreadIdx();
+        while (counter.IsDone() == false)
+        {
+            if ((threadIdx == 0) && ExecuteMainThreadJob())
+            {
+                continue;
+            }
+
+            HJob* pJob = FindJob(threadIdx);
+            if (pJob != nullptr)
+            {
+                Execute(pJob, threadIdx);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        // The last job may still hold the counter's lock.
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+    }
+
+    // ================================================================================================================
+    void HJobSystem::ParallelFor(
+        uint32_t             cnt,
+        uint32_t             chunkSize,
+        const HJobRangeFunc& func)
+    {
+        assert(chunkSize > 0);
+        if (cnt == 0)
+        {
+            return;
+        }
+
+        uint32_t chunksCnt = (cnt + chunkSize - 1) / chunkSize;
+        if ((chunksCnt == 1) || (m_threadsCnt <= 1) || (GetCurThreadIdx() == HJOB_INVALID_THREAD_IDX))
+        {
+            func(0, cnt);
+            return;
+        }
+
+        HJobCounter counter;
+        for (uint32_t chunk = 1; chunk < chunksCnt; chunk++)
+        {
+            uint32_t begin = chunk * chunkSize;
+            uint32_t end = std::min(begin + chunkSize, cnt);
+            Run([&func, begin, end]() { func(begin, end); }, &counter);
+        }
+
+        func(0, chunkSize);
+        Wait(counter);
+    }
+
+    // ================================================================================================================
+    void HJobSystem::WorkerLoop(
+        uint32_t threadIdx)
+    {
+        t_threadIdx = threadIdx;
+
+        uint32_t idleCnt = 0;
+        while (true)
+        {
+            HJob* pJob = FindJob(threadIdx);
+            if (pJob != nullptr)
+            {
+                Execute(pJob, threadIdx);
+                idleCnt = 0;
+                continue;
+            }
+
+            // Jobs often come in bursts, so spinning a little is cheaper than sleeping and being notified.
+            if (idleCnt < HJOB_IDLE_SPIN_CNT)
+            {
+                idleCnt++;
+                std::this_thread::yield();
+                continue;
+            }
+            idleCnt = 0;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_exit && (m_queuedJobsCnt.load(std::memory_order_seq_cst) <= 0))
+            {
+                return;
+            }
+
+            m_sleepingCnt.fetch_add(1, std::memory_order_seq_cst);
+            m_jobCv.wait(lock, [&]() { return m_exit || (m_queuedJobsCnt.load(std::memory_order_seq_cst) > 0); });
+            m_sleepingCnt.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+
+    // ================================================================================================================
+    HJobThreadStats HJobSystem::GetThreadStats(
+        uint32_t threadIdx) const
+    {
+        const HThreadData& threadData = *m_threadsData[threadIdx];
+        double elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_statsBeginTime).count();
+
+        HJobThreadStats stats{};
+        {
+            stats.jobsCnt = threadData.jobsCnt.load(std::memory_order_relaxed);
+            stats.stolenJobsCnt = threadData.stolenJobsCnt.load(std::memory_order_relaxed);
+            stats.busySec = threadData.busyNs.load(std::memory_order_relaxed) * 1e-9;
+            stats.utilization = (elapsedSec > 0.0) ? std::min(stats.busySec / elapsedSec, 1.0) : 0.0;
+        }
+        return stats;
+    }
+
+    // ================================================================================================================
+    void HJobSystem::ResetStats()
+    {
+        for (auto& pThreadData : m_threadsData)
+        {
+            pThreadData->jobsCnt = 0;
+            pThreadData->stolenJobsCnt = 0;
+            pThreadData->busyNs = 0;
+        }
+        m_statsBeginTime = std::chrono::steady_clock::now();
+    }
+}
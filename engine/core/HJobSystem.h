@@ -0,0 +1,169 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Each thread's deque holds this many queued jobs. A job that doesn't fit runs on the spot instead.
+#define HJOB_DEQUE_CAPACITY 4096
+
+// An idle worker keeps looking for jobs this many times before it sleeps.
+#define HJOB_IDLE_SPIN_CNT 64
+
+// The thread index of the threads that are not in the job system.
+#define HJOB_INVALID_THREAD_IDX UINT32_MAX
+
+namespace Hedge
+{
+    using HJobFunc = std::function<void()>;
+
+    // Range [begin, end) of a ParallelFor(...).
+    using HJobRangeFunc = std::function<void(uint32_t begin, uint32_t end)>;
+
+    struct HJob;
+
+    // Counts the unfinished jobs that are run with it. A counter can be waited and can be the dependency of other
+    // jobs, which are only queued after it reaches 0. It must outlive its jobs and the jobs depending on it.
+    class HJobCounter
+    {
+    public:
+        HJobCounter() : m_pendingCnt(0) {}
+        ~HJobCounter() {}
+
+        HJobCounter(const HJobCounter&) = delete;
+        HJobCounter& operator=(const HJobCounter&) = delete;
+
+        bool IsDone() const { return m_pendingCnt.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class HJobSystem;
+
+        std::atomic<uint32_t> m_pendingCnt;
+        std::mutex            m_mutex;         // Guards the continuations against the last finishing job.
+        std::vector<HJob*>    m_continuations; // Jobs depending on this counter.
+    };
+
+    // The accumulated work of a thread since the last ResetStats().
+    struct HJobThreadStats
+    {
+        uint64_t jobsCnt;
+        uint64_t stolenJobsCnt; // Jobs taken from the other threads' deques.
+        double   busySec;
+        double   utilization;   // busySec / The seconds since the last ResetStats().
+    };
+
+    // The engine's job system. Parallel work of the engine is expressed as jobs instead of dedicated threads, so the
+    // subsystems share one set of workers and never oversubscribe the cores.
+    // - Every thread has a Chase-Lev work stealing deque (Chase and Lev 2005, with the C11 memory orders of Le et al.
+    //   2013). A thread pushes and pops its own jobs at the bottom, so the latest job runs while it's hot in the
+    //   cache, and the idle threads steal the oldest jobs from the top.
+    // - Waiting on a counter executes other jobs instead of blocking, so jobs can run and wait for nested jobs.
+    // - Jobs that must run on the main thread (E.g. GLFW, ImGui and the queue submissions) go to a separate queue,
+    //   which is drained by ProcessMainThreadJobs() and the main thread's waits.
+    // - Idle workers sleep on a condition variable and are only notified when some workers are sleeping.
+    //
+    // The thread calling Init(...) is the main thread, which is the thread 0. Workers are the threads [1, threadsCnt).
+    // Jobs run from the threads out of the job system are executed on the spot.
+    class HJobSystem
+    {
+    public:
+        HJobSystem();
+        ~HJobSystem();
+
+        // threadsCnt includes the calling thread. 0 means to use the hardware concurrency.
+        void Init(uint32_t threadsCnt);
+
+        // The queued jobs are finished before the workers exit.
+        void Cleanup();
+
+        // Queue the func on any thread. The pCounter is optional and counts the job until it's finished. The job is
+        // only queued after the optional pDependency reaches 0.
+        void Run(HJobFunc func, HJobCounter* pCounter = nullptr, HJobCounter* pDependency = nullptr);
+
+        // Queue the func for the main thread. It can be called from any thread.
+        void RunOnMainThread(HJobFunc func, HJobCounter* pCounter = nullptr);
+
+        // Execute the other jobs until the counter reaches 0.
+        void Wait(HJobCounter& counter);
+
+        // Split [0, cnt) into chunks of chunkSize and run them on all threads. The calling thread takes the first
+        // chunk and returns after all of them are done.
+        void ParallelFor(uint32_t cnt, uint32_t chunkSize, const HJobRangeFunc& func);
+
+        // Run the queued main thread jobs. Called by the main thread once per frame.
+        void ProcessMainThreadJobs();
+
+        uint32_t GetThreadsCnt() const { return m_threadsCnt; }
+
+        // 0 is the main thread. HJOB_INVALID_THREAD_IDX for the threads that are not in the job system.
+        static uint32_t GetCurThreadIdx();
+
+        // Instrumentation. The stats can be read from any thread while the jobs are running.
+        HJobThreadStats GetThreadStats(uint32_t threadIdx) const;
+        void ResetStats();
+
+    private:
+        // Chase-Lev work stealing deque. Only the owner thread can push and pop. Any thread can steal.
+        class HJobDeque
+        {
+        public:
+            HJobDeque();
+
+            // Return false if the deque is full.
+            bool Push(HJob* pJob);
+            HJob* Pop();
+            HJob* Steal();
+
+        private:
+            alignas(64) std::atomic<int64_t> m_top;
+            alignas(64) std::atomic<int64_t> m_bottom;
+            std::atomic<HJob*>               m_jobs[HJOB_DEQUE_CAPACITY];
+        };
+
+        struct alignas(64) HThreadData
+        {
+            HJobDeque             deque;
+            uint32_t              rngState; // Picks the stealing victims.
+            std::atomic<uint64_t> jobsCnt;
+            std::atomic<uint64_t> stolenJobsCnt;
+            std::atomic<uint64_t> busyNs;
+        };
+
+        // Push the job into the calling thread's deque and wake a sleeping worker.
+        void Schedule(HJob* pJob);
+
+        // Pop a job of the thread or steal one from the others. Return nullptr if all deques are empty.
+        HJob* FindJob(uint32_t threadIdx);
+
+        // Run the job, finish its counter and queue the jobs depending on the counter.
+        void Execute(HJob* pJob, uint32_t threadIdx);
+
+        // Return false if there is no main thread job.
+        bool ExecuteMainThreadJob();
+
+        void WorkerLoop(uint32_t threadIdx);
+
+        uint32_t                                  m_threadsCnt;
+        std::vector<std::unique_ptr<HThreadData>> m_threadsData;
+        std::vector<std::thread>                  m_workers;
+
+        std::mutex        m_mainThreadMutex;
+        std::deque<HJob*> m_mainThreadJobs;
+
+        // Idle workers. The queued jobs counter is increased before checking the sleeping workers and the workers
+        // increase the sleeping counter before checking the queued jobs, so a job never waits for a sleeping worker.
+        std::mutex              m_mutex;
+        std::condition_variable m_jobCv;
+        std::atomic<int32_t>    m_queuedJobsCnt;
+        std::atomic<uint32_t>   m_sleepingCnt;
+        bool                    m_exit;
+
+        std::chrono::steady_clock::time_point m_statsBeginTime;
+    };
+}
@@ -4,6 +4,7 @@
 #include "HEntity.h"
 #include "Utils.h"
 #include <fstream>
+#include <iostream>
 #include <vector>
 #include <map>
 
@@ -29,6 +30,14 @@ namespace Hedge
         m_dict.insert({ nameHash, regInfo });
     }
 
+    // ================================================================================================================
+    const RegisterClassInfo* HSerializer::GetClassInfo(
+        uint32_t nameHash) const
+    {
+        auto itr = m_dict.find(nameHash);
+        return (itr != m_dict.end()) ? &itr->second : nullptr;
+    }
+
     // ================================================================================================================
     void HSerializer::SerializeScene(
         std::string& yamlNamePath, 
@@ -69,12 +78,18 @@ namespace Hedge
             const std::string& entityName = itr.first;
             std::string entityType = itr.second["Type"].as<std::string>();
 
-            RegisterClassInfo info = m_dict[crc32(entityType.c_str())];
-            HEntity* pEntity = info.pfnNewEntity();
+            uint32_t classNameHash = crc32(entityType.c_str());
+            const RegisterClassInfo* pInfo = GetClassInfo(classNameHash);
+            if (pInfo == nullptr)
+            {
+                std::cerr << "Skip the entity " << entityName << ". Its class " << entityType
+                          << " is not registered." << std::endl;
+                continue;
+            }
 
-            scene.SpawnEntity(pEntity, eventManager);
+            HEntity* pEntity = scene.SpawnEntity(classNameHash, *pInfo, eventManager);
 
-            info.pfnDeserialize(itr.second["Components"], entityName, pEntity);
+            pInfo->pfnDeserialize(itr.second["Components"], entityName, pEntity);
         }
     }
 }
\ No newline at end of file
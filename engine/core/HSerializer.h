@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <unordered_map>
 #include "yaml-cpp/yaml.h"
 
@@ -19,12 +20,16 @@ namespace Hedge
 typedef void (*PFN_SERIALIZE)(YAML::Emitter& emitter, Hedge::HEntity* pThis);
 typedef void (*PFN_DESERIALIZE)(YAML::Node& node, const std::string& name, Hedge::HEntity* pThis);
 typedef Hedge::HEntity* (*PFN_NEWENTITY)();
+typedef Hedge::HEntity* (*PFN_NEWENTITY_IN_PLACE)(void* pMem); // Placement new into the scene's entity pool.
 
 struct RegisterClassInfo
 {
     PFN_SERIALIZE pfnSerialize;
     PFN_DESERIALIZE pfnDeserialize;
     PFN_NEWENTITY pfnNewEntity;
+    PFN_NEWENTITY_IN_PLACE pfnNewEntityInPlace;
+    size_t classSize;  // sizeof(...) and alignof(...) of the class for its pool.
+    size_t classAlign;
 };
 
 namespace Hedge
@@ -39,6 +44,10 @@ namespace Hedge
         ~HSerializer();
 
         void RegisterAClass(uint32_t nameHash, RegisterClassInfo regInfo);
+
+        // Return nullptr if the class is not registered.
+        const RegisterClassInfo* GetClassInfo(uint32_t nameHash) const;
+
         void SerializeScene(std::string& yamlNamePath, HScene& scene);
         void DeserializeYamlToScene(const std::string& yamlNamePath, HScene& scene, HEventManager& eventManager);
 
@@ -2,6 +2,7 @@
 #include "render/HRenderManager.h"
 #include "core/HFrameListener.h"
 #include "scene/HScene.h"
+#include "core/HJobSystem.h"
 
 // Hide console window in release mode
 #ifndef _DEBUG
@@ -11,6 +12,7 @@
 extern Hedge::HFrameListener* g_pFrameListener;
 extern Hedge::HRenderManager* g_pRenderManager;
 extern Hedge::HGpuRsrcManager* g_pGpuRsrcManager;
+extern Hedge::HJobSystem* g_pJobSystem;
 
 void main(int argc, char** argv)
 {
@@ -25,25 +27,55 @@ void main(int argc, char** argv)
         // Poll events, resize handling
         g_pRenderManager->BeginNewFrame();
 
-        // Frame listener frame start
-        g_pFrameListener->FrameStarted();
+        // Jobs handed over to the main thread. E.g. Window and GUI calls.
+        g_pJobSystem->ProcessMainThreadJobs();
 
-        // Issue io events
-        g_pRenderManager->SendIOEvents(g_pFrameListener->GetActiveScene(),
-                                       g_pFrameListener->GetEventManager());
+        if (g_pRenderManager->IsPipelinedFramesEnabled())
+        {
+            // Record the last frame's scene snapshot on a job while this frame is simulated.
+            g_pRenderManager->BeginRecordSceneSnapshot();
 
-        g_pFrameListener->EntitiesPreRenderTick();
+            g_pFrameListener->FrameStarted();
 
-        // Render current scene (Generate scene rendering command buffer)
-        g_pRenderManager->RenderCurrentScene(g_pFrameListener->GetActiveSceneRenderInfo());
+            g_pRenderManager->SendIOEvents(g_pFrameListener->GetActiveScene(),
+                                           g_pFrameListener->GetEventManager());
 
-        g_pFrameListener->EntitiesPostRenderTick();
+            g_pFrameListener->EntitiesPreRenderTick();
 
-        // Frame listener frame end
-        g_pFrameListener->FrameEnded();
+            g_pRenderManager->StoreSceneSnapshot(g_pFrameListener->GetActiveSceneRenderInfo());
 
-        // Generate HUD info
-        g_pRenderManager->DrawHud(g_pFrameListener);
+            g_pFrameListener->EntitiesPostRenderTick();
+
+            g_pFrameListener->FrameEnded();
+
+            // The HUD shows the recorded scene image, so it waits for the recording.
+            g_pRenderManager->EndRecordSceneSnapshot();
+        }
+        else
+        {
+            // Frame listener frame start
+            g_pFrameListener->FrameStarted();
+
+            // Issue io events
+            g_pRenderManager->SendIOEvents(g_pFrameListener->GetActiveScene(),
+                                           g_pFrameListener->GetEventManager());
+
+            g_pFrameListener->EntitiesPreRenderTick();
+
+            // Render current scene (Generate scene rendering command buffer)
+            g_pRenderManager->RenderCurrentScene(g_pFrameListener->GetActiveSceneRenderInfo());
+
+            g_pFrameListener->EntitiesPostRenderTick();
+
+            // Frame listener frame end
+            g_pFrameListener->FrameEnded();
+        }
+
+        // Generate HUD info. There is no HUD without a window.
+        if (g_pRenderManager->IsHeadless() == false)
+        {
+            g_pRenderManager->DrawHud(g_pFrameListener);
+        }
 
         // Finalize the scene and swap buffers (Generate HUD rendering command buffer and submit to queue)
         g_pRenderManager->FinalizeSceneAndSwapBuffers();
@@ -13,6 +13,7 @@ Hedge::HFrameListener* g_pFrameListener = g_raiiManager.GetGame();
 Hedge::HRenderManager* g_pRenderManager = g_raiiManager.GetGameRenderManager();
 Hedge::HGpuRsrcManager* g_pGpuRsrcManager = g_raiiManager.GetGpuRsrcManager();
 Hedge::HAssetRsrcManager* g_pAssetRsrcManager = g_raiiManager.GetAssetRsrcManager();
+Hedge::HJobSystem* g_pJobSystem = g_raiiManager.GetJobSystem();
 
 namespace Hedge
 {
@@ -159,9 +160,10 @@ namespace Hedge
 
     // ================================================================================================================
     HGameRenderManager::HGameRenderManager(
-        HBaseGuiManager* pGuiManager,
-        HGpuRsrcManager* pGpuRsrcManager)
-        : HRenderManager(pGuiManager, pGpuRsrcManager)
+        HBaseGuiManager*           pGuiManager,
+        HGpuRsrcManager*           pGpuRsrcManager,
+        const HHeadlessRenderInfo* pHeadlessInfo)
+        : HRenderManager(pGuiManager, pGpuRsrcManager, pHeadlessInfo)
     {}
 
     // ================================================================================================================
@@ -192,15 +194,28 @@ namespace Hedge
         delete m_pGameTemplate;
         delete m_pAssetRsrcManager;
         delete m_pGpuRsrcManager;
+
+        delete m_pJobSystem;
     }
 
     // ================================================================================================================
     void GlobalVariablesRAIIManager::CreateCustomGlobalVariables()
     {
+        // The other managers' threads are jobs, so the job system is the first one in and the last one out.
+        m_pJobSystem = new HJobSystem();
+        m_pJobSystem->Init(0);
+
         m_pGameTemplate = new HGameTemplate();
         m_pGameGuiManager = new HGameGuiManager();
         m_pGpuRsrcManager = new HGpuRsrcManager();
-        m_pGameRenderManager = new HGameRenderManager(m_pGameGuiManager, m_pGpuRsrcManager);
+
+        // The game runs headless on the machines without a display. E.g. The automated performance tests.
+        HHeadlessRenderInfo headlessInfo{};
+        bool isHeadless = HRenderManager::GetHeadlessRenderInfoFromEnv(&headlessInfo);
+        m_pGameRenderManager = new HGameRenderManager(m_pGameGuiManager,
+                                                      m_pGpuRsrcManager,
+                                                      isHeadless ? &headlessInfo : nullptr);
+
         m_pAssetRsrcManager = new HAssetRsrcManager();
 
         std::string exePathName = GetExePath();
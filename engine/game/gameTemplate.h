@@ -2,6 +2,7 @@
 
 #include "../core/HFrameListener.h"
 #include "../core/HGpuRsrcManager.h"
+#include "../core/HJobSystem.h"
 #include "../render/HRenderManager.h"
 #include "../render/HBaseGuiManager.h"
 #include "../scene/HScene.h"
@@ -22,7 +23,7 @@ namespace Hedge
         virtual void AppStarts() override;
 
         virtual HScene& GetActiveScene() override { return *m_pScene; }
-        virtual SceneRenderInfo GetActiveSceneRenderInfo() override { return m_pScene->GetSceneRenderInfo(); }
+        virtual const SceneRenderInfo& GetActiveSceneRenderInfo() override { return m_pScene->GetSceneRenderInfo(); }
 
     protected:
         virtual void RegisterCustomSerializeClass() override {};
@@ -48,7 +49,9 @@ namespace Hedge
     class HGameRenderManager : public HRenderManager
     {
     public:
-        HGameRenderManager(HBaseGuiManager* pGuiManager, HGpuRsrcManager* pGpuRsrcManager);
+        HGameRenderManager(HBaseGuiManager*           pGuiManager,
+                           HGpuRsrcManager*           pGpuRsrcManager,
+                           const HHeadlessRenderInfo* pHeadlessInfo = nullptr);
         virtual ~HGameRenderManager();
 
         virtual void DrawHud(HFrameListener* pFrameListener) override;
@@ -65,6 +68,7 @@ namespace Hedge
         HGameGuiManager* GetGameGuiManager() { return m_pGameGuiManager; }
         HGpuRsrcManager* GetGpuRsrcManager() { return m_pGpuRsrcManager; }
         HAssetRsrcManager* GetAssetRsrcManager() { return m_pAssetRsrcManager; }
+        HJobSystem* GetJobSystem() { return m_pJobSystem; }
 
     protected:
         virtual void CreateCustomGlobalVariables();
@@ -75,5 +79,6 @@ namespace Hedge
         HGameGuiManager* m_pGameGuiManager;
         HGpuRsrcManager* m_pGpuRsrcManager;
         HAssetRsrcManager* m_pAssetRsrcManager;
+        HJobSystem* m_pJobSystem;
     };
 }
@@ -107,6 +107,12 @@ namespace Hedge
     // ================================================================================================================
     HBaseGuiManager::~HBaseGuiManager()
     {
+        // The GUI is not initialized in the headless mode.
+        if (m_pVkDevice == nullptr)
+        {
+            return;
+        }
+
         ImGui_ImplVulkan_Shutdown();
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
@@ -178,7 +178,9 @@ namespace Hedge
             }
             vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
 
-            std::vector<ShaderInputBinding> bindings = GenPerFrameGpuRsrcBindings(sceneRenderInfo, pFrameGpuRsrcControl);
+            std::vector<ShaderInputBinding> bindings = GenPerFrameGpuRsrcBindings(sceneRenderInfo,
+                                                                                  pRenderCtx,
+                                                                                  pFrameGpuRsrcControl);
             m_pPipelines[0]->CmdBindDescriptors(cmdBuf, bindings);
 
             vkCmdDraw(cmdBuf, 6, 1, 0, 0); // 6 vertices for a screen quad.
@@ -191,14 +193,21 @@ namespace Hedge
 
     // ================================================================================================================
     std::vector<ShaderInputBinding> HCubemapRenderer::GenPerFrameGpuRsrcBindings(const SceneRenderInfo& sceneRenderInfo,
+        const HRenderContext* const pRenderCtx,
         HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl)
     {
         ShaderInputBinding cubemapTexBinding{ HGPU_IMG, 0, sceneRenderInfo.skyboxCubemapGpuImg };
 
+        // The shader maps the fragment coordinates by the viewport size, which is the scaled render area with the
+        // dynamic resolution.
+        CameraInfo cameraInfo = sceneRenderInfo.cameraInfo;
+        cameraInfo.viewportWidthHeight[0] = static_cast<float>(pRenderCtx->renderArea.extent.width);
+        cameraInfo.viewportWidthHeight[1] = static_cast<float>(pRenderCtx->renderArea.extent.height);
+
         HGpuBuffer* pCameraUboBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
             VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-            (void*)&sceneRenderInfo.cameraInfo, sizeof(sceneRenderInfo.cameraInfo));
+            (void*)&cameraInfo, sizeof(cameraInfo));
 
         ShaderInputBinding cameraUboBinding{ HGPU_BUFFER, 1, pCameraUboBuffer };
 
@@ -37,6 +37,7 @@ namespace Hedge
 
     private:
         std::vector<ShaderInputBinding> GenPerFrameGpuRsrcBindings(const SceneRenderInfo& sceneRenderInfo,
+                                                                   const HRenderContext* const pRenderCtx,
                                                                    HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl);
 
     };
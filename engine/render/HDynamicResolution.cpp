@@ -0,0 +1,196 @@
+#include "HDynamicResolution.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// Weight of the newest frame in the smoothed GPU frame time.
+#define HDRS_SMOOTHING 0.2f
+
+// The controller aims a bit under the target frame time, so the frame time's noise doesn't miss the target.
+#define HDRS_HEADROOM 0.9f
+
+// Scale changes smaller than this ratio are ignored, so the resolution doesn't jitter around the target.
+#define HDRS_DEADBAND 0.03f
+
+// The largest scale change at a time.
+#define HDRS_MAX_SCALE_STEP 0.1f
+
+namespace Hedge
+{
+    // ================================================================================================================
+    HDynamicResolution::HDynamicResolution()
+        : m_pGpuRsrcManager(nullptr),
+          m_timestampQueryPool(VK_NULL_HANDLE),
+          m_frameSlotsCnt(0),
+          m_nsPerTick(0.f),
+          m_ticksMask(0),
+          m_info{ 16.6f, 0.5f, 1.f },
+          m_isEnabled(false),
+          m_scale(1.f),
+          m_gpuFrameMs(0.f),
+          m_framesSinceScaleChange(0)
+    {}
+
+    // ================================================================================================================
+    HDynamicResolution::~HDynamicResolution()
+    {}
+
+    // ================================================================================================================
+    void HDynamicResolution::Init(
+        HGpuRsrcManager* pGpuRsrcManager,
+        uint32_t         frameSlotsCnt)
+    {
+        m_pGpuRsrcManager = pGpuRsrcManager;
+        m_frameSlotsCnt = frameSlotsCnt;
+        m_frameSlotsWritten.resize(frameSlotsCnt, false);
+
+        m_nsPerTick = pGpuRsrcManager->GetTimestampPeriod();
+        if (m_nsPerTick == 0.f)
+        {
+            return;
+        }
+
+        uint32_t validBits = pGpuRsrcManager->GetTimestampValidBits();
+        m_ticksMask = (validBits >= 64) ? UINT64_MAX : ((1ull << validBits) - 1);
+
+        // The start and the end timestamps of each frame slot.
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        {
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = 2 * frameSlotsCnt;
+        }
+        VK_CHECK(vkCreateQueryPool(*pGpuRsrcManager->GetLogicalDevice(),
+                                   &queryPoolInfo,
+                                   nullptr,
+                                   &m_timestampQueryPool));
+    }
+
+    // ================================================================================================================
+    void HDynamicResolution::Cleanup()
+    {
+        if (m_timestampQueryPool != VK_NULL_HANDLE)
+        {
+            vkDestroyQueryPool(*m_pGpuRsrcManager->GetLogicalDevice(), m_timestampQueryPool, nullptr);
+            m_timestampQueryPool = VK_NULL_HANDLE;
+        }
+    }
+
+    // ================================================================================================================
+    void HDynamicResolution::SetEnabled(
+        bool enabled)
+    {
+        if (m_timestampQueryPool == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        // It starts from the best quality and goes down if the GPU cannot make it.
+        m_isEnabled = enabled;
+        m_scale = enabled ? m_info.maxScale : 1.f;
+        m_framesSinceScaleChange = 0;
+    }
+
+    // ================================================================================================================
+    void HDynamicResolution::SetInfo(
+        const HDynamicResolutionInfo& info)
+    {
+        assert((info.minScale > 0.f) && (info.minScale <= info.maxScale) && (info.maxScale <= 1.f));
+        m_info = info;
+
+        if (m_isEnabled)
+        {
+            m_scale = std::clamp(m_scale, m_info.minScale, m_info.maxScale);
+        }
+    }
+
+    // ================================================================================================================
+    void HDynamicResolution::CmdBeginFrame(
+        VkCommandBuffer cmdBuf,
+        uint32_t        frameSlot)
+    {
+        if (m_timestampQueryPool == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        vkCmdResetQueryPool(cmdBuf, m_timestampQueryPool, 2 * frameSlot, 2);
+        vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool, 2 * frameSlot);
+    }
+
+    // ================================================================================================================
+    void HDynamicResolution::CmdEndFrame(
+        VkCommandBuffer cmdBuf,
+        uint32_t        frameSlot)
+    {
+        if (m_timestampQueryPool == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryPool, 2 * frameSlot + 1);
+        m_frameSlotsWritten[frameSlot] = true;
+    }
+
+    // ================================================================================================================
+    void HDynamicResolution::ResolveFrameSlot(
+        uint32_t frameSlot)
+    {
+        if (m_frameSlotsWritten[frameSlot] == false)
+        {
+            return;
+        }
+        m_frameSlotsWritten[frameSlot] = false;
+
+        uint64_t timestamps[2] = {};
+        VK_CHECK(vkGetQueryPoolResults(*m_pGpuRsrcManager->GetLogicalDevice(),
+                                       m_timestampQueryPool,
+                                       2 * frameSlot,
+                                       2,
+                                       sizeof(timestamps),
+                                       timestamps,
+                                       sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+        uint64_t ticks = (timestamps[1] - timestamps[0]) & m_ticksMask;
+        float frameMs = static_cast<float>(ticks) * m_nsPerTick * 1e-6f;
+        m_gpuFrameMs = (m_gpuFrameMs == 0.f) ? frameMs : (m_gpuFrameMs + HDRS_SMOOTHING * (frameMs - m_gpuFrameMs));
+
+        // The frames in flight were recorded at the old scale. Their times don't reflect the last change yet.
+        m_framesSinceScaleChange++;
+        if ((m_isEnabled == false) || (m_framesSinceScaleChange <= m_frameSlotsCnt) || (m_gpuFrameMs <= 0.f))
+        {
+            return;
+        }
+
+        // The GPU time is mostly proportional to the shaded pixels, which are proportional to the scale squared.
+        float scaleRatio = sqrtf(m_info.targetFrameMs * HDRS_HEADROOM / m_gpuFrameMs);
+        if (fabsf(scaleRatio - 1.f) < HDRS_DEADBAND)
+        {
+            return;
+        }
+
+        float newScale = std::clamp(m_scale * scaleRatio, m_scale - HDRS_MAX_SCALE_STEP, m_scale + HDRS_MAX_SCALE_STEP);
+        newScale = std::clamp(newScale, m_info.minScale, m_info.maxScale);
+        if (newScale != m_scale)
+        {
+            m_scale = newScale;
+            m_framesSinceScaleChange = 0;
+        }
+    }
+
+    // ================================================================================================================
+    VkExtent2D HDynamicResolution::CalScaledExtent(
+        VkExtent2D fullExtent) const
+    {
+        if (m_scale >= 1.f)
+        {
+            return fullExtent;
+        }
+
+        uint32_t width = static_cast<uint32_t>(fullExtent.width * m_scale + 0.5f);
+        uint32_t height = static_cast<uint32_t>(fullExtent.height * m_scale + 0.5f);
+        return { std::clamp(width, 1u, fullExtent.width), std::clamp(height, 1u, fullExtent.height) };
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "../core/HGpuRsrcManager.h"
+
+namespace Hedge
+{
+    struct HDynamicResolutionInfo
+    {
+        float targetFrameMs; // E.g. 16.6 for 60 FPS.
+        float minScale;      // Bounds of the render scale. The scale applies to both the width and the height.
+        float maxScale;
+    };
+
+    // The dynamic resolution controller measures the GPU time of each frame with two timestamps and scales the
+    // scene's render area, so the GPU time stays under the target frame time. The scene is rendered into the top left
+    // corner of the full size render targets and upsampled to the full size afterwards, so changing the scale never
+    // reallocates anything.
+    //
+    // Like the HHiZPyramid, a frame slot's timestamps are read when the slot comes back. So, the controller reacts to
+    // the GPU time of the frames in flight ago and it waits for them between two scale changes.
+    class HDynamicResolution
+    {
+    public:
+        HDynamicResolution();
+        ~HDynamicResolution();
+
+        void Init(HGpuRsrcManager* pGpuRsrcManager, uint32_t frameSlotsCnt);
+        void Cleanup();
+
+        // It's a no-op without the timestamps support, and the scale stays at 1.
+        void SetEnabled(bool enabled);
+        bool IsEnabled() const { return m_isEnabled; }
+
+        void SetInfo(const HDynamicResolutionInfo& info);
+
+        // Reset the slot's queries and write the start timestamp. It must be outside of any rendering.
+        void CmdBeginFrame(VkCommandBuffer cmdBuf, uint32_t frameSlot);
+
+        // Write the end timestamp after all GPU work of the frame.
+        void CmdEndFrame(VkCommandBuffer cmdBuf, uint32_t frameSlot);
+
+        // The slot's commands are not submitted. E.g. The command buffer is reset.
+        void DiscardFrameSlot(uint32_t frameSlot) { m_frameSlotsWritten[frameSlot] = false; }
+
+        // The frame slot's in-flight fence must be waited. Read the GPU time and update the scale.
+        void ResolveFrameSlot(uint32_t frameSlot);
+
+        // The render area of a full extent at the current scale. It's never larger than the full extent.
+        VkExtent2D CalScaledExtent(VkExtent2D fullExtent) const;
+
+        float GetScale() const { return m_scale; }
+
+        // Smoothed GPU time of the latest finished frames. 0 without the timestamps support.
+        float GetGpuFrameMs() const { return m_gpuFrameMs; }
+
+    private:
+        HGpuRsrcManager*  m_pGpuRsrcManager;
+        VkQueryPool       m_timestampQueryPool;
+        std::vector<bool> m_frameSlotsWritten;
+        uint32_t          m_frameSlotsCnt;
+        float             m_nsPerTick;
+        uint64_t          m_ticksMask;
+
+        HDynamicResolutionInfo m_info;
+        bool                   m_isEnabled;
+        float                  m_scale;
+        float                  m_gpuFrameMs;
+        uint32_t               m_framesSinceScaleChange;
+    };
+}
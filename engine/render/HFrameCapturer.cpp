@@ -0,0 +1,232 @@
+#include "HFrameCapturer.h"
+#include "../logging/HLogger.h"
+#include "stb_image_write.h"
+#include <cassert>
+#include <cstdio>
+
+extern Hedge::HJobSystem* g_pJobSystem;
+
+namespace Hedge
+{
+    // ================================================================================================================
+    static uint32_t CaptureFormatPixelBytes(
+        VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return 4;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    // ================================================================================================================
+    HFrameCapturer::HFrameCapturer()
+        : m_pGpuRsrcManager(nullptr)
+    {}
+
+    // ================================================================================================================
+    HFrameCapturer::~HFrameCapturer()
+    {
+        Cleanup();
+    }
+
+    // ================================================================================================================
+    void HFrameCapturer::Init(
+        HGpuRsrcManager*   pGpuRsrcManager,
+        uint32_t           frameSlotsCnt,
+        const std::string& captureDir)
+    {
+        m_pGpuRsrcManager = pGpuRsrcManager;
+        m_captureDir = captureDir;
+        m_pendingCaptures.resize(frameSlotsCnt, { nullptr, { 0, 0 }, VK_FORMAT_UNDEFINED, 0, false });
+    }
+
+    // ================================================================================================================
+    void HFrameCapturer::Cleanup()
+    {
+        // Pending files are still written at the exit.
+        if (m_writingFilesCounter.IsDone() == false)
+        {
+            g_pJobSystem->Wait(m_writingFilesCounter);
+        }
+
+        for (HPendingCapture& capture : m_pendingCaptures)
+        {
+            if (capture.pReadbackBuffer != nullptr)
+            {
+                m_pGpuRsrcManager->DereferGpuBuffer(capture.pReadbackBuffer);
+            }
+        }
+        m_pendingCaptures.clear();
+    }
+
+    // ================================================================================================================
+    void HFrameCapturer::CmdCaptureImg(
+        VkCommandBuffer cmdBuf,
+        uint32_t        frameSlot,
+        HGpuImg*        pImg,
+        uint64_t        frameIdx)
+    {
+        HPendingCapture& capture = m_pendingCaptures[frameSlot];
+        assert(capture.isPending == false);
+
+        uint32_t pixelBytes = CaptureFormatPixelBytes(pImg->imgInfo.format);
+        if (pixelBytes == 0)
+        {
+            HDG_CORE_WARN("The frame capturer doesn't support the image format {}.", (int)pImg->imgInfo.format);
+            return;
+        }
+
+        VkExtent2D extent = { pImg->imgInfo.extent.width, pImg->imgInfo.extent.height };
+        uint32_t bytesNum = extent.width * extent.height * pixelBytes;
+
+        // The readback buffer of the slot is reused until the render target size changes.
+        if ((capture.pReadbackBuffer != nullptr) && (capture.pReadbackBuffer->byteCnt != bytesNum))
+        {
+            m_pGpuRsrcManager->DereferGpuBuffer(capture.pReadbackBuffer);
+            capture.pReadbackBuffer = nullptr;
+        }
+
+        if (capture.pReadbackBuffer == nullptr)
+        {
+            capture.pReadbackBuffer = m_pGpuRsrcManager->CreateGpuBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                         VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+                                                                         bytesNum,
+                                                                         "Frame Capture Readback Buffer");
+        }
+
+        VkBufferImageCopy copyRegion{};
+        {
+            copyRegion.bufferOffset = 0;
+            copyRegion.bufferRowLength = 0;
+            copyRegion.bufferImageHeight = 0;
+            copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copyRegion.imageSubresource.mipLevel = 0;
+            copyRegion.imageSubresource.baseArrayLayer = 0;
+            copyRegion.imageSubresource.layerCount = 1;
+            copyRegion.imageOffset = { 0, 0, 0 };
+            copyRegion.imageExtent = { extent.width, extent.height, 1 };
+        }
+
+        vkCmdCopyImageToBuffer(cmdBuf,
+                               pImg->gpuImg,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               capture.pReadbackBuffer->gpuBuffer,
+                               1,
+                               &copyRegion);
+
+        // Make the copy visible to the host read after the fence.
+        VkBufferMemoryBarrier2 hostReadBarrier{};
+        {
+            hostReadBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+            hostReadBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+            hostReadBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+            hostReadBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+            hostReadBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+            hostReadBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            hostReadBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            hostReadBarrier.buffer = capture.pReadbackBuffer->gpuBuffer;
+            hostReadBarrier.offset = 0;
+            hostReadBarrier.size = VK_WHOLE_SIZE;
+        }
+
+        VkDependencyInfo dependencyInfo{};
+        {
+            dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            dependencyInfo.bufferMemoryBarrierCount = 1;
+            dependencyInfo.pBufferMemoryBarriers = &hostReadBarrier;
+        }
+        vkCmdPipelineBarrier2(cmdBuf, &dependencyInfo);
+
+        capture.extent = extent;
+        capture.format = pImg->imgInfo.format;
+        capture.frameIdx = frameIdx;
+        capture.isPending = true;
+    }
+
+    // ================================================================================================================
+    void HFrameCapturer::ResolveFrameSlot(
+        uint32_t frameSlot)
+    {
+        HPendingCapture& capture = m_pendingCaptures[frameSlot];
+        if (capture.isPending == false)
+        {
+            return;
+        }
+
+        HCaptureFile captureFile{};
+        {
+            captureFile.data.resize(capture.pReadbackBuffer->byteCnt);
+            captureFile.extent = capture.extent;
+            captureFile.format = capture.format;
+            captureFile.frameIdx = capture.frameIdx;
+        }
+        m_pGpuRsrcManager->ReadDataFromBuffer(capture.pReadbackBuffer,
+                                              captureFile.data.data(),
+                                              capture.pReadbackBuffer->byteCnt);
+        capture.isPending = false;
+
+        g_pJobSystem->Run([this, captureFile = std::move(captureFile)]() mutable { WriteCaptureFile(captureFile); },
+                          &m_writingFilesCounter);
+    }
+
+    // ================================================================================================================
+    void HFrameCapturer::Flush()
+    {
+        for (uint32_t i = 0; i < m_pendingCaptures.size(); i++)
+        {
+            ResolveFrameSlot(i);
+        }
+
+        g_pJobSystem->Wait(m_writingFilesCounter);
+    }
+
+    // ================================================================================================================
+    void HFrameCapturer::WriteCaptureFile(
+        HCaptureFile& captureFile)
+    {
+        int width = static_cast<int>(captureFile.extent.width);
+        int height = static_cast<int>(captureFile.extent.height);
+
+        char fileName[64];
+        bool isHdr = (captureFile.format == VK_FORMAT_R32G32B32A32_SFLOAT);
+        snprintf(fileName, sizeof(fileName), "/frame_%06llu.%s",
+                 static_cast<unsigned long long>(captureFile.frameIdx), isHdr ? "hdr" : "png");
+        std::string filePathName = m_captureDir + fileName;
+
+        int result = 0;
+        if (isHdr)
+        {
+            result = stbi_write_hdr(filePathName.c_str(),
+                                    width,
+                                    height,
+                                    4,
+                                    reinterpret_cast<const float*>(captureFile.data.data()));
+        }
+        else
+        {
+            // The PNG is in the RGBA order.
+            if ((captureFile.format == VK_FORMAT_B8G8R8A8_UNORM) || (captureFile.format == VK_FORMAT_B8G8R8A8_SRGB))
+            {
+                for (uint32_t i = 0; i < captureFile.data.size(); i += 4)
+                {
+                    std::swap(captureFile.data[i], captureFile.data[i + 2]);
+                }
+            }
+
+            result = stbi_write_png(filePathName.c_str(), width, height, 4, captureFile.data.data(), width * 4);
+        }
+
+        if (result == 0)
+        {
+            HDG_CORE_ERROR("Failed to write the frame capture {}.", filePathName);
+        }
+    }
+}
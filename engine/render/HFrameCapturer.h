@@ -0,0 +1,62 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include "../core/HGpuRsrcManager.h"
+#include "../core/HJobSystem.h"
+
+namespace Hedge
+{
+    // The frame capturer reads rendered images back to the RAM and saves them as image files without stalling the
+    // frames:
+    // - The copy to a host visible buffer is recorded into the frame's command buffer.
+    // - The buffer is read when its frame slot comes back, which means the in-flight fence is already waited.
+    // - The encoding and the file writing of each capture is a job, so the captures of several frames are written in
+    //   parallel.
+    //
+    // 8 bits RGBA/BGRA images are saved as PNG files. 32 bits float RGBA images are saved as Radiance HDR files.
+    class HFrameCapturer
+    {
+    public:
+        HFrameCapturer();
+        ~HFrameCapturer();
+
+        void Init(HGpuRsrcManager* pGpuRsrcManager, uint32_t frameSlotsCnt, const std::string& captureDir);
+        void Cleanup();
+
+        // The image must be in the TRANSFER_SRC_OPTIMAL layout. E.g. Use it in a render graph pass that has the
+        // HRG_ACCESS_TRANSFER_SRC access of the image. One capture per frame slot.
+        void CmdCaptureImg(VkCommandBuffer cmdBuf, uint32_t frameSlot, HGpuImg* pImg, uint64_t frameIdx);
+
+        // The frame slot's in-flight fence must be waited. The slot's capture is sent to a writing job.
+        void ResolveFrameSlot(uint32_t frameSlot);
+
+        // The device must be idle. Resolve all pending captures and wait until they are written.
+        void Flush();
+
+    private:
+        struct HPendingCapture
+        {
+            HGpuBuffer* pReadbackBuffer;
+            VkExtent2D  extent;
+            VkFormat    format;
+            uint64_t    frameIdx;
+            bool        isPending;
+        };
+
+        struct HCaptureFile
+        {
+            std::vector<uint8_t> data;
+            VkExtent2D           extent;
+            VkFormat             format;
+            uint64_t             frameIdx;
+        };
+
+        void WriteCaptureFile(HCaptureFile& captureFile);
+
+        HGpuRsrcManager*             m_pGpuRsrcManager;
+        std::string                  m_captureDir;
+        std::vector<HPendingCapture> m_pendingCaptures; // One per frame slot.
+        HJobCounter                  m_writingFilesCounter;
+    };
+}
@@ -0,0 +1,570 @@
+#include "HGpuDrivenRenderer.h"
+#include "HRenderManager.h"
+#include "Utils.h"
+#include "UtilMath.h"
+#include "../scene/HScene.h"
+#include "../core/HGpuRsrcManager.h"
+#include "g_prebuiltShaders.h"
+#include <algorithm>
+#include <iostream>
+
+extern Hedge::HGpuRsrcManager* g_pGpuRsrcManager;
+
+namespace Hedge
+{
+    // ================================================================================================================
+    HGpuCullPipeline::HGpuCullPipeline() :
+        HPipeline()
+    {}
+
+    // ================================================================================================================
+    HGpuCullPipeline::~HGpuCullPipeline()
+    {}
+
+    // ================================================================================================================
+    void HGpuCullPipeline::CreateSetCustomPipelineInfo()
+    {
+        VkShaderModule compShaderModule = CreateShaderModule((uint32_t*)gpu_cull_compScript,
+                                                             sizeof(gpu_cull_compScript));
+
+        AddShaderStageInfo(CreateDefaultShaderStgCreateInfo(compShaderModule, VK_SHADER_STAGE_COMPUTE_BIT));
+        m_shaderModules.push_back(compShaderModule);
+
+        CreateSetDescriptorSetLayouts();
+        CreateSetCullPipelineLayout();
+    }
+
+    // ================================================================================================================
+    void HGpuCullPipeline::CreateSetDescriptorSetLayouts()
+    {
+        VkDescriptorSetLayoutBinding cullBindings[6] = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }, // Objects
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }, // Draw commands
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }, // Draw counts
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }, // Visible instances
+            { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }, // Batches
+            { 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }  // Batch instance counts
+        };
+
+        VkDescriptorSetLayoutCreateInfo cullDesSetLayoutInfo{};
+        {
+            cullDesSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            cullDesSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+            cullDesSetLayoutInfo.bindingCount = 6;
+            cullDesSetLayoutInfo.pBindings = cullBindings;
+        }
+
+        VkDescriptorSetLayout cullDescriptorSetLayout;
+        VK_CHECK(vkCreateDescriptorSetLayout(m_device,
+                                             &cullDesSetLayoutInfo,
+                                             nullptr,
+                                             &cullDescriptorSetLayout));
+
+        AddDescriptorSetLayout(cullDescriptorSetLayout);
+    }
+
+    // ================================================================================================================
+    void HGpuCullPipeline::CreateSetCullPipelineLayout()
+    {
+        VkPushConstantRange range = {};
+        {
+            range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            range.offset = 0;
+            range.size = sizeof(GpuCullPushConstant);
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        {
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = m_descriptorSetLayouts.size();
+            pipelineLayoutInfo.pSetLayouts = m_descriptorSetLayouts.data();
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &range;
+        }
+
+        VkPipelineLayout cullPipelineLayout;
+        VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout));
+        SetPipelineLayout(cullPipelineLayout);
+    }
+
+    // ================================================================================================================
+    HGpuDrivenRenderer::HGpuDrivenRenderer(VkDevice device)
+        : HBasicRenderer(device),
+          m_pObjsBuffer(nullptr),
+          m_pVisibleInstsBuffer(nullptr),
+          m_visibleInstsCapacity(0),
+          m_pMergedVertBuffer(nullptr),
+          m_pMergedIdxBuffer(nullptr),
+          m_pfnCmdDrawIndexedIndirectCount(nullptr)
+    {
+        // The render manager only creates this renderer when the bindless and the draw indirect count are supported.
+        assert(m_useBindless);
+
+        HGpuCullPipeline* pCullPipeline = new HGpuCullPipeline();
+        pCullPipeline->CreatePipeline(m_device);
+        m_pPipelines.push_back(pCullPipeline);
+
+        m_pfnCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+            m_device, "vkCmdDrawIndexedIndirectCountKHR");
+        if (m_pfnCmdDrawIndexedIndirectCount == nullptr)
+        {
+            // The renderer still works without the indirect count by falling back to the HBasicRenderer's path.
+            std::cerr << "Cannot find the vkCmdDrawIndexedIndirectCountKHR of the "
+                      << VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
+                      << ". The GPU driven renderer falls back to the CPU draws." << std::endl;
+        }
+    }
+
+    // ================================================================================================================
+    HGpuDrivenRenderer::~HGpuDrivenRenderer()
+    {
+        if (m_pObjsBuffer != nullptr)
+        {
+            g_pGpuRsrcManager->DereferGpuBuffer(m_pObjsBuffer);
+        }
+
+        if (m_pVisibleInstsBuffer != nullptr)
+        {
+            g_pGpuRsrcManager->DereferGpuBuffer(m_pVisibleInstsBuffer);
+        }
+
+        ReleaseMergedMeshes();
+    }
+
+    // ================================================================================================================
+    void HGpuDrivenRenderer::ReleaseMergedMeshes()
+    {
+        if (m_pMergedVertBuffer != nullptr)
+        {
+            g_pGpuRsrcManager->DereferGpuBuffer(m_pMergedVertBuffer);
+            g_pGpuRsrcManager->DereferGpuBuffer(m_pMergedIdxBuffer);
+            m_pMergedVertBuffer = nullptr;
+            m_pMergedIdxBuffer = nullptr;
+        }
+
+        for (const HMergedMesh& mesh : m_mergedMeshes)
+        {
+            g_pGpuRsrcManager->DereferGpuBuffer(mesh.pVertBuffer);
+            g_pGpuRsrcManager->DereferGpuBuffer(mesh.pIdxBuffer);
+        }
+
+        m_mergedMeshes.clear();
+        m_mergedMeshesIdx.clear();
+    }
+
+    // ================================================================================================================
+    void HGpuDrivenRenderer::UpdateMergedMeshes(
+        VkCommandBuffer&            cmdBuf,
+        const SceneRenderInfo&      sceneRenderInfo,
+        HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl)
+    {
+        bool allMerged = (m_pMergedVertBuffer != nullptr);
+        for (uint32_t batchIdx = 0; (batchIdx < m_instanceBatches.size()) && allMerged; batchIdx++)
+        {
+            uint32_t objIdx = m_instanceBatches[batchIdx].firstObjIdx;
+            allMerged = (m_mergedMeshesIdx.count(sceneRenderInfo.objsIdxBuffers[objIdx]) != 0);
+        }
+
+        if (allMerged == false)
+        {
+            // Rebuild with the current batches' meshes only, so the meshes that are not used anymore are dropped. The
+            // frames in flight still refer the old merged buffers through the frame resource control.
+            ReleaseMergedMeshes();
+
+            uint32_t vertsCnt = 0;
+            uint32_t idxsCnt = 0;
+            for (const HInstanceBatch& batch : m_instanceBatches)
+            {
+                uint32_t objIdx = batch.firstObjIdx;
+                HGpuBuffer* pIdxBuffer = sceneRenderInfo.objsIdxBuffers[objIdx];
+                if (m_mergedMeshesIdx.count(pIdxBuffer) != 0)
+                {
+                    continue;
+                }
+
+                HMergedMesh mesh{};
+                {
+                    mesh.pVertBuffer = sceneRenderInfo.objsVertBuffers[objIdx];
+                    mesh.pIdxBuffer = pIdxBuffer;
+                    mesh.vertexOffset = vertsCnt;
+                    mesh.firstIndex = idxsCnt;
+                    mesh.vertCnt = sceneRenderInfo.vertCounts[objIdx];
+                    mesh.idxCnt = sceneRenderInfo.idxCounts[objIdx];
+                }
+
+                g_pGpuRsrcManager->ReferGpuBufferImg(mesh.pVertBuffer);
+                g_pGpuRsrcManager->ReferGpuBufferImg(mesh.pIdxBuffer);
+
+                m_mergedMeshesIdx[pIdxBuffer] = m_mergedMeshes.size();
+                m_mergedMeshes.push_back(mesh);
+
+                vertsCnt += mesh.vertCnt;
+                idxsCnt += mesh.idxCnt;
+            }
+
+            m_pMergedVertBuffer = g_pGpuRsrcManager->CreateGpuBuffer(
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+                sizeof(float) * 12 * vertsCnt, "GpuDrivenMergedVertBuffer");
+
+            m_pMergedIdxBuffer = g_pGpuRsrcManager->CreateGpuBuffer(
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+                sizeof(uint16_t) * idxsCnt, "GpuDrivenMergedIdxBuffer");
+
+            for (const HMergedMesh& mesh : m_mergedMeshes)
+            {
+                VkBufferCopy vertCopyRegion{};
+                {
+                    vertCopyRegion.srcOffset = 0;
+                    vertCopyRegion.dstOffset = sizeof(float) * 12 * mesh.vertexOffset;
+                    vertCopyRegion.size = sizeof(float) * 12 * mesh.vertCnt;
+                }
+                vkCmdCopyBuffer(cmdBuf, mesh.pVertBuffer->gpuBuffer, m_pMergedVertBuffer->gpuBuffer,
+                                1, &vertCopyRegion);
+
+                VkBufferCopy idxCopyRegion{};
+                {
+                    idxCopyRegion.srcOffset = 0;
+                    idxCopyRegion.dstOffset = sizeof(uint16_t) * mesh.firstIndex;
+                    idxCopyRegion.size = sizeof(uint16_t) * mesh.idxCnt;
+                }
+                vkCmdCopyBuffer(cmdBuf, mesh.pIdxBuffer->gpuBuffer, m_pMergedIdxBuffer->gpuBuffer,
+                                1, &idxCopyRegion);
+
+                pFrameGpuRsrcControl->AddGpuBufferReferControl(mesh.pVertBuffer);
+                pFrameGpuRsrcControl->AddGpuBufferReferControl(mesh.pIdxBuffer);
+            }
+
+            VkMemoryBarrier copyBarrier{};
+            {
+                copyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                copyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                copyBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+            }
+
+            vkCmdPipelineBarrier(cmdBuf,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                 0,
+                                 1, &copyBarrier,
+                                 0, nullptr,
+                                 0, nullptr);
+        }
+
+        pFrameGpuRsrcControl->AddGpuBufferReferControl(m_pMergedVertBuffer);
+        pFrameGpuRsrcControl->AddGpuBufferReferControl(m_pMergedIdxBuffer);
+    }
+
+    // ================================================================================================================
+    void HGpuDrivenRenderer::ReserveVisibleInstsBuffer(
+        uint32_t objsCnt)
+    {
+        if (objsCnt <= m_visibleInstsCapacity)
+        {
+            return;
+        }
+
+        // The old buffer may still be used by the frames in flight. The frame resource control releases it after them.
+        if (m_pVisibleInstsBuffer != nullptr)
+        {
+            g_pGpuRsrcManager->DereferGpuBuffer(m_pVisibleInstsBuffer);
+        }
+
+        // Grow geometrically, so a scene that keeps spawning objects doesn't recreate the buffer every frame.
+        m_visibleInstsCapacity = std::max(objsCnt, m_visibleInstsCapacity * 2);
+
+        // Only the GPU writes and reads the visible instances, so it doesn't need to be host visible.
+        m_pVisibleInstsBuffer = g_pGpuRsrcManager->CreateGpuBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                                   VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+                                                                   sizeof(HInstanceData) * m_visibleInstsCapacity,
+                                                                   "GpuDrivenVisibleInsts");
+    }
+
+    // ================================================================================================================
+    void HGpuDrivenRenderer::UpdateObjsBuffer(
+        const SceneRenderInfo& sceneRenderInfo)
+    {
+        uint32_t objsCnt = m_sortedObjIdx.size();
+        m_newObjsData.resize(objsCnt);
+
+        for (uint32_t batchIdx = 0; batchIdx < m_instanceBatches.size(); batchIdx++)
+        {
+            const HInstanceBatch& batch = m_instanceBatches[batchIdx];
+            for (uint32_t i = batch.instanceBaseIdx; i < batch.instanceBaseIdx + batch.instanceCnt; i++)
+            {
+                uint32_t objIdx = m_sortedObjIdx[i];
+                GpuDrivenObjData& objData = m_newObjsData[i];
+
+                HInstanceData instanceData;
+                GenInstanceData(sceneRenderInfo, objIdx, instanceData);
+
+                memcpy(objData.modelMat, instanceData.modelMat, sizeof(HMat4x4));
+                memcpy(objData.boundingSphere, &sceneRenderInfo.objsBoundingSpheres[objIdx], sizeof(HBoundingSphere));
+                memcpy(objData.materialIdx, instanceData.materialIdx, sizeof(instanceData.materialIdx));
+                objData.batchIdx = batchIdx;
+                objData.instanceBaseIdx = batch.instanceBaseIdx;
+                objData.padding[0] = 0;
+                objData.padding[1] = 0;
+            }
+        }
+
+        // Static scenes don't need to re-upload anything. Frames in flight may still read the old buffer, so we
+        // create a new buffer when the data changes instead of overwriting it. The old buffer is released by the
+        // frame resource control after the frames that refer it are finished.
+        uint32_t bytesCnt = sizeof(GpuDrivenObjData) * objsCnt;
+        if ((m_pObjsBuffer == nullptr) ||
+            (m_newObjsData.size() != m_objsData.size()) ||
+            (memcmp(m_newObjsData.data(), m_objsData.data(), bytesCnt) != 0))
+        {
+            if (m_pObjsBuffer != nullptr)
+            {
+                g_pGpuRsrcManager->DereferGpuBuffer(m_pObjsBuffer);
+            }
+
+            m_pObjsBuffer = g_pGpuRsrcManager->CreateGpuBuffer(
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+                bytesCnt, "GpuDrivenObjsBuffer");
+
+            g_pGpuRsrcManager->SendDataToBuffer(m_pObjsBuffer, m_newObjsData.data(), bytesCnt);
+            m_objsData.swap(m_newObjsData);
+        }
+    }
+
+    // ================================================================================================================
+    void HGpuDrivenRenderer::CmdRenderInsts(
+        VkCommandBuffer&            cmdBuf,
+        const HRenderContext* const pRenderCtx,
+        const SceneRenderInfo&      sceneRenderInfo,
+        HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl)
+    {
+        uint32_t objsCnt = sceneRenderInfo.modelMats.size();
+        if (objsCnt == 0)
+        {
+            return;
+        }
+
+        if ((m_pfnCmdDrawIndexedIndirectCount == nullptr) || (IsSceneBindlessReady(sceneRenderInfo) == false))
+        {
+            HBasicRenderer::CmdRenderInsts(cmdBuf, pRenderCtx, sceneRenderInfo, pFrameGpuRsrcControl);
+            return;
+        }
+
+        // The cull shader compacts the visible instances in any order, so sorting by the view depth would only make
+        // the objects buffer re-upload when the camera moves.
+        BuildInstanceBatches(sceneRenderInfo, false);
+        UpdateObjsBuffer(sceneRenderInfo);
+        pFrameGpuRsrcControl->AddGpuBufferReferControl(m_pObjsBuffer);
+
+        // The meshes are copied before the scene rendering begins, because copies cannot be recorded in it.
+        UpdateMergedMeshes(cmdBuf, sceneRenderInfo, pFrameGpuRsrcControl);
+
+        // The batches of a permutation get consecutive draw commands, so each permutation is one indirect count draw.
+        // The draw commands' order in a permutation depends on the compute pass and doesn't matter.
+        uint32_t batchesCnt = m_instanceBatches.size();
+        uint32_t permutationBatchesCnt[HPBR_PERMUTATIONS_CNT] = {};
+        uint32_t permutationDrawCmdBase[HPBR_PERMUTATIONS_CNT] = {};
+
+        m_batchesData.resize(batchesCnt);
+        for (uint32_t batchIdx = 0; batchIdx < batchesCnt; batchIdx++)
+        {
+            const HInstanceBatch& batch = m_instanceBatches[batchIdx];
+            HGpuBuffer* pIdxBuffer = sceneRenderInfo.objsIdxBuffers[batch.firstObjIdx];
+            const HMergedMesh& mesh = m_mergedMeshes[m_mergedMeshesIdx[pIdxBuffer]];
+
+            GpuDrivenBatchData& batchData = m_batchesData[batchIdx];
+            batchData.indexCount = mesh.idxCnt;
+            batchData.firstIndex = mesh.firstIndex;
+            batchData.vertexOffset = mesh.vertexOffset;
+            batchData.instanceBaseIdx = batch.instanceBaseIdx;
+            batchData.permutation = GetObjPBRFeatures(sceneRenderInfo, batch.firstObjIdx);
+            batchData.padding[0] = 0;
+            batchData.padding[1] = 0;
+
+            permutationBatchesCnt[batchData.permutation]++;
+        }
+
+        for (uint32_t permutation = 1; permutation < HPBR_PERMUTATIONS_CNT; permutation++)
+        {
+            permutationDrawCmdBase[permutation] = permutationDrawCmdBase[permutation - 1] +
+                                                  permutationBatchesCnt[permutation - 1];
+        }
+
+        for (GpuDrivenBatchData& batchData : m_batchesData)
+        {
+            batchData.drawCmdBase = permutationDrawCmdBase[batchData.permutation];
+        }
+
+        HGpuBuffer* pBatchesBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            m_batchesData.data(), sizeof(GpuDrivenBatchData) * batchesCnt);
+
+        // The compute pass writes the draw commands and counts. Only the first draw count commands of a permutation
+        // are read, so the zeros are just a defined initial state.
+        m_zeroDrawCmds.resize(batchesCnt, VkDrawIndexedIndirectCommand{});
+        HGpuBuffer* pDrawCmdsBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            m_zeroDrawCmds.data(), sizeof(VkDrawIndexedIndirectCommand) * batchesCnt);
+
+        m_zeroCnts.resize(std::max<uint32_t>(batchesCnt, HPBR_PERMUTATIONS_CNT), 0);
+        HGpuBuffer* pDrawCntsBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            m_zeroCnts.data(), sizeof(uint32_t) * HPBR_PERMUTATIONS_CNT);
+
+        HGpuBuffer* pBatchInstCntsBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            m_zeroCnts.data(), sizeof(uint32_t) * batchesCnt);
+
+        ReserveVisibleInstsBuffer(objsCnt);
+        pFrameGpuRsrcControl->AddGpuBufferReferControl(m_pVisibleInstsBuffer);
+
+        // Culling passes
+        HPipeline* pCullPipeline = m_pPipelines[2];
+        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pCullPipeline->GetVkPipeline());
+
+        std::vector<ShaderInputBinding> cullBindings{ { HGPU_BUFFER, 0, m_pObjsBuffer },
+                                                      { HGPU_BUFFER, 1, pDrawCmdsBuffer },
+                                                      { HGPU_BUFFER, 2, pDrawCntsBuffer },
+                                                      { HGPU_BUFFER, 3, m_pVisibleInstsBuffer },
+                                                      { HGPU_BUFFER, 4, pBatchesBuffer },
+                                                      { HGPU_BUFFER, 5, pBatchInstCntsBuffer } };
+        pCullPipeline->CmdBindDescriptors(cmdBuf, cullBindings);
+
+        GpuCullPushConstant cullInfo{};
+        GenFrustumPlanes(sceneRenderInfo.vpMat.eles, cullInfo.frustumPlanes);
+        cullInfo.objCnt = objsCnt;
+        cullInfo.batchCnt = batchesCnt;
+        cullInfo.pass = HGPU_CULL_PASS_OBJS;
+
+        vkCmdPushConstants(cmdBuf,
+                           pCullPipeline->GetVkPipelineLayout(),
+                           VK_SHADER_STAGE_COMPUTE_BIT,
+                           0,
+                           sizeof(GpuCullPushConstant),
+                           &cullInfo);
+
+        vkCmdDispatch(cmdBuf, (objsCnt + 63) / 64, 1, 1);
+
+        // The compact draws pass reads the batches' final instance counts.
+        VkMemoryBarrier instCntsBarrier{};
+        {
+            instCntsBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            instCntsBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            instCntsBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        }
+
+        vkCmdPipelineBarrier(cmdBuf,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             1, &instCntsBarrier,
+                             0, nullptr,
+                             0, nullptr);
+
+        cullInfo.pass = HGPU_CULL_PASS_COMPACT_DRAWS;
+        vkCmdPushConstants(cmdBuf,
+                           pCullPipeline->GetVkPipelineLayout(),
+                           VK_SHADER_STAGE_COMPUTE_BIT,
+                           0,
+                           sizeof(GpuCullPushConstant),
+                           &cullInfo);
+
+        vkCmdDispatch(cmdBuf, (batchesCnt + 63) / 64, 1, 1);
+
+        VkMemoryBarrier cullBarrier{};
+        {
+            cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        }
+
+        vkCmdPipelineBarrier(cmdBuf,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                             0,
+                             1, &cullBarrier,
+                             0, nullptr,
+                             0, nullptr);
+
+        // Drawing pass
+        std::vector<ShaderInputBinding> perFrameGpuRsrcBindings = GenPerFrameGpuRsrcBinding(sceneRenderInfo,
+                                                                                            pRenderCtx,
+                                                                                            pFrameGpuRsrcControl);
+
+        HGpuBuffer* pVpMatUbo = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            (void*)sceneRenderInfo.vpMat.eles, sizeof(HMat4x4));
+
+        perFrameGpuRsrcBindings.push_back({ HGPU_BUFFER, 0, pVpMatUbo });
+        perFrameGpuRsrcBindings.push_back({ HGPU_BUFFER, 10, m_pVisibleInstsBuffer });
+
+        CmdBeginSceneRendering(cmdBuf, pRenderCtx, sceneRenderInfo);
+
+        // The permutations have the same layout, so the descriptors, the push constant and the merged geometry are
+        // bound once for all of them.
+        HPipeline* pBindlessPipeline = GetPBRPipeline(true, false, m_batchesData[0].permutation);
+        VkPipelineLayout bindlessPipelineLayout = pBindlessPipeline->GetVkPipelineLayout();
+
+        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pBindlessPipeline->GetVkPipeline());
+        pBindlessPipeline->CmdBindDescriptors(cmdBuf, perFrameGpuRsrcBindings);
+        vkCmdBindDescriptorSets(cmdBuf,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                bindlessPipelineLayout,
+                                1, 1, &m_bindlessDescriptorSet,
+                                0, nullptr);
+
+        PBRBindlessPushConstant drawInfo{};
+        memcpy(drawInfo.cameraPos, sceneRenderInfo.cameraPos, sizeof(float) * 3);
+        drawInfo.iblMaxMipLevels = sceneRenderInfo.iblMaxMipLevels;
+        drawInfo.ptLightCnt = sceneRenderInfo.pointLightsPositions.size();
+
+        vkCmdPushConstants(cmdBuf,
+                           bindlessPipelineLayout,
+                           VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0,
+                           sizeof(PBRBindlessPushConstant),
+                           &drawInfo);
+
+        VkDeviceSize vbOffset = 0;
+        vkCmdBindVertexBuffers(cmdBuf, 0, 1, &m_pMergedVertBuffer->gpuBuffer, &vbOffset);
+        vkCmdBindIndexBuffer(cmdBuf, m_pMergedIdxBuffer->gpuBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+        for (uint32_t permutation = 0; permutation < HPBR_PERMUTATIONS_CNT; permutation++)
+        {
+            if (permutationBatchesCnt[permutation] == 0)
+            {
+                continue;
+            }
+
+            HPipeline* pPermutationPipeline = GetPBRPipeline(true, false, permutation);
+            if (pPermutationPipeline != pBindlessPipeline)
+            {
+                vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pPermutationPipeline->GetVkPipeline());
+                pBindlessPipeline = pPermutationPipeline;
+            }
+
+            // The draw count is the number of the permutation's batches that have visible instances.
+            m_pfnCmdDrawIndexedIndirectCount(cmdBuf,
+                                             pDrawCmdsBuffer->gpuBuffer,
+                                             sizeof(VkDrawIndexedIndirectCommand) * permutationDrawCmdBase[permutation],
+                                             pDrawCntsBuffer->gpuBuffer,
+                                             sizeof(uint32_t) * permutation,
+                                             permutationBatchesCnt[permutation],
+                                             sizeof(VkDrawIndexedIndirectCommand));
+        }
+
+        // The merged buffers hold the meshes, but the textures are still sampled from the objects' images.
+        for (const HInstanceBatch& batch : m_instanceBatches)
+        {
+            AddObjRsrcReferControl(sceneRenderInfo, pFrameGpuRsrcControl, batch.firstObjIdx);
+        }
+
+        vkCmdEndRendering(cmdBuf);
+    }
+}
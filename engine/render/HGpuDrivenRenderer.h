@@ -0,0 +1,133 @@
+#pragma once
+#include "HRenderer.h"
+#include <unordered_map>
+
+namespace Hedge
+{
+    // Per object data read by the culling compute shader. It must match the ObjectData in the gpu_cull_comp.hlsl.
+    struct GpuDrivenObjData
+    {
+        float    modelMat[16];
+        float    boundingSphere[4]; // Model space center xyz and radius.
+        uint32_t materialIdx[4];    // Same as the HInstanceData's. Copied into the visible instance.
+        uint32_t batchIdx;
+        uint32_t instanceBaseIdx;
+        uint32_t padding[2];
+    };
+
+    // Per batch data read by the culling compute shader. It must match the BatchData in the gpu_cull_comp.hlsl.
+    struct GpuDrivenBatchData
+    {
+        uint32_t indexCount;
+        uint32_t firstIndex;   // In the merged index buffer.
+        int32_t  vertexOffset; // In the merged vertex buffer.
+        uint32_t instanceBaseIdx;
+        uint32_t permutation;  // The HPBRFeatureBits of the batch. Selects the draw count of the batch.
+        uint32_t drawCmdBase;  // First draw command of the batch's permutation.
+        uint32_t padding[2];
+    };
+
+    // The culling shader runs twice. The objects pass culls the objects and counts the visible instances of the
+    // batches. The compact draws pass appends the batches with visible instances to their permutations' draws.
+    enum HGpuCullPass
+    {
+        HGPU_CULL_PASS_OBJS          = 0,
+        HGPU_CULL_PASS_COMPACT_DRAWS = 1
+    };
+
+    // It must match the CullInfo in the gpu_cull_comp.hlsl.
+    struct GpuCullPushConstant
+    {
+        float    frustumPlanes[24]; // 6 world space planes. (nx, ny, nz, d) and the normal points inside.
+        uint32_t objCnt;
+        uint32_t batchCnt;
+        uint32_t pass;              // HGpuCullPass.
+    };
+
+    // The compute pipeline frustum culls all objects and fills the compacted indirect draw commands and draw counts.
+    class HGpuCullPipeline : public HPipeline
+    {
+    public:
+        HGpuCullPipeline();
+        ~HGpuCullPipeline();
+
+    protected:
+        virtual void CreateSetCustomPipelineInfo() override;
+
+    private:
+        void CreateSetDescriptorSetLayouts();
+        void CreateSetCullPipelineLayout();
+    };
+
+    // The GPU driven renderer moves the visibility decision and the draws to the GPU. The meshes are copied into one
+    // merged vertex buffer and one merged index buffer and the materials' texture indices are in the instances, so
+    // the CPU only records one vkCmdDrawIndexedIndirectCount per pipeline permutation. The compute pass decides which
+    // batches are drawn and how many instances each of them draws.
+    //
+    // Pipelines: [0] PBR, [1] bindless PBR (Both from the HBasicRenderer), [2] GPU cull.
+    // It needs the bindless textures and the VK_KHR_draw_indirect_count. It falls back to the HBasicRenderer's path
+    // if the scene's textures are not all in the bindless array or the draw indirect count function cannot be found.
+    class HGpuDrivenRenderer : public HBasicRenderer
+    {
+    public:
+        explicit HGpuDrivenRenderer(VkDevice device);
+
+        virtual ~HGpuDrivenRenderer();
+
+        virtual void CmdRenderInsts(VkCommandBuffer&            cmdBuf,
+                                    const HRenderContext* const pRenderCtx,
+                                    const SceneRenderInfo&      sceneRenderInfo,
+                                    HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl) override;
+
+        // The draws are decided by the GPU cull in the scene pass, so there are no CPU draws for a prepass to share.
+        virtual bool IsDepthPrepassSupported() override { return false; }
+
+    private:
+        // Upload the objects data into the persistent objects buffer. It's only re-uploaded when the data changes.
+        void UpdateObjsBuffer(const SceneRenderInfo& sceneRenderInfo);
+
+        // Grow the persistent visible instances buffer if it cannot hold the objects.
+        void ReserveVisibleInstsBuffer(uint32_t objsCnt);
+
+        // Copy the batches' meshes into the merged vertex and index buffers. The merged buffers are only rebuilt when
+        // a batch uses a mesh that is not in them yet.
+        void UpdateMergedMeshes(VkCommandBuffer&            cmdBuf,
+                                const SceneRenderInfo&      sceneRenderInfo,
+                                HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl);
+
+        // Release the merged buffers and the meshes they refer.
+        void ReleaseMergedMeshes();
+
+        // A mesh's location in the merged buffers.
+        struct HMergedMesh
+        {
+            HGpuBuffer* pVertBuffer;
+            HGpuBuffer* pIdxBuffer;
+            int32_t     vertexOffset;
+            uint32_t    firstIndex;
+            uint32_t    vertCnt;
+            uint32_t    idxCnt;
+        };
+
+        HGpuBuffer*                   m_pObjsBuffer;
+        std::vector<GpuDrivenObjData> m_objsData;
+        std::vector<GpuDrivenObjData> m_newObjsData;
+
+        HGpuBuffer* m_pVisibleInstsBuffer;
+        uint32_t    m_visibleInstsCapacity; // In instances.
+
+        // The merged meshes refer their source buffers, so a released mesh's buffer address cannot be reused by
+        // another mesh while it's still in the m_mergedMeshesIdx.
+        HGpuBuffer*                               m_pMergedVertBuffer;
+        HGpuBuffer*                               m_pMergedIdxBuffer;
+        std::vector<HMergedMesh>                  m_mergedMeshes;
+        std::unordered_map<HGpuBuffer*, uint32_t> m_mergedMeshesIdx; // Index buffer -> m_mergedMeshes idx.
+
+        // Per frame scratch data. They are members, so they don't allocate every frame.
+        std::vector<GpuDrivenBatchData>           m_batchesData;
+        std::vector<VkDrawIndexedIndirectCommand> m_zeroDrawCmds;
+        std::vector<uint32_t>                     m_zeroCnts;
+
+        PFN_vkCmdDrawIndexedIndirectCountKHR m_pfnCmdDrawIndexedIndirectCount;
+    };
+}
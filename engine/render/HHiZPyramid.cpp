@@ -0,0 +1,428 @@
+#include "HHiZPyramid.h"
+#include "Utils.h"
+#include "UtilMath.h"
+#include "g_prebuiltShaders.h"
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
+
+namespace Hedge
+{
+    // ================================================================================================================
+    HHiZBuildPipeline::HHiZBuildPipeline() :
+        HPipeline()
+    {}
+
+    // ================================================================================================================
+    HHiZBuildPipeline::~HHiZBuildPipeline()
+    {}
+
+    // ================================================================================================================
+    void HHiZBuildPipeline::CreateSetCustomPipelineInfo()
+    {
+        VkShaderModule compShaderModule = CreateShaderModule((uint32_t*)hiz_build_compScript,
+                                                             sizeof(hiz_build_compScript));
+
+        AddShaderStageInfo(CreateDefaultShaderStgCreateInfo(compShaderModule, VK_SHADER_STAGE_COMPUTE_BIT));
+        m_shaderModules.push_back(compShaderModule);
+
+        CreateSetDescriptorSetLayouts();
+        CreateSetHiZPipelineLayout();
+    }
+
+    // ================================================================================================================
+    void HHiZBuildPipeline::CreateSetDescriptorSetLayouts()
+    {
+        VkDescriptorSetLayoutBinding hiZBindings[2] = {
+            { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }, // Depth
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }  // Pyramid
+        };
+
+        VkDescriptorSetLayoutCreateInfo hiZDesSetLayoutInfo{};
+        {
+            hiZDesSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            hiZDesSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+            hiZDesSetLayoutInfo.bindingCount = 2;
+            hiZDesSetLayoutInfo.pBindings = hiZBindings;
+        }
+
+        VkDescriptorSetLayout hiZDescriptorSetLayout;
+        VK_CHECK(vkCreateDescriptorSetLayout(m_device,
+                                             &hiZDesSetLayoutInfo,
+                                             nullptr,
+                                             &hiZDescriptorSetLayout));
+
+        AddDescriptorSetLayout(hiZDescriptorSetLayout);
+    }
+
+    // ================================================================================================================
+    void HHiZBuildPipeline::CreateSetHiZPipelineLayout()
+    {
+        VkPushConstantRange range = {};
+        {
+            range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            range.offset = 0;
+            range.size = sizeof(HiZBuildPushConstant);
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        {
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = m_descriptorSetLayouts.size();
+            pipelineLayoutInfo.pSetLayouts = m_descriptorSetLayouts.data();
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &range;
+        }
+
+        VkPipelineLayout hiZPipelineLayout;
+        VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &hiZPipelineLayout));
+        SetPipelineLayout(hiZPipelineLayout);
+    }
+
+    // ================================================================================================================
+    HHiZPyramid::HHiZPyramid()
+        : m_pGpuRsrcManager(nullptr),
+          m_pBuildPipeline(nullptr),
+          m_isReady(false),
+          m_layout(),
+          m_vpMat(),
+          m_frameIdx(0)
+    {}
+
+    // ================================================================================================================
+    HHiZPyramid::~HHiZPyramid()
+    {
+        Cleanup();
+    }
+
+    // ================================================================================================================
+    void HHiZPyramid::Init(
+        HGpuRsrcManager* pGpuRsrcManager,
+        uint32_t         frameSlotsCnt)
+    {
+        m_pGpuRsrcManager = pGpuRsrcManager;
+
+        m_pBuildPipeline = new HHiZBuildPipeline();
+        m_pBuildPipeline->CreatePipeline(*pGpuRsrcManager->GetLogicalDevice());
+
+        HHiZFrameSlot emptySlot{};
+        {
+            emptySlot.pPyramidBuffer = nullptr;
+            emptySlot.pReadbackBuffer = nullptr;
+            emptySlot.isPending = false;
+        }
+        m_frameSlots.resize(frameSlotsCnt, emptySlot);
+        m_isReady = false;
+    }
+
+    // ================================================================================================================
+    void HHiZPyramid::Cleanup()
+    {
+        for (HHiZFrameSlot& slot : m_frameSlots)
+        {
+            if (slot.pPyramidBuffer != nullptr)
+            {
+                m_pGpuRsrcManager->DereferGpuBuffer(slot.pPyramidBuffer);
+                m_pGpuRsrcManager->DereferGpuBuffer(slot.pReadbackBuffer);
+            }
+        }
+        m_frameSlots.clear();
+
+        if (m_pBuildPipeline != nullptr)
+        {
+            delete m_pBuildPipeline;
+            m_pBuildPipeline = nullptr;
+        }
+
+        m_isReady = false;
+    }
+
+    // ================================================================================================================
+    void HHiZPyramid::GenLayout(
+        VkExtent2D  depthExtent,
+        HHiZLayout& layout)
+    {
+        layout.depthExtent = depthExtent;
+        layout.baseShift = 0;
+        while (((depthExtent.width + (1u << layout.baseShift) - 1) >> layout.baseShift) > HHIZ_MAX_BASE_WIDTH)
+        {
+            layout.baseShift++;
+        }
+
+        uint32_t footprint = 1u << layout.baseShift;
+        uint32_t width = (depthExtent.width + footprint - 1) >> layout.baseShift;
+        uint32_t height = (depthExtent.height + footprint - 1) >> layout.baseShift;
+        uint32_t offset = 0;
+
+        // Odd sizes round up, so a texel at the level i covers the base texels [x << i, (x + 1) << i).
+        layout.levels.clear();
+        while (true)
+        {
+            layout.levels.push_back({ width, height, offset });
+            offset += width * height;
+
+            if ((width == 1) && (height == 1))
+            {
+                break;
+            }
+
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+        }
+
+        layout.texelsCnt = offset;
+    }
+
+    // ================================================================================================================
+    void HHiZPyramid::CmdBuild(
+        VkCommandBuffer cmdBuf,
+        uint32_t        frameSlot,
+        HGpuImg*        pDepthImg,
+        VkExtent2D      depthExtent,
+        const float*    pVpMat,
+        uint64_t        frameIdx)
+    {
+        HHiZFrameSlot& slot = m_frameSlots[frameSlot];
+        assert(slot.isPending == false);
+
+        GenLayout(depthExtent, slot.layout);
+        uint32_t bytesNum = slot.layout.texelsCnt * sizeof(float);
+
+        // The buffers of the slot are reused until the depth size changes.
+        if ((slot.pPyramidBuffer != nullptr) && (slot.pPyramidBuffer->byteCnt != bytesNum))
+        {
+            m_pGpuRsrcManager->DereferGpuBuffer(slot.pPyramidBuffer);
+            m_pGpuRsrcManager->DereferGpuBuffer(slot.pReadbackBuffer);
+            slot.pPyramidBuffer = nullptr;
+            slot.pReadbackBuffer = nullptr;
+        }
+
+        if (slot.pPyramidBuffer == nullptr)
+        {
+            slot.pPyramidBuffer = m_pGpuRsrcManager->CreateGpuBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                                     VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+                                                                     bytesNum,
+                                                                     "Hi-Z Pyramid Buffer");
+
+            slot.pReadbackBuffer = m_pGpuRsrcManager->CreateGpuBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                      VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+                                                                      bytesNum,
+                                                                      "Hi-Z Readback Buffer");
+        }
+
+        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pBuildPipeline->GetVkPipeline());
+
+        std::vector<ShaderInputBinding> hiZBindings{ { HGPU_IMG, 0, pDepthImg },
+                                                     { HGPU_BUFFER, 1, slot.pPyramidBuffer } };
+        m_pBuildPipeline->CmdBindDescriptors(cmdBuf, hiZBindings);
+
+        // Each level reads the former level's writes.
+        VkMemoryBarrier2 levelBarrier{};
+        {
+            levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            levelBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            levelBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+            levelBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            levelBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+        }
+
+        VkDependencyInfo levelDependencyInfo{};
+        {
+            levelDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            levelDependencyInfo.memoryBarrierCount = 1;
+            levelDependencyInfo.pMemoryBarriers = &levelBarrier;
+        }
+
+        const std::vector<HHiZLevel>& levels = slot.layout.levels;
+        for (uint32_t i = 0; i < levels.size(); i++)
+        {
+            HiZBuildPushConstant levelInfo{};
+            {
+                levelInfo.srcWidth = (i == 0) ? slot.layout.depthExtent.width : levels[i - 1].width;
+                levelInfo.srcHeight = (i == 0) ? slot.layout.depthExtent.height : levels[i - 1].height;
+                levelInfo.srcOffset = (i == 0) ? 0 : levels[i - 1].offset;
+                levelInfo.dstWidth = levels[i].width;
+                levelInfo.dstHeight = levels[i].height;
+                levelInfo.dstOffset = levels[i].offset;
+                levelInfo.footprint = (i == 0) ? (1u << slot.layout.baseShift) : 2;
+                levelInfo.isBaseLevel = (i == 0) ? 1 : 0;
+            }
+
+            if (i != 0)
+            {
+                vkCmdPipelineBarrier2(cmdBuf, &levelDependencyInfo);
+            }
+
+            vkCmdPushConstants(cmdBuf,
+                               m_pBuildPipeline->GetVkPipelineLayout(),
+                               VK_SHADER_STAGE_COMPUTE_BIT,
+                               0,
+                               sizeof(HiZBuildPushConstant),
+                               &levelInfo);
+
+            vkCmdDispatch(cmdBuf, (levels[i].width + 7) / 8, (levels[i].height + 7) / 8, 1);
+        }
+
+        // Copy the whole pyramid to the readback buffer.
+        VkMemoryBarrier2 copyBarrier{};
+        {
+            copyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            copyBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            copyBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+            copyBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+            copyBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+        }
+
+        VkDependencyInfo copyDependencyInfo{};
+        {
+            copyDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            copyDependencyInfo.memoryBarrierCount = 1;
+            copyDependencyInfo.pMemoryBarriers = &copyBarrier;
+        }
+        vkCmdPipelineBarrier2(cmdBuf, &copyDependencyInfo);
+
+        VkBufferCopy copyRegion{};
+        {
+            copyRegion.srcOffset = 0;
+            copyRegion.dstOffset = 0;
+            copyRegion.size = bytesNum;
+        }
+        vkCmdCopyBuffer(cmdBuf, slot.pPyramidBuffer->gpuBuffer, slot.pReadbackBuffer->gpuBuffer, 1, &copyRegion);
+
+        // Make the copy visible to the host read after the fence.
+        VkBufferMemoryBarrier2 hostReadBarrier{};
+        {
+            hostReadBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+            hostReadBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+            hostReadBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+            hostReadBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+            hostReadBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+            hostReadBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            hostReadBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            hostReadBarrier.buffer = slot.pReadbackBuffer->gpuBuffer;
+            hostReadBarrier.offset = 0;
+            hostReadBarrier.size = VK_WHOLE_SIZE;
+        }
+
+        VkDependencyInfo hostDependencyInfo{};
+        {
+            hostDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            hostDependencyInfo.bufferMemoryBarrierCount = 1;
+            hostDependencyInfo.pBufferMemoryBarriers = &hostReadBarrier;
+        }
+        vkCmdPipelineBarrier2(cmdBuf, &hostDependencyInfo);
+
+        memcpy(slot.vpMat, pVpMat, sizeof(slot.vpMat));
+        slot.frameIdx = frameIdx;
+        slot.isPending = true;
+    }
+
+    // ================================================================================================================
+    void HHiZPyramid::ResolveFrameSlot(
+        uint32_t frameSlot)
+    {
+        HHiZFrameSlot& slot = m_frameSlots[frameSlot];
+        if (slot.isPending == false)
+        {
+            return;
+        }
+        slot.isPending = false;
+
+        // Swapchain images can come back out of order. An older pyramid doesn't replace a newer one.
+        if (m_isReady && (slot.frameIdx <= m_frameIdx))
+        {
+            return;
+        }
+
+        m_layout = slot.layout;
+        m_pyramid.resize(slot.layout.texelsCnt);
+        m_pGpuRsrcManager->ReadDataFromBuffer(slot.pReadbackBuffer,
+                                              m_pyramid.data(),
+                                              slot.layout.texelsCnt * sizeof(float));
+        memcpy(m_vpMat, slot.vpMat, sizeof(m_vpMat));
+        m_frameIdx = slot.frameIdx;
+        m_isReady = true;
+    }
+
+    // ================================================================================================================
+    bool HHiZPyramid::IsSphereOccluded(
+        const float* pCenter,
+        float        radius) const
+    {
+        if (m_isReady == false)
+        {
+            return false;
+        }
+
+        // Project the corners of the sphere's bounding box. The box encloses the sphere, so its screen rectangle and
+        // its nearest depth are conservative.
+        float ndcMin[2] = { FLT_MAX, FLT_MAX };
+        float ndcMax[2] = { -FLT_MAX, -FLT_MAX };
+        float nearestDepth = 0.f;
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            float corner[4] = { pCenter[0] + ((i & 1) ? radius : -radius),
+                                pCenter[1] + ((i & 2) ? radius : -radius),
+                                pCenter[2] + ((i & 4) ? radius : -radius),
+                                1.f };
+            float clipPos[4];
+            MatMulVec(m_vpMat, corner, 4, clipPos);
+
+            // The corners don't bound the projection of a box behind the camera.
+            if (clipPos[3] <= 0.f)
+            {
+                return false;
+            }
+
+            float invW = 1.f / clipPos[3];
+            for (uint32_t axis = 0; axis < 2; axis++)
+            {
+                ndcMin[axis] = std::min(ndcMin[axis], clipPos[axis] * invW);
+                ndcMax[axis] = std::max(ndcMax[axis], clipPos[axis] * invW);
+            }
+
+            // The depth is reversed, so the nearest depth is the max depth.
+            nearestDepth = std::max(nearestDepth, clipPos[2] * invW);
+        }
+
+        // In front of the near plane or out of the screen. The frustum culling decides them.
+        if ((nearestDepth >= 1.f) ||
+            (ndcMax[0] < -1.f) || (ndcMin[0] > 1.f) ||
+            (ndcMax[1] < -1.f) || (ndcMin[1] > 1.f))
+        {
+            return false;
+        }
+
+        auto ndcToBaseTexel = [this](float ndc, uint32_t depthSize) {
+            float depthTexel = (std::min(std::max(ndc, -1.f), 1.f) * 0.5f + 0.5f) * depthSize;
+            return std::min(static_cast<uint32_t>(depthTexel), depthSize - 1) >> m_layout.baseShift;
+        };
+
+        uint32_t minX = ndcToBaseTexel(ndcMin[0], m_layout.depthExtent.width);
+        uint32_t maxX = ndcToBaseTexel(ndcMax[0], m_layout.depthExtent.width);
+        uint32_t minY = ndcToBaseTexel(ndcMin[1], m_layout.depthExtent.height);
+        uint32_t maxY = ndcToBaseTexel(ndcMax[1], m_layout.depthExtent.height);
+
+        // The finest level that covers the rectangle with at most 2x2 texels.
+        uint32_t levelIdx = 0;
+        while ((levelIdx + 1 < m_layout.levels.size()) &&
+               (((maxX >> levelIdx) - (minX >> levelIdx) > 1) || ((maxY >> levelIdx) - (minY >> levelIdx) > 1)))
+        {
+            levelIdx++;
+        }
+
+        const HHiZLevel& level = m_layout.levels[levelIdx];
+        float farthestDepth = 1.f;
+        for (uint32_t y = (minY >> levelIdx); y <= (maxY >> levelIdx); y++)
+        {
+            for (uint32_t x = (minX >> levelIdx); x <= (maxX >> levelIdx); x++)
+            {
+                farthestDepth = std::min(farthestDepth, m_pyramid[level.offset + y * level.width + x]);
+            }
+        }
+
+        return nearestDepth < farthestDepth;
+    }
+}
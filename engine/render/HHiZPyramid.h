@@ -0,0 +1,120 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "HPipeline.h"
+#include "../core/HGpuRsrcManager.h"
+
+// The base level of the pyramid is the depth image halved until it's not wider than this. The CPU occlusion test only
+// needs coarse levels and the readback stays small.
+#define HHIZ_MAX_BASE_WIDTH 256
+
+namespace Hedge
+{
+    // It must match the HiZLevelInfo in the hiz_build_comp.hlsl.
+    struct HiZBuildPushConstant
+    {
+        uint32_t srcWidth;
+        uint32_t srcHeight;
+        uint32_t srcOffset;
+        uint32_t dstWidth;
+        uint32_t dstHeight;
+        uint32_t dstOffset;
+        uint32_t footprint;
+        uint32_t isBaseLevel;
+    };
+
+    // The compute pipeline builds one level of the Hi-Z pyramid from the depth image or from the former level.
+    class HHiZBuildPipeline : public HPipeline
+    {
+    public:
+        HHiZBuildPipeline();
+        ~HHiZBuildPipeline();
+
+    protected:
+        virtual void CreateSetCustomPipelineInfo() override;
+
+    private:
+        void CreateSetDescriptorSetLayouts();
+        void CreateSetHiZPipelineLayout();
+    };
+
+    // The hierarchical-Z pyramid keeps the farthest depth of each screen tile in a chain of levels. Each level halves
+    // the former one, so any screen rectangle is covered by at most 2x2 texels of some level.
+    //
+    // The pyramid is built on the GPU from a frame's depth and read back when the frame slot comes back, like the
+    // HFrameCapturer. Later frames occlusion-cull the objects' bounds against the latest read back pyramid with the
+    // view-perspective matrix of the frame that built it. So, the result lags behind by the frames in flight:
+    // Objects just revealed by a fast moving camera or occluder may pop in a few frames late.
+    class HHiZPyramid
+    {
+    public:
+        HHiZPyramid();
+        ~HHiZPyramid();
+
+        void Init(HGpuRsrcManager* pGpuRsrcManager, uint32_t frameSlotsCnt);
+        void Cleanup();
+
+        // The depth image must be in the SHADER_READ_ONLY_OPTIMAL layout. E.g. Use it in a render graph pass that has
+        // the HRG_ACCESS_COMPUTE_SAMPLED access of the depth. depthExtent is the rendered top left corner of the depth
+        // image, which is smaller than the image with the dynamic resolution. pVpMat is the depth's view-perspective
+        // matrix.
+        void CmdBuild(VkCommandBuffer cmdBuf,
+                      uint32_t        frameSlot,
+                      HGpuImg*        pDepthImg,
+                      VkExtent2D      depthExtent,
+                      const float*    pVpMat,
+                      uint64_t        frameIdx);
+
+        // The frame slot's in-flight fence must be waited. The slot's pyramid is used by the later tests if it's newer.
+        void ResolveFrameSlot(uint32_t frameSlot);
+
+        // The slot's build commands are not submitted. E.g. The command buffer is reset.
+        void DiscardFrameSlot(uint32_t frameSlot) { m_frameSlots[frameSlot].isPending = false; }
+
+        bool IsReady() const { return m_isReady; }
+
+        // Whether a world space sphere is behind the farthest depth of its screen rectangle. It's conservative: Spheres
+        // crossing the near plane or out of the screen are never occluded.
+        bool IsSphereOccluded(const float* pCenter, float radius) const;
+
+    private:
+        struct HHiZLevel
+        {
+            uint32_t width;
+            uint32_t height;
+            uint32_t offset; // In floats.
+        };
+
+        // The levels layout of a depth extent.
+        struct HHiZLayout
+        {
+            VkExtent2D             depthExtent;
+            uint32_t               baseShift; // A base level texel covers (1 << baseShift)^2 depth texels.
+            std::vector<HHiZLevel> levels;
+            uint32_t               texelsCnt;
+        };
+
+        struct HHiZFrameSlot
+        {
+            HGpuBuffer* pPyramidBuffer;
+            HGpuBuffer* pReadbackBuffer;
+            HHiZLayout  layout;
+            float       vpMat[16];
+            uint64_t    frameIdx;
+            bool        isPending;
+        };
+
+        static void GenLayout(VkExtent2D depthExtent, HHiZLayout& layout);
+
+        HGpuRsrcManager*           m_pGpuRsrcManager;
+        HHiZBuildPipeline*         m_pBuildPipeline;
+        std::vector<HHiZFrameSlot> m_frameSlots;
+
+        // The latest read back pyramid.
+        bool               m_isReady;
+        HHiZLayout         m_layout;
+        std::vector<float> m_pyramid;
+        float              m_vpMat[16];
+        uint64_t           m_frameIdx;
+    };
+}
@@ -0,0 +1,230 @@
+#include "HLightCluster.h"
+#include "../scene/HScene.h"
+#include "../util/UtilMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Hedge
+{
+    // ================================================================================================================
+    HLightClusterBuilder::HLightClusterBuilder()
+        : m_near(0.f),
+          m_far(0.f),
+          m_tanHalfFovX(0.f),
+          m_tanHalfFovY(0.f),
+          m_clusterMinX(HCLUSTER_CNT),
+          m_clusterMinY(HCLUSTER_CNT),
+          m_clusterMinZ(HCLUSTER_CNT),
+          m_clusterMaxX(HCLUSTER_CNT),
+          m_clusterMaxY(HCLUSTER_CNT),
+          m_clusterMaxZ(HCLUSTER_CNT),
+          m_clusterLights(HCLUSTER_CNT * HCLUSTER_MAX_LIGHTS),
+          m_clusterLightsCnt(HCLUSTER_CNT),
+          m_rowOverlap(HCLUSTER_GRID_X),
+          m_clusterInfo{},
+          m_clusterGrid(HCLUSTER_CNT * 2)
+    {
+        m_clusterInfo.gridDim[0] = HCLUSTER_GRID_X;
+        m_clusterInfo.gridDim[1] = HCLUSTER_GRID_Y;
+        m_clusterInfo.gridDim[2] = HCLUSTER_GRID_Z;
+    }
+
+    // ================================================================================================================
+    HLightClusterBuilder::~HLightClusterBuilder()
+    {}
+
+    // ================================================================================================================
+    void HLightClusterBuilder::UpdateClusterAabbs(
+        float nearPlane,
+        float farPlane,
+        float tanHalfFovX,
+        float tanHalfFovY)
+    {
+        m_near = nearPlane;
+        m_far = farPlane;
+        m_tanHalfFovX = tanHalfFovX;
+        m_tanHalfFovY = tanHalfFovY;
+
+        for (uint32_t z = 0; z < HCLUSTER_GRID_Z; z++)
+        {
+            // Exponential slices, so the clusters are roughly cubic in the camera space.
+            float depth0 = nearPlane * powf(farPlane / nearPlane, (float)z / HCLUSTER_GRID_Z);
+            float depth1 = nearPlane * powf(farPlane / nearPlane, (float)(z + 1) / HCLUSTER_GRID_Z);
+
+            for (uint32_t y = 0; y < HCLUSTER_GRID_Y; y++)
+            {
+                // The tile row 0 is at the top of the screen, which is the +y in the camera space.
+                float ndcY0 = -1.f + 2.f * y / HCLUSTER_GRID_Y;
+                float ndcY1 = -1.f + 2.f * (y + 1) / HCLUSTER_GRID_Y;
+
+                for (uint32_t x = 0; x < HCLUSTER_GRID_X; x++)
+                {
+                    float ndcX0 = -1.f + 2.f * x / HCLUSTER_GRID_X;
+                    float ndcX1 = -1.f + 2.f * (x + 1) / HCLUSTER_GRID_X;
+
+                    // The froxel's corners are on its near and far planes.
+                    float xs[4] = { ndcX0 * depth0, ndcX0 * depth1, ndcX1 * depth0, ndcX1 * depth1 };
+                    float ys[4] = { -ndcY0 * depth0, -ndcY0 * depth1, -ndcY1 * depth0, -ndcY1 * depth1 };
+
+                    uint32_t clusterIdx = (z * HCLUSTER_GRID_Y + y) * HCLUSTER_GRID_X + x;
+                    m_clusterMinX[clusterIdx] = *std::min_element(xs, xs + 4) * tanHalfFovX;
+                    m_clusterMaxX[clusterIdx] = *std::max_element(xs, xs + 4) * tanHalfFovX;
+                    m_clusterMinY[clusterIdx] = *std::min_element(ys, ys + 4) * tanHalfFovY;
+                    m_clusterMaxY[clusterIdx] = *std::max_element(ys, ys + 4) * tanHalfFovY;
+                    m_clusterMinZ[clusterIdx] = depth0;
+                    m_clusterMaxZ[clusterIdx] = depth1;
+                }
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HLightClusterBuilder::Build(
+        const SceneRenderInfo& sceneRenderInfo,
+        float                  viewportWidth,
+        float                  viewportHeight)
+    {
+        const CameraInfo& camInfo = sceneRenderInfo.cameraInfo;
+
+        m_lightIndices.clear();
+        memset(m_clusterLightsCnt.data(), 0, m_clusterLightsCnt.size() * sizeof(uint16_t));
+
+        float nearPlane = camInfo.nearPlane;
+        float farPlane = sceneRenderInfo.cameraFarPlane;
+        uint32_t lightsCnt = sceneRenderInfo.pointLightsPositions.size();
+
+        // No camera or no light. Every cluster is empty.
+        if ((nearPlane <= 0.f) || (farPlane <= nearPlane) || (lightsCnt == 0))
+        {
+            memset(m_clusterGrid.data(), 0, m_clusterGrid.size() * sizeof(uint32_t));
+            m_lightIndices.push_back(0); // A GPU buffer cannot be empty.
+            return;
+        }
+
+        float tanHalfFovX = camInfo.nearWidthHeight[0] / (2.f * nearPlane);
+        float tanHalfFovY = camInfo.nearWidthHeight[1] / (2.f * nearPlane);
+        if ((nearPlane != m_near) || (farPlane != m_far) ||
+            (tanHalfFovX != m_tanHalfFovX) || (tanHalfFovY != m_tanHalfFovY))
+        {
+            UpdateClusterAabbs(nearPlane, farPlane, tanHalfFovX, tanHalfFovY);
+        }
+
+        // The camera basis. Same as the GenViewMat(...).
+        float view[3] = { camInfo.view[0], camInfo.view[1], camInfo.view[2] };
+        float worldUp[3] = { camInfo.up[0], camInfo.up[1], camInfo.up[2] };
+        float right[3] = {};
+        float up[3] = {};
+        NormalizeVec(view, 3);
+        CrossProductVec3(view, worldUp, right);
+        NormalizeVec(right, 3);
+        CrossProductVec3(right, view, up);
+
+        float logScale = HCLUSTER_GRID_Z / logf(farPlane / nearPlane);
+        float logBias = -logf(nearPlane) * logScale;
+
+        for (uint32_t lightIdx = 0; lightIdx < lightsCnt; lightIdx++)
+        {
+            const float* pPos = sceneRenderInfo.pointLightsPositions[lightIdx].eles;
+            float radius = sceneRenderInfo.pointLightsRadii[lightIdx];
+
+            float toLight[3] = { pPos[0] - sceneRenderInfo.cameraPos[0],
+                                 pPos[1] - sceneRenderInfo.cameraPos[1],
+                                 pPos[2] - sceneRenderInfo.cameraPos[2] };
+
+            float sphere[4] = { DotProduct(toLight, right, 3),
+                                DotProduct(toLight, up, 3),
+                                DotProduct(toLight, view, 3),
+                                radius };
+
+            if ((sphere[2] + radius < nearPlane) || (sphere[2] - radius > farPlane))
+            {
+                continue;
+            }
+
+            // Conservative depth slice range.
+            float depthMin = std::max(sphere[2] - radius, nearPlane);
+            float depthMax = std::min(sphere[2] + radius, farPlane);
+            int32_t z0 = std::clamp((int32_t)floorf(logf(depthMin) * logScale + logBias), 0, HCLUSTER_GRID_Z - 1);
+            int32_t z1 = std::clamp((int32_t)floorf(logf(depthMax) * logScale + logBias), 0, HCLUSTER_GRID_Z - 1);
+
+            // Conservative screen tile range. x / depth over the sphere's bounding box peaks at the box's corners.
+            float invNearX = 1.f / (depthMin * tanHalfFovX);
+            float invFarX = 1.f / (depthMax * tanHalfFovX);
+            float invNearY = -1.f / (depthMin * tanHalfFovY);
+            float invFarY = -1.f / (depthMax * tanHalfFovY);
+
+            float ndcX[4] = { (sphere[0] - radius) * invNearX, (sphere[0] + radius) * invNearX,
+                              (sphere[0] - radius) * invFarX,  (sphere[0] + radius) * invFarX };
+            float ndcY[4] = { (sphere[1] - radius) * invNearY, (sphere[1] + radius) * invNearY,
+                              (sphere[1] - radius) * invFarY,  (sphere[1] + radius) * invFarY };
+
+            float ndcXMin = *std::min_element(ndcX, ndcX + 4);
+            float ndcXMax = *std::max_element(ndcX, ndcX + 4);
+            float ndcYMin = *std::min_element(ndcY, ndcY + 4);
+            float ndcYMax = *std::max_element(ndcY, ndcY + 4);
+
+            if ((ndcXMin > 1.f) || (ndcXMax < -1.f) || (ndcYMin > 1.f) || (ndcYMax < -1.f))
+            {
+                continue;
+            }
+
+            int32_t x0 = std::clamp((int32_t)floorf((ndcXMin + 1.f) * 0.5f * HCLUSTER_GRID_X), 0, HCLUSTER_GRID_X - 1);
+            int32_t x1 = std::clamp((int32_t)floorf((ndcXMax + 1.f) * 0.5f * HCLUSTER_GRID_X), 0, HCLUSTER_GRID_X - 1);
+            int32_t y0 = std::clamp((int32_t)floorf((ndcYMin + 1.f) * 0.5f * HCLUSTER_GRID_Y), 0, HCLUSTER_GRID_Y - 1);
+            int32_t y1 = std::clamp((int32_t)floorf((ndcYMax + 1.f) * 0.5f * HCLUSTER_GRID_Y), 0, HCLUSTER_GRID_Y - 1);
+            uint32_t rowCnt = x1 - x0 + 1;
+
+            // Exact sphere-AABB tests on the clusters in the range, a row at a time.
+            for (int32_t z = z0; z <= z1; z++)
+            {
+                for (int32_t y = y0; y <= y1; y++)
+                {
+                    uint32_t rowBase = (z * HCLUSTER_GRID_Y + y) * HCLUSTER_GRID_X + x0;
+                    SphereOverlapAabbs(sphere,
+                                       &m_clusterMinX[rowBase],
+                                       &m_clusterMinY[rowBase],
+                                       &m_clusterMinZ[rowBase],
+                                       &m_clusterMaxX[rowBase],
+                                       &m_clusterMaxY[rowBase],
+                                       &m_clusterMaxZ[rowBase],
+                                       rowCnt,
+                                       m_rowOverlap.data());
+
+                    for (uint32_t i = 0; i < rowCnt; i++)
+                    {
+                        uint32_t clusterIdx = rowBase + i;
+                        if (m_rowOverlap[i] && (m_clusterLightsCnt[clusterIdx] < HCLUSTER_MAX_LIGHTS))
+                        {
+                            uint32_t slot = clusterIdx * HCLUSTER_MAX_LIGHTS + m_clusterLightsCnt[clusterIdx];
+                            m_clusterLights[slot] = lightIdx;
+                            m_clusterLightsCnt[clusterIdx]++;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Pack all clusters' lights into one list.
+        for (uint32_t clusterIdx = 0; clusterIdx < HCLUSTER_CNT; clusterIdx++)
+        {
+            uint32_t cnt = m_clusterLightsCnt[clusterIdx];
+            m_clusterGrid[clusterIdx * 2] = m_lightIndices.size();
+            m_clusterGrid[clusterIdx * 2 + 1] = cnt;
+
+            const uint16_t* pLights = &m_clusterLights[clusterIdx * HCLUSTER_MAX_LIGHTS];
+            m_lightIndices.insert(m_lightIndices.end(), pLights, pLights + cnt);
+        }
+
+        if (m_lightIndices.empty())
+        {
+            m_lightIndices.push_back(0);
+        }
+
+        memcpy(m_clusterInfo.cameraView, view, sizeof(view));
+        m_clusterInfo.logScale = logScale;
+        m_clusterInfo.logBias = logBias;
+        m_clusterInfo.gridScale[0] = HCLUSTER_GRID_X / viewportWidth;
+        m_clusterInfo.gridScale[1] = HCLUSTER_GRID_Y / viewportHeight;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// The view frustum is divided into HCLUSTER_GRID_X * HCLUSTER_GRID_Y screen tiles and HCLUSTER_GRID_Z exponential
+// depth slices. Each froxel (cluster) only lists the point lights whose spheres touch it.
+#define HCLUSTER_GRID_X 16
+#define HCLUSTER_GRID_Y 9
+#define HCLUSTER_GRID_Z 24
+#define HCLUSTER_CNT (HCLUSTER_GRID_X * HCLUSTER_GRID_Y * HCLUSTER_GRID_Z)
+
+// Lights beyond this count in one cluster are dropped.
+#define HCLUSTER_MAX_LIGHTS 128
+
+namespace Hedge
+{
+    struct SceneRenderInfo;
+
+    // The fragment shader uses it to find the pixel's cluster. It must match the ClusterInfo in the PBR frag shaders.
+    struct HClusterInfo
+    {
+        float    cameraView[3];
+        float    logScale;      // slice = log(depth) * logScale + logBias.
+        float    gridScale[2];  // tile = pixel position * gridScale.
+        float    logBias;
+        uint32_t padding0;
+        uint32_t gridDim[3];
+        uint32_t padding1;
+    };
+
+    // Clustered forward shading (Olsson et al. 2012). The light assignment is built on the CPU every frame:
+    // The cluster AABBs are in the camera space and only rebuilt when the projection changes. Each light only tests
+    // the clusters in its screen and depth range, a row of clusters at a time with the SIMD sphere-AABB test.
+    //
+    // Outputs:
+    // - The cluster grid: (offset, count) into the light index list for each cluster.
+    // - The light index list: Point light indices of all clusters packed together.
+    class HLightClusterBuilder
+    {
+    public:
+        HLightClusterBuilder();
+        ~HLightClusterBuilder();
+
+        // The viewport is the rendered area in pixels. It's smaller than the camera's viewport with the dynamic
+        // resolution, so the fragment coordinates map to the clusters.
+        void Build(const SceneRenderInfo& sceneRenderInfo, float viewportWidth, float viewportHeight);
+
+        const HClusterInfo&          GetClusterInfo() const { return m_clusterInfo; }
+        const std::vector<uint32_t>& GetClusterGrid() const { return m_clusterGrid; }
+        const std::vector<uint32_t>& GetLightIndices() const { return m_lightIndices; }
+
+    private:
+        // Rebuild the camera space cluster AABBs. It's only necessary when the projection parameters change.
+        void UpdateClusterAabbs(float nearPlane, float farPlane, float tanHalfFovX, float tanHalfFovY);
+
+        float m_near;
+        float m_far;
+        float m_tanHalfFovX;
+        float m_tanHalfFovY;
+
+        // Camera space: x -- right, y -- up, z -- depth along the view direction.
+        std::vector<float> m_clusterMinX;
+        std::vector<float> m_clusterMinY;
+        std::vector<float> m_clusterMinZ;
+        std::vector<float> m_clusterMaxX;
+        std::vector<float> m_clusterMaxY;
+        std::vector<float> m_clusterMaxZ;
+
+        // Per frame scratch data.
+        std::vector<uint16_t> m_clusterLights; // HCLUSTER_MAX_LIGHTS slots per cluster.
+        std::vector<uint16_t> m_clusterLightsCnt;
+        std::vector<uint8_t>  m_rowOverlap;
+
+        HClusterInfo          m_clusterInfo;
+        std::vector<uint32_t> m_clusterGrid;
+        std::vector<uint32_t> m_lightIndices;
+    };
+}
@@ -0,0 +1,159 @@
+#include "HParallelCmdRecorder.h"
+#include "Utils.h"
+#include "../core/HJobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+extern Hedge::HJobSystem* g_pJobSystem;
+
+namespace Hedge
+{
+    // ================================================================================================================
+    HParallelCmdRecorder::HParallelCmdRecorder()
+        : m_device(VK_NULL_HANDLE),
+          m_chunksCnt(0),
+          m_curFrameSlot(0),
+          m_inheritedPipelineStatistics(0),
+          m_pRenderingInheritance(nullptr),
+          m_pRecordFunc(nullptr),
+          m_itemsCnt(0)
+    {}
+
+    // ================================================================================================================
+    HParallelCmdRecorder::~HParallelCmdRecorder()
+    {
+        Cleanup();
+    }
+
+    // ================================================================================================================
+    void HParallelCmdRecorder::Init(
+        VkDevice device,
+        uint32_t queueFamilyIdx,
+        uint32_t frameSlotsCnt,
+        uint32_t chunksCnt)
+    {
+        m_device = device;
+
+        // It's called before the job system is available, so the chunks follow the hardware instead of the workers.
+        if (chunksCnt == 0)
+        {
+            // Recording is rarely worth more than a handful of threads.
+            chunksCnt = std::min(std::max(std::thread::hardware_concurrency(), 1u), 8u);
+        }
+        m_chunksCnt = chunksCnt;
+
+        m_cmdPools.resize(frameSlotsCnt);
+        m_cmdBuffers.resize(frameSlotsCnt);
+        for (uint32_t slot = 0; slot < frameSlotsCnt; slot++)
+        {
+            m_cmdPools[slot].resize(chunksCnt);
+            m_cmdBuffers[slot].resize(chunksCnt);
+
+            for (uint32_t chunk = 0; chunk < chunksCnt; chunk++)
+            {
+                // The whole pool is reset every frame, so we don't need the reset command buffer bit.
+                VkCommandPoolCreateInfo poolInfo{};
+                {
+                    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                    poolInfo.queueFamilyIndex = queueFamilyIdx;
+                }
+                VK_CHECK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_cmdPools[slot][chunk]));
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                {
+                    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                    allocInfo.commandPool = m_cmdPools[slot][chunk];
+                    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                    allocInfo.commandBufferCount = 1;
+                }
+                VK_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, &m_cmdBuffers[slot][chunk]));
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HParallelCmdRecorder::Cleanup()
+    {
+        for (auto& slotPools : m_cmdPools)
+        {
+            for (VkCommandPool pool : slotPools)
+            {
+                vkDestroyCommandPool(m_device, pool, nullptr);
+            }
+        }
+        m_cmdPools.clear();
+        m_cmdBuffers.clear();
+    }
+
+    // ================================================================================================================
+    void HParallelCmdRecorder::BeginFrame(
+        uint32_t frameSlot)
+    {
+        m_curFrameSlot = frameSlot;
+        for (VkCommandPool pool : m_cmdPools[frameSlot])
+        {
+            VK_CHECK(vkResetCommandPool(m_device, pool, 0));
+        }
+    }
+
+    // ================================================================================================================
+    void HParallelCmdRecorder::RecordChunk(
+        uint32_t chunkIdx)
+    {
+        uint32_t begin = (uint64_t)m_itemsCnt * chunkIdx / m_chunksCnt;
+        uint32_t end = (uint64_t)m_itemsCnt * (chunkIdx + 1) / m_chunksCnt;
+
+        VkCommandBuffer cmdBuf = m_cmdBuffers[m_curFrameSlot][chunkIdx];
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        {
+            inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            inheritanceInfo.pNext = m_pRenderingInheritance;
+            inheritanceInfo.pipelineStatistics = m_inheritedPipelineStatistics;
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        {
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                              VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            beginInfo.pInheritanceInfo = &inheritanceInfo;
+        }
+
+        VK_CHECK(vkBeginCommandBuffer(cmdBuf, &beginInfo));
+        if (begin < end)
+        {
+            (*m_pRecordFunc)(cmdBuf, begin, end);
+        }
+        VK_CHECK(vkEndCommandBuffer(cmdBuf));
+    }
+
+    // ================================================================================================================
+    void HParallelCmdRecorder::CmdRecordParallel(
+        VkCommandBuffer                                primaryCmdBuf,
+        const VkCommandBufferInheritanceRenderingInfo& renderingInheritance,
+        uint32_t                                       itemsCnt,
+        const HCmdRecordFunc&                          recordFunc)
+    {
+        assert(m_chunksCnt > 0);
+
+        m_pRenderingInheritance = &renderingInheritance;
+        m_pRecordFunc = &recordFunc;
+        m_itemsCnt = itemsCnt;
+
+        // A chunk per job. The calling thread records the first chunk and helps with the others until they are done.
+        g_pJobSystem->ParallelFor(m_chunksCnt, 1, [this](uint32_t begin, uint32_t end) {
+            for (uint32_t chunk = begin; chunk < end; chunk++)
+            {
+                RecordChunk(chunk);
+            }
+        });
+
+        vkCmdExecuteCommands(primaryCmdBuf, m_chunksCnt, m_cmdBuffers[m_curFrameSlot].data());
+
+        m_pRenderingInheritance = nullptr;
+        m_pRecordFunc = nullptr;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <functional>
+
+namespace Hedge
+{
+    // Record a chunk of draws [begin, end) into the secondary command buffer.
+    using HCmdRecordFunc = std::function<void(VkCommandBuffer secondaryCmdBuf, uint32_t begin, uint32_t end)>;
+
+    // Records a draw list with the job system's threads. The draw list is split into a fixed number of chunks. Each
+    // chunk has its own command pool for each frame in flight, so a pool is only used by one job at a time and is only
+    // reset after its frame is finished. The chunks are recorded into secondary command buffers, which are executed by
+    // the primary in the chunks' order.
+    class HParallelCmdRecorder
+    {
+    public:
+        HParallelCmdRecorder();
+        ~HParallelCmdRecorder();
+
+        // 0 chunksCnt means to use the hardware concurrency.
+        void Init(VkDevice device, uint32_t queueFamilyIdx, uint32_t frameSlotsCnt, uint32_t chunksCnt);
+        void Cleanup();
+
+        // Reset the command pools of the frame slot. The GPU must be done with the frame slot's previous commands.
+        void BeginFrame(uint32_t frameSlot);
+
+        uint32_t GetChunksCnt() const { return m_chunksCnt; }
+
+        // Secondary command buffers executed inside of an active pipeline statistics query must inherit its flags.
+        void SetInheritedPipelineStatistics(VkQueryPipelineStatisticFlags flags)
+        {
+            m_inheritedPipelineStatistics = flags;
+        }
+
+        // Must be called inside of a vkCmdBeginRendering(...) with the
+        // VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT. Secondary command buffers don't inherit any states, so
+        // the recordFunc needs to bind the pipeline, descriptors and set the dynamic states.
+        void CmdRecordParallel(VkCommandBuffer                                 primaryCmdBuf,
+                               const VkCommandBufferInheritanceRenderingInfo& renderingInheritance,
+                               uint32_t                                        itemsCnt,
+                               const HCmdRecordFunc&                           recordFunc);
+
+    private:
+        // Record a chunk of the current draw list into its secondary command buffer.
+        void RecordChunk(uint32_t chunkIdx);
+
+        VkDevice m_device;
+        uint32_t m_chunksCnt;
+        uint32_t m_curFrameSlot;
+
+        VkQueryPipelineStatisticFlags m_inheritedPipelineStatistics;
+
+        std::vector<std::vector<VkCommandPool>>   m_cmdPools;   // [Frame slot][Chunk]
+        std::vector<std::vector<VkCommandBuffer>> m_cmdBuffers; // [Frame slot][Chunk]
+
+        // The current job.
+        const VkCommandBufferInheritanceRenderingInfo* m_pRenderingInheritance;
+        const HCmdRecordFunc*                          m_pRecordFunc;
+        uint32_t                                       m_itemsCnt;
+    };
+}
@@ -18,6 +18,7 @@ namespace Hedge
         m_pColorBlending(nullptr),
         m_pDynamicState(nullptr),
         m_pipelineLayout(VK_NULL_HANDLE),
+        m_pipelineBindPoint(VK_PIPELINE_BIND_POINT_GRAPHICS),
         m_isVertexInputInfoDefault(false),
         m_device(VK_NULL_HANDLE),
         m_pDepthStencilState(nullptr),
@@ -202,6 +203,12 @@ namespace Hedge
 
         CreateSetCustomPipelineInfo();
 
+        if ((m_shaderStgInfos.size() == 1) && (m_shaderStgInfos[0].stage == VK_SHADER_STAGE_COMPUTE_BIT))
+        {
+            CreateComputePipeline();
+            return;
+        }
+
         if (m_pVertexInputInfo == nullptr)
         {
             SetDefaultVertexInputInfo();
@@ -322,10 +329,14 @@ namespace Hedge
     }
 
     // ================================================================================================================
-    PBRPipeline::PBRPipeline() :
-        HPipeline()
+    PBRPipeline::PBRPipeline(
+        bool     isDepthPrepassed,
+        uint32_t features) :
+        HPipeline(),
+        m_isDepthPrepassed(isDepthPrepassed),
+        m_features(features)
     {
-
+        assert(features < HPBR_PERMUTATIONS_CNT);
     }
 
     // ================================================================================================================
@@ -440,6 +451,45 @@ namespace Hedge
         }
         pbrDescriptorSetBindings.push_back(ptLightRadianceBinding);
 
+        // The instances' model matrices of the frame. The objects sharing a mesh and a material are one instanced draw.
+        VkDescriptorSetLayoutBinding instancesBinding{};
+        {
+            instancesBinding.binding = 10;
+            instancesBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+            instancesBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            instancesBinding.descriptorCount = 1;
+        }
+        pbrDescriptorSetBindings.push_back(instancesBinding);
+
+        // Clustered light culling data: The cluster info UBO, the per-cluster (offset, count) grid and the light index
+        // list.
+        VkDescriptorSetLayoutBinding clusterInfoBinding{};
+        {
+            clusterInfoBinding.binding = 11;
+            clusterInfoBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            clusterInfoBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            clusterInfoBinding.descriptorCount = 1;
+        }
+        pbrDescriptorSetBindings.push_back(clusterInfoBinding);
+
+        VkDescriptorSetLayoutBinding clusterGridBinding{};
+        {
+            clusterGridBinding.binding = 12;
+            clusterGridBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            clusterGridBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            clusterGridBinding.descriptorCount = 1;
+        }
+        pbrDescriptorSetBindings.push_back(clusterGridBinding);
+
+        VkDescriptorSetLayoutBinding lightIndicesBinding{};
+        {
+            lightIndicesBinding.binding = 13;
+            lightIndicesBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            lightIndicesBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            lightIndicesBinding.descriptorCount = 1;
+        }
+        pbrDescriptorSetBindings.push_back(lightIndicesBinding);
+
         // Create descriptor layouts create infos
         VkDescriptorSetLayoutCreateInfo pbrDesSetLayoutInfo{};
         {
@@ -487,21 +537,10 @@ namespace Hedge
     // ================================================================================================================
     void PBRPipeline::CreateSetCustomPipelineInfo()
     {
-        VkPipelineRenderingCreateInfoKHR pipelineRenderCreateInfo{};
-        {
-            pipelineRenderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
-            pipelineRenderCreateInfo.colorAttachmentCount = 1;
-            pipelineRenderCreateInfo.pColorAttachmentFormats = &m_colorAttachmentFormat;
-            pipelineRenderCreateInfo.depthAttachmentFormat = VK_FORMAT_D16_UNORM;
-        }
-
-        VkPipelineRenderingCreateInfoKHR* pPipelineRenderCreateInfo = new VkPipelineRenderingCreateInfoKHR();
-        memcpy(pPipelineRenderCreateInfo, &pipelineRenderCreateInfo, sizeof(VkPipelineRenderingCreateInfoKHR));
-        SetPNext(pPipelineRenderCreateInfo);
-
         // Load shader scripts and create shader modules
         VkShaderModule vertShaderModule = CreateShaderModule((uint32_t*)pbr_vertScript, sizeof(pbr_vertScript));
-        VkShaderModule fragShaderModule = CreateShaderModule((uint32_t*)pbr_fragScript, sizeof(pbr_fragScript));
+        VkShaderModule fragShaderModule = CreateShaderModule((uint32_t*)pbr_fragPermutationsScripts[m_features],
+                                                             pbr_fragPermutationsBytes[m_features]);
         
         AddShaderStageInfo(CreateDefaultShaderStgCreateInfo(vertShaderModule, VK_SHADER_STAGE_VERTEX_BIT));
         AddShaderStageInfo(CreateDefaultShaderStgCreateInfo(fragShaderModule, VK_SHADER_STAGE_FRAGMENT_BIT));
@@ -515,6 +554,24 @@ namespace Hedge
         // Create pipeline layout
         CreateSetPBRPipelineLayout();
 
+        CreateSetPBRFixedStatesInfo();
+    }
+
+    // ================================================================================================================
+    void PBRPipeline::CreateSetPBRFixedStatesInfo()
+    {
+        VkPipelineRenderingCreateInfoKHR pipelineRenderCreateInfo{};
+        {
+            pipelineRenderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+            pipelineRenderCreateInfo.colorAttachmentCount = 1;
+            pipelineRenderCreateInfo.pColorAttachmentFormats = &m_colorAttachmentFormat;
+            pipelineRenderCreateInfo.depthAttachmentFormat = VK_FORMAT_D16_UNORM;
+        }
+
+        VkPipelineRenderingCreateInfoKHR* pPipelineRenderCreateInfo = new VkPipelineRenderingCreateInfoKHR();
+        memcpy(pPipelineRenderCreateInfo, &pipelineRenderCreateInfo, sizeof(VkPipelineRenderingCreateInfoKHR));
+        SetPNext(pPipelineRenderCreateInfo);
+
         VkPipelineVertexInputStateCreateInfo vertInputInfo = CreatePipelineVertexInputInfo();
         VkPipelineVertexInputStateCreateInfo* pVertInputInfo = new VkPipelineVertexInputStateCreateInfo();
         memcpy(pVertInputInfo, &vertInputInfo, sizeof(vertInputInfo));
@@ -590,6 +647,12 @@ namespace Hedge
             depthStencilInfo.depthTestEnable = VK_TRUE;
             depthStencilInfo.depthWriteEnable = VK_TRUE;
             depthStencilInfo.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL; // Reverse depth for higher precision. 
+            if (m_isDepthPrepassed)
+            {
+                // Only the closest surface of each pixel is in the prepassed depth.
+                depthStencilInfo.depthWriteEnable = VK_FALSE;
+                depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+            }
             depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
             depthStencilInfo.stencilTestEnable = VK_FALSE;
         }
@@ -597,6 +660,237 @@ namespace Hedge
         return depthStencilInfo;
     }
 
+    // ================================================================================================================
+    PBRBindlessPipeline::PBRBindlessPipeline(
+        VkDescriptorSetLayout bindlessSetLayout,
+        bool                  isDepthPrepassed,
+        uint32_t              features) :
+        PBRPipeline(isDepthPrepassed, features),
+        m_bindlessSetLayout(bindlessSetLayout)
+    {}
+
+    // ================================================================================================================
+    PBRBindlessPipeline::~PBRBindlessPipeline()
+    {}
+
+    // ================================================================================================================
+    void PBRBindlessPipeline::CreateSetCustomPipelineInfo()
+    {
+        VkShaderModule vertShaderModule = CreateShaderModule((uint32_t*)pbr_bindless_vertScript,
+                                                             sizeof(pbr_bindless_vertScript));
+        VkShaderModule fragShaderModule = CreateShaderModule(
+            (uint32_t*)pbr_bindless_fragPermutationsScripts[m_features],
+            pbr_bindless_fragPermutationsBytes[m_features]);
+
+        AddShaderStageInfo(CreateDefaultShaderStgCreateInfo(vertShaderModule, VK_SHADER_STAGE_VERTEX_BIT));
+        AddShaderStageInfo(CreateDefaultShaderStgCreateInfo(fragShaderModule, VK_SHADER_STAGE_FRAGMENT_BIT));
+
+        m_shaderModules.push_back(vertShaderModule);
+        m_shaderModules.push_back(fragShaderModule);
+
+        CreateSetPerFrameDescriptorSetLayout();
+        CreateSetBindlessPipelineLayout();
+
+        CreateSetPBRFixedStatesInfo();
+    }
+
+    // ================================================================================================================
+    void PBRBindlessPipeline::CreateSetPerFrameDescriptorSetLayout()
+    {
+        // Same binding ids as the PBRPipeline, but without the per-object material textures (4 - 7). They are in the
+        // bindless set now.
+        VkDescriptorSetLayoutBinding perFrameBindings[10] = {
+            { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1, VK_SHADER_STAGE_VERTEX_BIT,   nullptr }, // VP mat
+            { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }, // Diffuse irradiance
+            { 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }, // Prefilter env
+            { 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }, // Env brdf
+            { 8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }, // Pt lights pos
+            { 9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }, // Pt lights radiance
+            { 10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,        1, VK_SHADER_STAGE_VERTEX_BIT,   nullptr }, // Instance model mats
+            { 11, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,        1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }, // Cluster info
+            { 12, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,        1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }, // Cluster grid
+            { 13, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,        1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }  // Light indices
+        };
+
+        VkDescriptorSetLayoutCreateInfo perFrameDesSetLayoutInfo{};
+        {
+            perFrameDesSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            perFrameDesSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+            perFrameDesSetLayoutInfo.bindingCount = 10;
+            perFrameDesSetLayoutInfo.pBindings = perFrameBindings;
+        }
+
+        VkDescriptorSetLayout perFrameDescriptorSetLayout;
+        VK_CHECK(vkCreateDescriptorSetLayout(m_device,
+                                             &perFrameDesSetLayoutInfo,
+                                             nullptr,
+                                             &perFrameDescriptorSetLayout));
+
+        AddDescriptorSetLayout(perFrameDescriptorSetLayout);
+    }
+
+    // ================================================================================================================
+    void PBRBindlessPipeline::CreateSetBindlessPipelineLayout()
+    {
+        VkPushConstantRange range = {};
+        {
+            range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            range.offset = 0;
+            range.size = sizeof(PBRBindlessPushConstant);
+        }
+
+        // Set 0: Per frame push descriptors. Set 1: Bindless textures.
+        VkDescriptorSetLayout setLayouts[2] = { m_descriptorSetLayouts[0], m_bindlessSetLayout };
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        {
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 2;
+            pipelineLayoutInfo.pSetLayouts = setLayouts;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &range;
+        }
+
+        VkPipelineLayout bindlessPipelineLayout;
+        VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &bindlessPipelineLayout));
+        SetPipelineLayout(bindlessPipelineLayout);
+    }
+
+    // ================================================================================================================
+    PBRDepthPrepassPipeline::PBRDepthPrepassPipeline() :
+        PBRPipeline()
+    {}
+
+    // ================================================================================================================
+    PBRDepthPrepassPipeline::~PBRDepthPrepassPipeline()
+    {}
+
+    // ================================================================================================================
+    void PBRDepthPrepassPipeline::CreateSetCustomPipelineInfo()
+    {
+        // No fragment shader. The depth is the only output.
+        VkShaderModule vertShaderModule = CreateShaderModule((uint32_t*)pbr_depth_vertScript,
+                                                             sizeof(pbr_depth_vertScript));
+
+        AddShaderStageInfo(CreateDefaultShaderStgCreateInfo(vertShaderModule, VK_SHADER_STAGE_VERTEX_BIT));
+        m_shaderModules.push_back(vertShaderModule);
+
+        CreateSetDepthPrepassDescriptorSetLayout();
+        CreateSetDepthPrepassPipelineLayout();
+
+        CreateSetDepthOnlyStatesInfo();
+    }
+
+    // ================================================================================================================
+    void PBRDepthPrepassPipeline::CreateSetDepthPrepassDescriptorSetLayout()
+    {
+        // Same binding ids as the bindless PBR pipeline's geometry bindings.
+        VkDescriptorSetLayoutBinding depthPrepassBindings[2] = {
+            { 0,  VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr }, // VP mat
+            { 10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr }  // Instance model mats
+        };
+
+        VkDescriptorSetLayoutCreateInfo depthPrepassDesSetLayoutInfo{};
+        {
+            depthPrepassDesSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            depthPrepassDesSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+            depthPrepassDesSetLayoutInfo.bindingCount = 2;
+            depthPrepassDesSetLayoutInfo.pBindings = depthPrepassBindings;
+        }
+
+        VkDescriptorSetLayout depthPrepassDescriptorSetLayout;
+        VK_CHECK(vkCreateDescriptorSetLayout(m_device,
+                                             &depthPrepassDesSetLayoutInfo,
+                                             nullptr,
+                                             &depthPrepassDescriptorSetLayout));
+
+        AddDescriptorSetLayout(depthPrepassDescriptorSetLayout);
+    }
+
+    // ================================================================================================================
+    void PBRDepthPrepassPipeline::CreateSetDepthPrepassPipelineLayout()
+    {
+        VkPushConstantRange range = {};
+        {
+            range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+            range.offset = 0;
+            range.size = sizeof(PBRDepthPrepassPushConstant);
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        {
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = m_descriptorSetLayouts.size();
+            pipelineLayoutInfo.pSetLayouts = m_descriptorSetLayouts.data();
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &range;
+        }
+
+        VkPipelineLayout depthPrepassPipelineLayout;
+        VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &depthPrepassPipelineLayout));
+        SetPipelineLayout(depthPrepassPipelineLayout);
+    }
+
+    // ================================================================================================================
+    void PBRDepthPrepassPipeline::CreateSetDepthOnlyStatesInfo()
+    {
+        VkPipelineRenderingCreateInfoKHR pipelineRenderCreateInfo{};
+        {
+            pipelineRenderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+            pipelineRenderCreateInfo.colorAttachmentCount = 0;
+            pipelineRenderCreateInfo.depthAttachmentFormat = VK_FORMAT_D16_UNORM;
+        }
+
+        VkPipelineRenderingCreateInfoKHR* pPipelineRenderCreateInfo = new VkPipelineRenderingCreateInfoKHR();
+        memcpy(pPipelineRenderCreateInfo, &pipelineRenderCreateInfo, sizeof(VkPipelineRenderingCreateInfoKHR));
+        SetPNext(pPipelineRenderCreateInfo);
+
+        // The blending attachments count has to match the rendering's color attachments count.
+        PipelineColorBlendInfo* pColorBlendInfo = new PipelineColorBlendInfo();
+        memset(pColorBlendInfo, 0, sizeof(PipelineColorBlendInfo));
+        {
+            pColorBlendInfo->colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+            pColorBlendInfo->colorBlending.logicOpEnable = VK_FALSE;
+            pColorBlendInfo->colorBlending.attachmentCount = 0;
+        }
+        SetColorBlendingInfo(pColorBlendInfo);
+
+        VkPipelineVertexInputStateCreateInfo vertInputInfo = CreatePipelineVertexInputInfo();
+        VkPipelineVertexInputStateCreateInfo* pVertInputInfo = new VkPipelineVertexInputStateCreateInfo();
+        memcpy(pVertInputInfo, &vertInputInfo, sizeof(vertInputInfo));
+        SetVertexInputInfo(pVertInputInfo);
+        m_heapMem.push_back(pVertInputInfo);
+
+        VkPipelineDepthStencilStateCreateInfo depthStencilInfo = CreateDepthStencilStateInfo();
+        VkPipelineDepthStencilStateCreateInfo* pDepthStencilInfo = new VkPipelineDepthStencilStateCreateInfo();
+        memcpy(pDepthStencilInfo, &depthStencilInfo, sizeof(depthStencilInfo));
+        SetDepthStencilStateInfo(pDepthStencilInfo);
+        m_heapMem.push_back(pDepthStencilInfo);
+    }
+
+    // ================================================================================================================
+    void HPipeline::CreateComputePipeline()
+    {
+        m_pipelineBindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        {
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.pNext = m_pNext;
+            pipelineInfo.stage = m_shaderStgInfos[0];
+            pipelineInfo.layout = m_pipelineLayout;
+            pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        }
+
+        VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
+
+        m_pfnCmdPushDescriptorSet = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(m_device,
+                                                                                       "vkCmdPushDescriptorSetKHR");
+        if (!m_pfnCmdPushDescriptorSet) {
+            exit(1);
+        }
+    }
+
     // ================================================================================================================
     void HPipeline::CmdBindDescriptors(
         VkCommandBuffer                        cmdBuf,
@@ -631,7 +925,7 @@ namespace Hedge
         }
 
         m_pfnCmdPushDescriptorSet(cmdBuf,
-                                  VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                  m_pipelineBindPoint,
                                   m_pipelineLayout,
                                   0, writeDescriptorSetsVec.size(), writeDescriptorSetsVec.data());
     }
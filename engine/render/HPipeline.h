@@ -8,6 +8,9 @@
 // When we create the pipeline, if we find out that some infos are not fed before, we'll just use the default settings.
 //
 // In addition, we always use the dynamic rendering.
+//
+// A pipeline that only adds one compute shader stage is created as a compute pipeline. All the graphics states are
+// ignored in this case.
 namespace Hedge
 {
     struct HGpuRsrcFrameContext;
@@ -35,6 +38,7 @@ namespace Hedge
 
         VkPipeline GetVkPipeline() { return m_pipeline; }
         VkPipelineLayout GetVkPipelineLayout() { return m_pipelineLayout; }
+        VkPipelineBindPoint GetVkPipelineBindPoint() { return m_pipelineBindPoint; }
 
         void CreatePipeline(VkDevice device);
 
@@ -47,6 +51,9 @@ namespace Hedge
         }
 
         void SetPipelineLayout(VkPipelineLayout pipelineLayout) { m_pipelineLayout = pipelineLayout; }
+
+        // The pipeline takes the ownership of the heap allocated color blending info.
+        void SetColorBlendingInfo(PipelineColorBlendInfo* pColorBlendInfo) { m_pColorBlending = pColorBlendInfo; }
         void SetDepthStencilStateInfo(VkPipelineDepthStencilStateCreateInfo* pDepthStencilInfo)
         {
             m_pDepthStencilState = pDepthStencilInfo;
@@ -96,26 +103,106 @@ namespace Hedge
         void SetDefaultColorBlendingInfo();
         void SetDefaultDynamicStateInfo();
 
-        VkPipeline       m_pipeline;
-        VkPipelineLayout m_pipelineLayout;
+        void CreateComputePipeline();
+
+        VkPipeline          m_pipeline;
+        VkPipelineLayout    m_pipelineLayout;
+        VkPipelineBindPoint m_pipelineBindPoint;
+    };
+
+    // The features of the PBR fragment shaders. Each combination is a shader permutation compiled with the HPBR_*
+    // defines by the GenerateShaderHeader.py. The bits' order must match the defines' order in the script.
+    enum HPBRFeatureBits
+    {
+        HPBR_FEATURE_IBL           = 0x1, // The scene has the image based lighting.
+        HPBR_FEATURE_NORMAL_MAP    = 0x2, // The material's normal map is not flat.
+        HPBR_FEATURE_OCCLUSION_MAP = 0x4, // The material's occlusion is not white.
+        HPBR_FEATURE_ALL           = 0x7,
+        HPBR_PERMUTATIONS_CNT      = 0x8,
     };
 
-    // The PBR pipeline is a fixed pipeline that only uses pbr_vertScript and pbr_fragScript in the g_prebuiltShaders.h.
+    // The PBR pipeline is a fixed pipeline that only uses pbr_vertScript and a pbr_frag permutation in the
+    // g_prebuiltShaders.h. The permutation is picked by the HPBRFeatureBits. All permutations share the same layout,
+    // so the bound descriptors and push constants stay valid when a draw switches between them.
+    // A depth prepassed PBR pipeline draws on the depth of the depth prepass. It only shades the fragments with the
+    // EQUAL depth and doesn't write the depth.
     class PBRPipeline : public HPipeline
     {
     public:
-        PBRPipeline();
+        explicit PBRPipeline(bool isDepthPrepassed = false, uint32_t features = HPBR_FEATURE_ALL);
         ~PBRPipeline();
 
+        uint32_t GetFeatures() const { return m_features; }
+
     protected:
         virtual void CreateSetCustomPipelineInfo() override;
 
-    private:
-        void CreateSetDescriptorSetLayouts();
-        void CreateSetPBRPipelineLayout();
         VkPipelineVertexInputStateCreateInfo CreatePipelineVertexInputInfo();
         VkPipelineDepthStencilStateCreateInfo CreateDepthStencilStateInfo();
+        void CreateSetPBRFixedStatesInfo(); // Rendering formats, vertex input and depth states.
 
         static const VkFormat m_colorAttachmentFormat = VK_FORMAT_R8G8B8A8_SRGB;
+
+        bool     m_isDepthPrepassed;
+        uint32_t m_features; // HPBRFeatureBits.
+
+    private:
+        void CreateSetDescriptorSetLayouts();
+        void CreateSetPBRPipelineLayout();
+    };
+
+    // Push constant of the bindless PBR fragment shaders. It must match the BindlessDrawInfo in the
+    // pbr_bindless_frag.hlsl. It's the same for all draws of a pass: The model matrices and the material textures'
+    // bindless slots are in the per-frame instance storage buffer. (See the HInstanceData)
+    struct PBRBindlessPushConstant
+    {
+        float    cameraPos[3];
+        float    iblMaxMipLevels;
+        uint32_t ptLightCnt;
+    };
+
+    // The bindless PBR pipeline only pushes per-frame resources (camera, IBL and point lights) in the set 0. Material
+    // textures are read from the bindless set 1 owned by the HGpuRsrcManager, indexed by the instances' material
+    // slots, so there is no descriptor or push constant update per draw.
+    class PBRBindlessPipeline : public PBRPipeline
+    {
+    public:
+        explicit PBRBindlessPipeline(VkDescriptorSetLayout bindlessSetLayout,
+                                     bool                  isDepthPrepassed = false,
+                                     uint32_t              features = HPBR_FEATURE_ALL);
+        ~PBRBindlessPipeline();
+
+    protected:
+        virtual void CreateSetCustomPipelineInfo() override;
+
+    private:
+        void CreateSetPerFrameDescriptorSetLayout();
+        void CreateSetBindlessPipelineLayout();
+
+        VkDescriptorSetLayout m_bindlessSetLayout; // Not owned by the pipeline.
+    };
+
+    // It must match the DepthPrepassDrawInfo in the pbr_depth_vert.hlsl.
+    struct PBRDepthPrepassPushConstant
+    {
+        uint32_t instanceBaseIdx;
+    };
+
+    // The depth prepass pipeline only has the pbr_depth_vertScript and no color attachment. It reads the same vertex
+    // buffers, the view-perspective matrix UBO (binding 0) and the instance model matrices SSBO (binding 10) as the
+    // bindless PBR pipeline, so the depths are exactly the same as the PBR pipelines' depths.
+    class PBRDepthPrepassPipeline : public PBRPipeline
+    {
+    public:
+        PBRDepthPrepassPipeline();
+        ~PBRDepthPrepassPipeline();
+
+    protected:
+        virtual void CreateSetCustomPipelineInfo() override;
+
+    private:
+        void CreateSetDepthPrepassDescriptorSetLayout();
+        void CreateSetDepthPrepassPipelineLayout();
+        void CreateSetDepthOnlyStatesInfo();
     };
 }
\ No newline at end of file
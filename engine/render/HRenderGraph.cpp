@@ -0,0 +1,306 @@
+#include "HRenderGraph.h"
+#include "../core/HGpuRsrcManager.h"
+#include <unordered_set>
+#include <cassert>
+
+namespace Hedge
+{
+    struct HRenderGraphAccessInfo
+    {
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2        accesses;      // All accesses of the use. The destination accesses of its barrier.
+        VkAccessFlags2        writeAccesses; // The source accesses of the next use's barrier.
+        VkImageLayout         layout;
+        bool                  readsContent;  // Whether the use depends on the image's former content.
+    };
+
+    // Indexed by the HRenderGraphImgAccess.
+    static const HRenderGraphAccessInfo g_renderGraphAccessInfos[HRG_ACCESS_CNT] =
+    {
+        // HRG_ACCESS_COLOR_ATTACHMENT_WRITE
+        { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          false },
+        // HRG_ACCESS_COLOR_ATTACHMENT_READ_WRITE
+        { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+          VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+          true },
+        // HRG_ACCESS_DEPTH_ATTACHMENT_WRITE
+        { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+          VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+          VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+          VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+          false },
+        // HRG_ACCESS_DEPTH_ATTACHMENT_READ_WRITE
+        { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+          VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+          VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+          VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+          true },
+        // HRG_ACCESS_DEPTH_ATTACHMENT_READ
+        { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+          VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+          VK_ACCESS_2_NONE,
+          VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+          true },
+        // HRG_ACCESS_FRAGMENT_SAMPLED
+        { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+          VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+          VK_ACCESS_2_NONE,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          true },
+        // HRG_ACCESS_COMPUTE_SAMPLED
+        { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+          VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+          VK_ACCESS_2_NONE,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          true },
+        // HRG_ACCESS_COMPUTE_STORAGE_WRITE
+        { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+          VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+          VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+          VK_IMAGE_LAYOUT_GENERAL,
+          false },
+        // HRG_ACCESS_TRANSFER_SRC
+        { VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT,
+          VK_ACCESS_2_TRANSFER_READ_BIT,
+          VK_ACCESS_2_NONE,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          true },
+        // HRG_ACCESS_TRANSFER_DST
+        { VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+          VK_ACCESS_2_TRANSFER_WRITE_BIT,
+          VK_ACCESS_2_TRANSFER_WRITE_BIT,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          false },
+    };
+
+    // ================================================================================================================
+    HRenderGraph::HRenderGraph()
+        : m_culledPassesCnt(0),
+          m_imgBarriersCnt(0)
+    {}
+
+    // ================================================================================================================
+    HRenderGraph::~HRenderGraph()
+    {}
+
+    // ================================================================================================================
+    void HRenderGraph::Reset()
+    {
+        m_passes.clear();
+        m_imgStates.clear();
+        m_imgAliases.clear();
+    }
+
+    // ================================================================================================================
+    uint32_t HRenderGraph::AddPass(
+        const char*          pName,
+        bool                 isOutput,
+        HRenderGraphPassFunc func)
+    {
+        HRenderGraphPass pass{};
+        {
+            pass.pName = pName;
+            pass.isOutput = isOutput;
+            pass.isCulled = false;
+            pass.func = func;
+        }
+
+        m_passes.push_back(pass);
+        return m_passes.size() - 1;
+    }
+
+    // ================================================================================================================
+    void HRenderGraph::AddPassImgAccess(
+        uint32_t              passIdx,
+        HGpuImg*              pImg,
+        HRenderGraphImgAccess access)
+    {
+        assert(passIdx < m_passes.size());
+        std::vector<HRenderGraphImgUse>& imgUses = m_passes[passIdx].imgUses;
+
+        for (const HRenderGraphImgUse& imgUse : imgUses)
+        {
+            assert(imgUse.pImg != pImg);
+        }
+
+        imgUses.push_back({ pImg, access });
+    }
+
+    // ================================================================================================================
+    void HRenderGraph::AddImgAlias(
+        HGpuImg* pImg,
+        HGpuImg* pPrevImg)
+    {
+        m_imgAliases[pImg] = pPrevImg;
+    }
+
+    // ================================================================================================================
+    void HRenderGraph::CullPasses()
+    {
+        // Walk backward from the outputs. A pass is alive if it writes an image that a later alive pass needs.
+        std::unordered_set<HGpuImg*> neededImgs;
+        m_culledPassesCnt = 0;
+
+        for (int32_t i = m_passes.size() - 1; i >= 0; i--)
+        {
+            HRenderGraphPass& pass = m_passes[i];
+
+            pass.isCulled = (pass.isOutput == false);
+            for (const HRenderGraphImgUse& imgUse : pass.imgUses)
+            {
+                const HRenderGraphAccessInfo& info = g_renderGraphAccessInfos[imgUse.access];
+                if ((info.writeAccesses != VK_ACCESS_2_NONE) && (neededImgs.count(imgUse.pImg) != 0))
+                {
+                    pass.isCulled = false;
+                }
+            }
+
+            if (pass.isCulled)
+            {
+                m_culledPassesCnt++;
+                continue;
+            }
+
+            // An overwritten image doesn't need its former writers. A read needs them.
+            for (const HRenderGraphImgUse& imgUse : pass.imgUses)
+            {
+                const HRenderGraphAccessInfo& info = g_renderGraphAccessInfos[imgUse.access];
+                if (info.readsContent)
+                {
+                    neededImgs.insert(imgUse.pImg);
+                }
+                else if (info.writeAccesses != VK_ACCESS_2_NONE)
+                {
+                    neededImgs.erase(imgUse.pImg);
+                }
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HRenderGraph::AddImgUseBarrier(
+        const HRenderGraphImgUse& imgUse)
+    {
+        const HRenderGraphAccessInfo& info = g_renderGraphAccessInfos[imgUse.access];
+        HGpuImg* pImg = imgUse.pImg;
+
+        // The first use in the frame starts with an empty state, so it only needs the layout transition. An aliasing
+        // image starts with the state of the former image in its memory instead.
+        bool isFirstUse = (m_imgStates.count(pImg) == 0);
+        HRenderGraphImgState& state = m_imgStates[pImg];
+
+        if (isFirstUse && (m_imgAliases.count(pImg) != 0))
+        {
+            auto prevItr = m_imgStates.find(m_imgAliases[pImg]);
+            if (prevItr != m_imgStates.end())
+            {
+                state = prevItr->second;
+            }
+            pImg->curImgLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+
+        bool isWrite = (info.writeAccesses != VK_ACCESS_2_NONE);
+        bool isLayoutChange = (pImg->curImgLayout != info.layout);
+
+        VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 srcAccesses = VK_ACCESS_2_NONE;
+        bool needBarrier = false;
+
+        if (isWrite || isLayoutChange)
+        {
+            // WAW, WAR or a layout transition, which is also a write.
+            srcStages = state.lastWriteStages | state.readStages;
+            srcAccesses = state.lastWriteAccesses;
+            needBarrier = isLayoutChange || (srcStages != VK_PIPELINE_STAGE_2_NONE);
+        }
+        else if ((state.lastWriteStages != VK_PIPELINE_STAGE_2_NONE) && ((info.stages & ~state.readStages) != 0))
+        {
+            // RAW. Reads in the stages that already waited for the last write don't need another barrier.
+            srcStages = state.lastWriteStages;
+            srcAccesses = state.lastWriteAccesses;
+            needBarrier = true;
+        }
+
+        if (needBarrier)
+        {
+            VkImageMemoryBarrier2 barrier{};
+            {
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+                barrier.srcStageMask = srcStages;
+                barrier.srcAccessMask = srcAccesses;
+                barrier.dstStageMask = info.stages;
+                barrier.dstAccessMask = info.accesses;
+                barrier.oldLayout = pImg->curImgLayout;
+                barrier.newLayout = info.layout;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = pImg->gpuImg;
+                barrier.subresourceRange = pImg->imgSubresRange;
+            }
+            m_passBarriers.push_back(barrier);
+        }
+
+        if (isWrite || isLayoutChange)
+        {
+            // Later uses wait for this use. A read-only use after a layout transition only carries the transition.
+            state.lastWriteStages = info.stages;
+            state.lastWriteAccesses = info.writeAccesses;
+            state.readStages = isWrite ? VK_PIPELINE_STAGE_2_NONE : info.stages;
+        }
+        else
+        {
+            state.readStages |= info.stages;
+        }
+
+        pImg->curImgLayout = info.layout;
+    }
+
+    // ================================================================================================================
+    void HRenderGraph::Execute(
+        VkCommandBuffer& cmdBuf)
+    {
+        CullPasses();
+
+        m_imgStates.clear();
+        m_imgBarriersCnt = 0;
+
+        for (HRenderGraphPass& pass : m_passes)
+        {
+            if (pass.isCulled)
+            {
+                continue;
+            }
+
+            // All barriers of a pass go into one batch.
+            m_passBarriers.clear();
+            for (const HRenderGraphImgUse& imgUse : pass.imgUses)
+            {
+                AddImgUseBarrier(imgUse);
+            }
+
+            if (m_passBarriers.empty() == false)
+            {
+                VkDependencyInfo dependencyInfo{};
+                {
+                    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+                    dependencyInfo.imageMemoryBarrierCount = m_passBarriers.size();
+                    dependencyInfo.pImageMemoryBarriers = m_passBarriers.data();
+                }
+                vkCmdPipelineBarrier2(cmdBuf, &dependencyInfo);
+
+                m_imgBarriersCnt += m_passBarriers.size();
+            }
+
+            if (pass.func)
+            {
+                pass.func(cmdBuf);
+            }
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+namespace Hedge
+{
+    struct HGpuImg;
+
+    // How a pass uses an image. It decides the pipeline stages, the access masks and the image layout of the use.
+    enum HRenderGraphImgAccess
+    {
+        HRG_ACCESS_COLOR_ATTACHMENT_WRITE,      // Color attachment with the CLEAR load op.
+        HRG_ACCESS_COLOR_ATTACHMENT_READ_WRITE, // Color attachment with the LOAD load op or blending.
+        HRG_ACCESS_DEPTH_ATTACHMENT_WRITE,      // Depth attachment with the CLEAR load op.
+        HRG_ACCESS_DEPTH_ATTACHMENT_READ_WRITE, // Depth test and write on the existing depth.
+        HRG_ACCESS_DEPTH_ATTACHMENT_READ,       // Depth test without depth write.
+        HRG_ACCESS_FRAGMENT_SAMPLED,
+        HRG_ACCESS_COMPUTE_SAMPLED,
+        HRG_ACCESS_COMPUTE_STORAGE_WRITE,
+        HRG_ACCESS_TRANSFER_SRC,
+        HRG_ACCESS_TRANSFER_DST,
+        HRG_ACCESS_CNT
+    };
+
+    using HRenderGraphPassFunc = std::function<void(VkCommandBuffer& cmdBuf)>;
+
+    // A per frame render graph. Passes declare how they use the images and the graph:
+    // - Culls the passes whose results are never used by an output pass.
+    // - Puts one vkCmdPipelineBarrier2(...) in front of each pass, only with the stages and accesses that really
+    //   conflict, and transitions the image layouts. The HGpuImg::curImgLayout is kept up to date.
+    //
+    // The graph only syncs within the frame's command buffer. The first use of an image in a frame doesn't wait for the
+    // previous frame, since the frame slot's in-flight fence is waited before the recording.
+    class HRenderGraph
+    {
+    public:
+        HRenderGraph();
+        ~HRenderGraph();
+
+        // Remove all passes of the last frame.
+        void Reset();
+
+        // An output pass is never culled. E.g. The GUI pass that presents the scene. A pass without a function only
+        // gets its barriers, which is useful for the passes recorded out of the graph.
+        uint32_t AddPass(const char* pName, bool isOutput, HRenderGraphPassFunc func);
+
+        // One access per image per pass.
+        void AddPassImgAccess(uint32_t passIdx, HGpuImg* pImg, HRenderGraphImgAccess access);
+
+        // pImg shares the memory with pPrevImg, which is used by earlier passes only (E.g. Transient render targets
+        // from the HRenderTargetPool). The first use of pImg waits for all uses of pPrevImg and discards the content.
+        void AddImgAlias(HGpuImg* pImg, HGpuImg* pPrevImg);
+
+        // Cull the passes, then record the barriers and the passes in the adding order.
+        void Execute(VkCommandBuffer& cmdBuf);
+
+        uint32_t GetCulledPassesCnt() const { return m_culledPassesCnt; }
+        uint32_t GetImgBarriersCnt() const { return m_imgBarriersCnt; }
+
+    private:
+        struct HRenderGraphImgUse
+        {
+            HGpuImg*              pImg;
+            HRenderGraphImgAccess access;
+        };
+
+        struct HRenderGraphPass
+        {
+            const char*                     pName;
+            bool                            isOutput;
+            bool                            isCulled;
+            HRenderGraphPassFunc            func;
+            std::vector<HRenderGraphImgUse> imgUses;
+        };
+
+        // The sync state of an image in the frame.
+        struct HRenderGraphImgState
+        {
+            VkPipelineStageFlags2 lastWriteStages;
+            VkAccessFlags2        lastWriteAccesses;
+            VkPipelineStageFlags2 readStages; // Stages reading the image after the last write.
+        };
+
+        void CullPasses();
+
+        // Add the barrier of the image use if it conflicts with the image's former uses.
+        void AddImgUseBarrier(const HRenderGraphImgUse& imgUse);
+
+        std::vector<HRenderGraphPass> m_passes;
+
+        std::unordered_map<HGpuImg*, HRenderGraphImgState> m_imgStates;
+        std::unordered_map<HGpuImg*, HGpuImg*>             m_imgAliases; // Image -> The former image in its memory.
+        std::vector<VkImageMemoryBarrier2>                 m_passBarriers;
+
+        uint32_t m_culledPassesCnt;
+        uint32_t m_imgBarriersCnt;
+    };
+}
@@ -1,6 +1,7 @@
 #include "HRenderManager.h"
 #include "HRenderer.h"
 #include "HCubemapRendererPipeline.h"
+#include "HGpuDrivenRenderer.h"
 #include "../logging/HLogger.h"
 #include "Utils.h"
 #include "HBaseGuiManager.h"
@@ -10,60 +11,126 @@
 
 #include <string>
 #include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
 #include <set>
 
+extern Hedge::HJobSystem* g_pJobSystem;
+
 static void CheckVkResult(
     VkResult err)
 {
     VK_CHECK(err);
 }
 
+// Frames in flight of the headless mode. It's the number of the frame slots instead of the swapchain images.
+#define HHEADLESS_FRAME_SLOTS_CNT 2
+
+// Pipeline statistics queries of each frame slot.
+#define HSTATS_QUERY_DEPTH_PREPASS 0
+#define HSTATS_QUERY_SCENE         1
+#define HSTATS_QUERIES_PER_SLOT    2
+
 namespace Hedge
 {
     bool HRenderManager::m_frameBufferResize = false;
 
     // ================================================================================================================
     HRenderManager::HRenderManager(
-        HBaseGuiManager* pGuiManager,
-        HGpuRsrcManager* pGpuRsrcManager)
+        HBaseGuiManager*           pGuiManager,
+        HGpuRsrcManager*           pGpuRsrcManager,
+        const HHeadlessRenderInfo* pHeadlessInfo)
         : // m_curSwapchainFrameIdx(0),
           m_pGuiManager(pGuiManager),
           m_pGpuRsrcManager(pGpuRsrcManager),
-          m_skipSubmitThisFrameCommandBuffer(false)
+          m_skipSubmitThisFrameCommandBuffer(false),
+          m_isHeadless(pHeadlessInfo != nullptr),
+          m_headlessInfo(),
+          m_frameIdx(0),
+          m_pGlfwWindow(nullptr),
+          m_surface(VK_NULL_HANDLE),
+          m_swapchain(VK_NULL_HANDLE),
+          m_swapchainCmdPool(VK_NULL_HANDLE),
+          m_renderPass(VK_NULL_HANDLE),
+          m_acqSwapchainImgIdx(0),
+          m_depthPrepassEnabled(false),
+          m_hiZCullingEnabled(false),
+          m_statsQueryPool(VK_NULL_HANDLE),
+          m_sceneFragInvocations(0),
+          m_depthPrepassFragInvocations(0),
+          m_pipelinedFramesEnabled(false),
+          m_pSceneSnapshots{ new SceneRenderInfo(), new SceneRenderInfo() },
+          m_frontSnapshotIdx(0),
+          m_hasFrontSnapshot(false),
+          m_isRecordingSnapshot(false)
     {
+        if (m_isHeadless)
+        {
+            m_headlessInfo = *pHeadlessInfo;
+        }
+
         // Create vulkan instance and possible debug initialization.
-        m_pGpuRsrcManager->CreateVulkanAppInstDebugger();
+        m_pGpuRsrcManager->CreateVulkanAppInstDebugger(m_isHeadless);
 
-        // Init glfw window and create vk surface from it.
-        CreateGlfwWindowAndVkSurface();
+        if (m_isHeadless)
+        {
+            // Create physical device and logical device without a surface.
+            m_pGpuRsrcManager->CreateVulkanPhyLogicalDevice(nullptr);
+        }
+        else
+        {
+            // Init glfw window and create vk surface from it.
+            CreateGlfwWindowAndVkSurface();
 
-        // Create physical device and logical device.
-        m_pGpuRsrcManager->CreateVulkanPhyLogicalDevice(&m_surface);
+            // Create physical device and logical device.
+            m_pGpuRsrcManager->CreateVulkanPhyLogicalDevice(&m_surface);
+        }
 
         // Create other basic and shared graphics widgets
         m_pGpuRsrcManager->CreateCommandPool();
         m_pGpuRsrcManager->CreateDescriptorPool();
         m_pGpuRsrcManager->CreateVmaObjects();
+        m_pGpuRsrcManager->CreateBindlessDescriptorSet();
 
-        // Create swapchain related objects
-        CreateSwapchain();
-        CreateSwapchainImageViews();
-        CreateSwapchainSynObjs();
-        CreateSwapchainCmdBuffers();
-        CreateRenderpass();
-        CreateSwapchainFramebuffer();
+        if (m_isHeadless)
+        {
+            // The color render target uses the same format as the swapchain, so the captures look the same as the
+            // window.
+            m_surfaceFormat = { VK_FORMAT_R8G8B8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+            m_swapchainImgCnt = HHEADLESS_FRAME_SLOTS_CNT;
+            m_swapchainImageExtent = m_headlessInfo.renderExtent;
+
+            CreateSwapchainSynObjs();
+            CreateSwapchainCmdBuffers();
 
-        m_pGuiManager->Init(m_pGlfwWindow,
-                            m_pGpuRsrcManager->GetVkInstance(),
-                            m_pGpuRsrcManager->GetPhysicalDevice(),
-                            m_pGpuRsrcManager->GetLogicalDevice(),
-                            m_pGpuRsrcManager->GetGfxQueueFamilyIdx(),
-                            m_pGpuRsrcManager->GetGfxQueue(),
-                            m_pGpuRsrcManager->GetGfxCmdPool(),
-                            m_pGpuRsrcManager->GetDescriptorPool(),
-                            m_swapchainImgCnt,
-                            &m_renderPass,
-                            CheckVkResult);
+            if (m_headlessInfo.captureInterval != 0)
+            {
+                m_frameCapturer.Init(m_pGpuRsrcManager, m_swapchainImgCnt, m_headlessInfo.captureDir);
+            }
+        }
+        else
+        {
+            // Create swapchain related objects
+            CreateSwapchain();
+            CreateSwapchainImageViews();
+            CreateSwapchainSynObjs();
+            CreateSwapchainCmdBuffers();
+            CreateRenderpass();
+            CreateSwapchainFramebuffer();
+
+            m_pGuiManager->Init(m_pGlfwWindow,
+                                m_pGpuRsrcManager->GetVkInstance(),
+                                m_pGpuRsrcManager->GetPhysicalDevice(),
+                                m_pGpuRsrcManager->GetLogicalDevice(),
+                                m_pGpuRsrcManager->GetGfxQueueFamilyIdx(),
+                                m_pGpuRsrcManager->GetGfxQueue(),
+                                m_pGpuRsrcManager->GetGfxCmdPool(),
+                                m_pGpuRsrcManager->GetDescriptorPool(),
+                                m_swapchainImgCnt,
+                                &m_renderPass,
+                                CheckVkResult);
+        }
 
         // Create a basic PBR renderer
         VkDevice* pDevice = m_pGpuRsrcManager->GetLogicalDevice();
@@ -71,6 +138,25 @@ namespace Hedge
         m_pRenderers.push_back(pPbrRenderer);
         m_activeRendererIdx = 0;
 
+        // The GPU driven renderer is optional. Users can switch to it by SetActiveRenderer(1).
+        if (m_pGpuRsrcManager->IsBindlessSupported() && m_pGpuRsrcManager->IsDrawIndirectCountSupported())
+        {
+            m_pRenderers.push_back(new HGpuDrivenRenderer(*pDevice));
+        }
+
+        if (m_isHeadless && (m_headlessInfo.rendererIdx != 0))
+        {
+            if (m_headlessInfo.rendererIdx < m_pRenderers.size())
+            {
+                m_activeRendererIdx = m_headlessInfo.rendererIdx;
+            }
+            else
+            {
+                std::cerr << "The device doesn't support the renderer " << m_headlessInfo.rendererIdx
+                          << ". The headless frames use the basic renderer." << std::endl;
+            }
+        }
+
         // Create other skybox renderers/post-processing renderers
         m_pSkyboxRenderer = new HCubemapRenderer(*pDevice);
 
@@ -78,24 +164,63 @@ namespace Hedge
         m_frameDepthRenderResults.resize(m_swapchainImgCnt);
         m_renderImgsExtents.resize(m_swapchainImgCnt);
 
+        m_renderTargetPool.Init(m_pGpuRsrcManager, m_swapchainImgCnt);
         CreateRenderTargets();
 
         m_frameGpuRenderRsrcController.Init(m_swapchainImgCnt,
                                             m_pGpuRsrcManager);
+
+        // Use the hardware concurrency for the recording threads.
+        m_cmdRecorder.Init(*pDevice, m_pGpuRsrcManager->GetGfxQueueFamilyIdx(), m_swapchainImgCnt, 0);
+
+        m_hiZPyramid.Init(m_pGpuRsrcManager, m_swapchainImgCnt);
+
+        m_dynamicResolution.Init(m_pGpuRsrcManager, m_swapchainImgCnt);
+
+        // Count the fragment shader invocations of the depth prepass and the scene pass.
+        m_statsWrittenMasks.resize(m_swapchainImgCnt, 0);
+        if (m_pGpuRsrcManager->IsPipelineStatisticsSupported())
+        {
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            {
+                queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+                queryPoolInfo.queryCount = HSTATS_QUERIES_PER_SLOT * m_swapchainImgCnt;
+                queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+            }
+            VK_CHECK(vkCreateQueryPool(*pDevice, &queryPoolInfo, nullptr, &m_statsQueryPool));
+
+            m_cmdRecorder.SetInheritedPipelineStatistics(VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT);
+        }
     }
 
     // ================================================================================================================
     HRenderManager::~HRenderManager()
     {
-        CleanupSwapchain();
+        if (m_isHeadless)
+        {
+            // Write out the captures of the last frames.
+            m_pGpuRsrcManager->WaitDeviceIdle();
+            m_frameCapturer.Flush();
+            m_frameCapturer.Cleanup();
+        }
+        else
+        {
+            CleanupSwapchain();
+        }
 
         VkDevice* pVkDevice = m_pGpuRsrcManager->GetLogicalDevice();
 
         for (uint32_t i = 0; i < m_swapchainImgCnt; i++)
         {
-            m_pGpuRsrcManager->DereferGpuImg(m_frameColorRenderResults[i]);
-            m_pGpuRsrcManager->DereferGpuImg(m_frameDepthRenderResults[i]);
+            m_renderTargetPool.ReleaseRenderTarget(m_frameColorRenderResults[i]);
+            m_renderTargetPool.ReleaseRenderTarget(m_frameDepthRenderResults[i]);
+            if (m_frameUpscaleRenderResults[i] != nullptr)
+            {
+                m_renderTargetPool.ReleaseRenderTarget(m_frameUpscaleRenderResults[i]);
+            }
         }
+        m_renderTargetPool.Cleanup();
 
         for (auto itr : m_swapchainImgAvailableSemaphores)
         {
@@ -112,6 +237,19 @@ namespace Hedge
             vkDestroyFence(*pVkDevice, itr, nullptr);
         }
 
+        m_cmdRecorder.Cleanup();
+
+        vkDestroyCommandPool(*pVkDevice, m_swapchainCmdPool, nullptr);
+
+        m_hiZPyramid.Cleanup();
+
+        m_dynamicResolution.Cleanup();
+
+        if (m_statsQueryPool != VK_NULL_HANDLE)
+        {
+            vkDestroyQueryPool(*pVkDevice, m_statsQueryPool, nullptr);
+        }
+
         if (m_pSkyboxRenderer)
         {
             delete m_pSkyboxRenderer;
@@ -126,24 +264,69 @@ namespace Hedge
         {
             m_pGpuRsrcManager->DereferGpuImg(itr);
         }
+
+        delete m_pSceneSnapshots[0];
+        delete m_pSceneSnapshots[1];
         
-        vkDestroyRenderPass(*pVkDevice, m_renderPass, nullptr);
+        if (m_isHeadless == false)
+        {
+            vkDestroyRenderPass(*pVkDevice, m_renderPass, nullptr);
 
-        vkDestroySurfaceKHR(*m_pGpuRsrcManager->GetVkInstance(), m_surface, nullptr);
+            vkDestroySurfaceKHR(*m_pGpuRsrcManager->GetVkInstance(), m_surface, nullptr);
 
-        glfwDestroyWindow(m_pGlfwWindow);
+            glfwDestroyWindow(m_pGlfwWindow);
 
-        glfwTerminate();
+            glfwTerminate();
+        }
+    }
+
+    // ================================================================================================================
+    bool HRenderManager::GetHeadlessRenderInfoFromEnv(
+        HHeadlessRenderInfo* pHeadlessInfo)
+    {
+        const char* pHeadlessStr = std::getenv("HEDGE_HEADLESS");
+        if (pHeadlessStr == nullptr)
+        {
+            return false;
+        }
+
+        unsigned int width = 0;
+        unsigned int height = 0;
+        if ((sscanf(pHeadlessStr, "%ux%u", &width, &height) != 2) || (width == 0) || (height == 0))
+        {
+            width = 1280;
+            height = 640;
+        }
+
+        const char* pFramesStr = std::getenv("HEDGE_HEADLESS_FRAMES");
+        const char* pIntervalStr = std::getenv("HEDGE_CAPTURE_INTERVAL");
+        const char* pCaptureDirStr = std::getenv("HEDGE_CAPTURE_DIR");
+        const char* pRendererStr = std::getenv("HEDGE_RENDERER");
+
+        pHeadlessInfo->renderExtent = { width, height };
+        pHeadlessInfo->framesCnt = pFramesStr ? std::strtoul(pFramesStr, nullptr, 10) : 0;
+        pHeadlessInfo->captureInterval = pIntervalStr ? std::strtoul(pIntervalStr, nullptr, 10) : 0;
+        pHeadlessInfo->captureDir = pCaptureDirStr ? pCaptureDirStr : ".";
+        pHeadlessInfo->rendererIdx = pRendererStr ? std::strtoul(pRendererStr, nullptr, 10) : 0;
+
+        return true;
     }
 
     // ================================================================================================================
     void HRenderManager::BeginNewFrame()
     {
-        glfwPollEvents();
+        if (m_isHeadless)
+        {
+            AcquireHeadlessFrameSlot();
+        }
+        else
+        {
+            glfwPollEvents();
 
-        m_pGuiManager->StartNewFrame();
+            m_pGuiManager->StartNewFrame();
 
-        HandleResize(); // Get the acquire next frame idx.
+            HandleResize(); // Get the acquire next frame idx.
+        }
 
         // Wait for the resources from the possible on flight frame
         vkWaitForFences(*m_pGpuRsrcManager->GetLogicalDevice(),
@@ -154,6 +337,70 @@ namespace Hedge
 
         vkResetFences(*m_pGpuRsrcManager->GetLogicalDevice(), 1, &m_inFlightFences[m_acqSwapchainImgIdx]);
         vkResetCommandBuffer(m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx], 0);
+
+        ResolveFrameSlotReadback(m_acqSwapchainImgIdx);
+    }
+
+    // ================================================================================================================
+    void HRenderManager::ResolveFrameSlotReadback(
+        uint32_t frameSlot)
+    {
+        m_hiZPyramid.ResolveFrameSlot(frameSlot);
+        m_dynamicResolution.ResolveFrameSlot(frameSlot);
+
+        uint32_t writtenMask = m_statsWrittenMasks[frameSlot];
+        m_statsWrittenMasks[frameSlot] = 0;
+        for (uint32_t passQueryIdx = 0; passQueryIdx < HSTATS_QUERIES_PER_SLOT; passQueryIdx++)
+        {
+            // Passes not in the last frame of the slot count as 0.
+            uint64_t fragInvocations = 0;
+            if (writtenMask & (1u << passQueryIdx))
+            {
+                VK_CHECK(vkGetQueryPoolResults(*m_pGpuRsrcManager->GetLogicalDevice(),
+                                               m_statsQueryPool,
+                                               frameSlot * HSTATS_QUERIES_PER_SLOT + passQueryIdx,
+                                               1,
+                                               sizeof(uint64_t),
+                                               &fragInvocations,
+                                               sizeof(uint64_t),
+                                               VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+            }
+
+            if (passQueryIdx == HSTATS_QUERY_DEPTH_PREPASS)
+            {
+                m_depthPrepassFragInvocations = fragInvocations;
+            }
+            else
+            {
+                m_sceneFragInvocations = fragInvocations;
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HRenderManager::CmdBeginStatsQuery(
+        VkCommandBuffer cmdBuf,
+        uint32_t        passQueryIdx)
+    {
+        if (m_statsQueryPool != VK_NULL_HANDLE)
+        {
+            vkCmdBeginQuery(cmdBuf,
+                            m_statsQueryPool,
+                            m_acqSwapchainImgIdx * HSTATS_QUERIES_PER_SLOT + passQueryIdx,
+                            0);
+            m_statsWrittenMasks[m_acqSwapchainImgIdx] |= (1u << passQueryIdx);
+        }
+    }
+
+    // ================================================================================================================
+    void HRenderManager::CmdEndStatsQuery(
+        VkCommandBuffer cmdBuf,
+        uint32_t        passQueryIdx)
+    {
+        if (m_statsQueryPool != VK_NULL_HANDLE)
+        {
+            vkCmdEndQuery(cmdBuf, m_statsQueryPool, m_acqSwapchainImgIdx * HSTATS_QUERIES_PER_SLOT + passQueryIdx);
+        }
     }
 
     // ================================================================================================================
@@ -161,7 +408,11 @@ namespace Hedge
         HScene& scene,
         HEventManager& eventManager)
     {
-        m_pGuiManager->SendIOEvents(scene, eventManager);
+        // There is no input without a window.
+        if (m_isHeadless == false)
+        {
+            m_pGuiManager->SendIOEvents(scene, eventManager);
+        }
     }
 
     // ================================================================================================================
@@ -189,6 +440,9 @@ namespace Hedge
         // It's possible that the swapchain img is ready but the rendering result is not ready.
         m_pGpuRsrcManager->WaitTheFence(m_inFlightFences[m_acqSwapchainImgIdx]);
 
+        // The GPU is done with this frame slot, so its transient render targets can be reused.
+        m_renderTargetPool.BeginFrame(m_acqSwapchainImgIdx);
+
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
         {
             // The surface is imcompatiable with the swapchain (resize window).
@@ -207,35 +461,68 @@ namespace Hedge
         // However, it's possible that people drag the 3D rendering layout window, which changes the size of the 3D
         // window.
         VkExtent2D curRenderTargetExtent = m_renderImgsExtents[m_acqSwapchainImgIdx];
-        VkExtent2D desiredRenderTargetExtent = m_pGuiManager->GetRenderExtent();
+        VkExtent2D desiredRenderTargetExtent = GetDesiredRenderExtent();
         if ((desiredRenderTargetExtent.width != curRenderTargetExtent.width) ||
             (desiredRenderTargetExtent.height != curRenderTargetExtent.height))
         {
-            HGpuImg* pOldColorRenderResultGpuImg = m_frameColorRenderResults[m_acqSwapchainImgIdx];
-            HGpuImg* pOldDepthRenderResultGpuImg = m_frameDepthRenderResults[m_acqSwapchainImgIdx];
-
-            m_pGpuRsrcManager->DereferGpuImg(pOldColorRenderResultGpuImg);
-            m_pGpuRsrcManager->DereferGpuImg(pOldDepthRenderResultGpuImg);
-
-            VkExtent3D desiredExtent3D{ desiredRenderTargetExtent.width, desiredRenderTargetExtent.height, 1 };
+            // The old targets go back to the pool. Resizing back to a former size reuses them.
+            m_renderTargetPool.ReleaseRenderTarget(m_frameColorRenderResults[m_acqSwapchainImgIdx]);
+            m_renderTargetPool.ReleaseRenderTarget(m_frameDepthRenderResults[m_acqSwapchainImgIdx]);
 
             HGpuImgCreateInfo colorRenderTarget = CreateColorTargetHGpuImgInfo(desiredRenderTargetExtent);
             HGpuImgCreateInfo depthRenderTarget = CreateDepthTargetHGpuImgInfo(desiredRenderTargetExtent);
 
-            m_frameColorRenderResults[m_acqSwapchainImgIdx] = m_pGpuRsrcManager->CreateGpuImage(colorRenderTarget, "Color Render Target -- Resized");
-            m_frameDepthRenderResults[m_acqSwapchainImgIdx] = m_pGpuRsrcManager->CreateGpuImage(depthRenderTarget, "Depth Render Target -- Resized");
+            m_frameColorRenderResults[m_acqSwapchainImgIdx] = m_renderTargetPool.AcquireRenderTarget(colorRenderTarget, "Color Render Target -- Resized");
+            m_frameDepthRenderResults[m_acqSwapchainImgIdx] = m_renderTargetPool.AcquireRenderTarget(depthRenderTarget, "Depth Render Target -- Resized");
+            m_renderImgsExtents[m_acqSwapchainImgIdx] = desiredRenderTargetExtent;
+            m_frameOutputImgs[m_acqSwapchainImgIdx] = m_frameColorRenderResults[m_acqSwapchainImgIdx];
+        }
+    }
+
+    // ================================================================================================================
+    void HRenderManager::AcquireHeadlessFrameSlot()
+    {
+        m_acqSwapchainImgIdx = m_frameIdx % m_swapchainImgCnt;
+
+        // The frame slot's rendering and readback are done after the fence.
+        m_pGpuRsrcManager->WaitTheFence(m_inFlightFences[m_acqSwapchainImgIdx]);
+
+        m_renderTargetPool.BeginFrame(m_acqSwapchainImgIdx);
+
+        if (m_headlessInfo.captureInterval != 0)
+        {
+            m_frameCapturer.ResolveFrameSlot(m_acqSwapchainImgIdx);
         }
     }
 
+    // ================================================================================================================
+    VkExtent2D HRenderManager::GetDesiredRenderExtent()
+    {
+        return m_isHeadless ? m_headlessInfo.renderExtent : m_pGuiManager->GetRenderExtent();
+    }
+
     // ================================================================================================================
     void HRenderManager::CreateSwapchainCmdBuffers()
     {
+        // The scene can be recorded on a job while the game thread records the one-shot commands on the shared graphics
+        // pool. A pool must not be used by two threads at once, so the swapchain command buffers have their own pool.
+        VkCommandPoolCreateInfo commandPoolInfo{};
+        {
+            commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            commandPoolInfo.queueFamilyIndex = m_pGpuRsrcManager->GetGfxQueueFamilyIdx();
+        }
+        VK_CHECK(vkCreateCommandPool(*m_pGpuRsrcManager->GetLogicalDevice(),
+                                     &commandPoolInfo,
+                                     nullptr,
+                                     &m_swapchainCmdPool));
+
         // Create the command buffers for swapchain syn on the graphics pool
         m_swapchainRenderCmdBuffers.resize(m_swapchainImgCnt);
         VkCommandBufferAllocateInfo commandBufferAllocInfo{};
         {
             commandBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            commandBufferAllocInfo.commandPool = *m_pGpuRsrcManager->GetGfxCmdPool();
+            commandBufferAllocInfo.commandPool = m_swapchainCmdPool;
             commandBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
             commandBufferAllocInfo.commandBufferCount = (uint32_t)m_swapchainRenderCmdBuffers.size();
         }
@@ -252,6 +539,9 @@ namespace Hedge
         // Update UBO data and point light storage data.
         m_frameGpuRenderRsrcController.SwitchToFrame(m_acqSwapchainImgIdx);
 
+        // The fence of this swapchain image is waited, so its secondary command buffers are free to be reset.
+        m_cmdRecorder.BeginFrame(m_acqSwapchainImgIdx);
+
         // Fill the command buffer
         VkCommandBuffer curCmdBuffer = m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx];
 
@@ -261,58 +551,213 @@ namespace Hedge
         }
         VK_CHECK(vkBeginCommandBuffer(curCmdBuffer, &beginInfo));
 
-        Util::CmdTransImgLayout(curCmdBuffer,
-                                m_frameColorRenderResults[m_acqSwapchainImgIdx],
-                                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                VK_ACCESS_NONE,
-                                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
-
-        Util::CmdTransImgLayout(curCmdBuffer,
-                                m_frameDepthRenderResults[m_acqSwapchainImgIdx],
-                                VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-                                VK_ACCESS_NONE,
-                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-                                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT);
+        // The frame's GPU time starts before any of its work.
+        m_dynamicResolution.CmdBeginFrame(curCmdBuffer, m_acqSwapchainImgIdx);
+
+        // Queries have to be reset outside of the rendering before they begin.
+        m_statsWrittenMasks[m_acqSwapchainImgIdx] = 0;
+        if (m_statsQueryPool != VK_NULL_HANDLE)
+        {
+            vkCmdResetQueryPool(curCmdBuffer,
+                                m_statsQueryPool,
+                                m_acqSwapchainImgIdx * HSTATS_QUERIES_PER_SLOT,
+                                HSTATS_QUERIES_PER_SLOT);
+        }
+
+        HGpuImg* pColorImg = m_frameColorRenderResults[m_acqSwapchainImgIdx];
+        HGpuImg* pDepthImg = m_frameDepthRenderResults[m_acqSwapchainImgIdx];
+
+        HRenderer* pRenderer = m_pRenderers[m_activeRendererIdx];
+        bool useDepthPrepass = m_depthPrepassEnabled && pRenderer->IsDepthPrepassSupported();
+
+        // The render targets have the full extent. A render scale under 1 only uses their top left corner.
+        VkExtent2D fullExtent = m_renderImgsExtents[m_acqSwapchainImgIdx];
+        VkExtent2D renderExtent = m_dynamicResolution.CalScaledExtent(fullExtent);
+        bool isUpscaled = (renderExtent.width != fullExtent.width) || (renderExtent.height != fullExtent.height);
 
         HRenderContext renderCtx{};
         {
             renderCtx.renderArea.offset = { 0, 0 };
-            renderCtx.renderArea.extent = m_pGuiManager->GetRenderExtent();
+            renderCtx.renderArea.extent = renderExtent;
+
+            renderCtx.pColorAttachmentImg = pColorImg;
+            renderCtx.pDepthAttachmentImg = pDepthImg;
 
-            renderCtx.pColorAttachmentImg = m_frameColorRenderResults[m_acqSwapchainImgIdx];
-            renderCtx.pDepthAttachmentImg = m_frameDepthRenderResults[m_acqSwapchainImgIdx];
+            renderCtx.pCmdRecorder = &m_cmdRecorder;
+
+            renderCtx.hasDepthPrepass = useDepthPrepass;
+            renderCtx.pHiZPyramid = m_hiZCullingEnabled ? &m_hiZPyramid : nullptr;
         }
 
+        // The graph records the layout transitions and the barriers between the passes.
+        m_renderGraph.Reset();
+
         // Render the skybox background
-        m_pSkyboxRenderer->CmdRenderInsts(curCmdBuffer,
-                                          &renderCtx,
-                                          sceneRenderInfo,
-                                          &m_frameGpuRenderRsrcController);
-
-        // Create per frame resources. Record the rendering instructions
-        m_pRenderers[m_activeRendererIdx]->CmdRenderInsts(curCmdBuffer,
-                                                          &renderCtx,
-                                                          sceneRenderInfo,
-                                                          &m_frameGpuRenderRsrcController);
-
-        // ImGui needs the Shader Read Only layout -- Note: It waits for all commands so it has some overhead.
-        // NOTE: This should be moved to other places instead of putting it in the renderer... I should put it in an
-        //       util.
-        Util::CmdTransImgLayout(curCmdBuffer,
-                                m_frameColorRenderResults[m_acqSwapchainImgIdx],
-                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                VK_ACCESS_SHADER_READ_BIT,
-                                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
+        uint32_t skyboxPass = m_renderGraph.AddPass("Skybox", false, [&](VkCommandBuffer& cmdBuf) {
+            m_pSkyboxRenderer->CmdRenderInsts(cmdBuf, &renderCtx, sceneRenderInfo, &m_frameGpuRenderRsrcController);
+        });
+        m_renderGraph.AddPassImgAccess(skyboxPass, pColorImg, HRG_ACCESS_COLOR_ATTACHMENT_WRITE);
+
+        // The depth prepass fills the depth, so the scene pass only shades the visible surface of each pixel.
+        if (useDepthPrepass)
+        {
+            uint32_t depthPrepass = m_renderGraph.AddPass("DepthPrepass", false, [&](VkCommandBuffer& cmdBuf) {
+                CmdBeginStatsQuery(cmdBuf, HSTATS_QUERY_DEPTH_PREPASS);
+                pRenderer->CmdRenderDepthPrepass(cmdBuf, &renderCtx, sceneRenderInfo, &m_frameGpuRenderRsrcController);
+                CmdEndStatsQuery(cmdBuf, HSTATS_QUERY_DEPTH_PREPASS);
+            });
+            m_renderGraph.AddPassImgAccess(depthPrepass, pDepthImg, HRG_ACCESS_DEPTH_ATTACHMENT_WRITE);
+        }
+
+        // Create per frame resources. Record the rendering instructions.
+        // The scene loads the skybox background. Without a skybox, it clears the color and the skybox pass is culled.
+        // Nothing presents the scene in the headless mode, so the scene pass is the output.
+        uint32_t scenePass = m_renderGraph.AddPass("Scene", m_isHeadless, [&](VkCommandBuffer& cmdBuf) {
+            CmdBeginStatsQuery(cmdBuf, HSTATS_QUERY_SCENE);
+            pRenderer->CmdRenderInsts(cmdBuf, &renderCtx, sceneRenderInfo, &m_frameGpuRenderRsrcController);
+            CmdEndStatsQuery(cmdBuf, HSTATS_QUERY_SCENE);
+        });
+        m_renderGraph.AddPassImgAccess(scenePass,
+                                       pColorImg,
+                                       sceneRenderInfo.skyboxCubemapGpuImg == nullptr ?
+                                           HRG_ACCESS_COLOR_ATTACHMENT_WRITE : HRG_ACCESS_COLOR_ATTACHMENT_READ_WRITE);
+        m_renderGraph.AddPassImgAccess(scenePass,
+                                       pDepthImg,
+                                       useDepthPrepass ? HRG_ACCESS_DEPTH_ATTACHMENT_READ :
+                                                         HRG_ACCESS_DEPTH_ATTACHMENT_WRITE);
+
+        // Build the Hi-Z pyramid from the final depth for the occlusion culling of the following frames.
+        if (m_hiZCullingEnabled)
+        {
+            uint32_t hiZPass = m_renderGraph.AddPass("HiZ", true, [&](VkCommandBuffer& cmdBuf) {
+                m_hiZPyramid.CmdBuild(cmdBuf,
+                                      m_acqSwapchainImgIdx,
+                                      pDepthImg,
+                                      renderExtent,
+                                      sceneRenderInfo.vpMat.eles,
+                                      m_frameIdx);
+            });
+            m_renderGraph.AddPassImgAccess(hiZPass, pDepthImg, HRG_ACCESS_COMPUTE_SAMPLED);
+        }
+
+        // Upsample the scaled scene to the full extent. The GUI and the capture only see the full size image.
+        HGpuImg* pOutputImg = pColorImg;
+        if (isUpscaled)
+        {
+            pOutputImg = AcquireUpscaleTarget(fullExtent);
+
+            uint32_t upscalePass = m_renderGraph.AddPass("Upscale", false, [&](VkCommandBuffer& cmdBuf) {
+                VkImageBlit blitRegion{};
+                {
+                    blitRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+                    blitRegion.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width),
+                                                 static_cast<int32_t>(renderExtent.height),
+                                                 1 };
+                    blitRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+                    blitRegion.dstOffsets[1] = { static_cast<int32_t>(fullExtent.width),
+                                                 static_cast<int32_t>(fullExtent.height),
+                                                 1 };
+                }
+
+                vkCmdBlitImage(cmdBuf,
+                               pColorImg->gpuImg,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               pOutputImg->gpuImg,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               1,
+                               &blitRegion,
+                               VK_FILTER_LINEAR);
+            });
+            m_renderGraph.AddPassImgAccess(upscalePass, pColorImg, HRG_ACCESS_TRANSFER_SRC);
+            m_renderGraph.AddPassImgAccess(upscalePass, pOutputImg, HRG_ACCESS_TRANSFER_DST);
+        }
+        m_frameOutputImgs[m_acqSwapchainImgIdx] = pOutputImg;
+
+        if (m_isHeadless)
+        {
+            // Copy the scene color to the readback buffer. It's read when this frame slot comes back.
+            uint32_t captureInterval = m_headlessInfo.captureInterval;
+            if ((captureInterval != 0) && (m_frameIdx % captureInterval == 0))
+            {
+                uint32_t capturePass = m_renderGraph.AddPass("Capture", true, [&](VkCommandBuffer& cmdBuf) {
+                    m_frameCapturer.CmdCaptureImg(cmdBuf, m_acqSwapchainImgIdx, pOutputImg, m_frameIdx);
+                });
+                m_renderGraph.AddPassImgAccess(capturePass, pOutputImg, HRG_ACCESS_TRANSFER_SRC);
+            }
+        }
+        else
+        {
+            // ImGui samples the scene color in its render pass, which is recorded in the FinalizeSceneAndSwapBuffers().
+            // So, the GUI pass here only gets its barrier: The fragment shader waits for the scene's color output.
+            uint32_t guiPass = m_renderGraph.AddPass("Gui", true, nullptr);
+            m_renderGraph.AddPassImgAccess(guiPass, pOutputImg, HRG_ACCESS_FRAGMENT_SAMPLED);
+        }
+
+        m_renderGraph.Execute(curCmdBuffer);
+    }
+
+    // ================================================================================================================
+    void HRenderManager::SetPipelinedFramesEnabled(
+        bool enabled)
+    {
+        assert(m_isRecordingSnapshot == false);
+        m_pipelinedFramesEnabled = enabled;
+
+        // The snapshot from before the switch is stale.
+        m_hasFrontSnapshot = false;
+    }
+
+    // ================================================================================================================
+    void HRenderManager::BeginRecordSceneSnapshot()
+    {
+        assert(m_isRecordingSnapshot == false);
+
+        // The first pipelined frame has nothing to record yet. Its own snapshot is recorded at the end instead.
+        if (m_hasFrontSnapshot == false)
+        {
+            return;
+        }
+
+        // The frame slot is acquired and its fence is waited, so the job owns the frame's recording until the end.
+        const SceneRenderInfo* pSnapshot = m_pSceneSnapshots[m_frontSnapshotIdx];
+        g_pJobSystem->Run([this, pSnapshot]() { RenderCurrentScene(*pSnapshot); }, &m_recordSnapshotCounter);
+        m_isRecordingSnapshot = true;
+    }
+
+    // ================================================================================================================
+    void HRenderManager::StoreSceneSnapshot(
+        const SceneRenderInfo& sceneRenderInfo)
+    {
+        // The vectors keep their memory, so the copy stops allocating once the scene stops growing.
+        *m_pSceneSnapshots[1 - m_frontSnapshotIdx] = sceneRenderInfo;
+    }
+
+    // ================================================================================================================
+    void HRenderManager::EndRecordSceneSnapshot()
+    {
+        if (m_isRecordingSnapshot)
+        {
+            g_pJobSystem->Wait(m_recordSnapshotCounter);
+            m_isRecordingSnapshot = false;
+        }
+        else
+        {
+            RenderCurrentScene(*m_pSceneSnapshots[1 - m_frontSnapshotIdx]);
+        }
+
+        m_frontSnapshotIdx = 1 - m_frontSnapshotIdx;
+        m_hasFrontSnapshot = true;
     }
 
     // ================================================================================================================
     void HRenderManager::FinalizeSceneAndSwapBuffers()
     {
+        if (m_isHeadless)
+        {
+            SubmitHeadlessFrame();
+            return;
+        }
+
         if (m_skipSubmitThisFrameCommandBuffer == true)
         {
             vkResetCommandBuffer(m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx], 0);
@@ -323,6 +768,11 @@ namespace Hedge
             }
 
             vkBeginCommandBuffer(m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx], &beginInfo);
+
+            // The scene's queries and Hi-Z build are reset with the command buffer.
+            m_statsWrittenMasks[m_acqSwapchainImgIdx] = 0;
+            m_hiZPyramid.DiscardFrameSlot(m_acqSwapchainImgIdx);
+            m_dynamicResolution.DiscardFrameSlot(m_acqSwapchainImgIdx);
         }
 
         m_pGuiManager->RecordGuiDraw(m_renderPass,
@@ -330,6 +780,12 @@ namespace Hedge
             m_swapchainImageExtent,
             m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx]);
 
+        // A skipped scene lost its start timestamp with the command buffer reset.
+        if (m_skipSubmitThisFrameCommandBuffer == false)
+        {
+            m_dynamicResolution.CmdEndFrame(m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx], m_acqSwapchainImgIdx);
+        }
+
         VK_CHECK(vkEndCommandBuffer(m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx]));
 
         // Submit the filled command buffer to the graphics queue to draw the image
@@ -376,6 +832,7 @@ namespace Hedge
         }
 
         m_skipSubmitThisFrameCommandBuffer = false;
+        m_frameIdx++;
         /*
         if (m_skipSubmitThisFrameCommandBuffer == false)
         {
@@ -390,9 +847,38 @@ namespace Hedge
         */
     }
 
+    // ================================================================================================================
+    void HRenderManager::SubmitHeadlessFrame()
+    {
+        m_dynamicResolution.CmdEndFrame(m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx], m_acqSwapchainImgIdx);
+
+        VK_CHECK(vkEndCommandBuffer(m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx]));
+
+        // Nothing is presented, so the fence is the only thing to signal.
+        VkSubmitInfo submitInfo{};
+        {
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &m_swapchainRenderCmdBuffers[m_acqSwapchainImgIdx];
+        }
+
+        VK_CHECK(vkQueueSubmit(*m_pGpuRsrcManager->GetGfxQueue(),
+            1,
+            &submitInfo,
+            m_inFlightFences[m_acqSwapchainImgIdx]));
+
+        m_skipSubmitThisFrameCommandBuffer = false;
+        m_frameIdx++;
+    }
+
     // ================================================================================================================
     bool HRenderManager::WindowShouldClose()
     {
+        if (m_isHeadless)
+        {
+            return (m_headlessInfo.framesCnt != 0) && (m_frameIdx >= m_headlessInfo.framesCnt);
+        }
+
         return glfwWindowShouldClose(m_pGlfwWindow);
     }
 
@@ -413,6 +899,11 @@ namespace Hedge
     void HRenderManager::SetWindowTitle(
         const std::string& titleStr)
     {
+        if (m_isHeadless)
+        {
+            return;
+        }
+
         glfwSetWindowTitle(m_pGlfwWindow, titleStr.c_str());
     }
 
@@ -420,18 +911,21 @@ namespace Hedge
     void HRenderManager::CreateRenderTargets()
     {
         // Create the color render target and the depth render target
-        VkExtent2D desiredRenderTargetExtent = m_pGuiManager->GetRenderExtent();
+        VkExtent2D desiredRenderTargetExtent = GetDesiredRenderExtent();
         HGpuImgCreateInfo colorRenderTargetInfo = CreateColorTargetHGpuImgInfo(desiredRenderTargetExtent);
         HGpuImgCreateInfo depthRenderTargetInfo = CreateDepthTargetHGpuImgInfo(desiredRenderTargetExtent);
 
         m_frameColorRenderResults.resize(m_swapchainImgCnt);
         m_frameDepthRenderResults.resize(m_swapchainImgCnt);
+        m_frameUpscaleRenderResults.assign(m_swapchainImgCnt, nullptr);
+        m_frameOutputImgs.resize(m_swapchainImgCnt);
 
         for (uint32_t i = 0; i < m_swapchainImgCnt; i++)
         {
             m_renderImgsExtents[i] = desiredRenderTargetExtent;
-            m_frameColorRenderResults[i] = m_pGpuRsrcManager->CreateGpuImage(colorRenderTargetInfo, "Color Render Target Original");
-            m_frameDepthRenderResults[i] = m_pGpuRsrcManager->CreateGpuImage(depthRenderTargetInfo, "Depth Render Target Original");
+            m_frameColorRenderResults[i] = m_renderTargetPool.AcquireRenderTarget(colorRenderTargetInfo, "Color Render Target Original");
+            m_frameDepthRenderResults[i] = m_renderTargetPool.AcquireRenderTarget(depthRenderTargetInfo, "Depth Render Target Original");
+            m_frameOutputImgs[i] = m_frameColorRenderResults[i];
         }
     }
 
@@ -746,14 +1240,40 @@ namespace Hedge
     // ================================================================================================================
     VkImageView* HRenderManager::GetCurrentRenderImgView() 
     { 
-        return &(m_frameColorRenderResults[m_acqSwapchainImgIdx]->gpuImgView);
+        return &(m_frameOutputImgs[m_acqSwapchainImgIdx]->gpuImgView);
     }
 
     // ================================================================================================================
     VkExtent2D HRenderManager::GetCurrentRenderImgExtent()
     {
-        return { m_frameColorRenderResults[m_acqSwapchainImgIdx]->imgInfo.extent.width,
-                 m_frameColorRenderResults[m_acqSwapchainImgIdx]->imgInfo.extent.height };
+        return { m_frameOutputImgs[m_acqSwapchainImgIdx]->imgInfo.extent.width,
+                 m_frameOutputImgs[m_acqSwapchainImgIdx]->imgInfo.extent.height };
+    }
+
+    // ================================================================================================================
+    HGpuImg* HRenderManager::AcquireUpscaleTarget(
+        VkExtent2D extent)
+    {
+        HGpuImg*& pUpscaleImg = m_frameUpscaleRenderResults[m_acqSwapchainImgIdx];
+        if ((pUpscaleImg != nullptr) &&
+            ((pUpscaleImg->imgInfo.extent.width != extent.width) ||
+             (pUpscaleImg->imgInfo.extent.height != extent.height)))
+        {
+            m_renderTargetPool.ReleaseRenderTarget(pUpscaleImg);
+            pUpscaleImg = nullptr;
+        }
+
+        if (pUpscaleImg == nullptr)
+        {
+            // It's only a blit destination, so it doesn't need to be a color attachment.
+            HGpuImgCreateInfo upscaleTargetInfo = CreateColorTargetHGpuImgInfo(extent);
+            upscaleTargetInfo.imgUsageFlags = VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                              VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                              VK_IMAGE_USAGE_SAMPLED_BIT;
+            pUpscaleImg = m_renderTargetPool.AcquireRenderTarget(upscaleTargetInfo, "Upscaled Color Render Target");
+        }
+
+        return pUpscaleImg;
     }
 
     // ================================================================================================================
@@ -797,11 +1317,26 @@ namespace Hedge
         HGpuImgCreateInfo depthRenderTarget{};
         {
             depthRenderTarget.allocFlags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
-            depthRenderTarget.hasSampler = false;
+            depthRenderTarget.hasSampler = true;
             depthRenderTarget.imgViewType = VK_IMAGE_VIEW_TYPE_2D;
             depthRenderTarget.imgFormat = VK_FORMAT_D16_UNORM;
             depthRenderTarget.imgExtent = desiredExtent3D;
-            depthRenderTarget.imgUsageFlags = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            depthRenderTarget.imgUsageFlags = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                              VK_IMAGE_USAGE_SAMPLED_BIT; // The Hi-Z build reads it.
+
+            // The Hi-Z build loads texels, so the sampler doesn't filter.
+            VkSamplerCreateInfo samplerInfo{};
+            {
+                samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+                samplerInfo.magFilter = VK_FILTER_NEAREST;
+                samplerInfo.minFilter = VK_FILTER_NEAREST;
+                samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+                samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                samplerInfo.maxLod = 1.f;
+            }
+            depthRenderTarget.samplerInfo = samplerInfo;
 
             VkImageSubresourceRange imgSubRsrcRange{};
             {
@@ -825,18 +1360,26 @@ namespace Hedge
 
         for (uint32_t i = 0; i < m_swapchainImgCnt; i++)
         {
-            m_pGpuRsrcManager->DereferGpuImg(m_frameColorRenderResults[i]);
-            m_pGpuRsrcManager->DereferGpuImg(m_frameDepthRenderResults[i]);
+            m_renderTargetPool.ReleaseRenderTarget(m_frameColorRenderResults[i]);
+            m_renderTargetPool.ReleaseRenderTarget(m_frameDepthRenderResults[i]);
+            if (m_frameUpscaleRenderResults[i] != nullptr)
+            {
+                m_renderTargetPool.ReleaseRenderTarget(m_frameUpscaleRenderResults[i]);
+            }
         }
+        m_renderTargetPool.Cleanup();
 
         m_frameColorRenderResults.clear();
         m_frameDepthRenderResults.clear();
+        m_frameUpscaleRenderResults.clear();
+        m_frameOutputImgs.clear();
     }
 
     // ================================================================================================================
     void HRenderManager::InitRenderTargetHGpuRsrc()
     {
         m_frameGpuRenderRsrcController.Init(m_swapchainImgCnt, m_pGpuRsrcManager);
+        m_renderTargetPool.Init(m_pGpuRsrcManager, m_swapchainImgCnt);
         CreateRenderTargets();
     }
 
@@ -872,6 +1415,7 @@ namespace Hedge
     void HFrameGpuRenderRsrcControl::AddGpuBufferReferControl(
         HGpuBuffer* pHGpuBuffer)
     {
+        std::lock_guard<std::mutex> lock(m_mutex);
         m_pGpuRsrcManager->ReferGpuBufferImg(pHGpuBuffer);
         m_gpuRsrcFrameCtxs[m_curFrameIdx].m_pTmpGpuBuffers.push_back(pHGpuBuffer);
     }
@@ -880,6 +1424,7 @@ namespace Hedge
     void HFrameGpuRenderRsrcControl::AddGpuImgReferControl(
         HGpuImg* pHGpuImg)
     {
+        std::lock_guard<std::mutex> lock(m_mutex);
         m_pGpuRsrcManager->ReferGpuBufferImg(pHGpuImg);
         m_gpuRsrcFrameCtxs[m_curFrameIdx].m_pTmpGpuImgs.push_back(pHGpuImg);
     }
@@ -891,6 +1436,7 @@ namespace Hedge
         void*                    pRamData,
         uint32_t                 bytesNum)
     {
+        std::lock_guard<std::mutex> lock(m_mutex);
         HGpuBuffer* pBuffer = m_pGpuRsrcManager->CreateGpuBuffer(usage, vmaFlags, bytesNum, "TmpGpuBuffer");
         HGpuRsrcFrameContext& ctx = m_gpuRsrcFrameCtxs[m_curFrameIdx];
 
@@ -12,7 +12,16 @@
 #include <unordered_set>
 #include <iostream>
 #include <vector>
+#include <cassert>
+#include <mutex>
 #include "../core/HGpuRsrcManager.h"
+#include "../core/HJobSystem.h"
+#include "HParallelCmdRecorder.h"
+#include "HRenderGraph.h"
+#include "HRenderTargetPool.h"
+#include "HFrameCapturer.h"
+#include "HHiZPyramid.h"
+#include "HDynamicResolution.h"
 
 struct GLFWwindow;
 
@@ -40,6 +49,8 @@ namespace Hedge
     * change. It looks like it is highly possible that the performance should be ok.
     */
     // Assume that all gpu buffers and images will be used for shader inputs.
+    // Renderers can record commands with multiple threads, so creating and referring resources are thread safe.
+    // Switching frames and cleaning up must be done on the main thread when no recording is happening.
     struct HGpuRsrcFrameContext
     {
         std::vector<HGpuBuffer*> m_pTmpGpuBuffers;
@@ -70,14 +81,37 @@ namespace Hedge
         uint32_t                          m_curFrameIdx;
         HGpuRsrcManager*                  m_pGpuRsrcManager;
         std::vector<HGpuRsrcFrameContext> m_gpuRsrcFrameCtxs;
+        std::mutex                        m_mutex; // The recording threads add to the current frame context at once.
+    };
+
+    // The headless mode renders the scene into offscreen render targets without a window, a surface, a swapchain or
+    // the GUI. It runs on the machines without a display or a GPU (E.g. The lavapipe on the build machines).
+    struct HHeadlessRenderInfo
+    {
+        VkExtent2D  renderExtent;
+        uint32_t    framesCnt;       // The window should close after so many frames. 0 means never.
+        uint32_t    captureInterval; // Capture the color render target every so many frames. 0 means no capture.
+        std::string captureDir;
+        uint32_t    rendererIdx;     // The active renderer. (See the SetActiveRenderer(...))
     };
 
     class HRenderManager
     {
     public:
-        HRenderManager(HBaseGuiManager* pGuiManager, HGpuRsrcManager* pGpuRsrcManager);
+        // A null pHeadlessInfo creates the window and the swapchain.
+        HRenderManager(HBaseGuiManager*           pGuiManager,
+                       HGpuRsrcManager*           pGpuRsrcManager,
+                       const HHeadlessRenderInfo* pHeadlessInfo = nullptr);
         virtual ~HRenderManager();
 
+        // Read the headless settings from the environment variables:
+        // HEDGE_HEADLESS=<width>x<height>, HEDGE_HEADLESS_FRAMES=<cnt>, HEDGE_CAPTURE_INTERVAL=<cnt>,
+        // HEDGE_CAPTURE_DIR=<dir>, HEDGE_RENDERER=<idx>. Return false if the HEDGE_HEADLESS is not set.
+        // E.g. HEDGE_RENDERER=1 checks the GPU driven renderer on a software driver like the lavapipe.
+        static bool GetHeadlessRenderInfoFromEnv(HHeadlessRenderInfo* pHeadlessInfo);
+
+        bool IsHeadless() { return m_isHeadless; }
+
         void BeginNewFrame();
         void SendIOEvents(HScene& scene, HEventManager& eventManager);
         void RenderCurrentScene(const SceneRenderInfo& sceneRenderInfo);
@@ -91,6 +125,42 @@ namespace Hedge
         VkImageView* GetCurrentRenderImgView();
         VkExtent2D   GetCurrentRenderImgExtent();
 
+        // Renderers: [0] HBasicRenderer. [1] HGpuDrivenRenderer, if the device supports it.
+        uint32_t GetRenderersCnt() { return m_pRenderers.size(); }
+        void SetActiveRenderer(uint32_t idx) { assert(idx < m_pRenderers.size()); m_activeRendererIdx = idx; }
+
+        // The depth prepass is only used with the renderers supporting it. The Hi-Z culling uses the depth of the
+        // former frames, so it works with or without the prepass.
+        void SetDepthPrepassEnabled(bool enabled) { m_depthPrepassEnabled = enabled; }
+        void SetHiZCullingEnabled(bool enabled) { m_hiZCullingEnabled = enabled; }
+
+        // Fragment shader invocations of the latest finished frame. They are 0 if the device doesn't support the
+        // pipeline statistics queries.
+        uint64_t GetSceneFragShaderInvocations() const { return m_sceneFragInvocations; }
+        uint64_t GetDepthPrepassFragShaderInvocations() const { return m_depthPrepassFragInvocations; }
+
+        // The dynamic resolution renders the scene at a scale of the render extent and upsamples it into the image
+        // shown by the GUI. The scale follows the GPU frame time to the target. It's off by default and it needs the
+        // timestamps support of the graphics queue.
+        void SetDynamicResolutionEnabled(bool enabled) { m_dynamicResolution.SetEnabled(enabled); }
+        void SetDynamicResolutionInfo(const HDynamicResolutionInfo& info) { m_dynamicResolution.SetInfo(info); }
+        float GetRenderScale() const { return m_dynamicResolution.GetScale(); }
+        float GetGpuFrameMs() const { return m_dynamicResolution.GetGpuFrameMs(); }
+
+        // The pipelined frames record the last frame's scene snapshot on a job while the game simulates the current
+        // frame, so the scene on the screen is one frame behind the game. While a snapshot is recorded, the game must
+        // not call the render manager, and the GPU resources in the last snapshot must stay alive. The game can still
+        // create and release GPU resources, because the GpuRsrcManager serializes them. It's off by default.
+        void SetPipelinedFramesEnabled(bool enabled);
+        bool IsPipelinedFramesEnabled() const { return m_pipelinedFramesEnabled; }
+
+        // The pipelined frame replaces the RenderCurrentScene(...) with:
+        // BeginNewFrame() -> BeginRecordSceneSnapshot() -> Simulate and StoreSceneSnapshot(...) ->
+        // EndRecordSceneSnapshot() -> DrawHud(...) -> FinalizeSceneAndSwapBuffers().
+        void BeginRecordSceneSnapshot();
+        void StoreSceneSnapshot(const SceneRenderInfo& sceneRenderInfo);
+        void EndRecordSceneSnapshot();
+
     protected:
         // GUI
         uint32_t GetCurSwapchainFrameIdx() { return m_acqSwapchainImgIdx; }
@@ -111,6 +181,22 @@ namespace Hedge
         void CreateGlfwWindowAndVkSurface();
         void HandleResize();
 
+        // The headless frame slots are used in turns instead of being acquired from the swapchain.
+        void AcquireHeadlessFrameSlot();
+        void SubmitHeadlessFrame();
+
+        // Read the queries and the Hi-Z pyramid of the frame slot after its fence.
+        void ResolveFrameSlotReadback(uint32_t frameSlot);
+
+        // The query of a pass in the current frame slot. It's a no-op without the pipeline statistics.
+        void CmdBeginStatsQuery(VkCommandBuffer cmdBuf, uint32_t passQueryIdx);
+        void CmdEndStatsQuery(VkCommandBuffer cmdBuf, uint32_t passQueryIdx);
+
+        VkExtent2D GetDesiredRenderExtent();
+
+        // The current frame slot's full size target of the upsampled scene color.
+        HGpuImg* AcquireUpscaleTarget(VkExtent2D extent);
+
         static void GlfwFramebufferResizeCallback(GLFWwindow* window, int width, int height) 
             { m_frameBufferResize = true; }
 
@@ -130,6 +216,12 @@ namespace Hedge
         // Gpu resource
         HGpuRsrcManager* m_pGpuRsrcManager;
 
+        // Headless
+        bool                m_isHeadless;
+        HHeadlessRenderInfo m_headlessInfo;
+        uint64_t            m_frameIdx;
+        HFrameCapturer      m_frameCapturer;
+
         // GLFW and window context
         GLFWwindow*  m_pGlfwWindow;
         static bool  m_frameBufferResize;
@@ -145,6 +237,7 @@ namespace Hedge
         std::vector<VkSemaphore>     m_swapchainRenderFinishedSemaphores;
         std::vector<VkFence>         m_inFlightFences;
         std::vector<VkCommandBuffer> m_swapchainRenderCmdBuffers;
+        VkCommandPool                m_swapchainCmdPool; // Only for the m_swapchainRenderCmdBuffers.
         VkRenderPass                 m_renderPass; // The render pass for gui rendering.
         // uint32_t                     m_curSwapchainFrameIdx;
         uint32_t                     m_swapchainImgCnt;
@@ -157,7 +250,39 @@ namespace Hedge
         std::vector<HGpuImg*>      m_frameColorRenderResults;
         std::vector<HGpuImg*>      m_frameDepthRenderResults;
         std::vector<VkExtent2D>    m_renderImgsExtents;
+        std::vector<HGpuImg*>      m_frameUpscaleRenderResults; // Only created when the render scale is under 1.
+        std::vector<HGpuImg*>      m_frameOutputImgs;           // The color or the upscaled color. Shown by the GUI.
 
         HRenderer* m_pSkyboxRenderer;
+
+        // Per thread command pools for the renderers' parallel recording.
+        HParallelCmdRecorder m_cmdRecorder;
+
+        // Passes of the frame and their barriers. Rebuilt every frame.
+        HRenderGraph m_renderGraph;
+
+        // All render targets come from the pool, so resizing and new passes reuse the images and the memory.
+        HRenderTargetPool m_renderTargetPool;
+
+        // Depth prepass and Hi-Z occlusion culling.
+        bool        m_depthPrepassEnabled;
+        bool        m_hiZCullingEnabled;
+        HHiZPyramid m_hiZPyramid;
+
+        // Fragment shader invocations of the passes. Each frame slot has its own range of queries in the pool.
+        VkQueryPool           m_statsQueryPool;
+        std::vector<uint32_t> m_statsWrittenMasks; // Queries of each frame slot recorded in its last frame.
+        uint64_t              m_sceneFragInvocations;
+        uint64_t              m_depthPrepassFragInvocations;
+
+        HDynamicResolution m_dynamicResolution;
+
+        // The front snapshot is recorded while the game stores the next frame into the back snapshot.
+        bool             m_pipelinedFramesEnabled;
+        SceneRenderInfo* m_pSceneSnapshots[2];
+        uint32_t         m_frontSnapshotIdx;
+        bool             m_hasFrontSnapshot;
+        bool             m_isRecordingSnapshot;
+        HJobCounter      m_recordSnapshotCounter;
     };
 }
@@ -0,0 +1,220 @@
+#include "HRenderQueue.h"
+#include <algorithm>
+#include <cstring>
+
+#define HRENDER_KEY_DEPTH_BITS    24
+#define HRENDER_KEY_MESH_BITS     16
+#define HRENDER_KEY_MATERIAL_BITS 16
+#define HRENDER_KEY_PIPELINE_BITS 4
+
+#define HRENDER_KEY_MASK(bits) ((1ull << (bits)) - 1)
+
+namespace Hedge
+{
+    // ================================================================================================================
+    HRenderQueue::HRenderQueue()
+        : m_nearPlane(0.f),
+          m_farPlane(1.f),
+          m_stats{}
+    {}
+
+    // ================================================================================================================
+    HRenderQueue::~HRenderQueue()
+    {}
+
+    // ================================================================================================================
+    void HRenderQueue::Begin(
+        float nearPlane,
+        float farPlane)
+    {
+        m_nearPlane = nearPlane;
+        m_farPlane = farPlane > nearPlane ? farPlane : nearPlane + 1.f;
+
+        m_keys.clear();
+        m_drawIdx.clear();
+        m_objIdx.clear();
+        m_pipelineIds.clear();
+        m_materialIds.clear();
+        m_meshIds.clear();
+    }
+
+    // ================================================================================================================
+    uint32_t HRenderQueue::GetMaterialId(
+        uint64_t materialGuid)
+    {
+        auto itr = m_materialIdsMap.find(materialGuid);
+        if (itr != m_materialIdsMap.end())
+        {
+            return itr->second;
+        }
+
+        uint32_t id = m_materialIdsMap.size();
+        m_materialIdsMap.insert({ materialGuid, id });
+        return id;
+    }
+
+    // ================================================================================================================
+    uint32_t HRenderQueue::GetMeshId(
+        const void* pMesh)
+    {
+        auto itr = m_meshIdsMap.find(pMesh);
+        if (itr != m_meshIdsMap.end())
+        {
+            return itr->second;
+        }
+
+        uint32_t id = m_meshIdsMap.size();
+        m_meshIdsMap.insert({ pMesh, id });
+        return id;
+    }
+
+    // ================================================================================================================
+    void HRenderQueue::AddDraw(
+        uint32_t      objIdx,
+        HRenderBucket bucket,
+        uint32_t      pipelineId,
+        uint64_t      materialGuid,
+        const void*   pMesh,
+        float         viewDepth)
+    {
+        uint32_t materialId = GetMaterialId(materialGuid);
+        uint32_t meshId = GetMeshId(pMesh);
+
+        float depthNormalized = (viewDepth - m_nearPlane) / (m_farPlane - m_nearPlane);
+        depthNormalized = std::min(std::max(depthNormalized, 0.f), 1.f);
+        uint64_t depth = (uint64_t)(depthNormalized * HRENDER_KEY_MASK(HRENDER_KEY_DEPTH_BITS));
+
+        // Ids beyond the bits wrap around. It only makes the sort less optimal and never merges different states,
+        // since the callers compare the real states.
+        uint64_t pipelineBits = pipelineId & HRENDER_KEY_MASK(HRENDER_KEY_PIPELINE_BITS);
+        uint64_t materialBits = materialId & HRENDER_KEY_MASK(HRENDER_KEY_MATERIAL_BITS);
+        uint64_t meshBits = meshId & HRENDER_KEY_MASK(HRENDER_KEY_MESH_BITS);
+
+        uint64_t key = (uint64_t)bucket << 62;
+        if (bucket == HRENDER_BUCKET_OPAQUE)
+        {
+            key |= pipelineBits << 58;
+            key |= materialBits << 42;
+            key |= meshBits << 26;
+            key |= depth << 2;
+        }
+        else
+        {
+            uint64_t invDepth = HRENDER_KEY_MASK(HRENDER_KEY_DEPTH_BITS) - depth;
+            key |= invDepth << 38;
+            key |= pipelineBits << 34;
+            key |= materialBits << 18;
+            key |= meshBits << 2;
+        }
+
+        m_drawIdx.push_back(m_keys.size());
+        m_keys.push_back(key);
+        m_objIdx.push_back(objIdx);
+        m_pipelineIds.push_back(pipelineId);
+        m_materialIds.push_back(materialId);
+        m_meshIds.push_back(meshId);
+    }
+
+    // ================================================================================================================
+    void HRenderQueue::RadixSort()
+    {
+        uint32_t cnt = m_keys.size();
+        m_tmpKeys.resize(cnt);
+        m_tmpDrawIdx.resize(cnt);
+
+        // Build all 8 histograms in one read of the keys.
+        uint32_t histograms[8][256];
+        memset(histograms, 0, sizeof(histograms));
+        for (uint32_t i = 0; i < cnt; i++)
+        {
+            uint64_t key = m_keys[i];
+            for (uint32_t pass = 0; pass < 8; pass++)
+            {
+                histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+            }
+        }
+
+        uint64_t* pSrcKeys = m_keys.data();
+        uint64_t* pDstKeys = m_tmpKeys.data();
+        uint32_t* pSrcIdx = m_drawIdx.data();
+        uint32_t* pDstIdx = m_tmpDrawIdx.data();
+
+        for (uint32_t pass = 0; pass < 8; pass++)
+        {
+            uint32_t* pHistogram = histograms[pass];
+
+            // All keys fall into one bucket. This pass doesn't change the order.
+            uint32_t firstDigit = (pSrcKeys[0] >> (pass * 8)) & 0xFF;
+            if (pHistogram[firstDigit] == cnt)
+            {
+                continue;
+            }
+
+            uint32_t offsets[256];
+            uint32_t sum = 0;
+            for (uint32_t digit = 0; digit < 256; digit++)
+            {
+                offsets[digit] = sum;
+                sum += pHistogram[digit];
+            }
+
+            for (uint32_t i = 0; i < cnt; i++)
+            {
+                uint32_t digit = (pSrcKeys[i] >> (pass * 8)) & 0xFF;
+                uint32_t dst = offsets[digit]++;
+                pDstKeys[dst] = pSrcKeys[i];
+                pDstIdx[dst] = pSrcIdx[i];
+            }
+
+            std::swap(pSrcKeys, pDstKeys);
+            std::swap(pSrcIdx, pDstIdx);
+        }
+
+        // Odd number of passes leave the result in the tmp buffers.
+        if (pSrcKeys != m_keys.data())
+        {
+            m_keys.swap(m_tmpKeys);
+            m_drawIdx.swap(m_tmpDrawIdx);
+        }
+    }
+
+    // ================================================================================================================
+    void HRenderQueue::UpdateStats()
+    {
+        uint32_t cnt = m_keys.size();
+        m_stats = HRenderQueueStats{};
+        m_stats.drawsCnt = cnt;
+
+        for (uint32_t i = 1; i < cnt; i++)
+        {
+            uint32_t cur = m_drawIdx[i];
+            uint32_t prev = m_drawIdx[i - 1];
+            m_stats.pipelineChanges += m_pipelineIds[cur] != m_pipelineIds[prev];
+            m_stats.materialChanges += m_materialIds[cur] != m_materialIds[prev];
+            m_stats.meshChanges += m_meshIds[cur] != m_meshIds[prev];
+
+            // The submission order is the draw index order.
+            m_stats.unsortedPipelineChanges += m_pipelineIds[i] != m_pipelineIds[i - 1];
+            m_stats.unsortedMaterialChanges += m_materialIds[i] != m_materialIds[i - 1];
+            m_stats.unsortedMeshChanges += m_meshIds[i] != m_meshIds[i - 1];
+        }
+    }
+
+    // ================================================================================================================
+    void HRenderQueue::Sort()
+    {
+        uint32_t cnt = m_keys.size();
+        if (cnt > 1)
+        {
+            RadixSort();
+        }
+
+        UpdateStats();
+
+        m_sortedObjIdx.resize(cnt);
+        for (uint32_t i = 0; i < cnt; i++)
+        {
+            m_sortedObjIdx[i] = m_objIdx[m_drawIdx[i]];
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+namespace Hedge
+{
+    enum HRenderBucket
+    {
+        HRENDER_BUCKET_OPAQUE = 0,      // Sorted by states, then front to back for the early-z.
+        HRENDER_BUCKET_TRANSLUCENT = 1, // Sorted back to front for the blending, then by states.
+    };
+
+    // Number of states changes if the draws are issued in the sorted order and in the submission order.
+    struct HRenderQueueStats
+    {
+        uint32_t drawsCnt;
+
+        uint32_t pipelineChanges;
+        uint32_t materialChanges;
+        uint32_t meshChanges;
+
+        uint32_t unsortedPipelineChanges;
+        uint32_t unsortedMaterialChanges;
+        uint32_t unsortedMeshChanges;
+    };
+
+    // A render queue collects draws with 64-bit sort keys and radix sorts them into the submission order.
+    //
+    // Key layout (From the most significant bit):
+    // Opaque:      | bucket 2 | pipeline 4 | material 16 | mesh 16 | depth 24 | unused 2 |
+    // Translucent: | bucket 2 | inverted depth 24 | pipeline 4 | material 16 | mesh 16 | unused 2 |
+    //
+    // Materials and meshes are mapped to compact ids in the order they are first seen. The ids are kept across
+    // frames, so the order is stable for a static scene.
+    class HRenderQueue
+    {
+    public:
+        HRenderQueue();
+        ~HRenderQueue();
+
+        // Reset the draws. The depth range is used to quantize the view depth of the draws.
+        void Begin(float nearPlane, float farPlane);
+
+        void AddDraw(uint32_t      objIdx,
+                     HRenderBucket bucket,
+                     uint32_t      pipelineId,
+                     uint64_t      materialGuid,
+                     const void*   pMesh,
+                     float         viewDepth);
+
+        // Radix sort the keys and update the stats.
+        void Sort();
+
+        // Objects' indices in the sorted order.
+        const std::vector<uint32_t>& GetSortedObjIdx() const { return m_sortedObjIdx; }
+
+        const HRenderQueueStats& GetStats() const { return m_stats; }
+
+    private:
+        uint32_t GetMaterialId(uint64_t materialGuid);
+        uint32_t GetMeshId(const void* pMesh);
+
+        // LSD radix sort on 8 bits digits. Passes that all keys share the same digit are skipped.
+        void RadixSort();
+
+        void UpdateStats();
+
+        float m_nearPlane;
+        float m_farPlane;
+
+        // Per draw data in the submission order.
+        std::vector<uint64_t> m_keys;
+        std::vector<uint32_t> m_drawIdx; // The sort payload. Index into the submission order.
+        std::vector<uint32_t> m_objIdx;
+        std::vector<uint32_t> m_pipelineIds;
+        std::vector<uint32_t> m_materialIds;
+        std::vector<uint32_t> m_meshIds;
+
+        // Radix sort ping-pong buffers.
+        std::vector<uint64_t> m_tmpKeys;
+        std::vector<uint32_t> m_tmpDrawIdx;
+
+        std::vector<uint32_t> m_sortedObjIdx;
+
+        std::unordered_map<uint64_t, uint32_t>    m_materialIdsMap;
+        std::unordered_map<const void*, uint32_t> m_meshIdsMap;
+
+        HRenderQueueStats m_stats;
+    };
+}
@@ -0,0 +1,245 @@
+#include "HRenderTargetPool.h"
+#include <cassert>
+
+namespace Hedge
+{
+    // ================================================================================================================
+    HRenderTargetPool::HRenderTargetPool()
+        : m_pGpuRsrcManager(nullptr),
+          m_frameCnt(0),
+          m_curFrameSlot(0),
+          m_frameSlotsCnt(0)
+    {}
+
+    // ================================================================================================================
+    HRenderTargetPool::~HRenderTargetPool()
+    {}
+
+    // ================================================================================================================
+    void HRenderTargetPool::Init(
+        HGpuRsrcManager* pGpuRsrcManager,
+        uint32_t         frameSlotsCnt)
+    {
+        m_pGpuRsrcManager = pGpuRsrcManager;
+        m_frameSlotsCnt = frameSlotsCnt;
+        m_curFrameSlot = 0;
+        m_transientBlocks.resize(frameSlotsCnt);
+    }
+
+    // ================================================================================================================
+    void HRenderTargetPool::Cleanup()
+    {
+        for (HPooledRenderTarget& renderTarget : m_freeRenderTargets)
+        {
+            m_pGpuRsrcManager->DereferGpuImg(renderTarget.pImg);
+        }
+        m_freeRenderTargets.clear();
+
+        for (auto& slotBlocks : m_transientBlocks)
+        {
+            for (HTransientMemBlock& block : slotBlocks)
+            {
+                for (HTransientImg& img : block.imgs)
+                {
+                    m_pGpuRsrcManager->DereferGpuImg(img.pImg);
+                }
+                m_pGpuRsrcManager->FreeGpuImgMemory(block.memory);
+            }
+        }
+        m_transientBlocks.clear();
+    }
+
+    // ================================================================================================================
+    void HRenderTargetPool::BeginFrame(
+        uint32_t frameSlot)
+    {
+        // Transient images of the slot are only in use if their last used frame is the current frame.
+        m_frameCnt++;
+        m_curFrameSlot = frameSlot;
+
+        TrimIdleRsrc();
+    }
+
+    // ================================================================================================================
+    HRenderTargetKey HRenderTargetPool::GenKey(
+        const HGpuImgCreateInfo& createInfo)
+    {
+        return { createInfo.imgExtent.width,
+                 createInfo.imgExtent.height,
+                 createInfo.imgFormat,
+                 createInfo.imgUsageFlags };
+    }
+
+    // ================================================================================================================
+    HRenderTargetKey HRenderTargetPool::GenKey(
+        const HGpuImg* pImg)
+    {
+        return { pImg->imgInfo.extent.width, pImg->imgInfo.extent.height, pImg->imgInfo.format, pImg->imgInfo.usage };
+    }
+
+    // ================================================================================================================
+    HGpuImg* HRenderTargetPool::AcquireRenderTarget(
+        const HGpuImgCreateInfo& createInfo,
+        const std::string&       dbgMsg)
+    {
+        HRenderTargetKey key = GenKey(createInfo);
+
+        // A released target may still be used by the frames in flight.
+        for (uint32_t i = 0; i < m_freeRenderTargets.size(); i++)
+        {
+            const HPooledRenderTarget& renderTarget = m_freeRenderTargets[i];
+            if ((GenKey(renderTarget.pImg) == key) && (m_frameCnt >= renderTarget.releaseFrame + m_frameSlotsCnt))
+            {
+                HGpuImg* pImg = renderTarget.pImg;
+                m_freeRenderTargets.erase(m_freeRenderTargets.begin() + i);
+                return pImg;
+            }
+        }
+
+        return m_pGpuRsrcManager->CreateGpuImage(createInfo, dbgMsg);
+    }
+
+    // ================================================================================================================
+    void HRenderTargetPool::ReleaseRenderTarget(
+        HGpuImg* pImg)
+    {
+        m_freeRenderTargets.push_back({ pImg, m_frameCnt });
+    }
+
+    // ================================================================================================================
+    HGpuImg* HRenderTargetPool::AcquireTransientRenderTarget(
+        const HGpuImgCreateInfo& createInfo,
+        uint32_t                 firstPass,
+        uint32_t                 lastPass,
+        HGpuImg*&                pPrevImg)
+    {
+        assert(firstPass <= lastPass);
+
+        HRenderTargetKey key = GenKey(createInfo);
+        VkMemoryRequirements memReq = m_pGpuRsrcManager->GetGpuImgMemoryRequirements(createInfo);
+        std::vector<HTransientMemBlock>& blocks = m_transientBlocks[m_curFrameSlot];
+
+        // Images are placed at the start of a block. A block fits if it's big enough, its memory type is acceptable
+        // and all its current users finish before the first pass. So, transients should be acquired in the pass order.
+        HTransientMemBlock* pBlock = nullptr;
+        for (HTransientMemBlock& block : blocks)
+        {
+            if ((block.memReq.size < memReq.size) ||
+                ((block.memReq.memoryTypeBits & ~memReq.memoryTypeBits) != 0))
+            {
+                continue;
+            }
+
+            bool isFree = true;
+            for (const HTransientImg& img : block.imgs)
+            {
+                if ((img.lastUsedFrame == m_frameCnt) && (img.lastPass >= firstPass))
+                {
+                    isFree = false;
+                    break;
+                }
+            }
+
+            if (isFree)
+            {
+                pBlock = &block;
+                break;
+            }
+        }
+
+        if (pBlock == nullptr)
+        {
+            HTransientMemBlock block{};
+            {
+                block.memory = m_pGpuRsrcManager->AllocateGpuImgMemory(memReq);
+                block.memReq = memReq;
+            }
+            blocks.push_back(block);
+            pBlock = &blocks.back();
+        }
+
+        // The former user is the last one finishing in the block. The one we need to wait for.
+        pPrevImg = nullptr;
+        uint32_t prevLastPass = 0;
+        HTransientImg* pTransientImg = nullptr;
+        for (HTransientImg& img : pBlock->imgs)
+        {
+            if (img.lastUsedFrame == m_frameCnt)
+            {
+                if ((pPrevImg == nullptr) || (img.lastPass > prevLastPass))
+                {
+                    pPrevImg = img.pImg;
+                    prevLastPass = img.lastPass;
+                }
+            }
+            else if ((pTransientImg == nullptr) && (GenKey(img.pImg) == key))
+            {
+                pTransientImg = &img;
+            }
+        }
+
+        if (pTransientImg == nullptr)
+        {
+            HGpuImg* pImg = m_pGpuRsrcManager->CreateAliasingGpuImage(createInfo,
+                                                                      pBlock->memory,
+                                                                      "Transient Render Target");
+            pBlock->imgs.push_back({ pImg, 0, 0, 0 });
+            pTransientImg = &pBlock->imgs.back();
+        }
+
+        pTransientImg->lastUsedFrame = m_frameCnt;
+        pTransientImg->firstPass = firstPass;
+        pTransientImg->lastPass = lastPass;
+        pBlock->lastUsedFrame = m_frameCnt;
+
+        return pTransientImg->pImg;
+    }
+
+    // ================================================================================================================
+    void HRenderTargetPool::TrimIdleRsrc()
+    {
+        // Idle for so many frames means that no frame in flight uses them.
+        for (uint32_t i = 0; i < m_freeRenderTargets.size();)
+        {
+            if (m_frameCnt - m_freeRenderTargets[i].releaseFrame > HRENDER_TARGET_POOL_MAX_IDLE_FRAMES)
+            {
+                m_pGpuRsrcManager->DereferGpuImg(m_freeRenderTargets[i].pImg);
+                m_freeRenderTargets.erase(m_freeRenderTargets.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        for (auto& slotBlocks : m_transientBlocks)
+        {
+            for (uint32_t blockIdx = 0; blockIdx < slotBlocks.size();)
+            {
+                HTransientMemBlock& block = slotBlocks[blockIdx];
+                for (uint32_t i = 0; i < block.imgs.size();)
+                {
+                    if (m_frameCnt - block.imgs[i].lastUsedFrame > HRENDER_TARGET_POOL_MAX_IDLE_FRAMES)
+                    {
+                        m_pGpuRsrcManager->DereferGpuImg(block.imgs[i].pImg);
+                        block.imgs.erase(block.imgs.begin() + i);
+                    }
+                    else
+                    {
+                        i++;
+                    }
+                }
+
+                if (block.imgs.empty() && (m_frameCnt - block.lastUsedFrame > HRENDER_TARGET_POOL_MAX_IDLE_FRAMES))
+                {
+                    m_pGpuRsrcManager->FreeGpuImgMemory(block.memory);
+                    slotBlocks.erase(slotBlocks.begin() + blockIdx);
+                }
+                else
+                {
+                    blockIdx++;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include "../core/HGpuRsrcManager.h"
+
+// Free render targets and transient memory blocks unused for this number of frames are destroyed.
+#define HRENDER_TARGET_POOL_MAX_IDLE_FRAMES 120
+
+namespace Hedge
+{
+    // Render targets with the same key are interchangeable.
+    struct HRenderTargetKey
+    {
+        uint32_t          width;
+        uint32_t          height;
+        VkFormat          format;
+        VkImageUsageFlags usage;
+
+        bool operator==(const HRenderTargetKey& other) const
+        {
+            return (width == other.width) && (height == other.height) &&
+                   (format == other.format) && (usage == other.usage);
+        }
+    };
+
+    // The render manager gets its render targets from the pool instead of the GpuRsrcManager.
+    //
+    // Persistent render targets are held until they are released. A released target is reused by a later acquire of
+    // the same key once the frames in flight are done with it, so resizing back and forth doesn't reallocate.
+    //
+    // Transient render targets only live in a pass range [firstPass, lastPass] of the current frame. Transient targets
+    // with non-overlapping ranges alias one memory block. Each frame in flight has its own blocks. The former user of
+    // the memory is returned, so the render graph can put the aliasing barrier by the HRenderGraph::AddImgAlias(...).
+    class HRenderTargetPool
+    {
+    public:
+        HRenderTargetPool();
+        ~HRenderTargetPool();
+
+        void Init(HGpuRsrcManager* pGpuRsrcManager, uint32_t frameSlotsCnt);
+        void Cleanup();
+
+        // The frame slot's in-flight fence must be waited. It trims the idle targets and resets the slot's transients.
+        void BeginFrame(uint32_t frameSlot);
+
+        HGpuImg* AcquireRenderTarget(const HGpuImgCreateInfo& createInfo, const std::string& dbgMsg);
+        void     ReleaseRenderTarget(HGpuImg* pImg);
+
+        // pPrevImg is the image that used the memory in earlier passes of this frame or nullptr.
+        HGpuImg* AcquireTransientRenderTarget(const HGpuImgCreateInfo& createInfo,
+                                              uint32_t                 firstPass,
+                                              uint32_t                 lastPass,
+                                              HGpuImg*&                pPrevImg);
+
+    private:
+        struct HPooledRenderTarget
+        {
+            HGpuImg* pImg;
+            uint64_t releaseFrame;
+        };
+
+        // A transient image placed in a memory block and the pass range it's used in the current frame.
+        struct HTransientImg
+        {
+            HGpuImg* pImg;
+            uint64_t lastUsedFrame;
+            uint32_t firstPass;
+            uint32_t lastPass;
+        };
+
+        struct HTransientMemBlock
+        {
+            VmaAllocation              memory;
+            VkMemoryRequirements       memReq;
+            uint64_t                   lastUsedFrame;
+            std::vector<HTransientImg> imgs; // All images bound to the block. Kept across frames for the reuse.
+        };
+
+        static HRenderTargetKey GenKey(const HGpuImgCreateInfo& createInfo);
+        static HRenderTargetKey GenKey(const HGpuImg* pImg);
+
+        void TrimIdleRsrc();
+
+        HGpuRsrcManager* m_pGpuRsrcManager;
+        uint64_t         m_frameCnt;
+        uint32_t         m_curFrameSlot;
+        uint32_t         m_frameSlotsCnt;
+
+        std::vector<HPooledRenderTarget>             m_freeRenderTargets;
+        std::vector<std::vector<HTransientMemBlock>> m_transientBlocks; // [Frame slot][Block]
+    };
+}
@@ -5,6 +5,8 @@
 #include "Utils.h"
 #include "UtilMath.h"
 #include "../core/HGpuRsrcManager.h"
+#include "HParallelCmdRecorder.h"
+#include "HHiZPyramid.h"
 
 #include <GLFW/glfw3.h>
 
@@ -12,6 +14,12 @@
 #include <cassert>
 #include <vector>
 #include <set>
+#include <algorithm>
+
+// Below this number of draws (or instance batches), the draws are recorded inline in the primary command buffer.
+#define HPARALLEL_RECORD_MIN_DRAWS 64
+
+extern Hedge::HGpuRsrcManager* g_pGpuRsrcManager;
 
 namespace Hedge
 {
@@ -32,30 +40,124 @@ namespace Hedge
 
     // ================================================================================================================
     HBasicRenderer::HBasicRenderer(VkDevice device)
-        : HRenderer(device)
+        : HRenderer(device),
+          m_useBindless(false),
+          m_bindlessDescriptorSet(VK_NULL_HANDLE),
+          m_hiZCulledObjsCnt(0),
+          m_frameUseBindless(false),
+          m_frameDepthPrepassed(false),
+          m_frameDrawsCnt(0),
+          m_pDepthPrepassPipeline(nullptr),
+          m_pPBRPipelines{}
     {
         PBRPipeline* pPipeline = new PBRPipeline();
         pPipeline->CreatePipeline(m_device);
         m_pPipelines.push_back(pPipeline);
+        m_pPBRPipelines[0][0][HPBR_FEATURE_ALL] = pPipeline;
+
+        // The depth prepass. The scene pass permutations drawing on the prepassed depth are created on demand.
+        m_pDepthPrepassPipeline = new PBRDepthPrepassPipeline();
+        m_pDepthPrepassPipeline->CreatePipeline(m_device);
+
+        // The bindless pipeline is the m_pPipelines[1]. We keep the push descriptor pipeline as the fallback.
+        if (g_pGpuRsrcManager->IsBindlessSupported())
+        {
+            PBRBindlessPipeline* pBindlessPipeline =
+                new PBRBindlessPipeline(g_pGpuRsrcManager->GetBindlessDescriptorSetLayout());
+            pBindlessPipeline->CreatePipeline(m_device);
+            m_pPipelines.push_back(pBindlessPipeline);
+            m_pPBRPipelines[1][0][HPBR_FEATURE_ALL] = pBindlessPipeline;
+
+            m_bindlessDescriptorSet = g_pGpuRsrcManager->GetBindlessDescriptorSet();
+            m_useBindless = true;
+        }
     }
 
     // ================================================================================================================
     HBasicRenderer::~HBasicRenderer()
     {
+        delete m_pDepthPrepassPipeline;
+
+        // The full feature permutations without the depth prepass are deleted with the m_pPipelines.
+        for (uint32_t bindless = 0; bindless < 2; bindless++)
+        {
+            for (uint32_t depthEqual = 0; depthEqual < 2; depthEqual++)
+            {
+                for (uint32_t features = 0; features < HPBR_PERMUTATIONS_CNT; features++)
+                {
+                    PBRPipeline* pPipeline = m_pPBRPipelines[bindless][depthEqual][features];
+                    if ((pPipeline != nullptr) && ((depthEqual != 0) || (features != HPBR_FEATURE_ALL)))
+                    {
+                        delete pPipeline;
+                    }
+                }
+            }
+        }
+    }
+
+    // ================================================================================================================
+    uint32_t HBasicRenderer::GetObjPBRFeatures(
+        const SceneRenderInfo& sceneRenderInfo,
+        uint32_t               objIdx)
+    {
+        return sceneRenderInfo.objsPBRFeatures[objIdx] | (sceneRenderInfo.hasIbl ? HPBR_FEATURE_IBL : 0);
+    }
+
+    // ================================================================================================================
+    PBRPipeline* HBasicRenderer::GetPBRPipeline(
+        bool     bindless,
+        bool     depthEqual,
+        uint32_t features)
+    {
+        PBRPipeline*& pPipeline = m_pPBRPipelines[bindless][depthEqual][features];
+        if (pPipeline == nullptr)
+        {
+            if (bindless)
+            {
+                pPipeline = new PBRBindlessPipeline(g_pGpuRsrcManager->GetBindlessDescriptorSetLayout(),
+                                                    depthEqual,
+                                                    features);
+            }
+            else
+            {
+                pPipeline = new PBRPipeline(depthEqual, features);
+            }
+            pPipeline->CreatePipeline(m_device);
+        }
+
+        return pPipeline;
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::CreateFramePBRPipelines(
+        const SceneRenderInfo& sceneRenderInfo)
+    {
+        for (uint32_t i = 0; i < m_frameDrawsCnt; i++)
+        {
+            uint32_t objIdx = m_instanceBatches[i].firstObjIdx;
+            GetPBRPipeline(m_frameUseBindless, m_frameDepthPrepassed, GetObjPBRFeatures(sceneRenderInfo, objIdx));
+        }
     }
 
     // ================================================================================================================
     std::vector<ShaderInputBinding> HBasicRenderer::GenPerFrameGpuRsrcBinding(
         const SceneRenderInfo&      sceneRenderInfo,
+        const HRenderContext* const pRenderCtx,
         HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl)
     {
-        // The point light data
-        uint32_t pointLightPosRadianceBytesCnt = sizeof(HVec3) * sceneRenderInfo.pointLightsPositions.size();
+        // The point light data. The radius goes along with the position for the light's attenuation window.
+        uint32_t ptLightsCnt = sceneRenderInfo.pointLightsPositions.size();
+        m_pointLightsPosRadius.resize(ptLightsCnt * 4);
+        for (uint32_t i = 0; i < ptLightsCnt; i++)
+        {
+            memcpy(&m_pointLightsPosRadius[i * 4], sceneRenderInfo.pointLightsPositions[i].eles, sizeof(HVec3));
+            m_pointLightsPosRadius[i * 4 + 3] = sceneRenderInfo.pointLightsRadii[i];
+        }
 
         HGpuBuffer* pPtLightsPosStorageBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
             VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-            (void*)sceneRenderInfo.pointLightsPositions.data(), pointLightPosRadianceBytesCnt
+            (void*)m_pointLightsPosRadius.data(), sizeof(float) * m_pointLightsPosRadius.size()
         );
 
         ShaderInputBinding ptLightsPosBinding{ HGPU_BUFFER, 8, pPtLightsPosStorageBuffer };
@@ -63,11 +165,43 @@ namespace Hedge
         HGpuBuffer* pPtLightsRadianceStorageBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
             VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-            (void*)sceneRenderInfo.pointLightsRadiances.data(), pointLightPosRadianceBytesCnt
+            (void*)sceneRenderInfo.pointLightsRadiances.data(), sizeof(HVec3) * ptLightsCnt
         );
 
         ShaderInputBinding ptLightsRadianceBinding{ HGPU_BUFFER, 9, pPtLightsRadianceStorageBuffer };
 
+        // Clustered light lists. The fragment shader only loops over the lights of its cluster.
+        m_lightClusterBuilder.Build(sceneRenderInfo,
+                                    static_cast<float>(pRenderCtx->renderArea.extent.width),
+                                    static_cast<float>(pRenderCtx->renderArea.extent.height));
+
+        const HClusterInfo& clusterInfo = m_lightClusterBuilder.GetClusterInfo();
+        HGpuBuffer* pClusterInfoUbo = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            (void*)&clusterInfo, sizeof(HClusterInfo)
+        );
+
+        ShaderInputBinding clusterInfoBinding{ HGPU_BUFFER, 11, pClusterInfoUbo };
+
+        const std::vector<uint32_t>& clusterGrid = m_lightClusterBuilder.GetClusterGrid();
+        HGpuBuffer* pClusterGridBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            (void*)clusterGrid.data(), sizeof(uint32_t) * clusterGrid.size()
+        );
+
+        ShaderInputBinding clusterGridBinding{ HGPU_BUFFER, 12, pClusterGridBuffer };
+
+        const std::vector<uint32_t>& lightIndices = m_lightClusterBuilder.GetLightIndices();
+        HGpuBuffer* pLightIndicesBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            (void*)lightIndices.data(), sizeof(uint32_t) * lightIndices.size()
+        );
+
+        ShaderInputBinding lightIndicesBinding{ HGPU_BUFFER, 13, pLightIndicesBuffer };
+
         // Image based lightning bindings
         // Diffuse cubemap light map
         ShaderInputBinding diffuseLightCubemapBinding{ HGPU_IMG, 1, (void*)sceneRenderInfo.diffuseCubemapGpuImg };
@@ -80,37 +214,28 @@ namespace Hedge
 
         std::vector<ShaderInputBinding> perFrameBindings{ ptLightsPosBinding,
                                                           ptLightsRadianceBinding,
-                                                          diffuseLightCubemapBinding,
-                                                          prefilterEnvCubemapBinding,
-                                                          envBrdfBinding };
+                                                          clusterInfoBinding,
+                                                          clusterGridBinding,
+                                                          lightIndicesBinding };
+
+        // The permutations without the IBL don't read the IBL bindings.
+        if (sceneRenderInfo.hasIbl)
+        {
+            perFrameBindings.push_back(diffuseLightCubemapBinding);
+            perFrameBindings.push_back(prefilterEnvCubemapBinding);
+            perFrameBindings.push_back(envBrdfBinding);
+        }
         
         return perFrameBindings;
     }
 
     // ================================================================================================================
-    std::vector<ShaderInputBinding> HBasicRenderer::GenPerObjGpuRsrcBinding(
-        const SceneRenderInfo&      sceneRenderInfo,
-        HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl,
-        uint32_t                    objIdx)
+    void HBasicRenderer::GenPerObjGpuRsrcBinding(
+        const SceneRenderInfo&           sceneRenderInfo,
+        uint32_t                         objIdx,
+        std::vector<ShaderInputBinding>& oBindings)
     {
-        // The model matrix and view-perspective matrix UBO data.
-        uint32_t vertUboDataBytesCnt = 32 * sizeof(float);
-        void* pVertUboData = malloc(vertUboDataBytesCnt);
-
-        HMat4x4 modelMat = sceneRenderInfo.modelMats[objIdx];
-        HMat4x4 vpMat = sceneRenderInfo.vpMat;
-
-        memcpy(pVertUboData, modelMat.eles, sizeof(HMat4x4));
-        memcpy(static_cast<char*>(pVertUboData) + sizeof(HMat4x4), vpMat.eles, sizeof(HMat4x4));
-
-        HGpuBuffer* pVertUbo = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                                            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT |
-                                                                            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-                                                                            pVertUboData, vertUboDataBytesCnt);
-
-        free(pVertUboData);
-        ShaderInputBinding vertUboBinding{ HGPU_BUFFER, 0, pVertUbo };
-
+        // The model matrices are in the frame's instance buffer. Only the material textures are per object.
         // Base color
         ShaderInputBinding baseColorBinding{ HGPU_IMG, 4, (void*)sceneRenderInfo.modelBaseColors[objIdx] };
 
@@ -123,13 +248,10 @@ namespace Hedge
         // Occlusion
         ShaderInputBinding occlusionBinding{ HGPU_IMG, 7, (void*)sceneRenderInfo.modelOcclusionTexs[objIdx] };
 
-        std::vector<ShaderInputBinding> perObjBindings{ vertUboBinding,
-                                                        baseColorBinding,
-                                                        normalMapBinding,
-                                                        metallicRoughnessBinding,
-                                                        occlusionBinding };
-
-        return perObjBindings;
+        oBindings.push_back(baseColorBinding);
+        oBindings.push_back(normalMapBinding);
+        oBindings.push_back(metallicRoughnessBinding);
+        oBindings.push_back(occlusionBinding);
     }
 
     // ================================================================================================================
@@ -155,17 +277,12 @@ namespace Hedge
     }
 
     // ================================================================================================================
-    void HBasicRenderer::CmdRenderInsts(
-        VkCommandBuffer& cmdBuf,
+    void HBasicRenderer::CmdBeginSceneRendering(
+        VkCommandBuffer&            cmdBuf,
         const HRenderContext* const pRenderCtx,
-        const SceneRenderInfo& sceneRenderInfo,
-        HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl)
+        const SceneRenderInfo&      sceneRenderInfo,
+        bool                        secondaryCmdBufContents)
     {
-        std::vector<ShaderInputBinding> perFrameGpuRsrcBindings = GenPerFrameGpuRsrcBinding(sceneRenderInfo,
-                                                                                            pFrameGpuRsrcControl);
-        uint32_t pushConstantBytesCnt = 0;
-        void* pPushConstantData = GenPushConstants(sceneRenderInfo, pushConstantBytesCnt);
-
         VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
 
         VkRenderingAttachmentInfoKHR renderColorAttachmentInfo{};
@@ -188,11 +305,20 @@ namespace Hedge
             depthModelAttachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
             depthModelAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
             depthModelAttachmentInfo.clearValue = depthClearVal;
+
+            // The prepassed depth is only read. The following passes still see it.
+            if (pRenderCtx->hasDepthPrepass)
+            {
+                depthModelAttachmentInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL;
+                depthModelAttachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+                depthModelAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_NONE;
+            }
         }
 
         VkRenderingInfoKHR renderInfo{};
         {
             renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+            renderInfo.flags = secondaryCmdBufContents ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
             renderInfo.renderArea = pRenderCtx->renderArea;
             renderInfo.layerCount = 1;
             renderInfo.colorAttachmentCount = 1;
@@ -200,64 +326,554 @@ namespace Hedge
             renderInfo.pDepthAttachment = &depthModelAttachmentInfo;
         }
 
+        vkCmdBeginRendering(cmdBuf, &renderInfo);
+
+        // Only vkCmdExecuteCommands(...) is allowed in the primary command buffer in this case.
+        if (secondaryCmdBufContents == false)
+        {
+            CmdSetViewportScissor(cmdBuf, pRenderCtx);
+        }
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::CmdSetViewportScissor(
+        VkCommandBuffer&            cmdBuf,
+        const HRenderContext* const pRenderCtx)
+    {
+        VkViewport viewport{};
+        {
+            viewport.x = 0.f;
+            viewport.y = 0.f;
+            viewport.width = pRenderCtx->renderArea.extent.width;
+            viewport.height = pRenderCtx->renderArea.extent.height;
+            viewport.minDepth = 0.f;
+            viewport.maxDepth = 1.f;
+        }
+        vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        {
+            scissor.offset = { 0, 0 };
+            scissor.extent = pRenderCtx->renderArea.extent;
+        }
+        vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::CmdRenderInsts(
+        VkCommandBuffer& cmdBuf,
+        const HRenderContext* const pRenderCtx,
+        const SceneRenderInfo& sceneRenderInfo,
+        HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl)
+    {
         uint32_t objsCnt = sceneRenderInfo.modelMats.size();
         if (objsCnt != 0)
         {
-            vkCmdBeginRendering(cmdBuf, &renderInfo);
-            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pPipelines[0]->GetVkPipeline());
-
-            VkViewport viewport{};
+            std::vector<ShaderInputBinding> perFrameGpuRsrcBindings = GenPerFrameGpuRsrcBinding(sceneRenderInfo,
+                                                                                                pRenderCtx,
+                                                                                                pFrameGpuRsrcControl);
+
+            // Draw in the render key order: Objects with the same states are adjacent and are drawn front to back.
+            // The depth prepass of the frame has prepared the draws, and they must match its depth.
+            m_frameDepthPrepassed = pRenderCtx->hasDepthPrepass;
+            if (m_frameDepthPrepassed == false)
             {
-                viewport.x = 0.f;
-                viewport.y = 0.f;
-                viewport.width = pRenderCtx->renderArea.extent.width;
-                viewport.height = pRenderCtx->renderArea.extent.height;
-                viewport.minDepth = 0.f;
-                viewport.maxDepth = 1.f;
+                PrepareSceneDraws(sceneRenderInfo, pFrameGpuRsrcControl, pRenderCtx->pHiZPyramid);
             }
-            vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
 
-            VkRect2D scissor{};
+            // The recording threads cannot create pipelines.
+            CreateFramePBRPipelines(sceneRenderInfo);
+
+            bool useBindless = m_frameUseBindless;
+            uint32_t drawsCnt = m_frameDrawsCnt;
+            perFrameGpuRsrcBindings.insert(perFrameGpuRsrcBindings.end(),
+                                           m_frameGeometryBindings.begin(),
+                                           m_frameGeometryBindings.end());
+
+            auto cmdDrawObjs = [&](VkCommandBuffer& drawCmdBuf, uint32_t begin, uint32_t end) {
+                if (useBindless)
+                {
+                    CmdDrawObjsBindless(drawCmdBuf,
+                                        sceneRenderInfo,
+                                        pFrameGpuRsrcControl,
+                                        perFrameGpuRsrcBindings,
+                                        begin, end);
+                }
+                else
+                {
+                    CmdDrawObjsPushDescriptors(drawCmdBuf,
+                                               sceneRenderInfo,
+                                               pFrameGpuRsrcControl,
+                                               perFrameGpuRsrcBindings,
+                                               begin, end);
+                }
+            };
+
+            // Small scenes are cheaper to record on this thread than to hand them over to the job system.
+            HParallelCmdRecorder* pCmdRecorder = pRenderCtx->pCmdRecorder;
+            bool recordParallel = (pCmdRecorder != nullptr) &&
+                                  (pCmdRecorder->GetChunksCnt() > 1) &&
+                                  (drawsCnt >= HPARALLEL_RECORD_MIN_DRAWS);
+
+            CmdBeginSceneRendering(cmdBuf, pRenderCtx, sceneRenderInfo, recordParallel);
+
+            if (recordParallel)
             {
-                scissor.offset = { 0, 0 };
-                scissor.extent = pRenderCtx->renderArea.extent;
+                VkFormat colorFormat = pRenderCtx->pColorAttachmentImg->imgInfo.format;
+                VkCommandBufferInheritanceRenderingInfo renderingInheritance{};
+                {
+                    renderingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+                    renderingInheritance.colorAttachmentCount = 1;
+                    renderingInheritance.pColorAttachmentFormats = &colorFormat;
+                    renderingInheritance.depthAttachmentFormat = pRenderCtx->pDepthAttachmentImg->imgInfo.format;
+                    renderingInheritance.rasterizationSamples = pRenderCtx->pColorAttachmentImg->imgInfo.samples;
+                }
+
+                // Secondary command buffers don't inherit the dynamic states from the primary command buffer.
+                pCmdRecorder->CmdRecordParallel(cmdBuf, renderingInheritance, drawsCnt,
+                    [&](VkCommandBuffer secondaryCmdBuf, uint32_t begin, uint32_t end) {
+                        CmdSetViewportScissor(secondaryCmdBuf, pRenderCtx);
+                        cmdDrawObjs(secondaryCmdBuf, begin, end);
+                    });
             }
-            vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
+            else
+            {
+                cmdDrawObjs(cmdBuf, 0, drawsCnt);
+            }
+
+            vkCmdEndRendering(cmdBuf);
+        }
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::AddObjRsrcReferControl(
+        const SceneRenderInfo&      sceneRenderInfo,
+        HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl,
+        uint32_t                    objIdx)
+    {
+        pFrameGpuRsrcControl->AddGpuBufferReferControl(sceneRenderInfo.objsIdxBuffers[objIdx]);
+        pFrameGpuRsrcControl->AddGpuBufferReferControl(sceneRenderInfo.objsVertBuffers[objIdx]);
+        pFrameGpuRsrcControl->AddGpuImgReferControl(sceneRenderInfo.modelBaseColors[objIdx]);
+        pFrameGpuRsrcControl->AddGpuImgReferControl(sceneRenderInfo.modelNormalTexs[objIdx]);
+        pFrameGpuRsrcControl->AddGpuImgReferControl(sceneRenderInfo.modelMetallicRoughnessTexs[objIdx]);
+        pFrameGpuRsrcControl->AddGpuImgReferControl(sceneRenderInfo.modelOcclusionTexs[objIdx]);
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::CmdDrawObjsPushDescriptors(
+        VkCommandBuffer&                       cmdBuf,
+        const SceneRenderInfo&                 sceneRenderInfo,
+        HFrameGpuRenderRsrcControl*            pFrameGpuRsrcControl,
+        const std::vector<ShaderInputBinding>& perFrameGpuRsrcBindings,
+        uint32_t                               begin,
+        uint32_t                               end)
+    {
+        uint32_t pushConstantBytesCnt = 0;
+        void* pPushConstantData = GenPushConstants(sceneRenderInfo, pushConstantBytesCnt);
+
+        // The per frame bindings stay at the front. Only the material textures after them change between the batches,
+        // so the vector is allocated once for all draws.
+        std::vector<ShaderInputBinding> bindings = perFrameGpuRsrcBindings;
+        bindings.reserve(perFrameGpuRsrcBindings.size() + 4);
 
-            for (uint32_t objIdx = 0; objIdx < objsCnt; objIdx++)
+        HPipeline* pPipeline = nullptr;
+        HGpuBuffer* pBoundVertBuffer = nullptr;
+        HGpuBuffer* pBoundIdxBuffer = nullptr;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const HInstanceBatch& batch = m_instanceBatches[i];
+            uint32_t objIdx = batch.firstObjIdx;
+
+            // The render keys sort the objects by their permutations, so the pipeline rarely changes.
+            HPipeline* pObjPipeline = GetPBRPipeline(false,
+                                                     m_frameDepthPrepassed,
+                                                     GetObjPBRFeatures(sceneRenderInfo, objIdx));
+            if (pObjPipeline != pPipeline)
             {
-                std::vector<ShaderInputBinding> perObjGpuRsrcBindings = GenPerObjGpuRsrcBinding(sceneRenderInfo,
-                                                                                                pFrameGpuRsrcControl,
-                                                                                                objIdx);
+                vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pObjPipeline->GetVkPipeline());
+                pPipeline = pObjPipeline;
+            }
 
-                std::vector<ShaderInputBinding> bindings = perFrameGpuRsrcBindings;
-                bindings.insert(bindings.end(), perObjGpuRsrcBindings.begin(), perObjGpuRsrcBindings.end());
+            // The objects of a batch share the material, so its textures are pushed once per batch.
+            bindings.resize(perFrameGpuRsrcBindings.size());
+            GenPerObjGpuRsrcBinding(sceneRenderInfo, objIdx, bindings);
 
-                m_pPipelines[0]->CmdBindDescriptors(cmdBuf, bindings);
+            pPipeline->CmdBindDescriptors(cmdBuf, bindings);
 
+            if (sceneRenderInfo.objsVertBuffers[objIdx] != pBoundVertBuffer)
+            {
                 VkDeviceSize vbOffset = 0;
                 vkCmdBindVertexBuffers(cmdBuf, 0, 1, &sceneRenderInfo.objsVertBuffers[objIdx]->gpuBuffer, &vbOffset);
-                vkCmdBindIndexBuffer(cmdBuf, sceneRenderInfo.objsIdxBuffers[objIdx]->gpuBuffer, 0, VK_INDEX_TYPE_UINT16);
-                vkCmdPushConstants(cmdBuf,
-                    m_pPipelines[0]->GetVkPipelineLayout(),
-                    VK_SHADER_STAGE_FRAGMENT_BIT,
-                    0,
-                    pushConstantBytesCnt,
-                    pPushConstantData);
-                vkCmdDrawIndexed(cmdBuf, sceneRenderInfo.idxCounts[objIdx], 1, 0, 0, 0);
-
-                // Add the static mesh gpu rsrc into the frame resource control
-                pFrameGpuRsrcControl->AddGpuBufferReferControl(sceneRenderInfo.objsIdxBuffers[objIdx]);
-                pFrameGpuRsrcControl->AddGpuBufferReferControl(sceneRenderInfo.objsVertBuffers[objIdx]);
-                pFrameGpuRsrcControl->AddGpuImgReferControl(sceneRenderInfo.modelBaseColors[objIdx]);
-                pFrameGpuRsrcControl->AddGpuImgReferControl(sceneRenderInfo.modelNormalTexs[objIdx]);
-                pFrameGpuRsrcControl->AddGpuImgReferControl(sceneRenderInfo.modelMetallicRoughnessTexs[objIdx]);
-                pFrameGpuRsrcControl->AddGpuImgReferControl(sceneRenderInfo.modelOcclusionTexs[objIdx]);
+                pBoundVertBuffer = sceneRenderInfo.objsVertBuffers[objIdx];
             }
 
-            vkCmdEndRendering(cmdBuf);
+            if (sceneRenderInfo.objsIdxBuffers[objIdx] != pBoundIdxBuffer)
+            {
+                vkCmdBindIndexBuffer(cmdBuf,
+                                     sceneRenderInfo.objsIdxBuffers[objIdx]->gpuBuffer,
+                                     0,
+                                     VK_INDEX_TYPE_UINT16);
+                pBoundIdxBuffer = sceneRenderInfo.objsIdxBuffers[objIdx];
+            }
+
+            vkCmdPushConstants(cmdBuf,
+                pPipeline->GetVkPipelineLayout(),
+                VK_SHADER_STAGE_FRAGMENT_BIT,
+                0,
+                pushConstantBytesCnt,
+                pPushConstantData);
+
+            // The firstInstance is the batch's first instance in the instance buffer. (See the pbr_vert.hlsl)
+            vkCmdDrawIndexed(cmdBuf, sceneRenderInfo.idxCounts[objIdx], batch.instanceCnt, 0, 0, batch.instanceBaseIdx);
+
+            // Objects in a batch share the same rsrc so we only need to add them once.
+            AddObjRsrcReferControl(sceneRenderInfo, pFrameGpuRsrcControl, objIdx);
         }
 
         free(pPushConstantData);
     }
+
+    // ================================================================================================================
+    bool HBasicRenderer::IsSceneBindlessReady(
+        const SceneRenderInfo& sceneRenderInfo)
+    {
+        // It's possible that the bindless array runs out of slots. Then we just fallback to the push descriptors.
+        for (uint32_t objIdx = 0; objIdx < sceneRenderInfo.modelMats.size(); objIdx++)
+        {
+            if ((sceneRenderInfo.modelBaseColors[objIdx]->bindlessIdx == HGPU_INVALID_BINDLESS_IDX) ||
+                (sceneRenderInfo.modelNormalTexs[objIdx]->bindlessIdx == HGPU_INVALID_BINDLESS_IDX) ||
+                (sceneRenderInfo.modelMetallicRoughnessTexs[objIdx]->bindlessIdx == HGPU_INVALID_BINDLESS_IDX) ||
+                (sceneRenderInfo.modelOcclusionTexs[objIdx]->bindlessIdx == HGPU_INVALID_BINDLESS_IDX))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::BuildRenderQueue(
+        const SceneRenderInfo& sceneRenderInfo,
+        bool                   sortByViewDepth,
+        const HHiZPyramid*     pHiZ)
+    {
+        uint32_t objsCnt = sceneRenderInfo.modelMats.size();
+        uint32_t pipelineIdBase = m_useBindless && IsSceneBindlessReady(sceneRenderInfo) ? HPBR_PERMUTATIONS_CNT : 0;
+
+        m_renderQueue.Begin(sceneRenderInfo.cameraInfo.nearPlane, sceneRenderInfo.cameraFarPlane);
+        m_hiZCulledObjsCnt = 0;
+
+        for (uint32_t objIdx = 0; objIdx < objsCnt; objIdx++)
+        {
+            if ((pHiZ != nullptr) && pHiZ->IsReady())
+            {
+                float worldSphere[4];
+                TransformBoundingSphere(sceneRenderInfo.modelMats[objIdx].eles,
+                                        sceneRenderInfo.objsBoundingSpheres[objIdx].center,
+                                        worldSphere);
+
+                if (pHiZ->IsSphereOccluded(worldSphere, worldSphere[3]))
+                {
+                    m_hiZCulledObjsCnt++;
+                    continue;
+                }
+            }
+
+            float viewDepth = 0.f;
+            if (sortByViewDepth)
+            {
+                // The view depth of the bounding sphere's center.
+                const float* pModelMat = sceneRenderInfo.modelMats[objIdx].eles;
+                const float* pCenter = sceneRenderInfo.objsBoundingSpheres[objIdx].center;
+                for (uint32_t row = 0; row < 3; row++)
+                {
+                    float worldCenter = pModelMat[row * 4] * pCenter[0] +
+                                        pModelMat[row * 4 + 1] * pCenter[1] +
+                                        pModelMat[row * 4 + 2] * pCenter[2] +
+                                        pModelMat[row * 4 + 3];
+
+                    viewDepth += (worldCenter - sceneRenderInfo.cameraPos[row]) * sceneRenderInfo.cameraInfo.view[row];
+                }
+            }
+
+            // All PBR materials are opaque for now. Objects using the same shader permutation are adjacent.
+            m_renderQueue.AddDraw(objIdx,
+                                  HRENDER_BUCKET_OPAQUE,
+                                  pipelineIdBase + GetObjPBRFeatures(sceneRenderInfo, objIdx),
+                                  sceneRenderInfo.objsMaterialsGuid[objIdx],
+                                  sceneRenderInfo.objsVertBuffers[objIdx],
+                                  viewDepth);
+        }
+
+        m_renderQueue.Sort();
+        m_sortedObjIdx = m_renderQueue.GetSortedObjIdx();
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::BuildInstanceBatches(
+        const SceneRenderInfo& sceneRenderInfo,
+        bool                   sortByViewDepth,
+        const HHiZPyramid*     pHiZ)
+    {
+        // The render keys put the objects sharing the mesh and the material next to each other, front to back.
+        BuildRenderQueue(sceneRenderInfo, sortByViewDepth, pHiZ);
+
+        // Culled objects are not in the queue.
+        uint32_t objsCnt = m_sortedObjIdx.size();
+
+        auto isSameBatch = [&sceneRenderInfo](uint32_t a, uint32_t b) {
+            return (sceneRenderInfo.objsVertBuffers[a] == sceneRenderInfo.objsVertBuffers[b]) &&
+                   (sceneRenderInfo.objsIdxBuffers[a] == sceneRenderInfo.objsIdxBuffers[b]) &&
+                   (sceneRenderInfo.objsMaterialsGuid[a] == sceneRenderInfo.objsMaterialsGuid[b]);
+        };
+
+        m_instanceBatches.clear();
+
+        for (uint32_t i = 0; i < objsCnt; i++)
+        {
+            uint32_t objIdx = m_sortedObjIdx[i];
+
+            if (m_instanceBatches.empty() || (isSameBatch(m_instanceBatches.back().firstObjIdx, objIdx) == false))
+            {
+                m_instanceBatches.push_back({ objIdx, i, 1 });
+            }
+            else
+            {
+                m_instanceBatches.back().instanceCnt++;
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::GenInstanceData(
+        const SceneRenderInfo& sceneRenderInfo,
+        uint32_t               objIdx,
+        HInstanceData&         oInstanceData)
+    {
+        memcpy(oInstanceData.modelMat, sceneRenderInfo.modelMats[objIdx].eles, sizeof(HMat4x4));
+        oInstanceData.materialIdx[0] = sceneRenderInfo.modelBaseColors[objIdx]->bindlessIdx;
+        oInstanceData.materialIdx[1] = sceneRenderInfo.modelNormalTexs[objIdx]->bindlessIdx;
+        oInstanceData.materialIdx[2] = sceneRenderInfo.modelMetallicRoughnessTexs[objIdx]->bindlessIdx;
+        oInstanceData.materialIdx[3] = sceneRenderInfo.modelOcclusionTexs[objIdx]->bindlessIdx;
+    }
+
+    // ================================================================================================================
+    std::vector<ShaderInputBinding> HBasicRenderer::GenGeometryGpuRsrcBinding(
+        const SceneRenderInfo&      sceneRenderInfo,
+        HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl)
+    {
+        uint32_t objsCnt = m_sortedObjIdx.size();
+        m_instancesData.resize(objsCnt);
+        for (uint32_t i = 0; i < objsCnt; i++)
+        {
+            uint32_t objIdx = m_sortedObjIdx[i];
+            GenInstanceData(sceneRenderInfo, objIdx, m_instancesData[i]);
+        }
+
+        // The view-perspective matrix is the same for all objects, so it's a per frame ubo now.
+        HGpuBuffer* pVpMatUbo = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            (void*)sceneRenderInfo.vpMat.eles, sizeof(HMat4x4));
+
+        // All instances of this frame, ordered by batches.
+        HGpuBuffer* pInstanceStorageBuffer = pFrameGpuRsrcControl->CreateInitTmpGpuBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            (void*)m_instancesData.data(), sizeof(HInstanceData) * m_instancesData.size());
+
+        std::vector<ShaderInputBinding> geometryBindings{ { HGPU_BUFFER, 0, pVpMatUbo },
+                                                          { HGPU_BUFFER, 10, pInstanceStorageBuffer } };
+        return geometryBindings;
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::PrepareSceneDraws(
+        const SceneRenderInfo&      sceneRenderInfo,
+        HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl,
+        const HHiZPyramid*          pHiZ)
+    {
+        // Both the bindless and the push descriptors paths draw the instance batches.
+        m_frameUseBindless = m_useBindless && IsSceneBindlessReady(sceneRenderInfo);
+        BuildInstanceBatches(sceneRenderInfo, true, pHiZ);
+        m_frameDrawsCnt = m_instanceBatches.size();
+
+        // All objects can be occluded. We don't create empty buffers.
+        m_frameGeometryBindings.clear();
+        if (m_frameDrawsCnt != 0)
+        {
+            m_frameGeometryBindings = GenGeometryGpuRsrcBinding(sceneRenderInfo, pFrameGpuRsrcControl);
+        }
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::CmdRenderDepthPrepass(
+        VkCommandBuffer&            cmdBuf,
+        const HRenderContext* const pRenderCtx,
+        const SceneRenderInfo&      sceneRenderInfo,
+        HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl)
+    {
+        PrepareSceneDraws(sceneRenderInfo, pFrameGpuRsrcControl, pRenderCtx->pHiZPyramid);
+
+        // The depth is cleared even without objects, so the scene pass can always load it.
+        VkClearValue depthClearVal{};
+        depthClearVal.depthStencil.depth = 0.f;
+        VkRenderingAttachmentInfoKHR depthAttachmentInfo{};
+        {
+            depthAttachmentInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            depthAttachmentInfo.imageView = pRenderCtx->pDepthAttachmentImg->gpuImgView;
+            depthAttachmentInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+            depthAttachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            depthAttachmentInfo.clearValue = depthClearVal;
+        }
+
+        VkRenderingInfoKHR renderInfo{};
+        {
+            renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+            renderInfo.renderArea = pRenderCtx->renderArea;
+            renderInfo.layerCount = 1;
+            renderInfo.colorAttachmentCount = 0;
+            renderInfo.pDepthAttachment = &depthAttachmentInfo;
+        }
+
+        vkCmdBeginRendering(cmdBuf, &renderInfo);
+
+        if (m_frameDrawsCnt != 0)
+        {
+            CmdSetViewportScissor(cmdBuf, pRenderCtx);
+
+            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pDepthPrepassPipeline->GetVkPipeline());
+            m_pDepthPrepassPipeline->CmdBindDescriptors(cmdBuf, m_frameGeometryBindings);
+
+            HGpuBuffer* pBoundVertBuffer = nullptr;
+            HGpuBuffer* pBoundIdxBuffer = nullptr;
+            for (uint32_t i = 0; i < m_frameDrawsCnt; i++)
+            {
+                uint32_t objIdx = m_instanceBatches[i].firstObjIdx;
+
+                PBRDepthPrepassPushConstant drawInfo{};
+                drawInfo.instanceBaseIdx = m_instanceBatches[i].instanceBaseIdx;
+                uint32_t instanceCnt = m_instanceBatches[i].instanceCnt;
+
+                if (sceneRenderInfo.objsVertBuffers[objIdx] != pBoundVertBuffer)
+                {
+                    VkDeviceSize vbOffset = 0;
+                    vkCmdBindVertexBuffers(cmdBuf,
+                                           0, 1,
+                                           &sceneRenderInfo.objsVertBuffers[objIdx]->gpuBuffer,
+                                           &vbOffset);
+                    pBoundVertBuffer = sceneRenderInfo.objsVertBuffers[objIdx];
+                }
+
+                if (sceneRenderInfo.objsIdxBuffers[objIdx] != pBoundIdxBuffer)
+                {
+                    vkCmdBindIndexBuffer(cmdBuf,
+                                         sceneRenderInfo.objsIdxBuffers[objIdx]->gpuBuffer,
+                                         0,
+                                         VK_INDEX_TYPE_UINT16);
+                    pBoundIdxBuffer = sceneRenderInfo.objsIdxBuffers[objIdx];
+                }
+
+                vkCmdPushConstants(cmdBuf,
+                                   m_pDepthPrepassPipeline->GetVkPipelineLayout(),
+                                   VK_SHADER_STAGE_VERTEX_BIT,
+                                   0,
+                                   sizeof(PBRDepthPrepassPushConstant),
+                                   &drawInfo);
+                vkCmdDrawIndexed(cmdBuf, sceneRenderInfo.idxCounts[objIdx], instanceCnt, 0, 0, 0);
+
+                AddObjRsrcReferControl(sceneRenderInfo, pFrameGpuRsrcControl, objIdx);
+            }
+        }
+
+        vkCmdEndRendering(cmdBuf);
+    }
+
+    // ================================================================================================================
+    void HBasicRenderer::CmdDrawObjsBindless(
+        VkCommandBuffer&                       cmdBuf,
+        const SceneRenderInfo&                 sceneRenderInfo,
+        HFrameGpuRenderRsrcControl*            pFrameGpuRsrcControl,
+        const std::vector<ShaderInputBinding>& perFrameGpuRsrcBindings,
+        uint32_t                               begin,
+        uint32_t                               end)
+    {
+        // All objects can be occluded.
+        if (begin == end)
+        {
+            return;
+        }
+
+        HPipeline* pBindlessPipeline = GetPBRPipeline(true,
+                                                      m_frameDepthPrepassed,
+                                                      GetObjPBRFeatures(sceneRenderInfo,
+                                                                        m_instanceBatches[begin].firstObjIdx));
+        VkPipelineLayout bindlessPipelineLayout = pBindlessPipeline->GetVkPipelineLayout();
+
+        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pBindlessPipeline->GetVkPipeline());
+
+        // Descriptors are only pushed/bound once per command buffer. All permutations have the same layout, so
+        // switching the permutation keeps them.
+        pBindlessPipeline->CmdBindDescriptors(cmdBuf, perFrameGpuRsrcBindings);
+        vkCmdBindDescriptorSets(cmdBuf,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                bindlessPipelineLayout,
+                                1, 1, &m_bindlessDescriptorSet,
+                                0, nullptr);
+
+        // The material textures' slots are in the instances, so the push constant is the same for all batches.
+        PBRBindlessPushConstant drawInfo{};
+        memcpy(drawInfo.cameraPos, sceneRenderInfo.cameraPos, sizeof(float) * 3);
+        drawInfo.iblMaxMipLevels = sceneRenderInfo.iblMaxMipLevels;
+        drawInfo.ptLightCnt = sceneRenderInfo.pointLightsPositions.size();
+
+        vkCmdPushConstants(cmdBuf,
+                           bindlessPipelineLayout,
+                           VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0,
+                           sizeof(PBRBindlessPushConstant),
+                           &drawInfo);
+
+        HGpuBuffer* pBoundVertBuffer = nullptr;
+        HGpuBuffer* pBoundIdxBuffer = nullptr;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const HInstanceBatch& batch = m_instanceBatches[i];
+            uint32_t objIdx = batch.firstObjIdx;
+
+            HPipeline* pBatchPipeline = GetPBRPipeline(true,
+                                                       m_frameDepthPrepassed,
+                                                       GetObjPBRFeatures(sceneRenderInfo, objIdx));
+            if (pBatchPipeline != pBindlessPipeline)
+            {
+                vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pBatchPipeline->GetVkPipeline());
+                pBindlessPipeline = pBatchPipeline;
+            }
+
+            // Batches only differ in the material don't need to rebind the mesh.
+            if (sceneRenderInfo.objsVertBuffers[objIdx] != pBoundVertBuffer)
+            {
+                VkDeviceSize vbOffset = 0;
+                vkCmdBindVertexBuffers(cmdBuf, 0, 1, &sceneRenderInfo.objsVertBuffers[objIdx]->gpuBuffer, &vbOffset);
+                pBoundVertBuffer = sceneRenderInfo.objsVertBuffers[objIdx];
+            }
+
+            if (sceneRenderInfo.objsIdxBuffers[objIdx] != pBoundIdxBuffer)
+            {
+                vkCmdBindIndexBuffer(cmdBuf,
+                                     sceneRenderInfo.objsIdxBuffers[objIdx]->gpuBuffer,
+                                     0,
+                                     VK_INDEX_TYPE_UINT16);
+                pBoundIdxBuffer = sceneRenderInfo.objsIdxBuffers[objIdx];
+            }
+
+            // The firstInstance is the batch's first instance in the instance buffer. (See the pbr_bindless_vert.hlsl)
+            vkCmdDrawIndexed(cmdBuf, sceneRenderInfo.idxCounts[objIdx], batch.instanceCnt, 0, 0, batch.instanceBaseIdx);
+
+            // The textures are still referred so their bindless slots cannot be recycled during this frame.
+            // Objects in a batch share the same rsrc so we only need to add them once.
+            AddObjRsrcReferControl(sceneRenderInfo, pFrameGpuRsrcControl, objIdx);
+        }
+    }
 }
\ No newline at end of file
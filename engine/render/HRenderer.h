@@ -30,6 +30,8 @@
 #include <vector>
 
 #include "HPipeline.h"
+#include "HLightCluster.h"
+#include "HRenderQueue.h"
 
 namespace Hedge
 {
@@ -37,6 +39,8 @@ namespace Hedge
     struct HGpuBuffer;
     struct SceneRenderInfo;
     class HFrameGpuRenderRsrcControl;
+    class HParallelCmdRecorder;
+    class HHiZPyramid;
 
     struct HRenderContext
     {
@@ -55,6 +59,16 @@ namespace Hedge
         HGpuImg* pColorAttachmentImg;
         HGpuImg* pDepthAttachmentImg;
         VkRect2D renderArea;
+
+        // Optional. Renderers can record draws into secondary command buffers with multiple threads through it.
+        HParallelCmdRecorder* pCmdRecorder;
+
+        // The depth attachment already has this frame's depth from the CmdRenderDepthPrepass(...). The depth is only
+        // tested for equality then, so each pixel is shaded once.
+        bool hasDepthPrepass;
+
+        // Optional. Renderers can skip objects occluded in the latest Hi-Z pyramid.
+        const HHiZPyramid* pHiZPyramid;
     };
 
     class HRenderer
@@ -68,6 +82,13 @@ namespace Hedge
                                     const SceneRenderInfo&      sceneRenderInfo,
                                     HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl) = 0;
 
+        // A depth only pass before the CmdRenderInsts(...). It draws into the render context's depth attachment.
+        virtual bool IsDepthPrepassSupported() { return false; }
+        virtual void CmdRenderDepthPrepass(VkCommandBuffer&            cmdBuf,
+                                           const HRenderContext* const pRenderCtx,
+                                           const SceneRenderInfo&      sceneRenderInfo,
+                                           HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl) {}
+
         /*
         void CmdTransImgLayout(VkCommandBuffer& cmdBuf,
                                HGpuImg* pGpuImg,
@@ -102,6 +123,23 @@ namespace Hedge
     private:
     };
 
+    // An instance in the per-frame instance buffer. It must match the InstanceData in the InstanceData.hlsl.
+    // The material slots are the bindless indices of the base color, normal, metallic roughness and occlusion textures.
+    struct HInstanceData
+    {
+        float    modelMat[16];
+        uint32_t materialIdx[4];
+    };
+
+    // Objects sharing the same vertex buffer, index buffer and material are drawn by one instanced draw call.
+    // The instances of a batch are consecutive in the per-frame instance buffer.
+    struct HInstanceBatch
+    {
+        uint32_t firstObjIdx;     // An object in the batch. Used to get the shared mesh and material rsrc.
+        uint32_t instanceBaseIdx; // First instance of the batch in the instance buffer.
+        uint32_t instanceCnt;
+    };
+
     // A basic one pipeline forward PBR renderer.
     // TODO: Currently, the basic renderer is specific to the PBR pipeline.
     //       In the future, we may want to make it a parent class so that PBR pipeline, cubemap rendering pipeline
@@ -118,14 +156,129 @@ namespace Hedge
                                     const SceneRenderInfo&      sceneRenderInfo,
                                     HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl) override;
 
-    private:
+        // The prepass draws the same objects as the following CmdRenderInsts(...) of the frame. The scene pass reuses
+        // its render queue and geometry bindings.
+        virtual bool IsDepthPrepassSupported() override { return true; }
+        virtual void CmdRenderDepthPrepass(VkCommandBuffer&            cmdBuf,
+                                           const HRenderContext* const pRenderCtx,
+                                           const SceneRenderInfo&      sceneRenderInfo,
+                                           HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl) override;
+
+        // Objects culled by the Hi-Z pyramid in the last frame.
+        uint32_t GetHiZCulledObjsCnt() const { return m_hiZCulledObjsCnt; }
+
+        // State changes of the last frame's draws in the sorted order and in the scene order.
+        const HRenderQueueStats& GetRenderQueueStats() const { return m_renderQueue.GetStats(); }
+
+    protected:
         std::vector<ShaderInputBinding> GenPerFrameGpuRsrcBinding(const SceneRenderInfo&      sceneRenderInfo,
+                                                                  const HRenderContext* const pRenderCtx,
                                                                   HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl);
 
-        std::vector<ShaderInputBinding> GenPerObjGpuRsrcBinding(const SceneRenderInfo&      sceneRenderInfo,
-                                                                HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl,
-                                                                uint32_t                    objIdx);
+        // Begin the dynamic rendering on the render context's color and depth attachments and set the viewport.
+        // If the draws are in secondary command buffers, the viewport has to be set in the secondary command buffers.
+        void CmdBeginSceneRendering(VkCommandBuffer&            cmdBuf,
+                                    const HRenderContext* const pRenderCtx,
+                                    const SceneRenderInfo&      sceneRenderInfo,
+                                    bool                        secondaryCmdBufContents = false);
+
+        void CmdSetViewportScissor(VkCommandBuffer& cmdBuf, const HRenderContext* const pRenderCtx);
+
+        bool IsSceneBindlessReady(const SceneRenderInfo& sceneRenderInfo);
+
+        // The HPBRFeatureBits of an object's material and the scene.
+        static uint32_t GetObjPBRFeatures(const SceneRenderInfo& sceneRenderInfo, uint32_t objIdx);
+
+        // The model matrix and the material textures' bindless slots of an object.
+        static void GenInstanceData(const SceneRenderInfo& sceneRenderInfo,
+                                    uint32_t               objIdx,
+                                    HInstanceData&         oInstanceData);
+
+        // The PBR pipeline permutation. It's created at the first request, so the permutations that no material uses
+        // are never created. The recording threads only get the permutations created before the recording.
+        PBRPipeline* GetPBRPipeline(bool bindless, bool depthEqual, uint32_t features);
+
+        // Sort the scene objects by their render keys into the m_sortedObjIdx. Without the view depth, the order only
+        // depends on the states, so it's stable when the camera moves. Objects occluded in the pHiZ are left out.
+        void BuildRenderQueue(const SceneRenderInfo& sceneRenderInfo,
+                              bool                   sortByViewDepth,
+                              const HHiZPyramid*     pHiZ = nullptr);
+
+        // Group the sorted objects by mesh and material. It fills the m_sortedObjIdx and the m_instanceBatches.
+        void BuildInstanceBatches(const SceneRenderInfo& sceneRenderInfo,
+                                  bool                   sortByViewDepth,
+                                  const HHiZPyramid*     pHiZ = nullptr);
+
+        // Add the mesh and material rsrc of an object into the frame resource control.
+        void AddObjRsrcReferControl(const SceneRenderInfo&      sceneRenderInfo,
+                                    HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl,
+                                    uint32_t                    objIdx);
+
+        bool            m_useBindless;
+        VkDescriptorSet m_bindlessDescriptorSet;
+
+        HRenderQueue m_renderQueue;
+
+        // Per frame instancing scratch data. They are kept as members so we don't reallocate them every frame.
+        std::vector<uint32_t>       m_sortedObjIdx;
+        std::vector<HInstanceBatch> m_instanceBatches;
+        uint32_t                    m_hiZCulledObjsCnt;
+
+    private:
+        // Append the material textures' bindings of an object.
+        void GenPerObjGpuRsrcBinding(const SceneRenderInfo&           sceneRenderInfo,
+                                     uint32_t                         objIdx,
+                                     std::vector<ShaderInputBinding>& oBindings);
 
         void* GenPushConstants(const SceneRenderInfo& sceneRenderInfo, uint32_t& bytesCnt);
+
+        // Draw the instance batches [begin, end) with per-batch pushed material textures. It's the fallback when the
+        // bindless isn't available. It can be called from multiple recording threads with different command buffers.
+        void CmdDrawObjsPushDescriptors(VkCommandBuffer&                       cmdBuf,
+                                        const SceneRenderInfo&                 sceneRenderInfo,
+                                        HFrameGpuRenderRsrcControl*            pFrameGpuRsrcControl,
+                                        const std::vector<ShaderInputBinding>& perFrameGpuRsrcBindings,
+                                        uint32_t                               begin,
+                                        uint32_t                               end);
+
+        // Create the view-perspective matrix UBO and the instances SSBO in the m_sortedObjIdx order.
+        // The scene pass and the depth prepass share them.
+        std::vector<ShaderInputBinding> GenGeometryGpuRsrcBinding(const SceneRenderInfo&      sceneRenderInfo,
+                                                                  HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl);
+
+        // Build the draws of the frame: The instance batches and their geometry bindings.
+        void PrepareSceneDraws(const SceneRenderInfo&      sceneRenderInfo,
+                               HFrameGpuRenderRsrcControl* pFrameGpuRsrcControl,
+                               const HHiZPyramid*          pHiZ);
+
+        // Draw the instance batches [begin, end) with the bindless textures. Only the meshes and the permutations
+        // change between the draws. It can be called from multiple recording threads with different command buffers.
+        void CmdDrawObjsBindless(VkCommandBuffer&                       cmdBuf,
+                                 const SceneRenderInfo&                 sceneRenderInfo,
+                                 HFrameGpuRenderRsrcControl*            pFrameGpuRsrcControl,
+                                 const std::vector<ShaderInputBinding>& perFrameGpuRsrcBindings,
+                                 uint32_t                               begin,
+                                 uint32_t                               end);
+
+        std::vector<HInstanceData> m_instancesData;
+
+        // The draws prepared for the frame. The scene pass reuses them after a depth prepass.
+        bool                            m_frameUseBindless;
+        bool                            m_frameDepthPrepassed;
+        uint32_t                        m_frameDrawsCnt;
+        std::vector<ShaderInputBinding> m_frameGeometryBindings;
+
+        // Create the PBR pipeline permutations of the frame's draws before the draws are recorded.
+        void CreateFramePBRPipelines(const SceneRenderInfo& sceneRenderInfo);
+
+        // Not in the m_pPipelines, so the derived renderers' pipeline indices stay the same.
+        PBRDepthPrepassPipeline* m_pDepthPrepassPipeline;
+
+        // [Bindless][Depth EQUAL tested][HPBRFeatureBits]. The full feature permutations without the depth prepass
+        // are the m_pPipelines[0] and m_pPipelines[1].
+        PBRPipeline* m_pPBRPipelines[2][2][HPBR_PERMUTATIONS_CNT];
+
+        HLightClusterBuilder m_lightClusterBuilder;
+        std::vector<float>   m_pointLightsPosRadius; // (x, y, z, radius) per point light.
     };
 }
@@ -0,0 +1,687 @@
+#include "HDynamicAabbTree.h"
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+namespace Hedge
+{
+    // ================================================================================================================
+    static HAabb AabbUnion(
+        const HAabb& a,
+        const HAabb& b)
+    {
+        HAabb res;
+        for (int i = 0; i < 3; i++)
+        {
+            res.min[i] = std::min(a.min[i], b.min[i]);
+            res.max[i] = std::max(a.max[i], b.max[i]);
+        }
+        return res;
+    }
+
+    // ================================================================================================================
+    // Surface area heuristic cost. Half of the surface area is enough to compare costs.
+    static float AabbHalfArea(
+        const HAabb& a)
+    {
+        float dx = a.max[0] - a.min[0];
+        float dy = a.max[1] - a.min[1];
+        float dz = a.max[2] - a.min[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+
+    // ================================================================================================================
+    static bool AabbContains(
+        const HAabb& outer,
+        const HAabb& inner)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if ((inner.min[i] < outer.min[i]) || (inner.max[i] > outer.max[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ================================================================================================================
+    static bool AabbOverlap(
+        const HAabb& a,
+        const HAabb& b)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if ((a.max[i] < b.min[i]) || (a.min[i] > b.max[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ================================================================================================================
+    static bool AabbSphereOverlap(
+        const HAabb& a,
+        const float* pCenter,
+        float        radius)
+    {
+        float distSq = 0.f;
+        for (int i = 0; i < 3; i++)
+        {
+            float v = std::max(a.min[i], std::min(pCenter[i], a.max[i])) - pCenter[i];
+            distSq += v * v;
+        }
+        return distSq <= radius * radius;
+    }
+
+    // ================================================================================================================
+    // Return false if the AABB is completely outside of any plane.
+    static bool AabbFrustumOverlap(
+        const HAabb& a,
+        const float* pPlanes)
+    {
+        for (int p = 0; p < 6; p++)
+        {
+            const float* pPlane = &pPlanes[p * 4];
+
+            // The corner that is the furthest along the plane normal.
+            float dist = pPlane[3];
+            for (int i = 0; i < 3; i++)
+            {
+                dist += pPlane[i] * (pPlane[i] >= 0.f ? a.max[i] : a.min[i]);
+            }
+
+            if (dist < 0.f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ================================================================================================================
+    HDynamicAabbTree::HDynamicAabbTree(
+        float fatMargin)
+        : m_root(HAABB_TREE_NULL_NODE),
+          m_freeList(HAABB_TREE_NULL_NODE),
+          m_proxiesCnt(0),
+          m_fatMargin(fatMargin)
+    {}
+
+    // ================================================================================================================
+    HDynamicAabbTree::~HDynamicAabbTree()
+    {}
+
+    // ================================================================================================================
+    void HDynamicAabbTree::Clear()
+    {
+        m_nodes.clear();
+        m_root = HAABB_TREE_NULL_NODE;
+        m_freeList = HAABB_TREE_NULL_NODE;
+        m_proxiesCnt = 0;
+    }
+
+    // ================================================================================================================
+    int32_t HDynamicAabbTree::GetHeight() const
+    {
+        return m_root == HAABB_TREE_NULL_NODE ? 0 : m_nodes[m_root].height;
+    }
+
+    // ================================================================================================================
+    uint32_t HDynamicAabbTree::AllocateNode()
+    {
+        if (m_freeList == HAABB_TREE_NULL_NODE)
+        {
+            m_nodes.push_back(Node{});
+            m_freeList = m_nodes.size() - 1;
+            m_nodes[m_freeList].parentOrNext = HAABB_TREE_NULL_NODE;
+        }
+
+        uint32_t nodeIdx = m_freeList;
+        Node& node = m_nodes[nodeIdx];
+        m_freeList = node.parentOrNext;
+
+        node.parentOrNext = HAABB_TREE_NULL_NODE;
+        node.child1 = HAABB_TREE_NULL_NODE;
+        node.child2 = HAABB_TREE_NULL_NODE;
+        node.height = 0;
+        node.userData = 0;
+
+        return nodeIdx;
+    }
+
+    // ================================================================================================================
+    void HDynamicAabbTree::FreeNode(
+        uint32_t nodeIdx)
+    {
+        m_nodes[nodeIdx].parentOrNext = m_freeList;
+        m_nodes[nodeIdx].height = -1;
+        m_freeList = nodeIdx;
+    }
+
+    // ================================================================================================================
+    uint32_t HDynamicAabbTree::InsertProxy(
+        const HAabb& aabb,
+        uint32_t     userData)
+    {
+        uint32_t proxyId = AllocateNode();
+        Node& node = m_nodes[proxyId];
+
+        node.tightAabb = aabb;
+        for (int i = 0; i < 3; i++)
+        {
+            node.aabb.min[i] = aabb.min[i] - m_fatMargin;
+            node.aabb.max[i] = aabb.max[i] + m_fatMargin;
+        }
+        node.userData = userData;
+
+        InsertLeaf(proxyId);
+        m_proxiesCnt++;
+
+        return proxyId;
+    }
+
+    // ================================================================================================================
+    void HDynamicAabbTree::RemoveProxy(
+        uint32_t proxyId)
+    {
+        assert(m_nodes[proxyId].IsLeaf() && (m_nodes[proxyId].height == 0));
+
+        RemoveLeaf(proxyId);
+        FreeNode(proxyId);
+        m_proxiesCnt--;
+    }
+
+    // ================================================================================================================
+    bool HDynamicAabbTree::MoveProxy(
+        uint32_t     proxyId,
+        const HAabb& aabb)
+    {
+        Node& node = m_nodes[proxyId];
+        node.tightAabb = aabb;
+
+        if (AabbContains(node.aabb, aabb))
+        {
+            return false;
+        }
+
+        RemoveLeaf(proxyId);
+
+        for (int i = 0; i < 3; i++)
+        {
+            m_nodes[proxyId].aabb.min[i] = aabb.min[i] - m_fatMargin;
+            m_nodes[proxyId].aabb.max[i] = aabb.max[i] + m_fatMargin;
+        }
+
+        InsertLeaf(proxyId);
+        return true;
+    }
+
+    // ================================================================================================================
+    void HDynamicAabbTree::InsertLeaf(
+        uint32_t leafIdx)
+    {
+        if (m_root == HAABB_TREE_NULL_NODE)
+        {
+            m_root = leafIdx;
+            m_nodes[m_root].parentOrNext = HAABB_TREE_NULL_NODE;
+            return;
+        }
+
+        // Find the best sibling by the surface area heuristic. Descend to the child with the lower cost until the
+        // cost of making a new parent here is lower than descending.
+        HAabb leafAabb = m_nodes[leafIdx].aabb;
+        uint32_t siblingIdx = m_root;
+        while (m_nodes[siblingIdx].IsLeaf() == false)
+        {
+            const Node& curNode = m_nodes[siblingIdx];
+            uint32_t child1 = curNode.child1;
+            uint32_t child2 = curNode.child2;
+
+            float area = AabbHalfArea(curNode.aabb);
+            float combinedArea = AabbHalfArea(AabbUnion(curNode.aabb, leafAabb));
+
+            // Cost of creating a new parent for this node and the new leaf.
+            float cost = 2.f * combinedArea;
+
+            // Minimum cost of pushing the leaf further down the tree.
+            float inheritanceCost = 2.f * (combinedArea - area);
+
+            auto descendCost = [&](uint32_t childIdx) {
+                float newArea = AabbHalfArea(AabbUnion(leafAabb, m_nodes[childIdx].aabb));
+                if (m_nodes[childIdx].IsLeaf())
+                {
+                    return newArea + inheritanceCost;
+                }
+                return (newArea - AabbHalfArea(m_nodes[childIdx].aabb)) + inheritanceCost;
+            };
+
+            float cost1 = descendCost(child1);
+            float cost2 = descendCost(child2);
+
+            if ((cost < cost1) && (cost < cost2))
+            {
+                break;
+            }
+
+            siblingIdx = cost1 < cost2 ? child1 : child2;
+        }
+
+        // Create a new parent for the sibling and the leaf.
+        uint32_t oldParentIdx = m_nodes[siblingIdx].parentOrNext;
+        uint32_t newParentIdx = AllocateNode();
+        {
+            Node& newParent = m_nodes[newParentIdx];
+            newParent.parentOrNext = oldParentIdx;
+            newParent.aabb = AabbUnion(leafAabb, m_nodes[siblingIdx].aabb);
+            newParent.height = m_nodes[siblingIdx].height + 1;
+            newParent.child1 = siblingIdx;
+            newParent.child2 = leafIdx;
+        }
+
+        if (oldParentIdx != HAABB_TREE_NULL_NODE)
+        {
+            if (m_nodes[oldParentIdx].child1 == siblingIdx)
+            {
+                m_nodes[oldParentIdx].child1 = newParentIdx;
+            }
+            else
+            {
+                m_nodes[oldParentIdx].child2 = newParentIdx;
+            }
+        }
+        else
+        {
+            m_root = newParentIdx;
+        }
+
+        m_nodes[siblingIdx].parentOrNext = newParentIdx;
+        m_nodes[leafIdx].parentOrNext = newParentIdx;
+
+        RefitAncestors(m_nodes[leafIdx].parentOrNext);
+    }
+
+    // ================================================================================================================
+    void HDynamicAabbTree::RemoveLeaf(
+        uint32_t leafIdx)
+    {
+        if (leafIdx == m_root)
+        {
+            m_root = HAABB_TREE_NULL_NODE;
+            return;
+        }
+
+        uint32_t parentIdx = m_nodes[leafIdx].parentOrNext;
+        uint32_t grandParentIdx = m_nodes[parentIdx].parentOrNext;
+        uint32_t siblingIdx = m_nodes[parentIdx].child1 == leafIdx ? m_nodes[parentIdx].child2 :
+                                                                     m_nodes[parentIdx].child1;
+
+        // The sibling takes the parent's place.
+        if (grandParentIdx != HAABB_TREE_NULL_NODE)
+        {
+            if (m_nodes[grandParentIdx].child1 == parentIdx)
+            {
+                m_nodes[grandParentIdx].child1 = siblingIdx;
+            }
+            else
+            {
+                m_nodes[grandParentIdx].child2 = siblingIdx;
+            }
+            m_nodes[siblingIdx].parentOrNext = grandParentIdx;
+            FreeNode(parentIdx);
+
+            RefitAncestors(grandParentIdx);
+        }
+        else
+        {
+            m_root = siblingIdx;
+            m_nodes[siblingIdx].parentOrNext = HAABB_TREE_NULL_NODE;
+            FreeNode(parentIdx);
+        }
+    }
+
+    // ================================================================================================================
+    void HDynamicAabbTree::RefitAncestors(
+        uint32_t nodeIdx)
+    {
+        while (nodeIdx != HAABB_TREE_NULL_NODE)
+        {
+            nodeIdx = Balance(nodeIdx);
+
+            Node& node = m_nodes[nodeIdx];
+            const Node& child1 = m_nodes[node.child1];
+            const Node& child2 = m_nodes[node.child2];
+
+            node.height = 1 + std::max(child1.height, child2.height);
+            node.aabb = AabbUnion(child1.aabb, child2.aabb);
+
+            nodeIdx = node.parentOrNext;
+        }
+    }
+
+    // ================================================================================================================
+    // A is the input node. If one child is 2 levels higher than the other, rotate that child up.
+    //
+    // In the parent(child1, child2) form, where F is the higher child of C:
+    //
+    //    A(B, C(F, G))  -->  C(A(B, G), F)
+    //
+    // If G is the higher one, G stays with C and F goes to A instead.
+    uint32_t HDynamicAabbTree::Balance(
+        uint32_t iA)
+    {
+        Node& A = m_nodes[iA];
+        if (A.IsLeaf() || (A.height < 2))
+        {
+            return iA;
+        }
+
+        uint32_t iB = A.child1;
+        uint32_t iC = A.child2;
+        int32_t balance = m_nodes[iC].height - m_nodes[iB].height;
+
+        // Rotate the higher child up. The two cases are symmetric.
+        auto rotateUp = [&](uint32_t iHigh, uint32_t iLow, bool highIsChild2) {
+            Node& H = m_nodes[iHigh];
+            uint32_t iF = H.child1;
+            uint32_t iG = H.child2;
+
+            // Swap A and H.
+            H.child1 = iA;
+            H.parentOrNext = A.parentOrNext;
+            A.parentOrNext = iHigh;
+
+            if (H.parentOrNext != HAABB_TREE_NULL_NODE)
+            {
+                if (m_nodes[H.parentOrNext].child1 == iA)
+                {
+                    m_nodes[H.parentOrNext].child1 = iHigh;
+                }
+                else
+                {
+                    m_nodes[H.parentOrNext].child2 = iHigh;
+                }
+            }
+            else
+            {
+                m_root = iHigh;
+            }
+
+            // The higher grandchild stays with H, the lower one goes to A.
+            uint32_t iKeep = iF;
+            uint32_t iMove = iG;
+            if (m_nodes[iF].height < m_nodes[iG].height)
+            {
+                iKeep = iG;
+                iMove = iF;
+            }
+
+            H.child2 = iKeep;
+            if (highIsChild2)
+            {
+                A.child2 = iMove;
+            }
+            else
+            {
+                A.child1 = iMove;
+            }
+            m_nodes[iMove].parentOrNext = iA;
+
+            A.aabb = AabbUnion(m_nodes[iLow].aabb, m_nodes[iMove].aabb);
+            A.height = 1 + std::max(m_nodes[iLow].height, m_nodes[iMove].height);
+
+            H.aabb = AabbUnion(A.aabb, m_nodes[iKeep].aabb);
+            H.height = 1 + std::max(A.height, m_nodes[iKeep].height);
+
+            return iHigh;
+        };
+
+        if (balance > 1)
+        {
+            return rotateUp(iC, iB, true);
+        }
+
+        if (balance < -1)
+        {
+            return rotateUp(iB, iC, false);
+        }
+
+        return iA;
+    }
+
+    // ================================================================================================================
+    void HDynamicAabbTree::QueryAabb(
+        const HAabb&           aabb,
+        std::vector<uint32_t>& oUserData) const
+    {
+        if (m_root == HAABB_TREE_NULL_NODE)
+        {
+            return;
+        }
+
+        uint32_t stack[HAABB_TREE_STACK_SIZE];
+        uint32_t stackCnt = 0;
+        stack[stackCnt++] = m_root;
+
+        while (stackCnt > 0)
+        {
+            const Node& node = m_nodes[stack[--stackCnt]];
+            if (AabbOverlap(node.aabb, aabb) == false)
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (AabbOverlap(node.tightAabb, aabb))
+                {
+                    oUserData.push_back(node.userData);
+                }
+            }
+            else
+            {
+                assert(stackCnt + 2 <= HAABB_TREE_STACK_SIZE);
+                stack[stackCnt++] = node.child1;
+                stack[stackCnt++] = node.child2;
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HDynamicAabbTree::QuerySphere(
+        const float*           pCenter,
+        float                  radius,
+        std::vector<uint32_t>& oUserData) const
+    {
+        if (m_root == HAABB_TREE_NULL_NODE)
+        {
+            return;
+        }
+
+        uint32_t stack[HAABB_TREE_STACK_SIZE];
+        uint32_t stackCnt = 0;
+        stack[stackCnt++] = m_root;
+
+        while (stackCnt > 0)
+        {
+            const Node& node = m_nodes[stack[--stackCnt]];
+            if (AabbSphereOverlap(node.aabb, pCenter, radius) == false)
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (AabbSphereOverlap(node.tightAabb, pCenter, radius))
+                {
+                    oUserData.push_back(node.userData);
+                }
+            }
+            else
+            {
+                assert(stackCnt + 2 <= HAABB_TREE_STACK_SIZE);
+                stack[stackCnt++] = node.child1;
+                stack[stackCnt++] = node.child2;
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HDynamicAabbTree::QueryFrustum(
+        const float*           pPlanes,
+        std::vector<uint32_t>& oUserData) const
+    {
+        if (m_root == HAABB_TREE_NULL_NODE)
+        {
+            return;
+        }
+
+        uint32_t stack[HAABB_TREE_STACK_SIZE];
+        uint32_t stackCnt = 0;
+        stack[stackCnt++] = m_root;
+
+        while (stackCnt > 0)
+        {
+            const Node& node = m_nodes[stack[--stackCnt]];
+            if (AabbFrustumOverlap(node.aabb, pPlanes) == false)
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (AabbFrustumOverlap(node.tightAabb, pPlanes))
+                {
+                    oUserData.push_back(node.userData);
+                }
+            }
+            else
+            {
+                assert(stackCnt + 2 <= HAABB_TREE_STACK_SIZE);
+                stack[stackCnt++] = node.child1;
+                stack[stackCnt++] = node.child2;
+            }
+        }
+    }
+
+    // ================================================================================================================
+    bool HDynamicAabbTree::RayAabb(
+        const HAabb& aabb,
+        const float* pOrigin,
+        const float* pInvDir,
+        float        maxT,
+        float&       oT) const
+    {
+        float tMin = 0.f;
+        float tMax = maxT;
+        for (int i = 0; i < 3; i++)
+        {
+            float t1 = (aabb.min[i] - pOrigin[i]) * pInvDir[i];
+            float t2 = (aabb.max[i] - pOrigin[i]) * pInvDir[i];
+            tMin = std::max(tMin, std::min(t1, t2));
+            tMax = std::min(tMax, std::max(t1, t2));
+        }
+
+        oT = tMin;
+        return tMin <= tMax;
+    }
+
+    // ================================================================================================================
+    void HDynamicAabbTree::QueryRay(
+        const float*           pOrigin,
+        const float*           pDir,
+        float                  maxT,
+        std::vector<uint32_t>& oUserData) const
+    {
+        if (m_root == HAABB_TREE_NULL_NODE)
+        {
+            return;
+        }
+
+        // Division by 0 gives inf, which the slab test handles.
+        float invDir[3] = { 1.f / pDir[0], 1.f / pDir[1], 1.f / pDir[2] };
+
+        uint32_t stack[HAABB_TREE_STACK_SIZE];
+        uint32_t stackCnt = 0;
+        stack[stackCnt++] = m_root;
+
+        while (stackCnt > 0)
+        {
+            const Node& node = m_nodes[stack[--stackCnt]];
+            float t = 0.f;
+            if (RayAabb(node.aabb, pOrigin, invDir, maxT, t) == false)
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (RayAabb(node.tightAabb, pOrigin, invDir, maxT, t))
+                {
+                    oUserData.push_back(node.userData);
+                }
+            }
+            else
+            {
+                assert(stackCnt + 2 <= HAABB_TREE_STACK_SIZE);
+                stack[stackCnt++] = node.child1;
+                stack[stackCnt++] = node.child2;
+            }
+        }
+    }
+
+    // ================================================================================================================
+    bool HDynamicAabbTree::RayCastClosest(
+        const float* pOrigin,
+        const float* pDir,
+        float        maxT,
+        uint32_t&    oUserData,
+        float&       oT) const
+    {
+        if (m_root == HAABB_TREE_NULL_NODE)
+        {
+            return false;
+        }
+
+        float invDir[3] = { 1.f / pDir[0], 1.f / pDir[1], 1.f / pDir[2] };
+
+        bool hit = false;
+        float closestT = maxT;
+
+        uint32_t stack[HAABB_TREE_STACK_SIZE];
+        uint32_t stackCnt = 0;
+        stack[stackCnt++] = m_root;
+
+        while (stackCnt > 0)
+        {
+            const Node& node = m_nodes[stack[--stackCnt]];
+
+            // Shrink the ray to the closest hit so far, so farther subtrees are skipped.
+            float t = 0.f;
+            if (RayAabb(node.aabb, pOrigin, invDir, closestT, t) == false)
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (RayAabb(node.tightAabb, pOrigin, invDir, closestT, t))
+                {
+                    hit = true;
+                    closestT = t;
+                    oUserData = node.userData;
+                }
+            }
+            else
+            {
+                assert(stackCnt + 2 <= HAABB_TREE_STACK_SIZE);
+                stack[stackCnt++] = node.child1;
+                stack[stackCnt++] = node.child2;
+            }
+        }
+
+        oT = closestT;
+        return hit;
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// The queries use a fixed size traversal stack, so they don't allocate and can run on multiple threads. The tree is
+// balanced, so its height is around 1.44 * log2(n) and the stack is far from full for millions of proxies.
+#define HAABB_TREE_STACK_SIZE 256
+
+namespace Hedge
+{
+    constexpr uint32_t HAABB_TREE_NULL_NODE = UINT32_MAX;
+
+    struct HAabb
+    {
+        float min[3];
+        float max[3];
+    };
+
+    // An incremental dynamic AABB tree for the scene's spatial queries. (Box2D's b2DynamicTree / Bullet's btDbvt)
+    // Leaves store a fat AABB, which is the tight AABB plus a margin, so small movements don't need to restructure the
+    // tree. Internal nodes are kept balanced by rotations, so insert, remove and queries are O(log n).
+    // Each leaf (proxy) carries a user data. The scene uses the entity handle as the user data.
+    class HDynamicAabbTree
+    {
+    public:
+        explicit HDynamicAabbTree(float fatMargin = 0.1f);
+        ~HDynamicAabbTree();
+
+        // Return a proxy id that can be used to move or remove the proxy.
+        uint32_t InsertProxy(const HAabb& aabb, uint32_t userData);
+        void RemoveProxy(uint32_t proxyId);
+
+        // Update the tight AABB of a proxy. The proxy is only re-inserted if the new AABB goes out of its fat AABB.
+        // Return true if the proxy is re-inserted.
+        bool MoveProxy(uint32_t proxyId, const HAabb& aabb);
+
+        uint32_t GetUserData(uint32_t proxyId) const { return m_nodes[proxyId].userData; }
+        const HAabb& GetFatAabb(uint32_t proxyId) const { return m_nodes[proxyId].aabb; }
+        const HAabb& GetTightAabb(uint32_t proxyId) const { return m_nodes[proxyId].tightAabb; }
+
+        uint32_t GetProxiesCnt() const { return m_proxiesCnt; }
+        int32_t GetHeight() const;
+
+        void Clear();
+
+        // Queries append the user data of the proxies whose tight AABBs pass the test into the output vector.
+        void QueryAabb(const HAabb& aabb, std::vector<uint32_t>& oUserData) const;
+        void QuerySphere(const float* pCenter, float radius, std::vector<uint32_t>& oUserData) const;
+
+        // pPlanes: 6 planes (nx, ny, nz, d) with normals pointing inside. E.g. Planes from GenFrustumPlanes(...).
+        void QueryFrustum(const float* pPlanes, std::vector<uint32_t>& oUserData) const;
+
+        // The pDir doesn't need to be normalized. Hits are in the [0, maxT] range of the origin + t * dir.
+        void QueryRay(const float* pOrigin, const float* pDir, float maxT, std::vector<uint32_t>& oUserData) const;
+
+        // Return false if nothing is hit. Otherwise, output the closest hit's user data and t.
+        bool RayCastClosest(const float* pOrigin, const float* pDir, float maxT, uint32_t& oUserData, float& oT) const;
+
+    private:
+        struct Node
+        {
+            HAabb aabb;      // Fat AABB for leaves. Union of children for internal nodes.
+            HAabb tightAabb; // Only valid for leaves.
+
+            uint32_t parentOrNext; // The next free node when the node is in the free list.
+            uint32_t child1;
+            uint32_t child2;
+            int32_t  height;       // Leaf: 0. Free: -1.
+            uint32_t userData;
+
+            bool IsLeaf() const { return child1 == HAABB_TREE_NULL_NODE; }
+        };
+
+        uint32_t AllocateNode();
+        void FreeNode(uint32_t nodeIdx);
+
+        void InsertLeaf(uint32_t leafIdx);
+        void RemoveLeaf(uint32_t leafIdx);
+
+        // Rotate the subtree if it's imbalanced. Return the new root of the subtree.
+        uint32_t Balance(uint32_t nodeIdx);
+
+        // Walk from the node to the root, refit the AABBs and heights and rebalance along the way.
+        void RefitAncestors(uint32_t nodeIdx);
+
+        // Slab test. The inverse of the ray direction is precomputed by the caller.
+        bool RayAabb(const HAabb& aabb, const float* pOrigin, const float* pInvDir, float maxT, float& oT) const;
+
+        std::vector<Node> m_nodes;
+        uint32_t          m_root;
+        uint32_t          m_freeList;
+        uint32_t          m_proxiesCnt;
+        float             m_fatMargin;
+    };
+}
@@ -0,0 +1,65 @@
+#include "HEntityPool.h"
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+namespace Hedge
+{
+    // ================================================================================================================
+    HEntityPool::HEntityPool(
+        size_t slotSize,
+        size_t slotAlign)
+        : m_slotAlign(std::max(slotAlign, alignof(void*))),
+          m_lastBlockUsedCnt(HENTITY_POOL_BLOCK_SLOTS_CNT),
+          m_pFreeList(nullptr),
+          m_usedSlotsCnt(0)
+    {
+        // A freed slot holds the free list's next pointer and every slot in a block must stay aligned.
+        m_slotSize = std::max(slotSize, sizeof(void*));
+        m_slotSize = (m_slotSize + m_slotAlign - 1) / m_slotAlign * m_slotAlign;
+    }
+
+    // ================================================================================================================
+    HEntityPool::~HEntityPool()
+    {
+        assert(m_usedSlotsCnt == 0);
+        for (void* pBlock : m_blocks)
+        {
+            ::operator delete(pBlock, std::align_val_t(m_slotAlign));
+        }
+    }
+
+    // ================================================================================================================
+    void* HEntityPool::Alloc()
+    {
+        m_usedSlotsCnt++;
+
+        if (m_pFreeList)
+        {
+            void* pSlot = m_pFreeList;
+            m_pFreeList = *static_cast<void**>(pSlot);
+            return pSlot;
+        }
+
+        if (m_lastBlockUsedCnt == HENTITY_POOL_BLOCK_SLOTS_CNT)
+        {
+            m_blocks.push_back(::operator new(m_slotSize * HENTITY_POOL_BLOCK_SLOTS_CNT, std::align_val_t(m_slotAlign)));
+            m_lastBlockUsedCnt = 0;
+        }
+
+        void* pSlot = static_cast<char*>(m_blocks.back()) + m_slotSize * m_lastBlockUsedCnt;
+        m_lastBlockUsedCnt++;
+        return pSlot;
+    }
+
+    // ================================================================================================================
+    void HEntityPool::Free(
+        void* pSlot)
+    {
+        assert(m_usedSlotsCnt > 0);
+        m_usedSlotsCnt--;
+
+        *static_cast<void**>(pSlot) = m_pFreeList;
+        m_pFreeList = pSlot;
+    }
+}
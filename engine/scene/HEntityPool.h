@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A pool grows by blocks of this many entities.
+#define HENTITY_POOL_BLOCK_SLOTS_CNT 64
+
+namespace Hedge
+{
+    // Fixed size memory slots for the entities of one class. The slots are carved out of large aligned blocks, so the
+    // entities of a class are packed together and spawning or destroying them doesn't go to the global allocator after
+    // the pool has grown. The freed slots form an intrusive free list and are reused before the untouched slots.
+    // The pool only manages memory. The owner constructs and destructs the entities in the slots.
+    class HEntityPool
+    {
+    public:
+        HEntityPool(size_t slotSize, size_t slotAlign);
+        ~HEntityPool();
+
+        HEntityPool(const HEntityPool&) = delete;
+        HEntityPool& operator=(const HEntityPool&) = delete;
+
+        void* Alloc();
+        void Free(void* pSlot);
+
+        uint32_t GetUsedSlotsCnt() const { return m_usedSlotsCnt; }
+        uint32_t GetBlocksCnt() const { return static_cast<uint32_t>(m_blocks.size()); }
+
+    private:
+        size_t m_slotSize;
+        size_t m_slotAlign;
+
+        std::vector<void*> m_blocks;
+        uint32_t           m_lastBlockUsedCnt; // The untouched slots are at the end of the last block.
+        void*              m_pFreeList;        // Each freed slot stores the next freed slot.
+        uint32_t           m_usedSlotsCnt;
+    };
+}
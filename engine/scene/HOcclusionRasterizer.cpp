@@ -0,0 +1,518 @@
+#include "HOcclusionRasterizer.h"
+#include "../util/UtilMath.h"
+#include "../core/HJobSystem.h"
+#include <algorithm>
+#include <unordered_map>
+#include <cassert>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEDGE_OCCLUSION_SSE
+#endif
+
+// Vertices closer to the camera plane than this are treated as crossing the near plane.
+#define HOCCLUSION_MIN_CLIP_W 1e-5f
+
+// Triangles smaller than this in pixels don't cover any pixel centers in practice.
+#define HOCCLUSION_MIN_TRI_AREA 1e-4f
+
+extern Hedge::HJobSystem* g_pJobSystem;
+
+namespace Hedge
+{
+    // ================================================================================================================
+    HOcclusionRasterizer::HOcclusionRasterizer()
+        : m_width(0),
+          m_height(0),
+          m_tilesX(0),
+          m_tilesY(0),
+          m_vpMat(),
+          m_bandsCnt(0)
+    {}
+
+    // ================================================================================================================
+    HOcclusionRasterizer::~HOcclusionRasterizer()
+    {
+        Cleanup();
+    }
+
+    // ================================================================================================================
+    void HOcclusionRasterizer::Init(
+        uint32_t width,
+        uint32_t height,
+        uint32_t bandsCnt)
+    {
+        assert((width % HOCCLUSION_TILE_WIDTH == 0) && (height % HOCCLUSION_TILE_HEIGHT == 0));
+
+        m_width = width;
+        m_height = height;
+        m_tilesX = width / HOCCLUSION_TILE_WIDTH;
+        m_tilesY = height / HOCCLUSION_TILE_HEIGHT;
+
+        m_tileRefDepths.resize(m_tilesX * m_tilesY);
+        m_tileWorkDepths.resize(m_tilesX * m_tilesY);
+        m_tileMasks.resize(m_tilesX * m_tilesY);
+
+        if (bandsCnt == 0)
+        {
+            bandsCnt = std::min(std::max(std::thread::hardware_concurrency(), 1u), 8u);
+        }
+
+        // A band has at least one tile row.
+        m_bandsCnt = std::min(bandsCnt, m_tilesY);
+    }
+
+    // ================================================================================================================
+    void HOcclusionRasterizer::Cleanup()
+    {
+        m_tris.clear();
+        m_tileRefDepths.clear();
+        m_tileWorkDepths.clear();
+        m_tileMasks.clear();
+        m_bandsCnt = 0;
+    }
+
+    // ================================================================================================================
+    void HOcclusionRasterizer::BeginFrame(
+        const float* pVpMat)
+    {
+        memcpy(m_vpMat, pVpMat, sizeof(m_vpMat));
+        m_tris.clear();
+
+        // Nothing occludes yet: The reference layer is on the far plane and the working layer is empty.
+        std::fill(m_tileRefDepths.begin(), m_tileRefDepths.end(), 0.f);
+        std::fill(m_tileWorkDepths.begin(), m_tileWorkDepths.end(), 1.f);
+        std::fill(m_tileMasks.begin(), m_tileMasks.end(), 0);
+    }
+
+    // ================================================================================================================
+    void HOcclusionRasterizer::AddOccluder(
+        const float*    pModelMat,
+        const float*    pVerts,
+        uint32_t        vertsCnt,
+        const uint16_t* pIdx,
+        uint32_t        idxCnt)
+    {
+        float mvpMat[16];
+        MatrixMul4x4(m_vpMat, pModelMat, mvpMat);
+
+        m_clipVerts.resize(vertsCnt * 4);
+        for (uint32_t i = 0; i < vertsCnt; i++)
+        {
+            float pos[4] = { pVerts[i * 3], pVerts[i * 3 + 1], pVerts[i * 3 + 2], 1.f };
+            MatMulVec(mvpMat, pos, 4, &m_clipVerts[i * 4]);
+        }
+
+        for (uint32_t i = 0; i + 2 < idxCnt; i += 3)
+        {
+            float x[3];
+            float y[3];
+            float z[3];
+            bool crossNear = false;
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const float* pClip = &m_clipVerts[pIdx[i + k] * 4];
+                if (pClip[3] <= HOCCLUSION_MIN_CLIP_W)
+                {
+                    crossNear = true;
+                    break;
+                }
+
+                float invW = 1.f / pClip[3];
+                x[k] = (pClip[0] * invW * 0.5f + 0.5f) * m_width;
+                y[k] = (pClip[1] * invW * 0.5f + 0.5f) * m_height;
+                z[k] = pClip[2] * invW;
+                crossNear |= (z[k] > 1.f);
+            }
+
+            if (crossNear)
+            {
+                continue;
+            }
+
+            // Both windings are rasterized. The edges face inwards after the counter-clockwise reordering.
+            float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+            if (fabsf(area) < HOCCLUSION_MIN_TRI_AREA)
+            {
+                continue;
+            }
+
+            if (area < 0.f)
+            {
+                std::swap(x[1], x[2]);
+                std::swap(y[1], y[2]);
+                std::swap(z[1], z[2]);
+                area = -area;
+            }
+
+            float minX = std::min(std::min(x[0], x[1]), x[2]);
+            float maxX = std::max(std::max(x[0], x[1]), x[2]);
+            float minY = std::min(std::min(y[0], y[1]), y[2]);
+            float maxY = std::max(std::max(y[0], y[1]), y[2]);
+            if ((maxX < 0.f) || (maxY < 0.f) || (minX >= m_width) || (minY >= m_height))
+            {
+                continue;
+            }
+
+            HOccluderTri tri{};
+            {
+                tri.tileMinX = static_cast<uint32_t>(std::max(minX, 0.f)) / HOCCLUSION_TILE_WIDTH;
+                tri.tileMaxX = static_cast<uint32_t>(std::min(maxX, m_width - 1.f)) / HOCCLUSION_TILE_WIDTH;
+                tri.tileMinY = static_cast<uint32_t>(std::max(minY, 0.f)) / HOCCLUSION_TILE_HEIGHT;
+                tri.tileMaxY = static_cast<uint32_t>(std::min(maxY, m_height - 1.f)) / HOCCLUSION_TILE_HEIGHT;
+
+                for (uint32_t e = 0; e < 3; e++)
+                {
+                    uint32_t a = e;
+                    uint32_t b = (e + 1) % 3;
+                    tri.edgeA[e] = y[a] - y[b];
+                    tri.edgeB[e] = x[b] - x[a];
+                    tri.edgeC[e] = (y[b] - y[a]) * x[a] - (x[b] - x[a]) * y[a];
+                }
+
+                float dx1 = x[1] - x[0];
+                float dy1 = y[1] - y[0];
+                float dz1 = z[1] - z[0];
+                float dx2 = x[2] - x[0];
+                float dy2 = y[2] - y[0];
+                float dz2 = z[2] - z[0];
+                tri.depthA = (dz1 * dy2 - dz2 * dy1) / area;
+                tri.depthB = (dz2 * dx1 - dz1 * dx2) / area;
+                tri.depthC = z[0] - tri.depthA * x[0] - tri.depthB * y[0];
+
+                tri.minDepth = std::min(std::min(z[0], z[1]), z[2]);
+                tri.maxDepth = std::max(std::max(z[0], z[1]), z[2]);
+            }
+
+            m_tris.push_back(tri);
+        }
+    }
+
+    // ================================================================================================================
+    void HOcclusionRasterizer::RasterizeOccluders()
+    {
+        if (m_tris.empty())
+        {
+            return;
+        }
+
+        // Front to back. Near triangles fill the reference layers first, so the far ones are rejected early.
+        std::sort(m_tris.begin(), m_tris.end(), [](const HOccluderTri& a, const HOccluderTri& b) {
+            return a.maxDepth > b.maxDepth;
+        });
+
+        g_pJobSystem->ParallelFor(m_bandsCnt, 1, [this](uint32_t begin, uint32_t end) {
+            for (uint32_t band = begin; band < end; band++)
+            {
+                RasterizeBand(m_tilesY * band / m_bandsCnt, m_tilesY * (band + 1) / m_bandsCnt);
+            }
+        });
+    }
+
+    // ================================================================================================================
+    void HOcclusionRasterizer::RasterizeBand(
+        uint32_t tileRowBegin,
+        uint32_t tileRowEnd)
+    {
+        for (const HOccluderTri& tri : m_tris)
+        {
+            uint32_t tileYBegin = std::max(tri.tileMinY, tileRowBegin);
+            uint32_t tileYEnd = std::min(tri.tileMaxY + 1, tileRowEnd);
+            for (uint32_t tileY = tileYBegin; tileY < tileYEnd; tileY++)
+            {
+                for (uint32_t tileX = tri.tileMinX; tileX <= tri.tileMaxX; tileX++)
+                {
+                    uint32_t tileIdx = tileY * m_tilesX + tileX;
+
+                    // The whole triangle is behind the tile's reference layer.
+                    if (tri.maxDepth <= m_tileRefDepths[tileIdx])
+                    {
+                        continue;
+                    }
+
+                    uint32_t coverage = CalTileCoverage(tri, tileX, tileY);
+                    if (coverage == 0)
+                    {
+                        continue;
+                    }
+
+                    // The depth plane's farthest point in the tile is on a corner. The triangle's farthest vertex
+                    // also bounds it, so the tighter one is used.
+                    float cornerX = static_cast<float>(tileX * HOCCLUSION_TILE_WIDTH +
+                                                       (tri.depthA > 0.f ? 0 : HOCCLUSION_TILE_WIDTH));
+                    float cornerY = static_cast<float>(tileY * HOCCLUSION_TILE_HEIGHT +
+                                                       (tri.depthB > 0.f ? 0 : HOCCLUSION_TILE_HEIGHT));
+                    float planeFarDepth = tri.depthA * cornerX + tri.depthB * cornerY + tri.depthC;
+
+                    UpdateTile(tileIdx, coverage, std::max(planeFarDepth, tri.minDepth));
+                }
+            }
+        }
+    }
+
+    // ================================================================================================================
+    uint32_t HOcclusionRasterizer::CalTileCoverage(
+        const HOccluderTri& tri,
+        uint32_t            tileX,
+        uint32_t            tileY) const
+    {
+        float pixelX = tileX * HOCCLUSION_TILE_WIDTH + 0.5f;
+        float pixelY = tileY * HOCCLUSION_TILE_HEIGHT + 0.5f;
+        uint32_t coverage = 0;
+
+#ifdef HEDGE_OCCLUSION_SSE
+        // A tile row is 8 pixels: Two SSE registers.
+        __m128 xLeft = _mm_add_ps(_mm_set1_ps(pixelX), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+        __m128 xRight = _mm_add_ps(xLeft, _mm_set1_ps(4.f));
+        __m128 zero = _mm_setzero_ps();
+
+        __m128 edgeLeft[3];
+        __m128 edgeRight[3];
+        for (uint32_t e = 0; e < 3; e++)
+        {
+            __m128 edgeA = _mm_set1_ps(tri.edgeA[e]);
+            edgeLeft[e] = _mm_mul_ps(edgeA, xLeft);
+            edgeRight[e] = _mm_mul_ps(edgeA, xRight);
+        }
+
+        for (uint32_t row = 0; row < HOCCLUSION_TILE_HEIGHT; row++)
+        {
+            float y = pixelY + row;
+            __m128 insideLeft = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            __m128 insideRight = insideLeft;
+            for (uint32_t e = 0; e < 3; e++)
+            {
+                __m128 rowOffset = _mm_set1_ps(tri.edgeB[e] * y + tri.edgeC[e]);
+                insideLeft = _mm_and_ps(insideLeft, _mm_cmpge_ps(_mm_add_ps(edgeLeft[e], rowOffset), zero));
+                insideRight = _mm_and_ps(insideRight, _mm_cmpge_ps(_mm_add_ps(edgeRight[e], rowOffset), zero));
+            }
+
+            uint32_t rowMask = _mm_movemask_ps(insideLeft) | (_mm_movemask_ps(insideRight) << 4);
+            coverage |= rowMask << (row * HOCCLUSION_TILE_WIDTH);
+        }
+#else
+        for (uint32_t row = 0; row < HOCCLUSION_TILE_HEIGHT; row++)
+        {
+            float y = pixelY + row;
+            for (uint32_t col = 0; col < HOCCLUSION_TILE_WIDTH; col++)
+            {
+                float x = pixelX + col;
+                bool inside = true;
+                for (uint32_t e = 0; e < 3; e++)
+                {
+                    inside &= (tri.edgeA[e] * x + tri.edgeB[e] * y + tri.edgeC[e] >= 0.f);
+                }
+
+                if (inside)
+                {
+                    coverage |= 1u << (row * HOCCLUSION_TILE_WIDTH + col);
+                }
+            }
+        }
+#endif
+
+        return coverage;
+    }
+
+    // ================================================================================================================
+    void HOcclusionRasterizer::UpdateTile(
+        uint32_t tileIdx,
+        uint32_t coverage,
+        float    triFarDepth)
+    {
+        float& refDepth = m_tileRefDepths[tileIdx];
+        float& workDepth = m_tileWorkDepths[tileIdx];
+        uint32_t& mask = m_tileMasks[tileIdx];
+
+        // If the triangle is much nearer than the working layer, merging it would push the layer's depth far away.
+        // The working layer is discarded and restarts from the triangle.
+        float distWorkTri = triFarDepth - workDepth;
+        float distRefWork = workDepth - refDepth;
+        if (distWorkTri > distRefWork)
+        {
+            workDepth = 1.f;
+            mask = 0;
+        }
+
+        workDepth = std::min(workDepth, triFarDepth);
+        mask |= coverage;
+
+        // A full working layer covers the whole tile, so it becomes the reference layer.
+        if (mask == 0xFFFFFFFF)
+        {
+            refDepth = std::max(refDepth, workDepth);
+            workDepth = 1.f;
+            mask = 0;
+        }
+    }
+
+    // ================================================================================================================
+    bool HOcclusionRasterizer::IsAabbOccluded(
+        const float* pMin,
+        const float* pMax) const
+    {
+        if (m_tris.empty())
+        {
+            return false;
+        }
+
+        float ndcMin[2] = { FLT_MAX, FLT_MAX };
+        float ndcMax[2] = { -FLT_MAX, -FLT_MAX };
+        float nearestDepth = 0.f;
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            float corner[4] = { (i & 1) ? pMax[0] : pMin[0],
+                                (i & 2) ? pMax[1] : pMin[1],
+                                (i & 4) ? pMax[2] : pMin[2],
+                                1.f };
+            float clipPos[4];
+            MatMulVec(m_vpMat, corner, 4, clipPos);
+
+            if (clipPos[3] <= HOCCLUSION_MIN_CLIP_W)
+            {
+                return false;
+            }
+
+            float invW = 1.f / clipPos[3];
+            for (uint32_t axis = 0; axis < 2; axis++)
+            {
+                ndcMin[axis] = std::min(ndcMin[axis], clipPos[axis] * invW);
+                ndcMax[axis] = std::max(ndcMax[axis], clipPos[axis] * invW);
+            }
+            nearestDepth = std::max(nearestDepth, clipPos[2] * invW);
+        }
+
+        // In front of the near plane or out of the screen. The frustum culling decides them.
+        if ((nearestDepth >= 1.f) ||
+            (ndcMax[0] < -1.f) || (ndcMin[0] > 1.f) ||
+            (ndcMax[1] < -1.f) || (ndcMin[1] > 1.f))
+        {
+            return false;
+        }
+
+        auto ndcToTile = [](float ndc, uint32_t size, uint32_t tileSize) {
+            float pixel = (std::min(std::max(ndc, -1.f), 1.f) * 0.5f + 0.5f) * size;
+            return std::min(static_cast<uint32_t>(pixel), size - 1) / tileSize;
+        };
+
+        uint32_t tileMinX = ndcToTile(ndcMin[0], m_width, HOCCLUSION_TILE_WIDTH);
+        uint32_t tileMaxX = ndcToTile(ndcMax[0], m_width, HOCCLUSION_TILE_WIDTH);
+        uint32_t tileMinY = ndcToTile(ndcMin[1], m_height, HOCCLUSION_TILE_HEIGHT);
+        uint32_t tileMaxY = ndcToTile(ndcMax[1], m_height, HOCCLUSION_TILE_HEIGHT);
+
+        // Visible if the nearest depth isn't behind any overlapped tile's reference layer.
+        for (uint32_t tileY = tileMinY; tileY <= tileMaxY; tileY++)
+        {
+            const float* pRowRefDepths = &m_tileRefDepths[tileY * m_tilesX];
+            uint32_t tileX = tileMinX;
+#ifdef HEDGE_OCCLUSION_SSE
+            __m128 nearest = _mm_set1_ps(nearestDepth);
+            for (; tileX + 3 <= tileMaxX; tileX += 4)
+            {
+                if (_mm_movemask_ps(_mm_cmpge_ps(nearest, _mm_loadu_ps(&pRowRefDepths[tileX]))) != 0)
+                {
+                    return false;
+                }
+            }
+#endif
+            // Scalar tail or the fallback without SSE.
+            for (; tileX <= tileMaxX; tileX++)
+            {
+                if (nearestDepth >= pRowRefDepths[tileX])
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // ================================================================================================================
+    void HOcclusionRasterizer::GenOccluderMesh(
+        const float*           pPos,
+        uint32_t               vertsCnt,
+        const uint16_t*        pIdx,
+        uint32_t               idxCnt,
+        uint32_t               gridRes,
+        std::vector<float>&    oVerts,
+        std::vector<uint16_t>& oIdx)
+    {
+        // The merged vertices are indexed by uint16_t.
+        assert((gridRes > 0) && (gridRes * gridRes * gridRes <= 65536));
+
+        oVerts.clear();
+        oIdx.clear();
+        if (vertsCnt == 0)
+        {
+            return;
+        }
+
+        float aabbMin[3] = { pPos[0], pPos[1], pPos[2] };
+        float aabbMax[3] = { pPos[0], pPos[1], pPos[2] };
+        for (uint32_t i = 1; i < vertsCnt; i++)
+        {
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                aabbMin[axis] = std::min(aabbMin[axis], pPos[i * 3 + axis]);
+                aabbMax[axis] = std::max(aabbMax[axis], pPos[i * 3 + axis]);
+            }
+        }
+
+        // Vertex -> Merged vertex. The merged vertices accumulate their cells' positions first.
+        std::unordered_map<uint32_t, uint16_t> cellVerts;
+        std::vector<uint16_t> vertRemap(vertsCnt);
+        std::vector<uint32_t> mergedCnts;
+        for (uint32_t i = 0; i < vertsCnt; i++)
+        {
+            uint32_t cell[3];
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                float extent = aabbMax[axis] - aabbMin[axis];
+                float t = extent > 0.f ? (pPos[i * 3 + axis] - aabbMin[axis]) / extent : 0.f;
+                cell[axis] = std::min(static_cast<uint32_t>(t * gridRes), gridRes - 1);
+            }
+
+            uint32_t cellKey = (cell[2] * gridRes + cell[1]) * gridRes + cell[0];
+            auto itr = cellVerts.find(cellKey);
+            if (itr == cellVerts.end())
+            {
+                itr = cellVerts.insert({ cellKey, static_cast<uint16_t>(mergedCnts.size()) }).first;
+                mergedCnts.push_back(0);
+                oVerts.insert(oVerts.end(), { 0.f, 0.f, 0.f });
+            }
+
+            uint16_t mergedIdx = itr->second;
+            vertRemap[i] = mergedIdx;
+            mergedCnts[mergedIdx]++;
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                oVerts[mergedIdx * 3 + axis] += pPos[i * 3 + axis];
+            }
+        }
+
+        for (uint32_t i = 0; i < mergedCnts.size(); i++)
+        {
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                oVerts[i * 3 + axis] /= mergedCnts[i];
+            }
+        }
+
+        // Triangles with merged corners become lines or points.
+        for (uint32_t i = 0; i + 2 < idxCnt; i += 3)
+        {
+            uint16_t a = vertRemap[pIdx[i]];
+            uint16_t b = vertRemap[pIdx[i + 1]];
+            uint16_t c = vertRemap[pIdx[i + 2]];
+            if ((a != b) && (b != c) && (c != a))
+            {
+                oIdx.insert(oIdx.end(), { a, b, c });
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// A tile is 8x4 pixels, so its coverage fits in a 32 bits mask. Bit (y * 8 + x) is the pixel (x, y) of the tile.
+#define HOCCLUSION_TILE_WIDTH  8
+#define HOCCLUSION_TILE_HEIGHT 4
+
+namespace Hedge
+{
+    // A CPU masked software occlusion culling rasterizer (Andersson et al. 2015, "Masked Software Occlusion Culling").
+    // Occluder triangles are rasterized at a low resolution. Instead of a depth per pixel, each tile keeps two layers:
+    // The reference layer covers the whole tile and the working layer covers the pixels in its coverage mask. Each
+    // layer keeps its farthest depth, so the tile is updated with SIMD coverage masks and without per-pixel depths.
+    // Occludees are tested by their screen rectangles and nearest depths against the tiles' reference layers.
+    //
+    // The depth is reversed like the GPU depth: 1 is on the near plane and 0 is on the far plane.
+    // The screen is split into bands of tile rows and each band is a job that rasterizes all triangles into the band,
+    // so the jobs never write the same tile. Nothing depends on the GPU.
+    class HOcclusionRasterizer
+    {
+    public:
+        HOcclusionRasterizer();
+        ~HOcclusionRasterizer();
+
+        // The width must be a multiple of 8 and the height must be a multiple of 4. 0 bandsCnt means to use the
+        // hardware concurrency.
+        void Init(uint32_t width, uint32_t height, uint32_t bandsCnt);
+        void Cleanup();
+
+        // Clear the tiles and the occluders. The view-perspective matrix is row major like the SceneRenderInfo's.
+        void BeginFrame(const float* pVpMat);
+
+        // Add the triangles of an occluder mesh. pVerts are the model space xyz positions. Triangles crossing the near
+        // plane are skipped, so they may occlude less but never wrongly.
+        void AddOccluder(const float*    pModelMat,
+                         const float*    pVerts,
+                         uint32_t        vertsCnt,
+                         const uint16_t* pIdx,
+                         uint32_t        idxCnt);
+
+        // Rasterize all added occluders' triangles into the tiles.
+        void RasterizeOccluders();
+
+        // Whether a world space AABB is behind the occluders. AABBs crossing the near plane or out of the screen are
+        // never occluded.
+        bool IsAabbOccluded(const float* pMin, const float* pMax) const;
+
+        uint32_t GetOccluderTrisCnt() const { return m_tris.size(); }
+
+        // Simplify a mesh into a low poly occluder by the vertex clustering (Rossignac and Borrel 1993): Vertices in a
+        // cell of the gridRes^3 grid over the AABB are merged into their average and collapsed triangles are removed.
+        static void GenOccluderMesh(const float*           pPos,
+                                    uint32_t               vertsCnt,
+                                    const uint16_t*        pIdx,
+                                    uint32_t               idxCnt,
+                                    uint32_t               gridRes,
+                                    std::vector<float>&    oVerts,
+                                    std::vector<uint16_t>& oIdx);
+
+    private:
+        // The triangle setup in the pixel space. Pixel centers are at (x + 0.5, y + 0.5).
+        struct HOccluderTri
+        {
+            float    edgeA[3]; // Edge i is inside where edgeA[i] * x + edgeB[i] * y + edgeC[i] >= 0.
+            float    edgeB[3];
+            float    edgeC[3];
+            float    depthA;   // Depth plane: depthA * x + depthB * y + depthC.
+            float    depthB;
+            float    depthC;
+            float    minDepth;
+            float    maxDepth;
+            uint32_t tileMinX;
+            uint32_t tileMaxX;
+            uint32_t tileMinY;
+            uint32_t tileMaxY;
+        };
+
+        // Rasterize all triangles into the tile rows [tileRowBegin, tileRowEnd).
+        void RasterizeBand(uint32_t tileRowBegin, uint32_t tileRowEnd);
+
+        uint32_t CalTileCoverage(const HOccluderTri& tri, uint32_t tileX, uint32_t tileY) const;
+
+        void UpdateTile(uint32_t tileIdx, uint32_t coverage, float triFarDepth);
+
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_tilesX;
+        uint32_t m_tilesY;
+        float    m_vpMat[16];
+
+        std::vector<HOccluderTri> m_tris;
+        std::vector<float>        m_clipVerts; // Scratch clip space positions of an occluder. 4 floats per vertex.
+
+        // Tiles in the SoA layout, so occludee tests compare 4 tiles at once.
+        std::vector<float>    m_tileRefDepths;  // Reference layer's farthest depth. The whole tile is covered.
+        std::vector<float>    m_tileWorkDepths; // Working layer's farthest depth. Only the masked pixels are covered.
+        std::vector<uint32_t> m_tileMasks;
+
+        uint32_t m_bandsCnt;
+    };
+}
@@ -1,37 +1,71 @@
 #include "HScene.h"
 #include "../core/HEntity.h"
 #include "../core/HComponent.h"
+#include "../core/HSerializer.h"
 #include "../util/UtilMath.h"
+#include "../util/Utils.h"
 #include "../core/HAssetRsrcManager.h"
 #include "../render/HBaseGuiManager.h"
+#include "../render/HPipeline.h"
+#include <algorithm>
+#include <cassert>
 
 extern Hedge::HAssetRsrcManager* g_pAssetRsrcManager;
 extern Hedge::HGpuRsrcManager* g_pGpuRsrcManager;
 extern Hedge::HBaseGuiManager* g_pGuiManager;
 
+// The CPU occlusion buffer's resolution. Occluders are big, so a coarse buffer loses little culling.
+#define OCCLUSION_BUFFER_WIDTH  256
+#define OCCLUSION_BUFFER_HEIGHT 128
+
 namespace Hedge
 {
     // ================================================================================================================
     HScene::HScene() :
-        m_pDummyBlackCubemap(nullptr)
-    {}
+        m_renderInterpolationAlpha(1.f),
+        m_isFixedStepping(false),
+        m_renderInfo{},
+        m_occlusionCullingEnabled(true),
+        m_isOcclusionRasterizerInited(false),
+        m_occlusionCulledObjsCnt(0),
+        m_isTickEntitiesSorted(true),
+        m_isTickingEntities(false)
+    {
+        // Any change of these components makes the entity's render proxy out of date.
+        m_registry.on_construct<TransformComponent>().connect<&HScene::OnTransformChanged>(*this);
+        m_registry.on_update<TransformComponent>().connect<&HScene::OnTransformChanged>(*this);
+        m_registry.on_destroy<TransformComponent>().connect<&HScene::OnTransformChanged>(*this);
+        m_registry.on_construct<StaticMeshComponent>().connect<&HScene::OnRenderComponentChanged>(*this);
+        m_registry.on_update<StaticMeshComponent>().connect<&HScene::OnRenderComponentChanged>(*this);
+        m_registry.on_destroy<StaticMeshComponent>().connect<&HScene::OnRenderComponentChanged>(*this);
+
+        RegisterSnapshotComponent<TransformComponent>();
+        RegisterSnapshotComponent<StaticMeshComponent>();
+        RegisterSnapshotComponent<CameraComponent>();
+        RegisterSnapshotComponent<PointLightComponent>();
+        RegisterSnapshotComponent<ImageBasedLightingComponent>();
+        RegisterSnapshotComponent<BackgroundCubemapComponent>();
+    }
 
     // ================================================================================================================
     HScene::~HScene()
     {
-        for (auto p : m_entitiesHashTable)
-        {
-            delete p.second;
-        }
+        // The scene is going away. No need to track the components destroyed with the registry.
+        m_registry.on_construct<TransformComponent>().disconnect<&HScene::OnTransformChanged>(*this);
+        m_registry.on_update<TransformComponent>().disconnect<&HScene::OnTransformChanged>(*this);
+        m_registry.on_destroy<TransformComponent>().disconnect<&HScene::OnTransformChanged>(*this);
+        m_registry.on_construct<StaticMeshComponent>().disconnect<&HScene::OnRenderComponentChanged>(*this);
+        m_registry.on_update<StaticMeshComponent>().disconnect<&HScene::OnRenderComponentChanged>(*this);
+        m_registry.on_destroy<StaticMeshComponent>().disconnect<&HScene::OnRenderComponentChanged>(*this);
 
-        if (m_pDummyBlackCubemap)
+        for (auto p : m_entitiesHashTable)
         {
-            g_pGpuRsrcManager->DereferGpuImg(m_pDummyBlackCubemap);
+            FreeEntity(p.second);
         }
 
-        if (m_pDummyBlack2dImg)
+        for (auto p : m_pooledClasses)
         {
-            g_pGpuRsrcManager->DereferGpuImg(m_pDummyBlack2dImg);
+            delete p.second.pPool;
         }
     }
 
@@ -40,219 +74,641 @@ namespace Hedge
         HEntity* pEntity, 
         HEventManager& eventManager)
     {
-        entt::entity newEntity = m_registry.create();
+        SpawnEntityInternal(pEntity, eventManager, entt::null);
+    }
+
+    // ================================================================================================================
+    void HScene::SpawnEntityInternal(
+        HEntity*       pEntity,
+        HEventManager& eventManager,
+        entt::entity   hint)
+    {
+        entt::entity newEntity = (hint == entt::null) ? m_registry.create() : m_registry.create(hint);
+        assert((hint == entt::null) || (newEntity == hint));
+
         uint32_t entityHandle = static_cast<uint32_t>(newEntity);
         pEntity->CreateInSceneInternal(this, entityHandle);
 
         pEntity->OnDefineEntity(eventManager);
         
-        m_entitiesHashTable.insert({ entityHandle, pEntity });
+        // Reuse the nodes of the destroyed entities, so a scene that spawns and destroys doesn't allocate them.
+        if (m_freeEntityNodes.empty())
+        {
+            m_entitiesHashTable.insert({ entityHandle, pEntity });
+        }
+        else
+        {
+            auto node = std::move(m_freeEntityNodes.back());
+            m_freeEntityNodes.pop_back();
+            node.key() = entityHandle;
+            node.mapped() = pEntity;
+            m_entitiesHashTable.insert(std::move(node));
+        }
+
+        if (m_freeNameNodes.empty())
+        {
+            m_namesEntities.insert({ crc32(pEntity->GetEntityInstName().c_str()), pEntity });
+        }
+        else
+        {
+            auto node = std::move(m_freeNameNodes.back());
+            m_freeNameNodes.pop_back();
+            node.key() = crc32(pEntity->GetEntityInstName().c_str());
+            node.mapped() = pEntity;
+            m_namesEntities.insert(std::move(node));
+        }
+
+        std::vector<HEntity*>& classEntities = m_classesEntities[pEntity->GetClassNameHash()];
+        pEntity->m_classIdx = static_cast<uint32_t>(classEntities.size());
+        classEntities.push_back(pEntity);
+
+        if (pEntity->IsPreRenderTickEnabled())
+        {
+            pEntity->m_preRenderTickIdx = static_cast<uint32_t>(m_preRenderTickEntities.size());
+            m_preRenderTickEntities.push_back(pEntity);
+            m_isTickEntitiesSorted = false;
+        }
+
+        if (pEntity->IsPostRenderTickEnabled())
+        {
+            pEntity->m_postRenderTickIdx = static_cast<uint32_t>(m_postRenderTickEntities.size());
+            m_postRenderTickEntities.push_back(pEntity);
+            m_isTickEntitiesSorted = false;
+        }
     }
 
     // ================================================================================================================
-    void HScene::CreateDummyBlackTextures()
+    HEntity* HScene::SpawnEntity(
+        uint32_t                 classNameHash,
+        const RegisterClassInfo& classInfo,
+        HEventManager&           eventManager)
     {
-        // Cubemap
+        if (m_pooledClasses.count(classNameHash) == 0)
         {
-            VkImageSubresourceRange imgSubRsrcRange{};
+            HPooledClass pooledClass{};
             {
-                imgSubRsrcRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                imgSubRsrcRange.baseArrayLayer = 0;
-                imgSubRsrcRange.layerCount = 6;
-                imgSubRsrcRange.baseMipLevel = 0;
-                imgSubRsrcRange.levelCount = 1;
+                pooledClass.pPool = new HEntityPool(classInfo.classSize, classInfo.classAlign);
+                pooledClass.pfnNewEntityInPlace = classInfo.pfnNewEntityInPlace;
             }
+            m_pooledClasses.insert({ classNameHash, pooledClass });
+        }
+
+        return SpawnPooledEntity(classNameHash, eventManager, entt::null);
+    }
+
+    // ================================================================================================================
+    HEntity* HScene::SpawnPooledEntity(
+        uint32_t       classNameHash,
+        HEventManager& eventManager,
+        entt::entity   hint)
+    {
+        const HPooledClass& pooledClass = m_pooledClasses.at(classNameHash);
+        HEntity* pEntity = pooledClass.pfnNewEntityInPlace(pooledClass.pPool->Alloc());
+        pEntity->m_pPool = pooledClass.pPool;
+        SpawnEntityInternal(pEntity, eventManager, hint);
+        return pEntity;
+    }
+
+    // ================================================================================================================
+    void HScene::SaveSnapshot(
+        HSceneSnapshot& oSnapshot)
+    {
+        assert(m_isTickingEntities == false);
+
+        // The new transforms are only in the hierarchy after the update.
+        UpdateTransforms();
 
-            VkSamplerCreateInfo samplerInfo{};
+        oSnapshot.entities.resize(m_entitiesHashTable.size());
+        oSnapshot.entitiesStates.clear();
+
+        uint32_t entityIdx = 0;
+        for (const auto& itr : m_entitiesHashTable)
+        {
+            uint32_t entityHandle = itr.first;
+            HEntity* pEntity = itr.second;
+
+            HSnapshotEntity& snapshotEntity = oSnapshot.entities[entityIdx++];
+            snapshotEntity.handle = entityHandle;
+            snapshotEntity.classNameHash = pEntity->GetClassNameHash();
+            snapshotEntity.parentHandle = m_transformHierarchy.HasNode(entityHandle) ?
+                                          m_transformHierarchy.GetParent(entityHandle) : HTRANSFORM_NO_PARENT;
+            snapshotEntity.name = pEntity->GetEntityInstName();
+
+            snapshotEntity.stateOffset = static_cast<uint32_t>(oSnapshot.entitiesStates.size());
+            pEntity->SaveSnapshotState(oSnapshot.entitiesStates);
+            snapshotEntity.stateSize = static_cast<uint32_t>(oSnapshot.entitiesStates.size()) -
+                                       snapshotEntity.stateOffset;
+        }
+
+        std::sort(oSnapshot.entities.begin(), oSnapshot.entities.end(),
+                  [](const HSnapshotEntity& a, const HSnapshotEntity& b) { return a.handle < b.handle; });
+
+        oSnapshot.componentPools.resize(m_snapshotComponents.size());
+        for (uint32_t i = 0; i < m_snapshotComponents.size(); i++)
+        {
+            m_snapshotComponents[i].pfnSave(m_registry, oSnapshot.componentPools[i]);
+        }
+
+        oSnapshot.tags.clear();
+        for (const auto& itr : m_tagsEntities)
+        {
+            for (HEntity* pEntity : itr.second)
             {
-                samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-                samplerInfo.magFilter = VK_FILTER_LINEAR;
-                samplerInfo.minFilter = VK_FILTER_LINEAR;
-                samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-                samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                samplerInfo.minLod = -1000;
-                samplerInfo.maxLod = 1000;
-                samplerInfo.maxAnisotropy = 1.0f;
+                oSnapshot.tags.push_back({ itr.first, pEntity->GetEntityHandle() });
             }
+        }
+    }
+
+    // ================================================================================================================
+    bool HScene::RestoreSnapshot(
+        const HSceneSnapshot& snapshot,
+        HEventManager&        eventManager)
+    {
+        assert(m_isTickingEntities == false);
+        assert(snapshot.componentPools.size() == m_snapshotComponents.size());
 
-            HGpuImgCreateInfo dummyBlackCubemapInfo{};
+        auto isInSnapshot = [&snapshot](uint32_t entityHandle) {
+            auto itr = std::lower_bound(snapshot.entities.begin(), snapshot.entities.end(), entityHandle,
+                                        [](const HSnapshotEntity& a, uint32_t b) { return a.handle < b; });
+            return (itr != snapshot.entities.end()) && (itr->handle == entityHandle);
+        };
+
+        // Destroy the entities spawned after the snapshot.
+        m_snapshotScratchHandles.clear();
+        for (const auto& itr : m_entitiesHashTable)
+        {
+            if (isInSnapshot(itr.first) == false)
             {
-                dummyBlackCubemapInfo.allocFlags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
-                dummyBlackCubemapInfo.hasSampler = true;
-                dummyBlackCubemapInfo.imgSubresRange = imgSubRsrcRange;
-                dummyBlackCubemapInfo.imgUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-                dummyBlackCubemapInfo.imgViewType = VK_IMAGE_VIEW_TYPE_CUBE;
-                dummyBlackCubemapInfo.samplerInfo = samplerInfo;
-                dummyBlackCubemapInfo.imgCreateFlags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-                dummyBlackCubemapInfo.imgExtent = VkExtent3D{ 1, 1, 1 };
-                dummyBlackCubemapInfo.imgFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+                m_snapshotScratchHandles.push_back(itr.first);
             }
+        }
 
-            m_pDummyBlackCubemap = g_pGpuRsrcManager->CreateGpuImage(dummyBlackCubemapInfo, "m_pDummyBlackCubemap");
+        for (uint32_t entityHandle : m_snapshotScratchHandles)
+        {
+            DestroyEntityInternal(entityHandle);
+        }
 
-            VkClearColorValue clearColorVal{ 0.f, 0.f, 0.f, 1.f };
-            g_pGpuRsrcManager->CleanColorGpuImage(m_pDummyBlackCubemap, &clearColorVal);
+        // Respawn the destroyed entities at their old handles, so the handles kept by the gameplay stay valid. Their
+        // default components are overwritten below.
+        bool isComplete = true;
+        for (const HSnapshotEntity& snapshotEntity : snapshot.entities)
+        {
+            if (m_entitiesHashTable.count(snapshotEntity.handle) != 0)
+            {
+                continue;
+            }
 
-            g_pGpuRsrcManager->TransImageLayout(m_pDummyBlackCubemap, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            if (m_pooledClasses.count(snapshotEntity.classNameHash) == 0)
+            {
+                // A new-ed entity cannot be constructed again. Its handle stays invalid, so its components are skipped.
+                isComplete = false;
+                continue;
+            }
+
+            entt::entity hint = static_cast<entt::entity>(snapshotEntity.handle);
+            SpawnPooledEntity(snapshotEntity.classNameHash, eventManager, hint);
         }
 
-        // 2D black texture
+        for (uint32_t i = 0; i < m_snapshotComponents.size(); i++)
         {
-            VkImageSubresourceRange imgSubRsrcRange{};
+            m_snapshotComponents[i].pfnRestore(m_registry, snapshot.componentPools[i], m_snapshotScratchEntities);
+        }
+
+        // The respawned transforms need their nodes before their parents are set.
+        UpdateTransforms();
+
+        for (const HSnapshotEntity& snapshotEntity : snapshot.entities)
+        {
+            auto entityItr = m_entitiesHashTable.find(snapshotEntity.handle);
+            if (entityItr == m_entitiesHashTable.end())
             {
-                imgSubRsrcRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                imgSubRsrcRange.baseArrayLayer = 0;
-                imgSubRsrcRange.layerCount = 1;
-                imgSubRsrcRange.baseMipLevel = 0;
-                imgSubRsrcRange.levelCount = 1;
+                continue;
             }
 
-            VkSamplerCreateInfo samplerInfo{};
+            HEntity* pEntity = entityItr->second;
+            if (pEntity->GetEntityInstName() != snapshotEntity.name)
             {
-                samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-                samplerInfo.magFilter = VK_FILTER_LINEAR;
-                samplerInfo.minFilter = VK_FILTER_LINEAR;
-                samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-                samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                samplerInfo.minLod = -1000;
-                samplerInfo.maxLod = 1000;
-                samplerInfo.maxAnisotropy = 1.0f;
+                pEntity->SetEntityInstName(snapshotEntity.name);
             }
 
-            HGpuImgCreateInfo dummyBlack2dInfo{};
+            uint32_t entityHandle = snapshotEntity.handle;
+            if (m_transformHierarchy.HasNode(entityHandle) &&
+                (m_transformHierarchy.GetParent(entityHandle) != snapshotEntity.parentHandle))
             {
-                dummyBlack2dInfo.allocFlags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
-                dummyBlack2dInfo.hasSampler = true;
-                dummyBlack2dInfo.imgSubresRange = imgSubRsrcRange;
-                dummyBlack2dInfo.imgUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-                dummyBlack2dInfo.imgViewType = VK_IMAGE_VIEW_TYPE_2D;
-                dummyBlack2dInfo.samplerInfo = samplerInfo;
-                dummyBlack2dInfo.imgExtent = VkExtent3D{ 1, 1, 1 };
-                dummyBlack2dInfo.imgFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+                m_transformHierarchy.SetParent(entityHandle, snapshotEntity.parentHandle);
             }
 
-            m_pDummyBlack2dImg = g_pGpuRsrcManager->CreateGpuImage(dummyBlack2dInfo, "m_pDummyBlack2dImg");
+            pEntity->RestoreSnapshotState(snapshot.entitiesStates.data() + snapshotEntity.stateOffset,
+                                          snapshotEntity.stateSize);
+        }
 
-            VkClearColorValue clearColorVal{ 0.f, 0.f, 0.f, 1.f };
-            g_pGpuRsrcManager->CleanColorGpuImage(m_pDummyBlack2dImg, &clearColorVal);
+        for (auto& itr : m_tagsEntities)
+        {
+            itr.second.clear();
+        }
+
+        for (auto& itr : m_entitiesHashTable)
+        {
+            itr.second->m_tagsIdx.clear();
+        }
 
-            g_pGpuRsrcManager->TransImageLayout(m_pDummyBlack2dImg, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        for (const auto& tag : snapshot.tags)
+        {
+            auto entityItr = m_entitiesHashTable.find(tag.second);
+            if (entityItr != m_entitiesHashTable.end())
+            {
+                AddEntityTagInternal(entityItr->second, tag.first);
+            }
         }
+
+        // The restored transforms jump. They don't blend from the states that are rolled back.
+        ClearInterpolatedEntities();
+
+        return isComplete;
     }
 
     // ================================================================================================================
-    SceneRenderInfo HScene::GetSceneRenderInfo()
+    void HScene::DestroyEntity(
+        uint32_t entityHandle)
     {
-        SceneRenderInfo renderInfo{};
+        if (m_isTickingEntities)
+        {
+            m_destroyedEntities.push_back(entityHandle);
+        }
+        else
+        {
+            DestroyEntityInternal(entityHandle);
+        }
+    }
 
-        auto staticMeshView = m_registry.view<StaticMeshComponent>();
-        
-        for (auto entity : staticMeshView)
+    // ================================================================================================================
+    void HScene::DestroyEntityInternal(
+        uint32_t entityHandle)
+    {
+        auto entityItr = m_entitiesHashTable.find(entityHandle);
+        if (entityItr == m_entitiesHashTable.end())
         {
-            auto& meshComponent = staticMeshView.get<StaticMeshComponent>(entity);
-            auto& transComponent = m_registry.get<TransformComponent>(entity);
+            // It can be destroyed twice in the ticks.
+            return;
+        }
 
-            HStaticMeshAsset* pStaticMeshAsset = nullptr;
-            g_pAssetRsrcManager->GetAssetPtr(meshComponent.m_meshAssetGuid, (HAsset**)&pStaticMeshAsset);
+        HEntity* pEntity = entityItr->second;
+        m_freeEntityNodes.push_back(m_entitiesHashTable.extract(entityItr));
 
-            renderInfo.objsIdxBuffers.push_back(pStaticMeshAsset->GetIdxGpuBuffer(0));
-            renderInfo.idxCounts.push_back(pStaticMeshAsset->GetIdxCnt(0));
+        auto range = m_namesEntities.equal_range(crc32(pEntity->GetEntityInstName().c_str()));
+        for (auto itr = range.first; itr != range.second; itr++)
+        {
+            if (itr->second == pEntity)
+            {
+                m_freeNameNodes.push_back(m_namesEntities.extract(itr));
+                break;
+            }
+        }
 
-            renderInfo.objsVertBuffers.push_back(pStaticMeshAsset->GetVertGpuBuffer(0));
-            renderInfo.vertCounts.push_back(pStaticMeshAsset->GetVertCnt(0));
+        // The entity knows its places in the lists. The last entity of a list moves into its place.
+        std::vector<HEntity*>& classEntities = m_classesEntities[pEntity->GetClassNameHash()];
+        classEntities[pEntity->m_classIdx] = classEntities.back();
+        classEntities[pEntity->m_classIdx]->m_classIdx = pEntity->m_classIdx;
+        classEntities.pop_back();
 
-            HMaterialAsset* pMaterialAsset = nullptr;
-            g_pAssetRsrcManager->GetAssetPtr(pStaticMeshAsset->GetMaterialGUID(0), (HAsset**)&pMaterialAsset);
-            
-            HTextureAsset* pBaseColorTextureAsset = nullptr;
-            g_pAssetRsrcManager->GetAssetPtr(pMaterialAsset->GetBaseColorTextureGUID(), (HAsset**)&pBaseColorTextureAsset);
-            renderInfo.modelBaseColors.push_back(pBaseColorTextureAsset->GetGpuImgPtr());
+        while (pEntity->m_tagsIdx.empty() == false)
+        {
+            RemoveEntityTagInternal(pEntity, pEntity->m_tagsIdx.back().first);
+        }
 
-            HTextureAsset* pNormalMapAsset = nullptr;
-            g_pAssetRsrcManager->GetAssetPtr(pMaterialAsset->GetNormalMapGUID(), (HAsset**)&pNormalMapAsset);
-            renderInfo.modelNormalTexs.push_back(pNormalMapAsset->GetGpuImgPtr());
+        // The moved tick entities break the classes' order. They are sorted again before the next ticks.
+        if (pEntity->m_preRenderTickIdx != UINT32_MAX)
+        {
+            m_preRenderTickEntities[pEntity->m_preRenderTickIdx] = m_preRenderTickEntities.back();
+            m_preRenderTickEntities[pEntity->m_preRenderTickIdx]->m_preRenderTickIdx = pEntity->m_preRenderTickIdx;
+            m_preRenderTickEntities.pop_back();
+            m_isTickEntitiesSorted = false;
+        }
 
-            HTextureAsset* pMetallicRoughnessTextureAsset = nullptr;
-            g_pAssetRsrcManager->GetAssetPtr(pMaterialAsset->GetMetallicRoughnessGUID(), (HAsset**)&pMetallicRoughnessTextureAsset);
-            renderInfo.modelMetallicRoughnessTexs.push_back(pMetallicRoughnessTextureAsset->GetGpuImgPtr());
+        if (pEntity->m_postRenderTickIdx != UINT32_MAX)
+        {
+            m_postRenderTickEntities[pEntity->m_postRenderTickIdx] = m_postRenderTickEntities.back();
+            m_postRenderTickEntities[pEntity->m_postRenderTickIdx]->m_postRenderTickIdx = pEntity->m_postRenderTickIdx;
+            m_postRenderTickEntities.pop_back();
+            m_isTickEntitiesSorted = false;
+        }
 
-            HTextureAsset* pOcclusionAsset = nullptr;
-            g_pAssetRsrcManager->GetAssetPtr(pMaterialAsset->GetOcclusionGUID(), (HAsset**)&pOcclusionAsset);
-            renderInfo.modelOcclusionTexs.push_back(pOcclusionAsset->GetGpuImgPtr());
+        // An entity respawned at this handle (E.g. by the RestoreSnapshot(...)) must not inherit the node's links. So,
+        // the node is removed now instead of by the next transforms' update.
+        if (m_transformHierarchy.HasNode(entityHandle))
+        {
+            m_transformHierarchy.RemoveNode(entityHandle);
+        }
 
-            HMat4x4 modelMat{};
-            GenModelMat(transComponent.m_pos,
-                        transComponent.m_rot[2],
-                        transComponent.m_rot[0],
-                        transComponent.m_rot[1],
-                        transComponent.m_scale,
-                        modelMat.eles);
-            renderInfo.modelMats.push_back(modelMat);
+        // The components' destroy signals take the entity out of the transforms and the render proxies.
+        m_registry.destroy(static_cast<entt::entity>(entityHandle));
+
+        FreeEntity(pEntity);
+    }
+
+    // ================================================================================================================
+    void HScene::FreeEntity(
+        HEntity* pEntity)
+    {
+        HEntityPool* pPool = pEntity->m_pPool;
+        if (pPool == nullptr)
+        {
+            delete pEntity;
+            return;
+        }
+
+        pEntity->~HEntity();
+        pPool->Free(pEntity);
+    }
+
+    // ================================================================================================================
+    void HScene::FlushDestroyedEntities()
+    {
+        for (uint32_t entityHandle : m_destroyedEntities)
+        {
+            DestroyEntityInternal(entityHandle);
         }
+        m_destroyedEntities.clear();
+    }
+
+    // ================================================================================================================
+    bool HScene::GenCameraRenderInfo(
+        SceneRenderInfo& renderInfo)
+    {
+        bool hasCamera = false;
 
         // TODO: Need to have an active camera check.
         auto cameraEntityView = m_registry.view<CameraComponent>();
         for (auto entity : cameraEntityView)
         {
             auto& camComponent = cameraEntityView.get<CameraComponent>(entity);
-            auto& transComponent = m_registry.get<TransformComponent>(entity);
 
             // Update active camera's aspect ratio
             camComponent.m_aspect = (float)g_pGuiManager->GetRenderExtent().width / (float)g_pGuiManager->GetRenderExtent().height;
 
+            // An attached camera follows its parent's world position and orientation.
+            float camPos[3] = {};
+            float camView[3] = {};
+            float camUp[3] = {};
+            GenCameraWorldFrame(static_cast<uint32_t>(entity), camComponent, camPos, camView, camUp);
+
             float viewMat[16] = {};
             float persMat[16] = {};
-            GenViewMat(camComponent.m_view, transComponent.m_pos, camComponent.m_up, viewMat);
+            GenViewMat(camView, camPos, camUp, viewMat);
             GenPerspectiveProjMat(camComponent.m_near, camComponent.m_far, camComponent.m_fov, camComponent.m_aspect, persMat);
             MatrixMul4x4(persMat, viewMat, renderInfo.vpMat.eles);
 
-            camComponent.GetRight(renderInfo.cameraInfo.right);
+            CrossProductVec3(camView, camUp, renderInfo.cameraInfo.right);
+            NormalizeVec(renderInfo.cameraInfo.right, 3);
             camComponent.GetNearPlane(renderInfo.cameraInfo.nearWidthHeight[0],
                                       renderInfo.cameraInfo.nearWidthHeight[1],
                                       renderInfo.cameraInfo.nearPlane);
 
-            memcpy(renderInfo.cameraPos, transComponent.m_pos, sizeof(float) * 3);
-            memcpy(renderInfo.cameraInfo.view, camComponent.m_view, sizeof(float) * 3);
-            memcpy(renderInfo.cameraInfo.up, camComponent.m_up, sizeof(float) * 3);
+            memcpy(renderInfo.cameraPos, camPos, sizeof(float) * 3);
+            memcpy(renderInfo.cameraInfo.view, camView, sizeof(float) * 3);
+            memcpy(renderInfo.cameraInfo.up, camUp, sizeof(float) * 3);
             renderInfo.cameraInfo.viewportWidthHeight[0] = (float)g_pGuiManager->GetRenderExtent().width;
             renderInfo.cameraInfo.viewportWidthHeight[1] = (float)g_pGuiManager->GetRenderExtent().height;
+            renderInfo.cameraFarPlane = camComponent.m_far;
+
+            hasCamera = true;
+        }
+
+        return hasCamera;
+    }
+
+    // ================================================================================================================
+    void HScene::GenCameraWorldFrame(
+        uint32_t               entityHandle,
+        const CameraComponent& camComponent,
+        float*                 oPos,
+        float*                 oView,
+        float*                 oUp)
+    {
+        const float* pWorldMat = m_transformHierarchy.GetWorldMat(entityHandle);
+        oPos[0] = pWorldMat[3];
+        oPos[1] = pWorldMat[7];
+        oPos[2] = pWorldMat[11];
+
+        memcpy(oView, camComponent.m_view, sizeof(float) * 3);
+        memcpy(oUp, camComponent.m_up, sizeof(float) * 3);
+
+        uint32_t parentHandle = m_transformHierarchy.GetParent(entityHandle);
+        if (parentHandle != HTRANSFORM_NO_PARENT)
+        {
+            const float* pParentMat = m_transformHierarchy.GetWorldMat(parentHandle);
+            for (uint32_t i = 0; i < 3; i++)
+            {
+                oView[i] = DotProduct(&pParentMat[4 * i], camComponent.m_view, 3);
+                oUp[i] = DotProduct(&pParentMat[4 * i], camComponent.m_up, 3);
+            }
+            NormalizeVec(oView, 3);
+            NormalizeVec(oUp, 3);
+        }
+    }
+
+    // ================================================================================================================
+    void HScene::CullStaticMeshes(
+        const SceneRenderInfo& renderInfo,
+        bool                   hasCamera)
+    {
+        // The world space bounding spheres are already in the SoA arrays for the SIMD test.
+        uint32_t objsCnt = m_cullEntities.size();
+        m_cullVisible.resize(objsCnt);
+
+        if (hasCamera)
+        {
+            float frustumPlanes[24] = {};
+            GenFrustumPlanes(renderInfo.vpMat.eles, frustumPlanes);
+            FrustumCullSpheres(frustumPlanes,
+                               m_cullSphereX.data(),
+                               m_cullSphereY.data(),
+                               m_cullSphereZ.data(),
+                               m_cullSphereR.data(),
+                               objsCnt,
+                               m_cullVisible.data());
+
+            m_occlusionCulledObjsCnt = 0;
+            if (m_occlusionCullingEnabled)
+            {
+                OcclusionCullStaticMeshes(renderInfo);
+            }
+        }
+        else
+        {
+            // Without a camera, we don't know the frustum. Keep everything as before.
+            memset(m_cullVisible.data(), 1, objsCnt);
+        }
+    }
+
+    // ================================================================================================================
+    void HScene::OcclusionCullStaticMeshes(
+        const SceneRenderInfo& renderInfo)
+    {
+        bool hasOccluders = false;
+
+        // Occluders out of the frustum cover nothing on the screen.
+        for (uint32_t i = 0; i < m_cullEntities.size(); i++)
+        {
+            const HStaticMeshRenderProxy& proxy = m_renderProxies[i];
+            if ((m_cullVisible[i] == 0) || (proxy.isOccluder == false))
+            {
+                continue;
+            }
+
+            // Scenes without occluders don't pay for the occlusion buffer.
+            if (hasOccluders == false)
+            {
+                if (m_isOcclusionRasterizerInited == false)
+                {
+                    m_occlusionRasterizer.Init(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT, 0);
+                    m_isOcclusionRasterizerInited = true;
+                }
+                m_occlusionRasterizer.BeginFrame(renderInfo.vpMat.eles);
+                hasOccluders = true;
+            }
+
+            const std::vector<float>& occluderVerts = proxy.pMeshAsset->GetOccluderVerts(0);
+            const std::vector<uint16_t>& occluderIdx = proxy.pMeshAsset->GetOccluderIdx(0);
+            m_occlusionRasterizer.AddOccluder(m_cullModelMats[i].eles,
+                                              occluderVerts.data(),
+                                              occluderVerts.size() / 3,
+                                              occluderIdx.data(),
+                                              occluderIdx.size());
+        }
+
+        if ((hasOccluders == false) || (m_occlusionRasterizer.GetOccluderTrisCnt() == 0))
+        {
+            return;
+        }
+
+        m_occlusionRasterizer.RasterizeOccluders();
+
+        // Occluders are not tested, so they don't hide themselves.
+        for (uint32_t i = 0; i < m_cullEntities.size(); i++)
+        {
+            const HStaticMeshRenderProxy& proxy = m_renderProxies[i];
+            if ((m_cullVisible[i] == 0) || proxy.isOccluder)
+            {
+                continue;
+            }
+
+            float worldMin[3] = {};
+            float worldMax[3] = {};
+            TransformAabb(m_cullModelMats[i].eles,
+                          proxy.pMeshAsset->GetAabbMin(0),
+                          proxy.pMeshAsset->GetAabbMax(0),
+                          worldMin,
+                          worldMax);
+
+            if (m_occlusionRasterizer.IsAabbOccluded(worldMin, worldMax))
+            {
+                m_cullVisible[i] = 0;
+                m_occlusionCulledObjsCnt++;
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HScene::ClearRenderInfo()
+    {
+        SceneRenderInfo& renderInfo = m_renderInfo;
+
+        renderInfo.objsIdxBuffers.clear();
+        renderInfo.idxCounts.clear();
+        renderInfo.objsVertBuffers.clear();
+        renderInfo.vertCounts.clear();
+        renderInfo.objsMaterialsGuid.clear();
+        renderInfo.objsBoundingSpheres.clear();
+        renderInfo.modelMats.clear();
+        renderInfo.modelBaseColors.clear();
+        renderInfo.modelNormalTexs.clear();
+        renderInfo.modelMetallicRoughnessTexs.clear();
+        renderInfo.modelOcclusionTexs.clear();
+        renderInfo.objsPBRFeatures.clear();
+        renderInfo.pointLightsPositions.clear();
+        renderInfo.pointLightsRadiances.clear();
+        renderInfo.pointLightsRadii.clear();
+
+        renderInfo.hasIbl = false;
+        renderInfo.diffuseCubemapGpuImg = nullptr;
+        renderInfo.prefilterEnvCubemapGpuImg = nullptr;
+        renderInfo.envBrdfGpuImg = nullptr;
+        renderInfo.iblMaxMipLevels = 0.f;
+
+        renderInfo.vpMat = HMat4x4{};
+        memset(renderInfo.cameraPos, 0, sizeof(renderInfo.cameraPos));
+        renderInfo.cameraInfo = CameraInfo{};
+        renderInfo.cameraFarPlane = 0.f;
+
+        renderInfo.skyboxCubemapGpuImg = nullptr;
+    }
+
+    // ================================================================================================================
+    const SceneRenderInfo& HScene::GetSceneRenderInfo()
+    {
+        // Components accessed after the PreRenderTick(...).
+        UpdateRenderProxies();
+        InterpolateRenderProxies();
+
+        ClearRenderInfo();
+        SceneRenderInfo& renderInfo = m_renderInfo;
+
+        bool hasCamera = GenCameraRenderInfo(renderInfo);
+        CullStaticMeshes(renderInfo, hasCamera);
+
+        // Only the visible static meshes go into the render info, so culled objects cost nothing in the renderers.
+        for (uint32_t i = 0; i < m_cullEntities.size(); i++)
+        {
+            if (m_cullVisible[i] == 0)
+            {
+                continue;
+            }
+
+            const HStaticMeshRenderProxy& proxy = m_renderProxies[i];
+
+            renderInfo.objsIdxBuffers.push_back(proxy.pIdxBuffer);
+            renderInfo.idxCounts.push_back(proxy.idxCnt);
+
+            renderInfo.objsVertBuffers.push_back(proxy.pVertBuffer);
+            renderInfo.vertCounts.push_back(proxy.vertCnt);
+
+            renderInfo.objsMaterialsGuid.push_back(proxy.materialGuid);
+            renderInfo.objsBoundingSpheres.push_back(proxy.boundingSphere);
+
+            renderInfo.modelBaseColors.push_back(proxy.pBaseColor);
+            renderInfo.modelNormalTexs.push_back(proxy.pNormalTex);
+            renderInfo.modelMetallicRoughnessTexs.push_back(proxy.pMetallicRoughnessTex);
+            renderInfo.modelOcclusionTexs.push_back(proxy.pOcclusionTex);
+            renderInfo.objsPBRFeatures.push_back(proxy.pbrFeatures);
+
+            renderInfo.modelMats.push_back(m_cullModelMats[i]);
         }
 
+        // The lights can be children of moving entities, so their positions are the translations of their world
+        // matrices. The UpdateRenderProxies() updated the transforms above.
         auto pointLightsView = m_registry.view<PointLightComponent>();
         for (auto entity : pointLightsView)
         {
             auto& pointLightComponent = pointLightsView.get<PointLightComponent>(entity);
-            auto& transComponent = m_registry.get<TransformComponent>(entity);
+            const float* pWorldMat = m_transformHierarchy.GetWorldMat(static_cast<uint32_t>(entity));
 
             HVec3 pos;
-            memcpy(&pos, transComponent.m_pos, sizeof(transComponent.m_pos));
+            pos.eles[0] = pWorldMat[3];
+            pos.eles[1] = pWorldMat[7];
+            pos.eles[2] = pWorldMat[11];
 
             HVec3 radiance;
             memcpy(&radiance, pointLightComponent.m_color, sizeof(pointLightComponent.m_color));
 
             renderInfo.pointLightsPositions.push_back(pos);
             renderInfo.pointLightsRadiances.push_back(radiance);
+            renderInfo.pointLightsRadii.push_back(pointLightComponent.m_radius);
         }
 
-        // Check whether the scene has IBL. If we don't have, then we need to use black texture asset to init IBL
-        // textures
+        // Check whether the scene has IBL. If we don't have, the renderers use the shader permutations without IBL.
         auto iblEntityView = m_registry.view<ImageBasedLightingComponent>();
-        if (iblEntityView.empty())
-        {
-            if ((m_pDummyBlackCubemap == nullptr) || (m_pDummyBlack2dImg == nullptr))
-            {
-                CreateDummyBlackTextures();
-            }
-
-            renderInfo.diffuseCubemapGpuImg = m_pDummyBlackCubemap;
-            renderInfo.prefilterEnvCubemapGpuImg = m_pDummyBlackCubemap;
-            renderInfo.envBrdfGpuImg = m_pDummyBlack2dImg;
-        }
-        else
+        if (!iblEntityView.empty())
         {
             auto iblEntity = iblEntityView.front();
             auto& iblComponent = iblEntityView.get<ImageBasedLightingComponent>(iblEntity);
@@ -264,6 +720,7 @@ namespace Hedge
             renderInfo.prefilterEnvCubemapGpuImg = pIBLAsset->GetPrefilterEnvCubemap();
             renderInfo.envBrdfGpuImg = pIBLAsset->GetEnvBrdfTex();
             renderInfo.iblMaxMipLevels = pIBLAsset->GetIblMaxMipLevels();
+            renderInfo.hasIbl = true;
         }
 
         // Check whether the scene has skybox. If we don't have, we will just let it empty.
@@ -277,13 +734,141 @@ namespace Hedge
             renderInfo.skyboxCubemapGpuImg = pSkyboxCubemapAsset->GetGpuImgPtr();
         }
         
-        return renderInfo;
+        return m_renderInfo;
+    }
+
+    // ================================================================================================================
+    HEntity* HScene::FindEntityByName(
+        const char* pName) const
+    {
+        auto range = m_namesEntities.equal_range(crc32(pName));
+        for (auto itr = range.first; itr != range.second; itr++)
+        {
+            if (itr->second->GetEntityInstName() == pName)
+            {
+                return itr->second;
+            }
+        }
+        return nullptr;
+    }
+
+    // ================================================================================================================
+    const std::vector<HEntity*>& HScene::GetEntitiesByClass(
+        uint32_t classNameHash) const
+    {
+        static const std::vector<HEntity*> noEntities;
+        auto itr = m_classesEntities.find(classNameHash);
+        return (itr != m_classesEntities.end()) ? itr->second : noEntities;
+    }
+
+    // ================================================================================================================
+    const std::vector<HEntity*>& HScene::GetEntitiesByTag(
+        uint32_t tagHash) const
+    {
+        static const std::vector<HEntity*> noEntities;
+        auto itr = m_tagsEntities.find(tagHash);
+        return (itr != m_tagsEntities.end()) ? itr->second : noEntities;
+    }
+
+    // ================================================================================================================
+    void HScene::AddEntityTag(
+        uint32_t entityHandle,
+        uint32_t tagHash)
+    {
+        HEntity* pEntity = m_entitiesHashTable.at(entityHandle);
+        if (EntityHasTag(entityHandle, tagHash) == false)
+        {
+            AddEntityTagInternal(pEntity, tagHash);
+        }
+    }
+
+    // ================================================================================================================
+    void HScene::AddEntityTagInternal(
+        HEntity* pEntity,
+        uint32_t tagHash)
+    {
+        std::vector<HEntity*>& entities = m_tagsEntities[tagHash];
+        pEntity->m_tagsIdx.push_back({ tagHash, static_cast<uint32_t>(entities.size()) });
+        entities.push_back(pEntity);
+    }
+
+    // ================================================================================================================
+    void HScene::RemoveEntityTag(
+        uint32_t entityHandle,
+        uint32_t tagHash)
+    {
+        RemoveEntityTagInternal(m_entitiesHashTable.at(entityHandle), tagHash);
+    }
+
+    // ================================================================================================================
+    void HScene::RemoveEntityTagInternal(
+        HEntity* pEntity,
+        uint32_t tagHash)
+    {
+        auto isTag = [tagHash](const std::pair<uint32_t, uint32_t>& tagIdx) { return tagIdx.first == tagHash; };
+        auto tagIdxItr = std::find_if(pEntity->m_tagsIdx.begin(), pEntity->m_tagsIdx.end(), isTag);
+        if (tagIdxItr == pEntity->m_tagsIdx.end())
+        {
+            return;
+        }
+
+        // The order of a tag's entities doesn't matter. The last one moves into the removed place.
+        uint32_t idx = tagIdxItr->second;
+        *tagIdxItr = pEntity->m_tagsIdx.back();
+        pEntity->m_tagsIdx.pop_back();
+
+        std::vector<HEntity*>& entities = m_tagsEntities.at(tagHash);
+        HEntity* pMoved = entities.back();
+        entities[idx] = pMoved;
+        entities.pop_back();
+
+        if (pMoved != pEntity)
+        {
+            std::find_if(pMoved->m_tagsIdx.begin(), pMoved->m_tagsIdx.end(), isTag)->second = idx;
+        }
+    }
+
+    // ================================================================================================================
+    bool HScene::EntityHasTag(
+        uint32_t entityHandle,
+        uint32_t tagHash) const
+    {
+        // An entity only has a few tags, so its own list is searched instead of the tag's entities.
+        const HEntity* pEntity = m_entitiesHashTable.at(entityHandle);
+        for (const auto& tagIdx : pEntity->m_tagsIdx)
+        {
+            if (tagIdx.first == tagHash)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // ================================================================================================================
+    void HScene::OnEntityRenamed(
+        HEntity*           pEntity,
+        const std::string& oldName)
+    {
+        auto range = m_namesEntities.equal_range(crc32(oldName.c_str()));
+        for (auto itr = range.first; itr != range.second; itr++)
+        {
+            if (itr->second == pEntity)
+            {
+                // Move the node to the new name's hash instead of allocating a new one.
+                auto node = m_namesEntities.extract(itr);
+                node.key() = crc32(pEntity->GetEntityInstName().c_str());
+                m_namesEntities.insert(std::move(node));
+                break;
+            }
+        }
     }
 
     // ================================================================================================================
     void HScene::GetAllEntitiesNamesHashes(
         std::vector<std::pair<std::string, uint32_t>>& entities)
     {
+        entities.reserve(entities.size() + m_entitiesHashTable.size());
         for (const auto& itr : m_entitiesHashTable)
         {
             entities.push_back({itr.second->GetEntityInstName(), itr.first});
@@ -293,18 +878,450 @@ namespace Hedge
     // ================================================================================================================
     void HScene::PreRenderTick(double deltaSec)
     {
-        for (auto& itr : m_entitiesHashTable)
+        // Variable steps render the latest transforms.
+        if ((m_isFixedStepping == false) && (m_interpolatedEntities.empty() == false))
+        {
+            ClearInterpolatedEntities();
+        }
+
+        if (m_isTickEntitiesSorted == false)
+        {
+            auto classLess = [](HEntity* pA, HEntity* pB) { return pA->GetClassNameHash() < pB->GetClassNameHash(); };
+            std::stable_sort(m_preRenderTickEntities.begin(), m_preRenderTickEntities.end(), classLess);
+            std::stable_sort(m_postRenderTickEntities.begin(), m_postRenderTickEntities.end(), classLess);
+
+            for (uint32_t i = 0; i < m_preRenderTickEntities.size(); i++)
+            {
+                m_preRenderTickEntities[i]->m_preRenderTickIdx = i;
+            }
+
+            for (uint32_t i = 0; i < m_postRenderTickEntities.size(); i++)
+            {
+                m_postRenderTickEntities[i]->m_postRenderTickIdx = i;
+            }
+            m_isTickEntitiesSorted = true;
+        }
+
+        // The ticks can spawn entities, which are appended to the list. They start ticking from the next frame, and
+        // the loop uses indices because the append may reallocate the list.
+        m_isTickingEntities = true;
+        uint32_t tickEntitiesCnt = static_cast<uint32_t>(m_preRenderTickEntities.size());
+        for (uint32_t i = 0; i < tickEntitiesCnt; i++)
         {
-            itr.second->PreRenderTick(deltaSec);
+            m_preRenderTickEntities[i]->PreRenderTick(deltaSec);
         }
+        m_isTickingEntities = false;
+        FlushDestroyedEntities();
+
+        m_systemScheduler.RunPhase(HSYSTEM_PHASE_PRE_RENDER, m_registry, static_cast<float>(deltaSec));
+
+        UpdateRenderProxies();
+    }
+
+    // ================================================================================================================
+    void HScene::FixedStepTick(double stepSec)
+    {
+        // Flush the changes made between the steps, so only the step's movements are captured.
+        UpdateTransforms();
+        ClearInterpolatedEntities();
+
+        m_isFixedStepping = true;
+        PreRenderTick(stepSec);
+        m_isFixedStepping = false;
     }
 
     // ================================================================================================================
     void HScene::PostRenderTick(double deltaSec)
     {
-        for (auto& itr : m_entitiesHashTable)
+        // The ticks can append spawned entities, so iterate the entities from before the ticks by indices.
+        m_isTickingEntities = true;
+        uint32_t tickEntitiesCnt = static_cast<uint32_t>(m_postRenderTickEntities.size());
+        for (uint32_t i = 0; i < tickEntitiesCnt; i++)
+        {
+            m_postRenderTickEntities[i]->PostRenderTick(deltaSec);
+        }
+        m_isTickingEntities = false;
+        FlushDestroyedEntities();
+
+        m_systemScheduler.RunPhase(HSYSTEM_PHASE_POST_RENDER, m_registry, static_cast<float>(deltaSec));
+    }
+
+    // ================================================================================================================
+    void HScene::OnTransformChanged(
+        entt::registry& registry,
+        entt::entity    entity)
+    {
+        m_dirtyTransformEntities.push_back(entity);
+    }
+
+    // ================================================================================================================
+    void HScene::OnRenderComponentChanged(
+        entt::registry& registry,
+        entt::entity    entity)
+    {
+        // Only record it. The component may not be constructed, updated or destroyed yet.
+        m_dirtyRenderEntities.push_back(entity);
+    }
+
+    // ================================================================================================================
+    void HScene::UpdateTransforms()
+    {
+        if (m_dirtyTransformEntities.empty() == false)
+        {
+            std::sort(m_dirtyTransformEntities.begin(), m_dirtyTransformEntities.end());
+            auto dirtyEnd = std::unique(m_dirtyTransformEntities.begin(), m_dirtyTransformEntities.end());
+
+            // Gather the changed transforms into the SoA layout, so their local matrices are generated in batches.
+            m_localTransformsSoA.Clear();
+            m_localTransformsEntities.clear();
+            for (auto itr = m_dirtyTransformEntities.begin(); itr != dirtyEnd; itr++)
+            {
+                entt::entity entity = *itr;
+                uint32_t entityHandle = static_cast<uint32_t>(entity);
+
+                if (m_registry.valid(entity) && m_registry.all_of<TransformComponent>(entity))
+                {
+                    if (m_transformHierarchy.HasNode(entityHandle) == false)
+                    {
+                        m_transformHierarchy.AddNode(entityHandle);
+                        m_newTransformEntities.push_back(entityHandle);
+                    }
+
+                    auto& transComponent = m_registry.get<TransformComponent>(entity);
+                    m_localTransformsSoA.Push(transComponent.m_pos, transComponent.m_rot, transComponent.m_scale);
+                    m_localTransformsEntities.push_back(entityHandle);
+                }
+                else if (m_transformHierarchy.HasNode(entityHandle))
+                {
+                    // Its children become roots and the render proxy goes away.
+                    m_transformHierarchy.RemoveNode(entityHandle);
+                    m_dirtyRenderEntities.push_back(entity);
+                }
+            }
+
+            m_localMats.resize(16 * m_localTransformsEntities.size());
+            GenModelMats(m_localTransformsSoA, m_localMats.data());
+            for (uint32_t i = 0; i < m_localTransformsEntities.size(); i++)
+            {
+                m_transformHierarchy.SetLocalMat(m_localTransformsEntities[i], &m_localMats[16 * i]);
+            }
+
+            m_dirtyTransformEntities.clear();
+        }
+
+        // Only the changed subtrees are recomputed.
+        m_changedWorldEntities.clear();
+        if (m_isFixedStepping)
+        {
+            m_oldWorldMats.clear();
+            m_transformHierarchy.UpdateWorldMats(m_changedWorldEntities, &m_oldWorldMats);
+        }
+        else
+        {
+            m_transformHierarchy.UpdateWorldMats(m_changedWorldEntities);
+        }
+
+        for (uint32_t i = 0; i < m_changedWorldEntities.size(); i++)
+        {
+            uint32_t entityHandle = m_changedWorldEntities[i];
+            m_dirtyRenderEntities.push_back(static_cast<entt::entity>(entityHandle));
+
+            // The first change in the step keeps the world matrix before it. The new transforms pop into place.
+            bool isNew = std::binary_search(m_newTransformEntities.begin(), m_newTransformEntities.end(), entityHandle);
+            if (m_isFixedStepping && (isNew == false))
+            {
+                HMat4x4 oldWorldMat{};
+                memcpy(oldWorldMat.eles, &m_oldWorldMats[16 * i], sizeof(HMat4x4));
+                if (m_prevWorldMats.insert({ entityHandle, oldWorldMat }).second)
+                {
+                    m_interpolatedEntities.push_back(entityHandle);
+                }
+            }
+        }
+        m_newTransformEntities.clear();
+    }
+
+    // ================================================================================================================
+    void HScene::InterpolateRenderProxies()
+    {
+        if (m_interpolatedEntities.empty())
+        {
+            return;
+        }
+
+        // A step's rotation is small, so blending the matrices' elements barely shrinks the meshes in between.
+        float alpha = std::clamp(m_renderInterpolationAlpha, 0.f, 1.f);
+        for (uint32_t entityHandle : m_interpolatedEntities)
+        {
+            auto proxyItr = m_entitiesRenderProxies.find(entityHandle);
+            if ((proxyItr == m_entitiesRenderProxies.end()) || (m_transformHierarchy.HasNode(entityHandle) == false))
+            {
+                continue;
+            }
+
+            uint32_t proxyIdx = proxyItr->second;
+            const float* pPrevWorldMat = m_prevWorldMats[entityHandle].eles;
+            const float* pWorldMat = m_transformHierarchy.GetWorldMat(entityHandle);
+
+            HMat4x4& modelMat = m_cullModelMats[proxyIdx];
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                modelMat.eles[i] = pPrevWorldMat[i] + alpha * (pWorldMat[i] - pPrevWorldMat[i]);
+            }
+
+            float worldSphere[4] = {};
+            TransformBoundingSphere(modelMat.eles, &m_renderProxies[proxyIdx].boundingSphere.center[0], worldSphere);
+            m_cullSphereX[proxyIdx] = worldSphere[0];
+            m_cullSphereY[proxyIdx] = worldSphere[1];
+            m_cullSphereZ[proxyIdx] = worldSphere[2];
+            m_cullSphereR[proxyIdx] = worldSphere[3];
+        }
+    }
+
+    // ================================================================================================================
+    void HScene::ClearInterpolatedEntities()
+    {
+        for (uint32_t entityHandle : m_interpolatedEntities)
+        {
+            m_dirtyRenderEntities.push_back(static_cast<entt::entity>(entityHandle));
+        }
+
+        m_interpolatedEntities.clear();
+        m_prevWorldMats.clear();
+    }
+
+    // ================================================================================================================
+    void HScene::UpdateRenderProxies()
+    {
+        UpdateTransforms();
+
+        if (m_dirtyRenderEntities.empty())
+        {
+            return;
+        }
+
+        std::sort(m_dirtyRenderEntities.begin(), m_dirtyRenderEntities.end());
+        auto dirtyEnd = std::unique(m_dirtyRenderEntities.begin(), m_dirtyRenderEntities.end());
+
+        for (auto itr = m_dirtyRenderEntities.begin(); itr != dirtyEnd; itr++)
+        {
+            entt::entity entity = *itr;
+            uint32_t entityHandle = static_cast<uint32_t>(entity);
+
+            auto proxyItr = m_entitiesRenderProxies.find(entityHandle);
+            bool hasProxy = (proxyItr != m_entitiesRenderProxies.end());
+
+            if (m_registry.valid(entity) && m_registry.all_of<StaticMeshComponent, TransformComponent>(entity))
+            {
+                uint32_t proxyIdx = hasProxy ? proxyItr->second : static_cast<uint32_t>(m_cullEntities.size());
+                ExtractRenderProxy(entity, proxyIdx);
+            }
+            else if (hasProxy)
+            {
+                // The entity is destroyed or lost its mesh.
+                RemoveRenderProxy(proxyItr->second);
+            }
+        }
+
+        m_dirtyRenderEntities.clear();
+    }
+
+    // ================================================================================================================
+    void HScene::ExtractRenderProxy(
+        entt::entity entity,
+        uint32_t     proxyIdx)
+    {
+        auto& meshComponent = m_registry.get<StaticMeshComponent>(entity);
+
+        bool isNewProxy = (proxyIdx == m_cullEntities.size());
+        if (isNewProxy)
+        {
+            m_cullEntities.push_back(entity);
+            m_cullModelMats.push_back(HMat4x4{});
+            m_cullSphereX.push_back(0.f);
+            m_cullSphereY.push_back(0.f);
+            m_cullSphereZ.push_back(0.f);
+            m_cullSphereR.push_back(0.f);
+            m_renderProxies.push_back(HStaticMeshRenderProxy{});
+            m_entitiesRenderProxies.insert({ static_cast<uint32_t>(entity), proxyIdx });
+        }
+
+        HStaticMeshRenderProxy& proxy = m_renderProxies[proxyIdx];
+
+        HStaticMeshAsset* pStaticMeshAsset = nullptr;
+        g_pAssetRsrcManager->GetAssetPtr(meshComponent.m_meshAssetGuid, (HAsset**)&pStaticMeshAsset);
+
+        proxy.pMeshAsset = pStaticMeshAsset;
+        proxy.pIdxBuffer = pStaticMeshAsset->GetIdxGpuBuffer(0);
+        proxy.idxCnt = pStaticMeshAsset->GetIdxCnt(0);
+        proxy.pVertBuffer = pStaticMeshAsset->GetVertGpuBuffer(0);
+        proxy.vertCnt = pStaticMeshAsset->GetVertCnt(0);
+        proxy.materialGuid = pStaticMeshAsset->GetMaterialGUID(0);
+        proxy.isOccluder = meshComponent.m_isOccluder;
+        memcpy(&proxy.boundingSphere, pStaticMeshAsset->GetBoundingSphere(0), sizeof(HBoundingSphere));
+
+        HMaterialAsset* pMaterialAsset = nullptr;
+        g_pAssetRsrcManager->GetAssetPtr(proxy.materialGuid, (HAsset**)&pMaterialAsset);
+
+        HTextureAsset* pTextureAsset = nullptr;
+        g_pAssetRsrcManager->GetAssetPtr(pMaterialAsset->GetBaseColorTextureGUID(), (HAsset**)&pTextureAsset);
+        proxy.pBaseColor = pTextureAsset->GetGpuImgPtr();
+
+        g_pAssetRsrcManager->GetAssetPtr(pMaterialAsset->GetNormalMapGUID(), (HAsset**)&pTextureAsset);
+        proxy.pNormalTex = pTextureAsset->GetGpuImgPtr();
+
+        g_pAssetRsrcManager->GetAssetPtr(pMaterialAsset->GetMetallicRoughnessGUID(), (HAsset**)&pTextureAsset);
+        proxy.pMetallicRoughnessTex = pTextureAsset->GetGpuImgPtr();
+
+        g_pAssetRsrcManager->GetAssetPtr(pMaterialAsset->GetOcclusionGUID(), (HAsset**)&pTextureAsset);
+        proxy.pOcclusionTex = pTextureAsset->GetGpuImgPtr();
+
+        proxy.pbrFeatures = 0;
+        proxy.pbrFeatures |= pMaterialAsset->HasNormalMap() ? HPBR_FEATURE_NORMAL_MAP : 0;
+        proxy.pbrFeatures |= pMaterialAsset->HasOcclusionMap() ? HPBR_FEATURE_OCCLUSION_MAP : 0;
+
+        // World space data
+        HMat4x4& modelMat = m_cullModelMats[proxyIdx];
+        memcpy(modelMat.eles, m_transformHierarchy.GetWorldMat(static_cast<uint32_t>(entity)), sizeof(HMat4x4));
+
+        float worldSphere[4] = {};
+        TransformBoundingSphere(modelMat.eles, pStaticMeshAsset->GetBoundingSphere(0), worldSphere);
+        m_cullSphereX[proxyIdx] = worldSphere[0];
+        m_cullSphereY[proxyIdx] = worldSphere[1];
+        m_cullSphereZ[proxyIdx] = worldSphere[2];
+        m_cullSphereR[proxyIdx] = worldSphere[3];
+
+        HAabb worldAabb{};
+        TransformAabb(modelMat.eles,
+                      pStaticMeshAsset->GetAabbMin(0),
+                      pStaticMeshAsset->GetAabbMax(0),
+                      worldAabb.min,
+                      worldAabb.max);
+
+        if (isNewProxy)
         {
-            itr.second->PostRenderTick(deltaSec);
+            proxy.spatialProxyId = m_spatialTree.InsertProxy(worldAabb, static_cast<uint32_t>(entity));
         }
+        else
+        {
+            // It's cheap if the entity doesn't move out of its fat AABB.
+            m_spatialTree.MoveProxy(proxy.spatialProxyId, worldAabb);
+        }
+    }
+
+    // ================================================================================================================
+    void HScene::RemoveRenderProxy(
+        uint32_t proxyIdx)
+    {
+        m_spatialTree.RemoveProxy(m_renderProxies[proxyIdx].spatialProxyId);
+        m_entitiesRenderProxies.erase(static_cast<uint32_t>(m_cullEntities[proxyIdx]));
+
+        // Move the last proxy into the hole, so the arrays stay dense.
+        uint32_t lastIdx = static_cast<uint32_t>(m_cullEntities.size()) - 1;
+        if (proxyIdx != lastIdx)
+        {
+            m_cullEntities[proxyIdx] = m_cullEntities[lastIdx];
+            m_cullModelMats[proxyIdx] = m_cullModelMats[lastIdx];
+            m_cullSphereX[proxyIdx] = m_cullSphereX[lastIdx];
+            m_cullSphereY[proxyIdx] = m_cullSphereY[lastIdx];
+            m_cullSphereZ[proxyIdx] = m_cullSphereZ[lastIdx];
+            m_cullSphereR[proxyIdx] = m_cullSphereR[lastIdx];
+            m_renderProxies[proxyIdx] = m_renderProxies[lastIdx];
+            m_entitiesRenderProxies[static_cast<uint32_t>(m_cullEntities[proxyIdx])] = proxyIdx;
+        }
+
+        m_cullEntities.pop_back();
+        m_cullModelMats.pop_back();
+        m_cullSphereX.pop_back();
+        m_cullSphereY.pop_back();
+        m_cullSphereZ.pop_back();
+        m_cullSphereR.pop_back();
+        m_renderProxies.pop_back();
+    }
+
+    // ================================================================================================================
+    bool HScene::SetEntityParent(
+        uint32_t entityHandle,
+        uint32_t parentEntityHandle)
+    {
+        // The transforms added since the last update don't have their nodes yet.
+        UpdateTransforms();
+
+        if (m_transformHierarchy.HasNode(entityHandle) == false)
+        {
+            return false;
+        }
+
+        // It also rejects parents without a TransformComponent.
+        return m_transformHierarchy.SetParent(entityHandle, parentEntityHandle);
+    }
+
+    // ================================================================================================================
+    uint32_t HScene::GetEntityParent(
+        uint32_t entityHandle)
+    {
+        UpdateTransforms();
+        return m_transformHierarchy.HasNode(entityHandle) ? m_transformHierarchy.GetParent(entityHandle) :
+                                                            HTRANSFORM_NO_PARENT;
+    }
+
+    // ================================================================================================================
+    const float* HScene::GetEntityWorldMat(
+        uint32_t entityHandle)
+    {
+        UpdateTransforms();
+        return m_transformHierarchy.GetWorldMat(entityHandle);
+    }
+
+    // ================================================================================================================
+    void HScene::QueryEntitiesInFrustum(
+        const HMat4x4&         vpMat,
+        std::vector<uint32_t>& oEntities) const
+    {
+        float frustumPlanes[24] = {};
+        GenFrustumPlanes(vpMat.eles, frustumPlanes);
+        m_spatialTree.QueryFrustum(frustumPlanes, oEntities);
+    }
+
+    // ================================================================================================================
+    void HScene::QueryEntitiesInSphere(
+        const float*           pCenter,
+        float                  radius,
+        std::vector<uint32_t>& oEntities) const
+    {
+        m_spatialTree.QuerySphere(pCenter, radius, oEntities);
+    }
+
+    // ================================================================================================================
+    void HScene::QueryEntitiesInBox(
+        const float*           pMin,
+        const float*           pMax,
+        std::vector<uint32_t>& oEntities) const
+    {
+        HAabb box{};
+        memcpy(box.min, pMin, 3 * sizeof(float));
+        memcpy(box.max, pMax, 3 * sizeof(float));
+        m_spatialTree.QueryAabb(box, oEntities);
+    }
+
+    // ================================================================================================================
+    void HScene::QueryEntitiesByRay(
+        const float*           pOrigin,
+        const float*           pDir,
+        float                  maxT,
+        std::vector<uint32_t>& oEntities) const
+    {
+        m_spatialTree.QueryRay(pOrigin, pDir, maxT, oEntities);
+    }
+
+    // ================================================================================================================
+    bool HScene::RayCastClosestEntity(
+        const float* pOrigin,
+        const float* pDir,
+        float        maxT,
+        uint32_t&    oEntity,
+        float&       oT) const
+    {
+        return m_spatialTree.RayCastClosest(pOrigin, pDir, maxT, oEntity, oT);
     }
-}
\ No newline at end of file
+}
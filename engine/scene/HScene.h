@@ -3,11 +3,22 @@
 #include <unordered_map>
 #include <vector>
 #include "../core/HGpuRsrcManager.h"
+#include "../util/UtilMath.h"
+#include "HDynamicAabbTree.h"
+#include "HEntityPool.h"
+#include "HSceneSnapshot.h"
+#include "HOcclusionRasterizer.h"
+#include "HTransformHierarchy.h"
+#include "HSystemScheduler.h"
+
+struct RegisterClassInfo;
 
 namespace Hedge
 {
     class HEntity;
     class HEventManager;
+    class HStaticMeshAsset;
+    class CameraComponent;
 
     struct HMat4x4
     {
@@ -19,6 +30,12 @@ namespace Hedge
         float eles[3];
     };
 
+    struct HBoundingSphere
+    {
+        float center[3];
+        float radius;
+    };
+
     struct CameraInfo
     {
         float view[3];
@@ -41,17 +58,22 @@ namespace Hedge
         std::vector<uint32_t>    vertCounts;
         
         std::vector<uint64_t> objsMaterialsGuid;
+
+        std::vector<HBoundingSphere> objsBoundingSpheres; // Model space.
         
         std::vector<HMat4x4>  modelMats;
         std::vector<HGpuImg*> modelBaseColors;
         std::vector<HGpuImg*> modelNormalTexs;
         std::vector<HGpuImg*> modelMetallicRoughnessTexs;
         std::vector<HGpuImg*> modelOcclusionTexs;
+        std::vector<uint32_t> objsPBRFeatures; // Material HPBRFeatureBits. The HPBR_FEATURE_IBL is from the hasIbl.
 
         std::vector<HVec3> pointLightsPositions;
         std::vector<HVec3> pointLightsRadiances;
+        std::vector<float> pointLightsRadii; // Lights don't affect anything beyond their radii.
 
-        // Image based lightning
+        // Image based lightning. The IBL images are nullptr if the scene doesn't have it.
+        bool     hasIbl;
         HGpuImg* diffuseCubemapGpuImg;
         HGpuImg* prefilterEnvCubemapGpuImg;
         HGpuImg* envBrdfGpuImg;
@@ -61,6 +83,7 @@ namespace Hedge
         HMat4x4    vpMat;
         float      cameraPos[3];
         CameraInfo cameraInfo;
+        float      cameraFarPlane;
 
         // Skybox -- We will render the skybox if the skyboxCubemapGpuImg is not nullptr.
         HGpuImg* skyboxCubemapGpuImg;
@@ -73,37 +96,290 @@ namespace Hedge
         ~HScene();
 
         // Entity functions
+        // The scene takes the ownership of the new-ed entity.
         void SpawnEntity(HEntity* pEntity, HEventManager& eventManager);
 
+        // Construct and spawn an entity in the scene's pool of its class. The pools are created on demand from the
+        // registered class's size and alignment, so the entities of a class are packed together and spawning
+        // doesn't hit the global allocator. E.g. Projectiles and pickups.
+        HEntity* SpawnEntity(uint32_t classNameHash, const RegisterClassInfo& classInfo, HEventManager& eventManager);
+
+        // Destroy the entity with its components. A pooled entity's slot goes back to its pool. The entities destroyed
+        // in the ticks, including the ticking entity itself, are freed after all ticks of the phase.
+        void DestroyEntity(uint32_t entityHandle);
+
+        // Snapshots for the play-in-editor reset and the rollback. Saving copies the registered components, the
+        // entities' names, transform parents, tags and their HEntity::SaveSnapshotState(...) into the snapshot.
+        // Restoring destroys the entities spawned since then, respawns the destroyed pooled entities at their old
+        // handles and copies everything back. Only the components that differ from the snapshot notify their
+        // observers, so a restore costs little more than the changes since the save. The entities spawned from
+        // new-ed pointers cannot be respawned. If one of them was destroyed between the two, it stays destroyed and
+        // the restore returns false. They must not be called in the ticks or systems.
+        void SaveSnapshot(HSceneSnapshot& oSnapshot);
+        bool RestoreSnapshot(const HSceneSnapshot& snapshot, HEventManager& eventManager);
+
+        // Register a component type for the snapshots. The engine's components are registered by the scene.
+        // Trivially copyable components are copied with memcpy. The others are copied by their copy constructors and
+        // need an operator==, so the unchanged ones are not replaced.
+        template<typename T>
+        void RegisterSnapshotComponent()
+            { m_snapshotComponents.push_back({ &SaveSnapshotComponents<T>, &RestoreSnapshotComponents<T> }); }
+
         HEntity* GetEntity(uint32_t entityHandle) { return m_entitiesHashTable[entityHandle]; }
 
+        // Indexed lookups. They never scan the scene, so gameplay code can call them every frame.
+        // Return nullptr if no entity has the instance name. Any of them if several entities share it.
+        HEntity* FindEntityByName(const char* pName) const;
+
+        // The entities of a class, E.g. GetEntitiesByClass(crc32("HCubeEntity")), or of a tag. The vectors are owned
+        // by the scene and stay valid until the next spawn, rename or tag change.
+        const std::vector<HEntity*>& GetEntitiesByClass(uint32_t classNameHash) const;
+        const std::vector<HEntity*>& GetEntitiesByTag(uint32_t tagHash) const;
+
+        // User tags, E.g. AddEntityTag(handle, crc32("Wall")). An entity can have many tags. Adding a tag twice does
+        // nothing.
+        void AddEntityTag(uint32_t entityHandle, uint32_t tagHash);
+        void RemoveEntityTag(uint32_t entityHandle, uint32_t tagHash);
+        bool EntityHasTag(uint32_t entityHandle, uint32_t tagHash) const;
+
+        // Called by the HEntity::SetEntityInstName(...) to move the entity in the name index.
+        void OnEntityRenamed(HEntity* pEntity, const std::string& oldName);
+
         // Component functions
         template<typename Type, typename... Args>
         void EntityAddComponent(uint32_t entityHandle, Args &&...args) 
             { m_registry.emplace<Type>(static_cast<entt::entity>(entityHandle), std::forward<Args>(args)...); }
         
+        // The component can be modified through the reference, so it notifies the component's update observers.
         template<typename T>
         T& EntityGetComponent(uint32_t entityHandle)
+            { return m_registry.patch<T>(static_cast<entt::entity>(entityHandle)); }
+
+        // Read-only access. It doesn't notify the observers, so reading a component doesn't make it dirty.
+        template<typename T>
+        const T& EntityReadComponent(uint32_t entityHandle) const
             { return m_registry.get<T>(static_cast<entt::entity>(entityHandle)); }
         
-        SceneRenderInfo GetSceneRenderInfo();
+        // The render info stays valid until the next call. Only the static meshes whose components were accessed
+        // since the last call are extracted again.
+        const SceneRenderInfo& GetSceneRenderInfo();
+
+        // Attach an entity's transform to another entity's transform. Its TransformComponent becomes relative to the
+        // parent. HTRANSFORM_NO_PARENT detaches it. Return false if either entity doesn't have a TransformComponent or
+        // it would create a cycle.
+        bool SetEntityParent(uint32_t entityHandle, uint32_t parentEntityHandle);
+        uint32_t GetEntityParent(uint32_t entityHandle);
+
+        // The cached world matrix of the entity's TransformComponent. Changed transforms are propagated first. The
+        // pointer is valid until the next transforms' update.
+        const float* GetEntityWorldMat(uint32_t entityHandle);
 
         std::unordered_map<uint32_t, HEntity*>& GetEntityHashTable() { return m_entitiesHashTable; }
 
         bool IsEmpty() { return m_entitiesHashTable.empty(); }
 
+        // Copy all entities' names. It's for the tools listing the whole scene. E.g. The editor's scene outliner.
         void GetAllEntitiesNamesHashes(std::vector<std::pair<std::string, uint32_t>>& entities);
         
+        // The entities' enabled virtual ticks run on the calling thread first, then the phase's systems run on the
+        // job system.
         void PreRenderTick(double deltaSec);
         void PostRenderTick(double deltaSec);
 
+        // A PreRenderTick(...) of the fixed timestep. The static meshes' world matrices before the step are kept, so
+        // the render info can be interpolated between the last two steps. The transforms changed out of the steps
+        // are not interpolated.
+        void FixedStepTick(double stepSec);
+
+        // The static meshes moved by the last FixedStepTick(...) are rendered at alpha in [0, 1] between their world
+        // matrices before and after the step. 1 renders the latest step.
+        void SetRenderInterpolationAlpha(float alpha) { m_renderInterpolationAlpha = alpha; }
+
+        // Register a system that processes the entities having all of the Components in chunks. The access must
+        // declare every component that the func reads or writes. The written components of the entities that the func
+        // flags as changed notify their observers after the system finishes.
+        template<typename... Components>
+        void RegisterSystem(HSystemPhase         phase,
+                            const std::string&   name,
+                            const HSystemAccess& access,
+                            const HSystemFunc&   func,
+                            uint32_t             chunkSize = HSYSTEM_DEFAULT_CHUNK_SIZE)
+        {
+            m_systemScheduler.AddSystem(phase,
+                                        name,
+                                        access,
+                                        &HSystemScheduler::GatherEntities<Components...>,
+                                        func,
+                                        chunkSize);
+        }
+
+        void UnregisterSystem(const std::string& name) { m_systemScheduler.RemoveSystem(name); }
+
+        // Spatial queries on the world space AABBs of the static meshes. They output the entity handles and reflect
+        // the transforms at the end of the last PreRenderTick(...) or GetSceneRenderInfo().
+        void QueryEntitiesInFrustum(const HMat4x4& vpMat, std::vector<uint32_t>& oEntities) const;
+        void QueryEntitiesInSphere(const float* pCenter, float radius, std::vector<uint32_t>& oEntities) const;
+        void QueryEntitiesInBox(const float* pMin, const float* pMax, std::vector<uint32_t>& oEntities) const;
+        void QueryEntitiesByRay(const float* pOrigin, const float* pDir, float maxT, std::vector<uint32_t>& oEntities) const;
+
+        // Return false if the ray doesn't hit any entity's AABB.
+        bool RayCastClosestEntity(const float* pOrigin, const float* pDir, float maxT, uint32_t& oEntity, float& oT) const;
+
+        // The static meshes marked as occluders hide the other static meshes behind them before they go into the
+        // SceneRenderInfo. It's on by default and costs nothing in scenes without occluders.
+        void SetOcclusionCullingEnabled(bool enabled) { m_occlusionCullingEnabled = enabled; }
+        bool IsOcclusionCullingEnabled() const { return m_occlusionCullingEnabled; }
+
+        // The number of static meshes culled by the occluders in the last GetSceneRenderInfo().
+        uint32_t GetOcclusionCulledObjsCnt() const { return m_occlusionCulledObjsCnt; }
+
     private:
-        void CreateDummyBlackTextures();
+        // Fill the camera related render info. Return false if the scene doesn't have a camera.
+        bool GenCameraRenderInfo(SceneRenderInfo& renderInfo);
+
+        // The camera's world position, view and up. The view and the up are rotated by the camera's parent.
+        void GenCameraWorldFrame(uint32_t entityHandle, const CameraComponent& camComponent, float* oPos, float* oView,
+                                 float* oUp);
+
+        // Reset the m_renderInfo but keep its vectors' memory.
+        void ClearRenderInfo();
+
+        // The hint is the entity handle to use. entt::null creates a new one.
+        void SpawnEntityInternal(HEntity* pEntity, HEventManager& eventManager, entt::entity hint);
+
+        // Construct the entity in the class's pool.
+        HEntity* SpawnPooledEntity(uint32_t classNameHash, HEventManager& eventManager, entt::entity hint);
+
+        // Remove the entity from the scene's tables and indices, destroy its components and free it.
+        void DestroyEntityInternal(uint32_t entityHandle);
+        void FreeEntity(HEntity* pEntity);
+
+        // Keep the tag's entities and the entity's places in them in step.
+        void AddEntityTagInternal(HEntity* pEntity, uint32_t tagHash);
+        void RemoveEntityTagInternal(HEntity* pEntity, uint32_t tagHash);
+
+        // The entities destroyed by the ticks are only freed after the ticks, so the tick lists stay intact.
+        void FlushDestroyedEntities();
+
+        // Frustum cull all static meshes. The visible ones are in the m_cullEntities[i] where m_cullVisible[i] is 1.
+        void CullStaticMeshes(const SceneRenderInfo& renderInfo, bool hasCamera);
+
+        // Rasterize the frustum visible occluders and clear the m_cullVisible of the meshes behind them.
+        void OcclusionCullStaticMeshes(const SceneRenderInfo& renderInfo);
+
+        // The registry's signals of the TransformComponent and the StaticMeshComponent.
+        void OnTransformChanged(entt::registry& registry, entt::entity entity);
+        void OnRenderComponentChanged(entt::registry& registry, entt::entity entity);
+
+        // Update the changed local matrices and propagate them to the world matrices. The entities whose world
+        // matrices changed go to the dirty render entities.
+        void UpdateTransforms();
+
+        // Extract, insert or remove the render proxies of the changed entities. The spatial tree follows them.
+        void UpdateRenderProxies();
+        void ExtractRenderProxy(entt::entity entity, uint32_t proxyIdx);
+        void RemoveRenderProxy(uint32_t proxyIdx);
+
+        // Blend the interpolated entities' model matrices and world spheres by the m_renderInterpolationAlpha. The
+        // spatial tree keeps the latest step, so the queries see the simulated state.
+        void InterpolateRenderProxies();
+
+        // The interpolated entities stop moving. Their render proxies are extracted again at the latest step.
+        void ClearInterpolatedEntities();
 
         entt::registry m_registry;
+
+        // The render data of a static mesh that only changes with its components.
+        struct HStaticMeshRenderProxy
+        {
+            HStaticMeshAsset* pMeshAsset;
+            HGpuBuffer*       pIdxBuffer;
+            uint32_t          idxCnt;
+            HGpuBuffer*       pVertBuffer;
+            uint32_t          vertCnt;
+            uint64_t          materialGuid;
+            HBoundingSphere   boundingSphere; // Model space.
+            HGpuImg*          pBaseColor;
+            HGpuImg*          pNormalTex;
+            HGpuImg*          pMetallicRoughnessTex;
+            HGpuImg*          pOcclusionTex;
+            uint32_t          pbrFeatures;
+            bool              isOccluder;
+            uint32_t          spatialProxyId; // Proxy id in the spatial tree.
+        };
+
+        // The static meshes' render proxies. The i-th elements of these arrays belong to the same entity. They are
+        // persistent and only the changed entities are extracted again, so static meshes cost nothing until culling.
+        std::vector<entt::entity>           m_cullEntities;
+        std::vector<HMat4x4>                m_cullModelMats;
+        std::vector<float>                  m_cullSphereX; // World space bounding spheres for the SIMD culling.
+        std::vector<float>                  m_cullSphereY;
+        std::vector<float>                  m_cullSphereZ;
+        std::vector<float>                  m_cullSphereR;
+        std::vector<HStaticMeshRenderProxy> m_renderProxies;
+        std::vector<uint8_t>                m_cullVisible;
+
+        std::unordered_map<uint32_t, uint32_t> m_entitiesRenderProxies; // Entity handle -> Render proxy index.
+        std::vector<entt::entity>              m_dirtyRenderEntities;   // It can have duplicates.
+
+        HTransformHierarchy       m_transformHierarchy;
+        std::vector<entt::entity> m_dirtyTransformEntities; // It can have duplicates.
+        std::vector<uint32_t>     m_changedWorldEntities;
+        HTransformSoA             m_localTransformsSoA; // The changed transforms for the batched local matrices.
+        std::vector<uint32_t>     m_localTransformsEntities;
+        std::vector<float>        m_localMats;
+        std::vector<uint32_t>     m_newTransformEntities; // Sorted. Added to the hierarchy in this update.
+        std::vector<float>        m_oldWorldMats;
+
+        // Render interpolation of the fixed timestep. The world matrices before the last step of the entities that
+        // it moved.
+        std::unordered_map<uint32_t, HMat4x4> m_prevWorldMats; // Entity handle -> World matrix before the step.
+        std::vector<uint32_t>                 m_interpolatedEntities;
+        float                                 m_renderInterpolationAlpha;
+        bool                                  m_isFixedStepping;
+
+        SceneRenderInfo m_renderInfo;
+
+        HOcclusionRasterizer m_occlusionRasterizer;
+        bool                 m_occlusionCullingEnabled;
+        bool                 m_isOcclusionRasterizerInited;
+        uint32_t             m_occlusionCulledObjsCnt;
+
         std::unordered_map<uint32_t, HEntity*> m_entitiesHashTable;
 
-        HGpuImg* m_pDummyBlackCubemap;
-        HGpuImg* m_pDummyBlack2dImg;
+        // Entity indices. The names are keyed by their crc32, so the lookups don't build strings and the entities
+        // sharing a hash are told apart by their names.
+        std::unordered_multimap<uint32_t, HEntity*>         m_namesEntities;   // Name hash -> Entity.
+        std::unordered_map<uint32_t, std::vector<HEntity*>> m_classesEntities; // Class name hash -> Entities.
+        std::unordered_map<uint32_t, std::vector<HEntity*>> m_tagsEntities;    // Tag hash -> Entities.
+
+        // The nodes erased from the handle and name tables. The spawns reuse them instead of allocating new ones.
+        std::vector<std::unordered_map<uint32_t, HEntity*>::node_type>      m_freeEntityNodes;
+        std::vector<std::unordered_multimap<uint32_t, HEntity*>::node_type> m_freeNameNodes;
+
+        // The classes spawned into the pools. The constructor is kept, so the snapshots can respawn their entities.
+        struct HPooledClass
+        {
+            HEntityPool* pPool;
+            HEntity*     (*pfnNewEntityInPlace)(void* pMem);
+        };
+
+        std::unordered_map<uint32_t, HPooledClass> m_pooledClasses; // Class name hash -> Pool and constructor.
+
+        std::vector<HSnapshotComponentFuncs> m_snapshotComponents;
+        std::vector<uint32_t>                m_snapshotScratchHandles;
+        std::vector<entt::entity>            m_snapshotScratchEntities;
+
+        // The entities that enabled their virtual ticks. They are sorted by their classes, so the same overrides are
+        // called one after another. Entities spawned by the ticks are appended and sorted before the next ticks.
+        std::vector<HEntity*> m_preRenderTickEntities;
+        std::vector<HEntity*> m_postRenderTickEntities;
+        bool                  m_isTickEntitiesSorted;
+        bool                  m_isTickingEntities;
+        std::vector<uint32_t> m_destroyedEntities; // Destroyed during the ticks. Freed after them.
+
+        HSystemScheduler m_systemScheduler;
+
+        HDynamicAabbTree m_spatialTree;
     };
 }
\ No newline at end of file
@@ -0,0 +1,208 @@
+#pragma once
+#include <entt.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Hedge
+{
+    // The copies of a component type's instances in a snapshot. The i-th component belongs to the i-th entity.
+    struct HSnapshotComponentPool
+    {
+        std::vector<entt::entity> entities;
+        std::vector<entt::entity> sortedEntities; // For the membership tests of the restore.
+        std::vector<uint8_t>      bytes;          // Packed trivially copyable components.
+        std::shared_ptr<void>     pObjects;       // std::vector<T> of the other components.
+    };
+
+    struct HSnapshotEntity
+    {
+        uint32_t    handle;
+        uint32_t    classNameHash;
+        uint32_t    parentHandle; // HTRANSFORM_NO_PARENT if it's a root or doesn't have a TransformComponent.
+        uint32_t    stateOffset;  // The bytes of its HEntity::SaveSnapshotState(...) in the entitiesStates.
+        uint32_t    stateSize;
+        std::string name;
+    };
+
+    // A copy of a scene's entities, components, transform parents and tags. (See the HScene::SaveSnapshot(...))
+    // It can only be restored into the scene that saved it. The vectors keep their memory, so saving into the same
+    // snapshot again, E.g. once per frame for the rollback, doesn't allocate for the trivially copyable components.
+    struct HSceneSnapshot
+    {
+        std::vector<HSnapshotEntity>               entities; // Sorted by the handles.
+        std::vector<uint8_t>                       entitiesStates;
+        std::vector<HSnapshotComponentPool>        componentPools; // In the scene's registration order.
+        std::vector<std::pair<uint32_t, uint32_t>> tags;           // Tag hash, Entity handle.
+    };
+
+    // The trivially copyable components are copied with their storage's packed arrays. The in place deleted ones can
+    // have holes in the arrays, so they are copied one by one as the other components.
+    template<typename T>
+    constexpr bool HIsSnapshotBulkCopied = std::is_trivially_copyable_v<T> &&
+                                           (std::is_empty_v<T> == false) &&
+                                           (entt::component_traits<T>::in_place_delete == false);
+
+    // Copy all instances of a component type between the registry and a snapshot pool.
+    struct HSnapshotComponentFuncs
+    {
+        void (*pfnSave)(entt::registry& registry, HSnapshotComponentPool& oPool);
+        void (*pfnRestore)(entt::registry&               registry,
+                           const HSnapshotComponentPool& pool,
+                           std::vector<entt::entity>&    scratch);
+    };
+
+    // ================================================================================================================
+    template<typename T>
+    void SaveSnapshotComponents(
+        entt::registry&         registry,
+        HSnapshotComponentPool& oPool)
+    {
+        if constexpr (HIsSnapshotBulkCopied<T>)
+        {
+            // The i-th component of the storage's pages belongs to the i-th entity of its packed entities.
+            constexpr size_t pageSize = entt::component_traits<T>::page_size;
+            auto& storage = registry.storage<T>();
+            size_t cnt = storage.size();
+
+            oPool.entities.resize(cnt);
+            oPool.bytes.resize(sizeof(T) * cnt);
+            if (cnt != 0)
+            {
+                memcpy(oPool.entities.data(), storage.data(), sizeof(entt::entity) * cnt);
+            }
+
+            for (size_t pageStart = 0; pageStart < cnt; pageStart += pageSize)
+            {
+                size_t pageCnt = std::min(pageSize, cnt - pageStart);
+                memcpy(&oPool.bytes[sizeof(T) * pageStart], storage.raw()[pageStart / pageSize], sizeof(T) * pageCnt);
+            }
+        }
+        else
+        {
+            auto view = registry.view<T>();
+            oPool.entities.assign(view.begin(), view.end());
+        }
+
+        oPool.sortedEntities.assign(oPool.entities.begin(), oPool.entities.end());
+        std::sort(oPool.sortedEntities.begin(), oPool.sortedEntities.end());
+
+        if constexpr (HIsSnapshotBulkCopied<T> == false)
+        {
+            if (oPool.pObjects == nullptr)
+            {
+                oPool.pObjects = std::make_shared<std::vector<T>>();
+            }
+
+            std::vector<T>& objects = *static_cast<std::vector<T>*>(oPool.pObjects.get());
+            objects.clear();
+            for (entt::entity entity : oPool.entities)
+            {
+                objects.push_back(registry.get<T>(entity));
+            }
+        }
+    }
+
+    // ================================================================================================================
+    template<typename T>
+    void RestoreSnapshotComponents(
+        entt::registry&               registry,
+        const HSnapshotComponentPool& pool,
+        std::vector<entt::entity>&    scratch)
+    {
+        if constexpr (HIsSnapshotBulkCopied<T>)
+        {
+            // Usually the same entities have the components as in the snapshot, E.g. a rollback of a few frames. Then,
+            // the storage's pages are compared and copied back as a whole. Only the entities in the changed pages are
+            // compared one by one, so just the changed components notify their observers.
+            constexpr size_t pageSize = entt::component_traits<T>::page_size;
+            auto& storage = registry.storage<T>();
+            size_t cnt = pool.entities.size();
+
+            if ((storage.size() == cnt) &&
+                ((cnt == 0) || (memcmp(storage.data(), pool.entities.data(), sizeof(entt::entity) * cnt) == 0)))
+            {
+                for (size_t pageStart = 0; pageStart < cnt; pageStart += pageSize)
+                {
+                    size_t pageCnt = std::min(pageSize, cnt - pageStart);
+                    T* pPage = storage.raw()[pageStart / pageSize];
+                    const T* pSrcPage = reinterpret_cast<const T*>(&pool.bytes[sizeof(T) * pageStart]);
+                    if (memcmp(pPage, pSrcPage, sizeof(T) * pageCnt) == 0)
+                    {
+                        continue;
+                    }
+
+                    for (size_t i = 0; i < pageCnt; i++)
+                    {
+                        if (memcmp(&pPage[i], &pSrcPage[i], sizeof(T)) != 0)
+                        {
+                            memcpy(&pPage[i], &pSrcPage[i], sizeof(T));
+                            registry.patch<T>(pool.entities[pageStart + i]);
+                        }
+                    }
+                }
+                return;
+            }
+        }
+
+        // The entities having the components changed. Remove the components added after the snapshot.
+        scratch.clear();
+        for (entt::entity entity : registry.view<T>())
+        {
+            if (std::binary_search(pool.sortedEntities.begin(), pool.sortedEntities.end(), entity) == false)
+            {
+                scratch.push_back(entity);
+            }
+        }
+
+        for (entt::entity entity : scratch)
+        {
+            registry.remove<T>(entity);
+        }
+
+        for (size_t i = 0; i < pool.entities.size(); i++)
+        {
+            entt::entity entity = pool.entities[i];
+
+            // The entity couldn't be respawned. (See the HScene::RestoreSnapshot(...))
+            if (registry.valid(entity) == false)
+            {
+                continue;
+            }
+
+            if constexpr (std::is_trivially_copyable_v<T>)
+            {
+                const T* pSrc = reinterpret_cast<const T*>(&pool.bytes[sizeof(T) * i]);
+                T* pDst = registry.try_get<T>(entity);
+                if (pDst == nullptr)
+                {
+                    registry.emplace<T>(entity, *pSrc);
+                }
+                else if (memcmp(pDst, pSrc, sizeof(T)) != 0)
+                {
+                    // Only the changed components notify their observers, so the unchanged transforms and render
+                    // proxies are not updated again.
+                    memcpy(pDst, pSrc, sizeof(T));
+                    registry.patch<T>(entity);
+                }
+            }
+            else
+            {
+                const std::vector<T>& objects = *static_cast<const std::vector<T>*>(pool.pObjects.get());
+                const T* pDst = registry.try_get<T>(entity);
+                if (pDst == nullptr)
+                {
+                    registry.emplace<T>(entity, objects[i]);
+                }
+                else if ((*pDst == objects[i]) == false)
+                {
+                    registry.replace<T>(entity, objects[i]);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,195 @@
+#include "HSystemScheduler.h"
+#include "../core/HJobSystem.h"
+#include <algorithm>
+#include <cassert>
+
+extern Hedge::HJobSystem* g_pJobSystem;
+
+namespace Hedge
+{
+    // ================================================================================================================
+    bool HSystemAccess::Overlaps(
+        const std::vector<entt::id_type>& a,
+        const std::vector<entt::id_type>& b)
+    {
+        // Systems only declare a few components, so the linear search is faster than sets.
+        for (entt::id_type id : a)
+        {
+            if (std::find(b.begin(), b.end(), id) != b.end())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // ================================================================================================================
+    bool HSystemAccess::ConflictsWith(
+        const HSystemAccess& other) const
+    {
+        return Overlaps(m_writes, other.m_writes) ||
+               Overlaps(m_writes, other.m_reads) ||
+               Overlaps(m_reads, other.m_writes);
+    }
+
+    // ================================================================================================================
+    void HSystemAccess::NotifyWrites(
+        entt::registry&     registry,
+        const entt::entity* pEntities,
+        const uint8_t*      pChangedFlags,
+        uint32_t            cnt) const
+    {
+        for (HPatchFunc patchFunc : m_patchFuncs)
+        {
+            patchFunc(registry, pEntities, pChangedFlags, cnt);
+        }
+    }
+
+    // ================================================================================================================
+    HSystemScheduler::HSystemScheduler()
+        : m_isStagesDirty{}
+    {}
+
+    // ================================================================================================================
+    HSystemScheduler::~HSystemScheduler()
+    {}
+
+    // ================================================================================================================
+    void HSystemScheduler::AddSystem(
+        HSystemPhase         phase,
+        const std::string&   name,
+        const HSystemAccess& access,
+        HSystemGatherFunc    gatherFunc,
+        const HSystemFunc&   func,
+        uint32_t             chunkSize)
+    {
+        assert(chunkSize > 0);
+
+        HSystem system{};
+        {
+            system.name = name;
+            system.access = access;
+            system.gatherFunc = gatherFunc;
+            system.func = func;
+            system.chunkSize = chunkSize;
+        }
+        m_systems[phase].push_back(system);
+        m_isStagesDirty[phase] = true;
+    }
+
+    // ================================================================================================================
+    void HSystemScheduler::RemoveSystem(
+        const std::string& name)
+    {
+        for (uint32_t phase = 0; phase < HSYSTEM_PHASE_CNT; phase++)
+        {
+            auto& systems = m_systems[phase];
+            auto itr = std::find_if(systems.begin(), systems.end(),
+                                    [&name](const HSystem& system) { return system.name == name; });
+            if (itr != systems.end())
+            {
+                // Keep the order of the other systems.
+                systems.erase(itr);
+                m_isStagesDirty[phase] = true;
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HSystemScheduler::BuildStages(
+        HSystemPhase phase)
+    {
+        const std::vector<HSystem>& systems = m_systems[phase];
+        std::vector<std::vector<uint32_t>>& stages = m_stages[phase];
+        stages.clear();
+
+        std::vector<uint32_t> systemsStages(systems.size());
+        for (uint32_t i = 0; i < systems.size(); i++)
+        {
+            uint32_t stage = 0;
+            for (uint32_t prev = 0; prev < i; prev++)
+            {
+                if (systems[i].access.ConflictsWith(systems[prev].access))
+                {
+                    stage = std::max(stage, systemsStages[prev] + 1);
+                }
+            }
+
+            systemsStages[i] = stage;
+            if (stage >= stages.size())
+            {
+                stages.resize(stage + 1);
+            }
+            stages[stage].push_back(i);
+        }
+
+        m_isStagesDirty[phase] = false;
+    }
+
+    // ================================================================================================================
+    void HSystemScheduler::RunPhase(
+        HSystemPhase    phase,
+        entt::registry& registry,
+        float           deltaSec)
+    {
+        std::vector<HSystem>& systems = m_systems[phase];
+        if (systems.empty())
+        {
+            return;
+        }
+
+        if (m_isStagesDirty[phase])
+        {
+            BuildStages(phase);
+        }
+
+        for (const std::vector<uint32_t>& stage : m_stages[phase])
+        {
+            // The previous stages may have changed the components that the entities are gathered by.
+            m_jobs.clear();
+            for (uint32_t systemIdx : stage)
+            {
+                HSystem& system = systems[systemIdx];
+                system.gatherFunc(registry, system.entities);
+                system.changedFlags.assign(system.entities.size(), 0);
+
+                uint32_t entitiesCnt = static_cast<uint32_t>(system.entities.size());
+                for (uint32_t begin = 0; begin < entitiesCnt; begin += system.chunkSize)
+                {
+                    m_jobs.push_back({ systemIdx, begin, std::min(begin + system.chunkSize, entitiesCnt) });
+                }
+            }
+
+            RunJobs(systems, registry, deltaSec);
+
+            // Signals are not thread safe, so the observers are notified here.
+            for (uint32_t systemIdx : stage)
+            {
+                HSystem& system = systems[systemIdx];
+                uint32_t entitiesCnt = static_cast<uint32_t>(system.entities.size());
+                system.access.NotifyWrites(registry, system.entities.data(), system.changedFlags.data(), entitiesCnt);
+            }
+        }
+    }
+
+    // ================================================================================================================
+    void HSystemScheduler::RunJobs(
+        std::vector<HSystem>& systems,
+        entt::registry&       registry,
+        float                 deltaSec)
+    {
+        // A single chunk runs on the calling thread.
+        g_pJobSystem->ParallelFor(static_cast<uint32_t>(m_jobs.size()), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t jobIdx = begin; jobIdx < end; jobIdx++)
+            {
+                const HSystemJob& job = m_jobs[jobIdx];
+                HSystem& system = systems[job.systemIdx];
+                system.func(registry,
+                            &system.entities[job.begin],
+                            &system.changedFlags[job.begin],
+                            job.end - job.begin,
+                            deltaSec);
+            }
+        });
+    }
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <entt.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A system's entities are split into chunks of this size by default. A chunk is a job of the job system.
+#define HSYSTEM_DEFAULT_CHUNK_SIZE 256
+
+namespace Hedge
+{
+    enum HSystemPhase
+    {
+        HSYSTEM_PHASE_PRE_RENDER = 0, // After the entities' PreRenderTick(...).
+        HSYSTEM_PHASE_POST_RENDER,    // After the entities' PostRenderTick(...).
+        HSYSTEM_PHASE_CNT
+    };
+
+    // Process a chunk of the system's entities. Chunks of the same system and other non-conflicting systems run at the
+    // same time on different threads. So, it must only access the declared components of the chunk's entities through
+    // registry.get<T>(...), and must not create or destroy entities, or add, remove or patch components.
+    // pChangedFlags has cnt zeros. Set the i-th flag to non-zero if the i-th entity's written components are changed.
+    using HSystemFunc = std::function<void(entt::registry&     registry,
+                                           const entt::entity* pEntities,
+                                           uint8_t*            pChangedFlags,
+                                           uint32_t            cnt,
+                                           float               deltaSec)>;
+
+    // Gather the entities that a system iterates.
+    using HSystemGatherFunc = void (*)(entt::registry& registry, std::vector<entt::entity>& oEntities);
+
+    // The components that a system reads and writes. E.g. HSystemAccess().Read<A>().Write<B, C>().
+    class HSystemAccess
+    {
+    public:
+        template<typename... T>
+        HSystemAccess& Read()
+        {
+            (m_reads.push_back(entt::type_hash<T>::value()), ...);
+            return *this;
+        }
+
+        template<typename... T>
+        HSystemAccess& Write()
+        {
+            (m_writes.push_back(entt::type_hash<T>::value()), ...);
+            (m_patchFuncs.push_back(&PatchComponents<T>), ...);
+            return *this;
+        }
+
+        // Two systems conflict if one of them writes a component that the other one reads or writes.
+        bool ConflictsWith(const HSystemAccess& other) const;
+
+        // Systems cannot patch the components on the worker threads, so the written components' update observers are
+        // notified after the system finishes. Only the entities flagged as changed by the system are notified, so the
+        // unchanged ones don't make the scene's transforms and render proxies update again.
+        void NotifyWrites(entt::registry&     registry,
+                          const entt::entity* pEntities,
+                          const uint8_t*      pChangedFlags,
+                          uint32_t            cnt) const;
+
+    private:
+        using HPatchFunc = void (*)(entt::registry&     registry,
+                                    const entt::entity* pEntities,
+                                    const uint8_t*      pChangedFlags,
+                                    uint32_t            cnt);
+
+        template<typename T>
+        static void PatchComponents(
+            entt::registry&     registry,
+            const entt::entity* pEntities,
+            const uint8_t*      pChangedFlags,
+            uint32_t            cnt)
+        {
+            for (uint32_t i = 0; i < cnt; i++)
+            {
+                if (pChangedFlags[i] && registry.all_of<T>(pEntities[i]))
+                {
+                    registry.patch<T>(pEntities[i]);
+                }
+            }
+        }
+
+        static bool Overlaps(const std::vector<entt::id_type>& a, const std::vector<entt::id_type>& b);
+
+        std::vector<entt::id_type> m_reads;
+        std::vector<entt::id_type> m_writes;
+        std::vector<HPatchFunc>    m_patchFuncs;
+    };
+
+    // Runs the registered systems of a phase on the job system.
+    // The systems of a phase are grouped into stages. A system goes into the stage after the last stage that has a
+    // conflicting system registered before it, so conflicting systems keep their registration order and the others
+    // run together. Each stage's systems are split into chunks, which are run as jobs until the stage is done.
+    class HSystemScheduler
+    {
+    public:
+        HSystemScheduler();
+        ~HSystemScheduler();
+
+        // The name must be unique.
+        void AddSystem(HSystemPhase         phase,
+                       const std::string&   name,
+                       const HSystemAccess& access,
+                       HSystemGatherFunc    gatherFunc,
+                       const HSystemFunc&   func,
+                       uint32_t             chunkSize);
+
+        void RemoveSystem(const std::string& name);
+
+        void RunPhase(HSystemPhase phase, entt::registry& registry, float deltaSec);
+
+        // The entities that have all of the components.
+        template<typename... Components>
+        static void GatherEntities(
+            entt::registry&            registry,
+            std::vector<entt::entity>& oEntities)
+        {
+            auto view = registry.view<Components...>();
+            oEntities.assign(view.begin(), view.end());
+        }
+
+    private:
+        struct HSystem
+        {
+            std::string               name;
+            HSystemAccess             access;
+            HSystemGatherFunc         gatherFunc;
+            HSystemFunc               func;
+            uint32_t                  chunkSize;
+            std::vector<entt::entity> entities;     // Gathered at the start of its stage.
+            std::vector<uint8_t>      changedFlags; // One per entity. Not a vector<bool>, because chunks write it.
+        };
+
+        struct HSystemJob
+        {
+            uint32_t systemIdx;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        void BuildStages(HSystemPhase phase);
+
+        // Run the m_jobs on the job system. Return after all of them are done.
+        void RunJobs(std::vector<HSystem>& systems, entt::registry& registry, float deltaSec);
+
+        std::vector<HSystem>               m_systems[HSYSTEM_PHASE_CNT];
+        std::vector<std::vector<uint32_t>> m_stages[HSYSTEM_PHASE_CNT]; // System indices of each stage.
+        bool                               m_isStagesDirty[HSYSTEM_PHASE_CNT];
+
+        std::vector<HSystemJob> m_jobs; // The current stage's chunks.
+    };
+}
@@ -0,0 +1,288 @@
+#include "HTransformHierarchy.h"
+#include "../util/UtilMath.h"
+#include <cassert>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+namespace Hedge
+{
+    static const float IdentityMat[16] = { 1.f, 0.f, 0.f, 0.f,
+                                           0.f, 1.f, 0.f, 0.f,
+                                           0.f, 0.f, 1.f, 0.f,
+                                           0.f, 0.f, 0.f, 1.f };
+
+    // ================================================================================================================
+    HTransformHierarchy::HTransformHierarchy()
+        : m_hasDirty(false),
+          m_isOrderDirty(false)
+    {}
+
+    // ================================================================================================================
+    HTransformHierarchy::~HTransformHierarchy()
+    {}
+
+    // ================================================================================================================
+    uint32_t HTransformHierarchy::GetNodeIdx(
+        uint32_t entity) const
+    {
+        auto itr = m_entitiesNodes.find(entity);
+        assert(itr != m_entitiesNodes.end());
+        return itr->second;
+    }
+
+    // ================================================================================================================
+    void HTransformHierarchy::AddNode(
+        uint32_t entity)
+    {
+        assert(HasNode(entity) == false);
+
+        // A root has no parent, so the order still holds.
+        m_entitiesNodes.insert({ entity, static_cast<uint32_t>(m_entities.size()) });
+        m_entities.push_back(entity);
+        m_parents.push_back(HTRANSFORM_NO_PARENT);
+        m_localMats.insert(m_localMats.end(), IdentityMat, IdentityMat + 16);
+        m_worldMats.insert(m_worldMats.end(), IdentityMat, IdentityMat + 16);
+        m_dirty.push_back(1);
+        m_hasDirty = true;
+    }
+
+    // ================================================================================================================
+    void HTransformHierarchy::RemoveNode(
+        uint32_t entity)
+    {
+        uint32_t nodeIdx = GetNodeIdx(entity);
+        uint32_t lastIdx = static_cast<uint32_t>(m_entities.size()) - 1;
+
+        for (uint32_t i = 0; i < m_parents.size(); i++)
+        {
+            if (m_parents[i] == nodeIdx)
+            {
+                m_parents[i] = HTRANSFORM_NO_PARENT;
+                m_dirty[i] = 1;
+                m_hasDirty = true;
+            }
+        }
+
+        // Move the last node into the hole. It may be before its parent or after its children now.
+        if (nodeIdx != lastIdx)
+        {
+            for (uint32_t i = 0; i < m_parents.size(); i++)
+            {
+                if (m_parents[i] == lastIdx)
+                {
+                    m_parents[i] = nodeIdx;
+                }
+            }
+
+            m_entities[nodeIdx] = m_entities[lastIdx];
+            m_parents[nodeIdx] = m_parents[lastIdx];
+            memcpy(&m_localMats[16 * nodeIdx], &m_localMats[16 * lastIdx], 16 * sizeof(float));
+            memcpy(&m_worldMats[16 * nodeIdx], &m_worldMats[16 * lastIdx], 16 * sizeof(float));
+            m_dirty[nodeIdx] = m_dirty[lastIdx];
+            m_entitiesNodes[m_entities[nodeIdx]] = nodeIdx;
+            m_isOrderDirty = true;
+        }
+
+        m_entities.pop_back();
+        m_parents.pop_back();
+        m_localMats.resize(16 * lastIdx);
+        m_worldMats.resize(16 * lastIdx);
+        m_dirty.pop_back();
+        m_entitiesNodes.erase(entity);
+    }
+
+    // ================================================================================================================
+    bool HTransformHierarchy::SetParent(
+        uint32_t entity,
+        uint32_t parentEntity)
+    {
+        uint32_t nodeIdx = GetNodeIdx(entity);
+        uint32_t parentIdx = HTRANSFORM_NO_PARENT;
+
+        if (parentEntity != HTRANSFORM_NO_PARENT)
+        {
+            auto itr = m_entitiesNodes.find(parentEntity);
+            if (itr == m_entitiesNodes.end())
+            {
+                return false;
+            }
+            parentIdx = itr->second;
+
+            // Walk up from the new parent. Meeting the node means a cycle.
+            for (uint32_t ancestor = parentIdx; ancestor != HTRANSFORM_NO_PARENT; ancestor = m_parents[ancestor])
+            {
+                if (ancestor == nodeIdx)
+                {
+                    return false;
+                }
+            }
+        }
+
+        if (m_parents[nodeIdx] != parentIdx)
+        {
+            m_parents[nodeIdx] = parentIdx;
+            m_dirty[nodeIdx] = 1;
+            m_hasDirty = true;
+
+            if ((parentIdx != HTRANSFORM_NO_PARENT) && (parentIdx > nodeIdx))
+            {
+                m_isOrderDirty = true;
+            }
+        }
+
+        return true;
+    }
+
+    // ================================================================================================================
+    uint32_t HTransformHierarchy::GetParent(
+        uint32_t entity) const
+    {
+        uint32_t parentIdx = m_parents[GetNodeIdx(entity)];
+        return (parentIdx == HTRANSFORM_NO_PARENT) ? HTRANSFORM_NO_PARENT : m_entities[parentIdx];
+    }
+
+    // ================================================================================================================
+    void HTransformHierarchy::SetLocalMat(
+        uint32_t     entity,
+        const float* pLocalMat)
+    {
+        uint32_t nodeIdx = GetNodeIdx(entity);
+        memcpy(&m_localMats[16 * nodeIdx], pLocalMat, 16 * sizeof(float));
+        m_dirty[nodeIdx] = 1;
+        m_hasDirty = true;
+    }
+
+    // ================================================================================================================
+    const float* HTransformHierarchy::GetWorldMat(
+        uint32_t entity) const
+    {
+        return &m_worldMats[16 * GetNodeIdx(entity)];
+    }
+
+    // ================================================================================================================
+    void HTransformHierarchy::SortNodes()
+    {
+        uint32_t nodesCnt = static_cast<uint32_t>(m_entities.size());
+
+        // The parents may be after their children, so walk up the chains and stop at the known depths.
+        std::vector<uint32_t> depths(nodesCnt, UINT32_MAX);
+        std::vector<uint32_t> chain;
+        for (uint32_t i = 0; i < nodesCnt; i++)
+        {
+            uint32_t node = i;
+            while ((node != HTRANSFORM_NO_PARENT) && (depths[node] == UINT32_MAX))
+            {
+                chain.push_back(node);
+                node = m_parents[node];
+            }
+
+            uint32_t depth = (node == HTRANSFORM_NO_PARENT) ? 0 : (depths[node] + 1);
+            for (auto itr = chain.rbegin(); itr != chain.rend(); itr++)
+            {
+                depths[*itr] = depth++;
+            }
+            chain.clear();
+        }
+
+        std::vector<uint32_t> order(nodesCnt);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&depths](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+
+        std::vector<uint32_t> newIndices(nodesCnt);
+        for (uint32_t i = 0; i < nodesCnt; i++)
+        {
+            newIndices[order[i]] = i;
+        }
+
+        std::vector<uint32_t> entities(nodesCnt);
+        std::vector<uint32_t> parents(nodesCnt);
+        std::vector<float>    localMats(16 * nodesCnt);
+        std::vector<float>    worldMats(16 * nodesCnt);
+        std::vector<uint8_t>  dirty(nodesCnt);
+        for (uint32_t i = 0; i < nodesCnt; i++)
+        {
+            uint32_t oldIdx = order[i];
+            uint32_t oldParent = m_parents[oldIdx];
+
+            entities[i] = m_entities[oldIdx];
+            parents[i] = (oldParent == HTRANSFORM_NO_PARENT) ? HTRANSFORM_NO_PARENT : newIndices[oldParent];
+            memcpy(&localMats[16 * i], &m_localMats[16 * oldIdx], 16 * sizeof(float));
+            memcpy(&worldMats[16 * i], &m_worldMats[16 * oldIdx], 16 * sizeof(float));
+            dirty[i] = m_dirty[oldIdx];
+            m_entitiesNodes[entities[i]] = i;
+        }
+
+        m_entities.swap(entities);
+        m_parents.swap(parents);
+        m_localMats.swap(localMats);
+        m_worldMats.swap(worldMats);
+        m_dirty.swap(dirty);
+
+        m_isOrderDirty = false;
+    }
+
+    // ================================================================================================================
+    void HTransformHierarchy::UpdateWorldMats(
+        std::vector<uint32_t>& oChangedEntities,
+        std::vector<float>*    pOldWorldMats)
+    {
+        if (m_isOrderDirty)
+        {
+            SortNodes();
+        }
+
+        if (m_hasDirty == false)
+        {
+            return;
+        }
+
+        // A parent is updated before its children, so its dirty flag already covers its whole subtree.
+        for (uint32_t i = 0; i < m_entities.size(); i++)
+        {
+            uint32_t parentIdx = m_parents[i];
+            if ((parentIdx != HTRANSFORM_NO_PARENT) && m_dirty[parentIdx])
+            {
+                m_dirty[i] = 1;
+            }
+
+            if (m_dirty[i] == 0)
+            {
+                continue;
+            }
+
+            if (pOldWorldMats)
+            {
+                pOldWorldMats->insert(pOldWorldMats->end(), &m_worldMats[16 * i], &m_worldMats[16 * i] + 16);
+            }
+
+            if (parentIdx == HTRANSFORM_NO_PARENT)
+            {
+                memcpy(&m_worldMats[16 * i], &m_localMats[16 * i], 16 * sizeof(float));
+            }
+            else
+            {
+                MatrixMul4x4(&m_worldMats[16 * parentIdx], &m_localMats[16 * i], &m_worldMats[16 * i]);
+            }
+
+            oChangedEntities.push_back(m_entities[i]);
+        }
+
+        memset(m_dirty.data(), 0, m_dirty.size());
+        m_hasDirty = false;
+    }
+
+    // ================================================================================================================
+    void HTransformHierarchy::Clear()
+    {
+        m_entities.clear();
+        m_parents.clear();
+        m_localMats.clear();
+        m_worldMats.clear();
+        m_dirty.clear();
+        m_entitiesNodes.clear();
+        m_hasDirty = false;
+        m_isOrderDirty = false;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Hedge
+{
+    constexpr uint32_t HTRANSFORM_NO_PARENT = UINT32_MAX;
+
+    // Parent-child relationships of the scene's transforms and their cached world matrices.
+    // Nodes live in contiguous arrays where a parent is always before its children. The arrays are sorted by the
+    // depth (breadth-first order) when the structure changes, so a single linear pass can propagate the dirty flags
+    // from parents to children and only the changed subtrees are recomputed.
+    // Each node is keyed by its entity handle. Matrices are 16 floats, row major, like the GenModelMat(...).
+    class HTransformHierarchy
+    {
+    public:
+        HTransformHierarchy();
+        ~HTransformHierarchy();
+
+        // The new node is a root with an identity local matrix.
+        void AddNode(uint32_t entity);
+
+        // The node's children become roots. Their local matrices stay, so they are relative to the world afterwards.
+        void RemoveNode(uint32_t entity);
+
+        bool HasNode(uint32_t entity) const { return m_entitiesNodes.count(entity) != 0; }
+
+        // HTRANSFORM_NO_PARENT detaches the node. Return false if the parent is not in the hierarchy or the node is
+        // the parent itself or one of its ancestors.
+        bool SetParent(uint32_t entity, uint32_t parentEntity);
+        uint32_t GetParent(uint32_t entity) const;
+
+        void SetLocalMat(uint32_t entity, const float* pLocalMat);
+
+        // Recompute the world matrices of the dirty nodes and their descendants. Their entities are appended to the
+        // output vector. The optional pOldWorldMats gets their world matrices before the update in the same order.
+        void UpdateWorldMats(std::vector<uint32_t>& oChangedEntities, std::vector<float>* pOldWorldMats = nullptr);
+
+        // The world matrix at the last UpdateWorldMats(...).
+        const float* GetWorldMat(uint32_t entity) const;
+
+        uint32_t GetNodesCnt() const { return static_cast<uint32_t>(m_entities.size()); }
+
+        void Clear();
+
+    private:
+        // Stable sort the nodes by their depths and remap the parents' indices.
+        void SortNodes();
+
+        uint32_t GetNodeIdx(uint32_t entity) const;
+
+        std::vector<uint32_t> m_entities;
+        std::vector<uint32_t> m_parents;   // Node indices. HTRANSFORM_NO_PARENT for roots.
+        std::vector<float>    m_localMats; // 16 floats per node.
+        std::vector<float>    m_worldMats;
+        std::vector<uint8_t>  m_dirty;
+
+        std::unordered_map<uint32_t, uint32_t> m_entitiesNodes; // Entity handle -> Node index.
+
+        bool m_hasDirty;
+        bool m_isOrderDirty; // A parent may be after its children.
+    };
+}
@@ -2,6 +2,11 @@
 #include <math.h>
 #include <cstring>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEDGE_MATH_SSE
+#endif
+
 namespace Hedge
 {
     // TODO: The calculation is incorrect. The pView is not equivalent to camera space's z.
@@ -79,6 +84,180 @@ namespace Hedge
         pResMat[8] = cosf(pitch) * cosf(head);
     }
 
+    void HTransformSoA::Push(
+        const float* pPos,
+        const float* pRot,
+        const float* pScale)
+    {
+        posX.push_back(pPos[0]);
+        posY.push_back(pPos[1]);
+        posZ.push_back(pPos[2]);
+        pitch.push_back(pRot[0]);
+        head.push_back(pRot[1]);
+        roll.push_back(pRot[2]);
+        scaleX.push_back(pScale[0]);
+        scaleY.push_back(pScale[1]);
+        scaleZ.push_back(pScale[2]);
+    }
+
+    void HTransformSoA::Clear()
+    {
+        posX.clear();
+        posY.clear();
+        posZ.clear();
+        pitch.clear();
+        head.clear();
+        roll.clear();
+        scaleX.clear();
+        scaleY.clear();
+        scaleZ.clear();
+    }
+
+#ifdef HEDGE_MATH_SSE
+    // Sine and cosine of 4 floats. (Cephes sinf/cosf, as in the sse_mathfun)
+    // The input is reduced to [-pi/4, pi/4] by its octant and both polynomials are evaluated, then the octant picks
+    // the polynomial and the sign of each output.
+    static inline void SinCos4(
+        __m128  x,
+        __m128& oSin,
+        __m128& oCos)
+    {
+        const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+        __m128 sinSign = _mm_and_ps(x, signMask);
+        x = _mm_andnot_ps(signMask, x);
+
+        // Octant j is rounded up to an even number.
+        __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+        j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+        __m128 y = _mm_cvtepi32_ps(j);
+
+        __m128 sinSwapSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+        __m128 cosSign = _mm_castsi128_ps(
+            _mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+        __m128 polyMask = _mm_castsi128_ps(
+            _mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+        sinSign = _mm_xor_ps(sinSign, sinSwapSign);
+
+        // Extended precision x - j * pi / 4.
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+
+        __m128 z = _mm_mul_ps(x, x);
+
+        __m128 cosPoly = _mm_set1_ps(2.443315711809948e-5f);
+        cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(-1.388731625493765e-3f));
+        cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(4.166664568298827e-2f));
+        cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+        cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.f));
+
+        __m128 sinPoly = _mm_set1_ps(-1.9515295891e-4f);
+        sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(8.3321608736e-3f));
+        sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(-1.6666654611e-1f));
+        sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+        __m128 sinRes = _mm_or_ps(_mm_and_ps(polyMask, sinPoly), _mm_andnot_ps(polyMask, cosPoly));
+        __m128 cosRes = _mm_or_ps(_mm_and_ps(polyMask, cosPoly), _mm_andnot_ps(polyMask, sinPoly));
+
+        oSin = _mm_xor_ps(sinRes, sinSign);
+        oCos = _mm_xor_ps(cosRes, cosSign);
+    }
+#endif
+
+    void GenModelMats(
+        const HTransformSoA& transforms,
+        float*               pResMats)
+    {
+        uint32_t cnt = transforms.GetCnt();
+        uint32_t i = 0;
+
+#ifdef HEDGE_MATH_SSE
+        const __m128 lastRow = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+        for (; i + 4 <= cnt; i += 4)
+        {
+            __m128 sr, cr, sp, cp, sh, ch;
+            SinCos4(_mm_loadu_ps(&transforms.roll[i]), sr, cr);
+            SinCos4(_mm_loadu_ps(&transforms.pitch[i]), sp, cp);
+            SinCos4(_mm_loadu_ps(&transforms.head[i]), sh, ch);
+
+            __m128 sx = _mm_loadu_ps(&transforms.scaleX[i]);
+            __m128 sy = _mm_loadu_ps(&transforms.scaleY[i]);
+            __m128 sz = _mm_loadu_ps(&transforms.scaleZ[i]);
+
+            // The GenRotationMat(...)'s elements with each column scaled.
+            __m128 spsh = _mm_mul_ps(sp, sh);
+            __m128 spch = _mm_mul_ps(sp, ch);
+
+            __m128 row0[4], row1[4], row2[4];
+            row0[0] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(cr, ch), _mm_mul_ps(sr, spsh)), sx);
+            row0[1] = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(sr, cp)), sy);
+            row0[2] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cr, sh), _mm_mul_ps(sr, spch)), sz);
+            row0[3] = _mm_loadu_ps(&transforms.posX[i]);
+
+            row1[0] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(sr, ch), _mm_mul_ps(cr, spsh)), sx);
+            row1[1] = _mm_mul_ps(_mm_mul_ps(cr, cp), sy);
+            row1[2] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sr, sh), _mm_mul_ps(cr, spch)), sz);
+            row1[3] = _mm_loadu_ps(&transforms.posY[i]);
+
+            row2[0] = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(cp, sh)), sx);
+            row2[1] = _mm_mul_ps(sp, sy);
+            row2[2] = _mm_mul_ps(_mm_mul_ps(cp, ch), sz);
+            row2[3] = _mm_loadu_ps(&transforms.posZ[i]);
+
+            // Each register holds one element of 4 matrices. Transpose them into the 4 matrices' rows.
+            _MM_TRANSPOSE4_PS(row0[0], row0[1], row0[2], row0[3]);
+            _MM_TRANSPOSE4_PS(row1[0], row1[1], row1[2], row1[3]);
+            _MM_TRANSPOSE4_PS(row2[0], row2[1], row2[2], row2[3]);
+
+            for (uint32_t m = 0; m < 4; m++)
+            {
+                float* pMat = &pResMats[16 * (i + m)];
+                _mm_storeu_ps(pMat, row0[m]);
+                _mm_storeu_ps(pMat + 4, row1[m]);
+                _mm_storeu_ps(pMat + 8, row2[m]);
+                _mm_storeu_ps(pMat + 12, lastRow);
+            }
+        }
+#endif
+
+        // Scalar tail or the fallback without SSE.
+        for (; i < cnt; i++)
+        {
+            float sr = sinf(transforms.roll[i]);
+            float cr = cosf(transforms.roll[i]);
+            float sp = sinf(transforms.pitch[i]);
+            float cp = cosf(transforms.pitch[i]);
+            float sh = sinf(transforms.head[i]);
+            float ch = cosf(transforms.head[i]);
+
+            float sx = transforms.scaleX[i];
+            float sy = transforms.scaleY[i];
+            float sz = transforms.scaleZ[i];
+
+            float* pMat = &pResMats[16 * i];
+            pMat[0] = (cr * ch - sr * sp * sh) * sx;
+            pMat[1] = -sr * cp * sy;
+            pMat[2] = (cr * sh + sr * sp * ch) * sz;
+            pMat[3] = transforms.posX[i];
+
+            pMat[4] = (sr * ch + cr * sp * sh) * sx;
+            pMat[5] = cr * cp * sy;
+            pMat[6] = (sr * sh - cr * sp * ch) * sz;
+            pMat[7] = transforms.posY[i];
+
+            pMat[8] = -cp * sh * sx;
+            pMat[9] = sp * sy;
+            pMat[10] = cp * ch * sz;
+            pMat[11] = transforms.posZ[i];
+
+            pMat[12] = 0.f;
+            pMat[13] = 0.f;
+            pMat[14] = 0.f;
+            pMat[15] = 1.f;
+        }
+    }
+
     void GenModelMat(
         float* pPos, 
         float roll, 
@@ -165,4 +344,189 @@ namespace Hedge
         }
         return false;
     }
+
+    void GenFrustumPlanes(
+        const float* pVpMat,
+        float*       pPlanes)
+    {
+        const float* row0 = &pVpMat[0];
+        const float* row1 = &pVpMat[4];
+        const float* row2 = &pVpMat[8];
+        const float* row3 = &pVpMat[12];
+
+        for (int j = 0; j < 4; j++)
+        {
+            pPlanes[0 * 4 + j] = row3[j] + row0[j]; // Left
+            pPlanes[1 * 4 + j] = row3[j] - row0[j]; // Right
+            pPlanes[2 * 4 + j] = row3[j] + row1[j]; // Bottom
+            pPlanes[3 * 4 + j] = row3[j] - row1[j]; // Top
+            pPlanes[4 * 4 + j] = row2[j];           // z >= 0
+            pPlanes[5 * 4 + j] = row3[j] - row2[j]; // z <= w
+        }
+
+        for (int i = 0; i < 6; i++)
+        {
+            float* pPlane = &pPlanes[i * 4];
+            float len = sqrtf(pPlane[0] * pPlane[0] + pPlane[1] * pPlane[1] + pPlane[2] * pPlane[2]);
+            if (len > 0.f)
+            {
+                ScalarMul(1.f / len, pPlane, 4);
+            }
+        }
+    }
+
+    void TransformBoundingSphere(
+        const float* pModelMat,
+        const float* pSphere,
+        float*       pResSphere)
+    {
+        float center[4] = { pSphere[0], pSphere[1], pSphere[2], 1.f };
+        float worldCenter[4] = {};
+        MatMulVec(pModelMat, center, 4, worldCenter);
+
+        float maxScaleSq = 0.f;
+        for (int col = 0; col < 3; col++)
+        {
+            float scaleSq = pModelMat[col] * pModelMat[col] +
+                            pModelMat[4 + col] * pModelMat[4 + col] +
+                            pModelMat[8 + col] * pModelMat[8 + col];
+            maxScaleSq = scaleSq > maxScaleSq ? scaleSq : maxScaleSq;
+        }
+
+        memcpy(pResSphere, worldCenter, 3 * sizeof(float));
+        pResSphere[3] = pSphere[3] * sqrtf(maxScaleSq);
+    }
+
+    void TransformAabb(
+        const float* pModelMat,
+        const float* pMin,
+        const float* pMax,
+        float*       pResMin,
+        float*       pResMax)
+    {
+        // New center = M * center. New extent_i = sum_j(|M_ij| * extent_j).
+        for (int row = 0; row < 3; row++)
+        {
+            float center = pModelMat[row * 4 + 3];
+            float extent = 0.f;
+            for (int col = 0; col < 3; col++)
+            {
+                float m = pModelMat[row * 4 + col];
+                center += m * (pMin[col] + pMax[col]) * 0.5f;
+                extent += fabsf(m) * (pMax[col] - pMin[col]) * 0.5f;
+            }
+            pResMin[row] = center - extent;
+            pResMax[row] = center + extent;
+        }
+    }
+
+    void FrustumCullSpheres(
+        const float* pPlanes,
+        const float* pCenterX,
+        const float* pCenterY,
+        const float* pCenterZ,
+        const float* pRadius,
+        uint32_t     cnt,
+        uint8_t*     pVisible)
+    {
+        uint32_t i = 0;
+
+#ifdef HEDGE_MATH_SSE
+        // Broadcast each plane's components once. Each iteration tests 4 spheres against all 6 planes.
+        __m128 planeX[6], planeY[6], planeZ[6], planeD[6];
+        for (int p = 0; p < 6; p++)
+        {
+            planeX[p] = _mm_set1_ps(pPlanes[p * 4]);
+            planeY[p] = _mm_set1_ps(pPlanes[p * 4 + 1]);
+            planeZ[p] = _mm_set1_ps(pPlanes[p * 4 + 2]);
+            planeD[p] = _mm_set1_ps(pPlanes[p * 4 + 3]);
+        }
+
+        for (; i + 4 <= cnt; i += 4)
+        {
+            __m128 cx = _mm_loadu_ps(&pCenterX[i]);
+            __m128 cy = _mm_loadu_ps(&pCenterY[i]);
+            __m128 cz = _mm_loadu_ps(&pCenterZ[i]);
+            __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&pRadius[i]));
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, planeX[p]), _mm_mul_ps(cy, planeY[p])),
+                                         _mm_add_ps(_mm_mul_ps(cz, planeZ[p]), planeD[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negR));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            pVisible[i]     = (mask >> 0) & 1;
+            pVisible[i + 1] = (mask >> 1) & 1;
+            pVisible[i + 2] = (mask >> 2) & 1;
+            pVisible[i + 3] = (mask >> 3) & 1;
+        }
+#endif
+
+        // Scalar tail or the fallback without SSE.
+        for (; i < cnt; i++)
+        {
+            uint8_t inside = 1;
+            for (int p = 0; p < 6; p++)
+            {
+                const float* pPlane = &pPlanes[p * 4];
+                float dist = pCenterX[i] * pPlane[0] + pCenterY[i] * pPlane[1] + pCenterZ[i] * pPlane[2] + pPlane[3];
+                if (dist < -pRadius[i])
+                {
+                    inside = 0;
+                    break;
+                }
+            }
+            pVisible[i] = inside;
+        }
+    }
+
+    void SphereOverlapAabbs(
+        const float* pSphere,
+        const float* pMinX,
+        const float* pMinY,
+        const float* pMinZ,
+        const float* pMaxX,
+        const float* pMaxY,
+        const float* pMaxZ,
+        uint32_t     cnt,
+        uint8_t*     pOverlap)
+    {
+        uint32_t i = 0;
+        float radiusSq = pSphere[3] * pSphere[3];
+
+#ifdef HEDGE_MATH_SSE
+        // The squared distance from the sphere center to the closest point on each AABB.
+        __m128 cx = _mm_set1_ps(pSphere[0]);
+        __m128 cy = _mm_set1_ps(pSphere[1]);
+        __m128 cz = _mm_set1_ps(pSphere[2]);
+        __m128 rSq = _mm_set1_ps(radiusSq);
+
+        for (; i + 4 <= cnt; i += 4)
+        {
+            __m128 dx = _mm_sub_ps(_mm_max_ps(_mm_loadu_ps(&pMinX[i]), _mm_min_ps(cx, _mm_loadu_ps(&pMaxX[i]))), cx);
+            __m128 dy = _mm_sub_ps(_mm_max_ps(_mm_loadu_ps(&pMinY[i]), _mm_min_ps(cy, _mm_loadu_ps(&pMaxY[i]))), cy);
+            __m128 dz = _mm_sub_ps(_mm_max_ps(_mm_loadu_ps(&pMinZ[i]), _mm_min_ps(cz, _mm_loadu_ps(&pMaxZ[i]))), cz);
+
+            __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+            int mask = _mm_movemask_ps(_mm_cmple_ps(distSq, rSq));
+            pOverlap[i]     = (mask >> 0) & 1;
+            pOverlap[i + 1] = (mask >> 1) & 1;
+            pOverlap[i + 2] = (mask >> 2) & 1;
+            pOverlap[i + 3] = (mask >> 3) & 1;
+        }
+#endif
+
+        // Scalar tail or the fallback without SSE.
+        for (; i < cnt; i++)
+        {
+            float dx = fmaxf(pMinX[i], fminf(pSphere[0], pMaxX[i])) - pSphere[0];
+            float dy = fmaxf(pMinY[i], fminf(pSphere[1], pMaxY[i])) - pSphere[1];
+            float dz = fmaxf(pMinZ[i], fminf(pSphere[2], pMaxZ[i])) - pSphere[2];
+            pOverlap[i] = (dx * dx + dy * dy + dz * dz) <= radiusSq ? 1 : 0;
+        }
+    }
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include <cstdint>
+#include <cmath>
+#include <vector>
 
 // TODO: Dim can be put into template for optimization.
 namespace Hedge
@@ -155,8 +157,64 @@ namespace Hedge
 
     void GenRotationMat(float roll, float pitch, float head, float* pResMat);
 
+    // Transforms in the SoA layout for the batched model matrices generation. The rotations are in radians.
+    struct HTransformSoA
+    {
+        std::vector<float> posX;
+        std::vector<float> posY;
+        std::vector<float> posZ;
+        std::vector<float> pitch;
+        std::vector<float> head;
+        std::vector<float> roll;
+        std::vector<float> scaleX;
+        std::vector<float> scaleY;
+        std::vector<float> scaleZ;
+
+        // pRot is [pitch, head, roll] like the TransformComponent's m_rot.
+        void Push(const float* pPos, const float* pRot, const float* pScale);
+        void Clear();
+        uint32_t GetCnt() const { return static_cast<uint32_t>(posX.size()); }
+    };
+
+    // The same matrices as the GenModelMat(...), 16 floats per transform in the pResMats. The rotation's columns are
+    // scaled directly instead of multiplying the TR and the S matrices. SSE generates 4 matrices per iteration with a
+    // polynomial sin/cos, whose error is around the float's epsilon.
+    void GenModelMats(const HTransformSoA& transforms, float* pResMats);
+
     // Realtime rendering -- P75 -- Eqn(4.30)
     void GenRotationMatArb(float* axis, float radien, float* pResMat);
 
     bool AABBCubeSphereIntersection(float* cubeMin, float* cubeMax, float* sphereCenter, float sphereRadius, float* nearPoint);
+
+    // Extract 6 normalized planes (nx, ny, nz, d) from a row major view-perspective matrix (Gribb-Hartmann).
+    // Normals point inside. The clip space is 0 <= z <= w, so it works for both the normal and the reversed depth.
+    void GenFrustumPlanes(const float* pVpMat, float* pPlanes);
+
+    // Transform a model space bounding sphere (cx, cy, cz, r). The radius is scaled by the largest axis scale.
+    void TransformBoundingSphere(const float* pModelMat, const float* pSphere, float* pResSphere);
+
+    // Transform a model space AABB and output the world space AABB that encloses it. (Arvo, Graphics Gems 1990)
+    void TransformAabb(const float* pModelMat, const float* pMin, const float* pMax, float* pResMin, float* pResMax);
+
+    // Test spheres in the SoA layout against the frustum planes. SSE tests 4 spheres per iteration.
+    // pVisible[i] is 1 if the sphere i intersects or is inside the frustum, otherwise 0.
+    void FrustumCullSpheres(const float* pPlanes,
+                            const float* pCenterX,
+                            const float* pCenterY,
+                            const float* pCenterZ,
+                            const float* pRadius,
+                            uint32_t     cnt,
+                            uint8_t*     pVisible);
+
+    // Test one sphere (cx, cy, cz, r) against AABBs in the SoA layout. SSE tests 4 AABBs per iteration.
+    // pOverlap[i] is 1 if the sphere overlaps the AABB i, otherwise 0.
+    void SphereOverlapAabbs(const float* pSphere,
+                            const float* pMinX,
+                            const float* pMinY,
+                            const float* pMinZ,
+                            const float* pMaxX,
+                            const float* pMaxY,
+                            const float* pMaxZ,
+                            uint32_t     cnt,
+                            uint8_t*     pOverlap);
 }
\ No newline at end of file
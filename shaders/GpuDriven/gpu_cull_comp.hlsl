@@ -0,0 +1,137 @@
+#pragma pack_matrix(row_major)
+
+#include <InstanceData.hlsl>
+
+// NOTE: [[vk::binding(X[, Y])]] -- X: binding number, Y: descriptor set.
+
+// Matches the GpuDrivenObjData on the host.
+struct ObjectData
+{
+    float4x4 modelMat;
+    float4   boundingSphere; // Model space center xyz and radius.
+    uint4    materialIdx;
+    uint     batchIdx;
+    uint     instanceBaseIdx;
+    uint2    padding;
+};
+
+// Matches the GpuDrivenBatchData on the host.
+struct BatchData
+{
+    uint indexCount;
+    uint firstIndex;    // In the merged index buffer.
+    int  vertexOffset;  // In the merged vertex buffer.
+    uint instanceBaseIdx;
+    uint permutation;   // The draw count of the batch's pipeline permutation.
+    uint drawCmdBase;   // The permutation's first draw command.
+    uint2 padding;
+};
+
+// Same as the VkDrawIndexedIndirectCommand.
+struct DrawIndexedIndirectCmd
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int  vertexOffset;
+    uint firstInstance;
+};
+
+// Matches the GpuCullPushConstant on the host.
+struct CullInfo
+{
+    float4 frustumPlanes[6]; // World space. Normal points inside.
+    uint   objCnt;
+    uint   batchCnt;
+    uint   pass;             // HGpuCullPass.
+};
+
+#define HGPU_CULL_PASS_OBJS          0
+#define HGPU_CULL_PASS_COMPACT_DRAWS 1
+
+[[vk::binding(0, 0)]] StructuredBuffer<ObjectData>               i_objects;
+[[vk::binding(1, 0)]] RWStructuredBuffer<DrawIndexedIndirectCmd> o_drawCmds;
+[[vk::binding(2, 0)]] RWStructuredBuffer<uint>                   o_drawCnts;
+[[vk::binding(3, 0)]] RWStructuredBuffer<InstanceData>           o_visibleInstances;
+[[vk::binding(4, 0)]] StructuredBuffer<BatchData>                i_batches;
+[[vk::binding(5, 0)]] RWStructuredBuffer<uint>                   o_batchInstCnts;
+
+[[vk::push_constant]] CullInfo i_cullInfo;
+
+// One thread per object. A visible object appends itself to its batch's instances and bumps the batch's instance count.
+void CullObject(
+    uint objIdx)
+{
+    if (objIdx >= i_cullInfo.objCnt)
+    {
+        return;
+    }
+
+    ObjectData obj = i_objects[objIdx];
+
+    float3 center = mul(obj.modelMat, float4(obj.boundingSphere.xyz, 1.0)).xyz;
+
+    float3 scaleX = float3(obj.modelMat[0][0], obj.modelMat[1][0], obj.modelMat[2][0]);
+    float3 scaleY = float3(obj.modelMat[0][1], obj.modelMat[1][1], obj.modelMat[2][1]);
+    float3 scaleZ = float3(obj.modelMat[0][2], obj.modelMat[1][2], obj.modelMat[2][2]);
+    float maxScale = max(length(scaleX), max(length(scaleY), length(scaleZ)));
+    float radius = obj.boundingSphere.w * maxScale;
+
+    for (uint i = 0; i < 6; i++)
+    {
+        float4 plane = i_cullInfo.frustumPlanes[i];
+        if (dot(plane.xyz, center) + plane.w < -radius)
+        {
+            return;
+        }
+    }
+
+    uint slot;
+    InterlockedAdd(o_batchInstCnts[obj.batchIdx], 1, slot);
+    o_visibleInstances[obj.instanceBaseIdx + slot].modelMat = obj.modelMat;
+    o_visibleInstances[obj.instanceBaseIdx + slot].materialIdx = obj.materialIdx;
+}
+
+// One thread per batch, after all objects are culled. A batch with visible instances appends its draw command to its
+// permutation's draw commands, so each permutation is one indirect count draw of only the visible batches.
+void CompactDraw(
+    uint batchIdx)
+{
+    if (batchIdx >= i_cullInfo.batchCnt)
+    {
+        return;
+    }
+
+    uint instCnt = o_batchInstCnts[batchIdx];
+    if (instCnt == 0)
+    {
+        return;
+    }
+
+    BatchData batch = i_batches[batchIdx];
+
+    uint drawSlot;
+    InterlockedAdd(o_drawCnts[batch.permutation], 1, drawSlot);
+
+    DrawIndexedIndirectCmd drawCmd;
+    drawCmd.indexCount = batch.indexCount;
+    drawCmd.instanceCount = instCnt;
+    drawCmd.firstIndex = batch.firstIndex;
+    drawCmd.vertexOffset = batch.vertexOffset;
+    drawCmd.firstInstance = batch.instanceBaseIdx;
+    o_drawCmds[batch.drawCmdBase + drawSlot] = drawCmd;
+}
+
+[numthreads(64, 1, 1)]
+void main(
+    uint3 i_dispatchThreadId : SV_DispatchThreadID)
+{
+    if (i_cullInfo.pass == HGPU_CULL_PASS_OBJS)
+    {
+        CullObject(i_dispatchThreadId.x);
+    }
+    else
+    {
+        CompactDraw(i_dispatchThreadId.x);
+    }
+}
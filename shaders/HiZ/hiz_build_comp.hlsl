@@ -0,0 +1,60 @@
+#pragma pack_matrix(row_major)
+
+// NOTE: [[vk::binding(X[, Y])]] -- X: binding number, Y: descriptor set.
+
+// Matches the HiZBuildPushConstant on the host.
+struct HiZLevelInfo
+{
+    uint srcWidth;
+    uint srcHeight;
+    uint srcOffset;   // Unused for the base level.
+    uint dstWidth;
+    uint dstHeight;
+    uint dstOffset;
+    uint footprint;   // A destination texel covers footprint x footprint source texels.
+    uint isBaseLevel; // The base level reads the depth texture instead of the pyramid.
+};
+
+[[vk::binding(0, 0)]] Texture2D<float> i_depthTexture;
+[[vk::binding(0, 0)]] SamplerState     i_depthSamplerState;
+
+// All levels of the pyramid. Each level is a row major width x height array starting from its offset.
+[[vk::binding(1, 0)]] RWStructuredBuffer<float> io_pyramid;
+
+[[vk::push_constant]] HiZLevelInfo i_levelInfo;
+
+// One thread per destination texel. A texel keeps the farthest depth of its footprint. The depth is reversed, so the
+// farthest depth is the min depth. Footprints on the right and the bottom edges are clamped into the source.
+[numthreads(8, 8, 1)]
+void main(
+    uint3 i_dispatchThreadId : SV_DispatchThreadID)
+{
+    uint2 dstCoord = i_dispatchThreadId.xy;
+    if ((dstCoord.x >= i_levelInfo.dstWidth) || (dstCoord.y >= i_levelInfo.dstHeight))
+    {
+        return;
+    }
+
+    uint2 srcBegin = dstCoord * i_levelInfo.footprint;
+    uint2 srcEnd = min(srcBegin + i_levelInfo.footprint, uint2(i_levelInfo.srcWidth, i_levelInfo.srcHeight));
+
+    float farthestDepth = 1.0;
+    for (uint y = srcBegin.y; y < srcEnd.y; y++)
+    {
+        for (uint x = srcBegin.x; x < srcEnd.x; x++)
+        {
+            float depth = 0.0;
+            if (i_levelInfo.isBaseLevel != 0)
+            {
+                depth = i_depthTexture.Load(int3(x, y, 0));
+            }
+            else
+            {
+                depth = io_pyramid[i_levelInfo.srcOffset + y * i_levelInfo.srcWidth + x];
+            }
+            farthestDepth = min(farthestDepth, depth);
+        }
+    }
+
+    io_pyramid[i_levelInfo.dstOffset + dstCoord.y * i_levelInfo.dstWidth + dstCoord.x] = farthestDepth;
+}
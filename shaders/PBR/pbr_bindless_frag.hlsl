@@ -0,0 +1,160 @@
+#pragma pack_matrix(row_major)
+
+#include <GGXModel.hlsl>
+#include <ClusteredLights.hlsl>
+
+// NOTE: [[vk::binding(X[, Y])]] -- X: binding number, Y: descriptor set.
+
+// Permutation defines. The GenerateShaderHeader.py compiles all their combinations and the engine picks one by the
+// HPBRFeatureBits of the scene and the material. A feature that is off costs nothing, and its textures are not read.
+// HPBR_IBL           -- The scene has the image based lighting.
+// HPBR_NORMAL_MAP    -- The material's normal map is not flat.
+// HPBR_OCCLUSION_MAP -- The material's occlusion is not white.
+
+// The same for all draws of a pass. Matches the PBRBindlessPushConstant on the host.
+struct BindlessDrawInfo
+{
+    float3   cameraPos;
+    float    maxMipLevel;
+    uint     ptLightCnt;
+};
+
+[[vk::binding(1, 0)]] TextureCube i_diffuseCubeMapTexture;
+[[vk::binding(1, 0)]] SamplerState i_diffuseCubemapSamplerState;
+
+[[vk::binding(2, 0)]] TextureCube i_prefilterEnvCubeMapTexture;
+[[vk::binding(2, 0)]] SamplerState i_prefilterEnvCubeMapSamplerState;
+
+[[vk::binding(3, 0)]] Texture2D    i_envBrdfTexture;
+[[vk::binding(3, 0)]] SamplerState i_envBrdfSamplerState;
+
+// All material textures are in the bindless array (Set 1). The indices come from the instance's materialIdx.
+// (See the InstanceData.hlsl)
+[[vk::binding(0, 1)]] Texture2D    i_bindlessTextures[];
+[[vk::binding(0, 1)]] SamplerState i_bindlessSamplers[];
+
+[[vk::push_constant]] BindlessDrawInfo i_sceneInfo;
+
+float4 main(
+    float4 i_pixelWorldPos     : POSITION0,
+    float4 i_pixelWorldNormal  : NORMAL0,
+    float4 i_pixelWorldTangent : TANGENT0,
+    float2 i_pixelWorldUv      : TEXCOORD0,
+    nointerpolation uint4 i_materialIdx : MATERIAL0,
+    float4 i_fragCoord         : SV_Position) : SV_Target
+{
+    float3 V = normalize(i_sceneInfo.cameraPos - i_pixelWorldPos.xyz);
+    float3 N = normalize(i_pixelWorldNormal.xyz);
+
+    // The metallicRoughness texture's green channel contains roughness values and its blue channel contains metalness
+    // values.
+    uint baseColorIdx = i_materialIdx.x;
+    uint normalIdx = i_materialIdx.y;
+    uint mrIdx = i_materialIdx.z;
+    uint occlusionIdx = i_materialIdx.w;
+
+    float2 metallicRoughness = i_bindlessTextures[mrIdx].Sample(i_bindlessSamplers[mrIdx], i_pixelWorldUv).xy;
+    float3 baseColor = i_bindlessTextures[baseColorIdx].Sample(i_bindlessSamplers[baseColorIdx], i_pixelWorldUv).xyz;
+
+#ifdef HPBR_NORMAL_MAP
+    float3 tangent = normalize(i_pixelWorldTangent.xyz);
+    float3 biTangent = normalize(cross(N, tangent));
+    float3 normalSampled = i_bindlessTextures[normalIdx].Sample(i_bindlessSamplers[normalIdx], i_pixelWorldUv).xyz;
+    normalSampled = normalize(normalSampled * 2.0 - 1.0);
+    N = tangent * normalSampled.x + biTangent * normalSampled.y + N * normalSampled.z;
+#endif
+
+    float NoV = saturate(dot(N, V));
+    float3 R = 2 * NoV * N - V;
+
+    float metalic = metallicRoughness[0];
+    float roughness = metallicRoughness[1];
+
+    float3 F0 = float3(0.04, 0.04, 0.04);
+    F0 = lerp(F0, baseColor, float3(metalic, metalic, metalic));
+
+    // Without the IBL, the scene's ambient is black.
+    float3 iblRadiance = float3(0.0, 0.0, 0.0);
+#ifdef HPBR_IBL
+#ifdef HPBR_OCCLUSION_MAP
+    float occlusion = i_bindlessTextures[occlusionIdx].Sample(i_bindlessSamplers[occlusionIdx], i_pixelWorldUv).x;
+#endif
+
+    float3 diffuseIrradiance = i_diffuseCubeMapTexture.Sample(i_diffuseCubemapSamplerState, N).xyz;
+
+    float3 prefilterEnv = i_prefilterEnvCubeMapTexture.SampleLevel(i_prefilterEnvCubeMapSamplerState,
+                                                                   R, roughness * i_sceneInfo.maxMipLevel).xyz;
+
+    float2 envBrdf = i_envBrdfTexture.Sample(i_envBrdfSamplerState, float2(NoV, roughness)).xy;
+
+    float3 iblKs = fresnelSchlickRoughness(NoV, F0, roughness);
+    float3 iblKd = float3(1.0, 1.0, 1.0) - iblKs;
+    iblKd *= (1.0 - metalic);
+
+    float3 iblDiffuse = iblKd * diffuseIrradiance * baseColor;
+    float3 iblSpecular = prefilterEnv * (iblKs * envBrdf.x + envBrdf.y);
+
+    // The occlusion only applies to the ambient light.
+#ifdef HPBR_OCCLUSION_MAP
+    iblRadiance = (iblDiffuse + iblSpecular) * occlusion;
+#else
+    iblRadiance = iblDiffuse + iblSpecular;
+#endif
+#endif
+
+    // Point lights radiance contributions
+    float3 pointLightsRadiance = float3(0.0, 0.0, 0.0);
+
+    // For future debugging purpose
+    /*
+    float attenuation = 0.0;
+    float lightNormalCosTheta = 0.0;
+    float3 kD = float3(0.0, 0.0, 0.0);
+    float3 F = float3(0.0, 0.0, 0.0);
+    float3 lightRadiance = float3(0.0, 0.0, 0.0);
+    float3 specular = float3(0.0, 0.0, 0.0);
+    float3 NFG = float3(0.0, 0.0, 0.0);
+    float NDF = 0.0;
+    float G = 0.0;
+    */
+
+    // Only the lights that can reach the pixel's cluster.
+    uint2 clusterLights = GetClusterLights(i_fragCoord.xy, i_pixelWorldPos.xyz, i_sceneInfo.cameraPos);
+    for(uint j = 0; j < clusterLights.y; j++)
+    {
+        uint i = i_clusterLightIndices[clusterLights.x + j];
+        float4 lightPosRadius = i_pointLightsPosRadius[i];
+        float3 lightPos = lightPosRadius.xyz;
+        float3 lightRadiance = i_pointLightsRadience[i];
+        float3 wi       = normalize(lightPos - i_pixelWorldPos.xyz);
+		float3 H	    = normalize(wi + V);
+		float  dist     = length(lightPos - i_pixelWorldPos.xyz);
+
+        float attenuation = PointLightAttenuation(dist, lightPosRadius.w);
+        lightRadiance = lightRadiance * attenuation;
+        float lightNormalCosTheta = max(dot(N, wi), 0.0);
+
+        float NDF = DistributionGGX(N, H, roughness);
+        float G   = GeometrySmithDirectLight(N, V, wi, roughness);
+        float3 F  = FresnelSchlick(max(dot(H, V), 0.0), F0);
+
+        float3 NFG = NDF * F * G;
+        float denominator = 4.0 * NoV * lightNormalCosTheta  + 0.0001;
+
+        float3 specular = NFG / denominator;
+
+        float3 kD = float3(1.0, 1.0, 1.0) - F; // The amount of light goes into the material.
+		kD *= (1.0 - metalic);
+
+        pointLightsRadiance += (kD * (baseColor / 3.14159265359) + specular) * lightRadiance * lightNormalCosTheta;
+    }
+
+    float3 color = iblRadiance + pointLightsRadiance;
+    // float3 color = iblRadiance;
+
+    // Gamma Correction
+    color = color / (color + float3(1.0, 1.0, 1.0));
+    color = pow(color, float3(1.0/2.2, 1.0/2.2, 1.0/2.2)); 
+
+    return float4(color, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma pack_matrix(row_major)
+
+#include <InstanceData.hlsl>
+
+struct VSOutput
+{
+    float4 Pos : SV_POSITION;
+    float4 WorldPos : POSITION0;
+    float4 Normal : NORMAL0;
+    float4 Tangent : TANGENT0;
+    float2 UV : TEXCOORD0;
+    nointerpolation uint4 MaterialIdx : MATERIAL0;
+};
+
+struct VSInput
+{
+    float3 vPosition : POSITION;
+    float3 vNormal : NORMAL;
+    float4 vTangent : TANGENT;
+    float2 vUv : TEXCOORD;
+};
+
+[[vk::binding(0, 0)]] cbuffer UBO0 { float4x4 i_vpMat; }
+
+// All instances of this frame. The instances of a draw are consecutive from its firstInstance, and the SV_InstanceID is
+// the Vulkan InstanceIndex, which includes the firstInstance.
+[[vk::binding(10, 0)]] StructuredBuffer<InstanceData> i_instances;
+
+VSOutput main(
+    VSInput i_vertInput,
+    uint    i_instanceId : SV_InstanceID)
+{
+    VSOutput output = (VSOutput)0;
+
+    InstanceData instance = i_instances[i_instanceId];
+    float4x4 modelMat = instance.modelMat;
+    float4x4 mvpMat = mul(i_vpMat, modelMat);
+    
+    // Precise, so the depth is EQUAL to the depth prepass's depth.
+    precise float4 pos = mul(mvpMat, float4(i_vertInput.vPosition, 1.0));
+    output.Pos = pos;
+    output.WorldPos = mul(modelMat, float4(i_vertInput.vPosition, 1.0));
+    output.Normal = mul(modelMat, float4(i_vertInput.vNormal, 0.0));
+    output.Tangent = mul(modelMat, float4(i_vertInput.vTangent.xyz, 0.0));
+    output.UV = i_vertInput.vUv;
+    output.MaterialIdx = instance.materialIdx;
+
+    return output;
+}
@@ -0,0 +1,43 @@
+#pragma pack_matrix(row_major)
+
+#include <InstanceData.hlsl>
+
+struct VSOutput
+{
+    float4 Pos : SV_POSITION;
+};
+
+struct VSInput
+{
+    float3 vPosition : POSITION;
+};
+
+// Matches the PBRDepthPrepassPushConstant on the host.
+struct DepthPrepassDrawInfo
+{
+    uint instanceBaseIdx;
+};
+
+[[vk::binding(0, 0)]] cbuffer UBO0 { float4x4 i_vpMat; }
+
+// All instances' model matrices of this frame. Instances of a draw are consecutive from the instanceBaseIdx.
+[[vk::binding(10, 0)]] StructuredBuffer<InstanceData> i_instances;
+
+[[vk::push_constant]] DepthPrepassDrawInfo i_drawInfo;
+
+// The scene pass tests the depth EQUAL to this pass, so the position must be computed in the same way as the PBR
+// vertex shaders and it must be precise.
+VSOutput main(
+    VSInput i_vertInput,
+    uint    i_instanceId : SV_InstanceID)
+{
+    VSOutput output = (VSOutput)0;
+
+    float4x4 modelMat = i_instances[i_drawInfo.instanceBaseIdx + i_instanceId].modelMat;
+    float4x4 mvpMat = mul(i_vpMat, modelMat);
+
+    precise float4 pos = mul(mvpMat, float4(i_vertInput.vPosition, 1.0));
+    output.Pos = pos;
+
+    return output;
+}
@@ -1,10 +1,16 @@
 #pragma pack_matrix(row_major)
 
 #include <GGXModel.hlsl>
+#include <ClusteredLights.hlsl>
 
 // NOTE: [[vk::binding(X[, Y])]] -- X: binding number, Y: descriptor set.
 
-// An IBL check is not so necessary since the performance of IBL rendering is pretty good.
+// Permutation defines. The GenerateShaderHeader.py compiles all their combinations and the engine picks one by the
+// HPBRFeatureBits of the scene and the material. A feature that is off costs nothing, and its textures are not read.
+// HPBR_IBL           -- The scene has the image based lighting.
+// HPBR_NORMAL_MAP    -- The material's normal map is not flat.
+// HPBR_OCCLUSION_MAP -- The material's occlusion is not white.
+
 struct SceneInfo
 {
     float3 cameraPos;
@@ -36,34 +42,28 @@ struct SceneInfo
 [[vk::binding(7, 0)]] Texture2D i_occlusionTexture;
 [[vk::binding(7, 0)]] SamplerState i_occlusionSamplerState;
 
-[[vk::binding(8, 0)]] StructuredBuffer<float3> i_pointLightsPos;
-[[vk::binding(9, 0)]] StructuredBuffer<float3> i_pointLightsRadience;
-
 [[vk::push_constant]] SceneInfo i_sceneInfo;
 
-float PointLightAttenuation(float dist)
-{
-    return (1.0 / (dist * dist));
-}
-
 float4 main(
     float4 i_pixelWorldPos     : POSITION0,
     float4 i_pixelWorldNormal  : NORMAL0,
     float4 i_pixelWorldTangent : TANGENT0,
-    float2 i_pixelWorldUv      : TEXCOORD0) : SV_Target
+    float2 i_pixelWorldUv      : TEXCOORD0,
+    float4 i_fragCoord         : SV_Position) : SV_Target
 {
     float3 V = normalize(i_sceneInfo.cameraPos - i_pixelWorldPos.xyz);
     float3 N = normalize(i_pixelWorldNormal.xyz);
-    float3 tangent = normalize(i_pixelWorldTangent.xyz);
-    float3 biTangent = normalize(cross(N, tangent));
 
     float2 metallicRoughness = i_metallicRoughnessTexture.Sample(i_metallicRoughnessSamplerState, i_pixelWorldUv).xy;
     float3 baseColor = i_baseColorTexture.Sample(i_baseColorSamplerState, i_pixelWorldUv).xyz;
-    float3 normalSampled = i_normalTexture.Sample(i_normalSamplerState, i_pixelWorldUv).xyz;
-    float occlusion = i_occlusionTexture.Sample(i_occlusionSamplerState, i_pixelWorldUv).x;
 
+#ifdef HPBR_NORMAL_MAP
+    float3 tangent = normalize(i_pixelWorldTangent.xyz);
+    float3 biTangent = normalize(cross(N, tangent));
+    float3 normalSampled = i_normalTexture.Sample(i_normalSamplerState, i_pixelWorldUv).xyz;
     normalSampled = normalize(normalSampled * 2.0 - 1.0);
     N = tangent * normalSampled.x + biTangent * normalSampled.y + N * normalSampled.z;
+#endif
 
     float NoV = saturate(dot(N, V));
     float3 R = 2 * NoV * N - V;
@@ -74,6 +74,13 @@ float4 main(
     float3 F0 = float3(0.04, 0.04, 0.04);
     F0 = lerp(F0, baseColor, float3(metalic, metalic, metalic));
 
+    // Without the IBL, the scene's ambient is black.
+    float3 iblRadiance = float3(0.0, 0.0, 0.0);
+#ifdef HPBR_IBL
+#ifdef HPBR_OCCLUSION_MAP
+    float occlusion = i_occlusionTexture.Sample(i_occlusionSamplerState, i_pixelWorldUv).x;
+#endif
+
     float3 diffuseIrradiance = i_diffuseCubeMapTexture.Sample(i_diffuseCubemapSamplerState, N).xyz;
 
     float3 prefilterEnv = i_prefilterEnvCubeMapTexture.SampleLevel(i_prefilterEnvCubeMapSamplerState,
@@ -88,7 +95,13 @@ float4 main(
     float3 iblDiffuse = iblKd * diffuseIrradiance * baseColor;
     float3 iblSpecular = prefilterEnv * (iblKs * envBrdf.x + envBrdf.y);
 
-    float3 iblRadiance = (iblDiffuse + iblSpecular) * occlusion;
+    // The occlusion only applies to the ambient light.
+#ifdef HPBR_OCCLUSION_MAP
+    iblRadiance = (iblDiffuse + iblSpecular) * occlusion;
+#else
+    iblRadiance = iblDiffuse + iblSpecular;
+#endif
+#endif
 
     // Point lights radiance contributions
     float3 pointLightsRadiance = float3(0.0, 0.0, 0.0);
@@ -106,15 +119,19 @@ float4 main(
     float G = 0.0;
     */
 
-    for(int i = 0; i < i_sceneInfo.ptLightCnt; i++)
+    // Only the lights that can reach the pixel's cluster.
+    uint2 clusterLights = GetClusterLights(i_fragCoord.xy, i_pixelWorldPos.xyz, i_sceneInfo.cameraPos);
+    for(uint j = 0; j < clusterLights.y; j++)
     {
-        float3 lightPos = i_pointLightsPos[i];
+        uint i = i_clusterLightIndices[clusterLights.x + j];
+        float4 lightPosRadius = i_pointLightsPosRadius[i];
+        float3 lightPos = lightPosRadius.xyz;
         float3 lightRadiance = i_pointLightsRadience[i];
         float3 wi       = normalize(lightPos - i_pixelWorldPos.xyz);
 		float3 H	    = normalize(wi + V);
 		float  dist     = length(lightPos - i_pixelWorldPos.xyz);
 
-        float attenuation = PointLightAttenuation(dist);
+        float attenuation = PointLightAttenuation(dist, lightPosRadius.w);
         lightRadiance = lightRadiance * attenuation;
         float lightNormalCosTheta = max(dot(N, wi), 0.0);
 
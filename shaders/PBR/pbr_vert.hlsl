@@ -1,5 +1,7 @@
 #pragma pack_matrix(row_major)
 
+#include <InstanceData.hlsl>
+
 struct VSOutput
 {
     float4 Pos : SV_POSITION;
@@ -17,25 +19,27 @@ struct VSInput
     float2 vUv : TEXCOORD;
 };
 
-struct VertUBO
-{
-    float4x4 modelMat;
-    float4x4 vpMat;
-};
+[[vk::binding(0, 0)]] cbuffer UBO0 { float4x4 i_vpMat; }
 
-[[vk::binding(0, 0)]] cbuffer UBO0 { VertUBO i_vertUbo; }
+// All instances' model matrices of this frame. A batch's draw starts at its first instance by the firstInstance, and
+// the SV_InstanceID is the Vulkan InstanceIndex, which includes the firstInstance.
+[[vk::binding(10, 0)]] StructuredBuffer<InstanceData> i_instances;
 
 VSOutput main(
-    VSInput i_vertInput)
+    VSInput i_vertInput,
+    uint    i_instanceId : SV_InstanceID)
 {
     VSOutput output = (VSOutput)0;
 
-    float4x4 mvpMat = mul(i_vertUbo.vpMat, i_vertUbo.modelMat);
+    float4x4 modelMat = i_instances[i_instanceId].modelMat;
+    float4x4 mvpMat = mul(i_vpMat, modelMat);
     
-    output.Pos = mul(mvpMat, float4(i_vertInput.vPosition, 1.0));
-    output.WorldPos = mul(i_vertUbo.modelMat, float4(i_vertInput.vPosition, 1.0));
-    output.Normal = mul(i_vertUbo.modelMat, float4(i_vertInput.vNormal, 0.0));
-    output.Tangent = mul(i_vertUbo.modelMat, float4(i_vertInput.vTangent.xyz, 0.0));
+    // Precise, so the depth is EQUAL to the depth prepass's depth.
+    precise float4 pos = mul(mvpMat, float4(i_vertInput.vPosition, 1.0));
+    output.Pos = pos;
+    output.WorldPos = mul(modelMat, float4(i_vertInput.vPosition, 1.0));
+    output.Normal = mul(modelMat, float4(i_vertInput.vNormal, 0.0));
+    output.Tangent = mul(modelMat, float4(i_vertInput.vTangent.xyz, 0.0));
     output.UV = i_vertInput.vUv;
 
     return output;
@@ -0,0 +1,44 @@
+// Clustered forward shading. The CPU assigns point lights to the view frustum's froxels (HLightClusterBuilder) and a
+// pixel only loops over the lights of its froxel.
+
+// It must match the HClusterInfo on the host.
+struct ClusterInfo
+{
+    float3 cameraView;
+    float  logScale;
+    float2 gridScale;
+    float  logBias;
+    uint   padding0;
+    uint3  gridDim;
+    uint   padding1;
+};
+
+[[vk::binding(8, 0)]] StructuredBuffer<float4> i_pointLightsPosRadius;
+[[vk::binding(9, 0)]] StructuredBuffer<float3> i_pointLightsRadience;
+
+[[vk::binding(11, 0)]] ConstantBuffer<ClusterInfo> i_clusterInfo;
+[[vk::binding(12, 0)]] StructuredBuffer<uint2>     i_clusterGrid; // (offset, count) into the i_clusterLightIndices.
+[[vk::binding(13, 0)]] StructuredBuffer<uint>      i_clusterLightIndices;
+
+// Inverse square falloff windowed to reach 0 at the light's radius, so lights cut off by the clusters don't leave a
+// visible edge. (Karis 2013, Real Shading in Unreal Engine 4)
+float PointLightAttenuation(float dist, float radius)
+{
+    float distRatio = dist / radius;
+    float window = saturate(1.0 - distRatio * distRatio * distRatio * distRatio);
+    return (window * window) / (dist * dist + 0.0001);
+}
+
+// Return the (offset, count) of the lights in the pixel's cluster.
+uint2 GetClusterLights(float2 fragCoord, float3 worldPos, float3 cameraPos)
+{
+    float depth = max(dot(worldPos - cameraPos, i_clusterInfo.cameraView), 0.0001);
+
+    uint3 clusterIdx;
+    clusterIdx.xy = uint2(fragCoord * i_clusterInfo.gridScale);
+    clusterIdx.z = uint(max(log(depth) * i_clusterInfo.logScale + i_clusterInfo.logBias, 0.0));
+    clusterIdx = min(clusterIdx, i_clusterInfo.gridDim - uint3(1, 1, 1));
+
+    uint flatIdx = (clusterIdx.z * i_clusterInfo.gridDim.y + clusterIdx.y) * i_clusterInfo.gridDim.x + clusterIdx.x;
+    return i_clusterGrid[flatIdx];
+}
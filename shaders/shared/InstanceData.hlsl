@@ -0,0 +1,8 @@
+// An instance in the frame's instance buffer. It must match the HInstanceData on the host.
+// The materialIdx are the bindless slots of the base color, normal, metallic roughness and occlusion textures, so the
+// instances of all batches can be drawn without changing the push constants between the draws.
+struct InstanceData
+{
+    float4x4 modelMat;
+    uint4    materialIdx;
+};
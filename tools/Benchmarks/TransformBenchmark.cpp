@@ -0,0 +1,117 @@
+// A microbenchmark of the model matrices generation. It compares the per object GenModelMat(...) with the batched
+// GenModelMats(...) on the SoA transforms and reports the largest difference between their matrices.
+//
+// It only depends on the engine's math utilities, so it's built without the engine. E.g.
+// g++ -O2 -std=c++17 -I../../engine/util TransformBenchmark.cpp ../../engine/util/UtilMath.cpp -o TransformBenchmark
+// cl /O2 /std:c++17 /EHsc /I..\..\engine\util TransformBenchmark.cpp ..\..\engine\util\UtilMath.cpp
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "UtilMath.h"
+
+// The transforms count of each run. It's large enough to go out of the L1 and small enough to stay in the L2.
+#define BENCH_TRANSFORMS_CNT 10000
+#define BENCH_RUNS_CNT       200
+
+// ====================================================================================================================
+static double BenchmarkMs(
+    void (*pFunc)(void*),
+    void* pData)
+{
+    // Warm up the caches and the branch predictors.
+    pFunc(pData);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t run = 0; run < BENCH_RUNS_CNT; run++)
+    {
+        pFunc(pData);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count() / BENCH_RUNS_CNT;
+}
+
+struct BenchData
+{
+    Hedge::HTransformSoA transformsSoA;
+    std::vector<float>   pos;
+    std::vector<float>   rot;
+    std::vector<float>   scale;
+    std::vector<float>   scalarMats;
+    std::vector<float>   batchedMats;
+};
+
+// ====================================================================================================================
+static void RunScalar(
+    void* pData)
+{
+    BenchData& data = *static_cast<BenchData*>(pData);
+    for (uint32_t i = 0; i < BENCH_TRANSFORMS_CNT; i++)
+    {
+        // Same as the scene used to call it for each entity.
+        Hedge::GenModelMat(&data.pos[3 * i],
+                           data.rot[3 * i + 2],
+                           data.rot[3 * i],
+                           data.rot[3 * i + 1],
+                           &data.scale[3 * i],
+                           &data.scalarMats[16 * i]);
+    }
+}
+
+// ====================================================================================================================
+static void RunBatched(
+    void* pData)
+{
+    BenchData& data = *static_cast<BenchData*>(pData);
+    Hedge::GenModelMats(data.transformsSoA, data.batchedMats.data());
+}
+
+// ====================================================================================================================
+int main()
+{
+    BenchData data;
+    data.pos.resize(3 * BENCH_TRANSFORMS_CNT);
+    data.rot.resize(3 * BENCH_TRANSFORMS_CNT);
+    data.scale.resize(3 * BENCH_TRANSFORMS_CNT);
+    data.scalarMats.resize(16 * BENCH_TRANSFORMS_CNT);
+    data.batchedMats.resize(16 * BENCH_TRANSFORMS_CNT);
+
+    // Fixed seed, so runs are comparable.
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> posDist(-100.f, 100.f);
+    std::uniform_real_distribution<float> rotDist(-6.3f, 6.3f);
+    std::uniform_real_distribution<float> scaleDist(0.1f, 10.f);
+    for (uint32_t i = 0; i < 3 * BENCH_TRANSFORMS_CNT; i++)
+    {
+        data.pos[i] = posDist(rng);
+        data.rot[i] = rotDist(rng);
+        data.scale[i] = scaleDist(rng);
+    }
+
+    for (uint32_t i = 0; i < BENCH_TRANSFORMS_CNT; i++)
+    {
+        data.transformsSoA.Push(&data.pos[3 * i], &data.rot[3 * i], &data.scale[3 * i]);
+    }
+
+    double scalarMs = BenchmarkMs(RunScalar, &data);
+    double batchedMs = BenchmarkMs(RunBatched, &data);
+
+    // The scale multiplies the sin/cos's error, so the difference grows with the scale.
+    float maxErr = 0.f;
+    for (uint32_t i = 0; i < 16 * BENCH_TRANSFORMS_CNT; i++)
+    {
+        maxErr = fmaxf(maxErr, fabsf(data.scalarMats[i] - data.batchedMats[i]));
+    }
+
+    printf("Transforms: %u, runs: %u\n", BENCH_TRANSFORMS_CNT, BENCH_RUNS_CNT);
+    printf("GenModelMat  per object: %8.4f ms/run, %6.2f ns/matrix\n",
+           scalarMs, scalarMs * 1e6 / BENCH_TRANSFORMS_CNT);
+    printf("GenModelMats batched   : %8.4f ms/run, %6.2f ns/matrix\n",
+           batchedMs, batchedMs * 1e6 / BENCH_TRANSFORMS_CNT);
+    printf("Speedup: %.2fx, max abs difference: %g (scale <= 10)\n", scalarMs / batchedMs, maxErr);
+
+    return 0;
+}
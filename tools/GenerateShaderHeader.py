@@ -1,10 +1,19 @@
 # Compile HLSL prebuilt/builtin shader to spirv.
 # Put spirv into a header file that can be used in the engine.
-# Currently, the script only supports vertex shader and fragment shader.
+# Currently, the script supports vertex shader, fragment shader and compute shader (HLSL only).
 import os
+import shutil
 import subprocess
 import sys
 
+# Shaders compiled into multiple permutations. A permutation's index has the i-th bit set if the i-th define is on.
+# The engine picks the permutations by the same bits (E.g. The HPBRFeatureBits for the PBR fragment shaders), so the
+# defines' order must match the bits' order.
+shaderPermutations = {
+    "pbr_frag.hlsl": ["HPBR_IBL", "HPBR_NORMAL_MAP", "HPBR_OCCLUSION_MAP"],
+    "pbr_bindless_frag.hlsl": ["HPBR_IBL", "HPBR_NORMAL_MAP", "HPBR_OCCLUSION_MAP"]
+}
+
 
 def GenerateShaderFormatedArray(hexStr, arrayName):
     shaderArrayStr = "    constexpr uint8_t " + arrayName + "[] = {\n"
@@ -21,6 +30,25 @@ def GenerateShaderFormatedArray(hexStr, arrayName):
     return shaderArrayStr
 
 
+def GetPermutationName(shaderName, permutationIdx):
+    return shaderName.rsplit(".")[0] + "_p" + str(permutationIdx)
+
+
+# The permutations of a shader are indexed by their feature bits in the engine:
+# <shader>PermutationsScripts[bits] and <shader>PermutationsBytes[bits].
+def GeneratePermutationsTableStr(shaderName, permutationsCnt):
+    baseName = shaderName.rsplit(".")[0]
+    tableStr = "    constexpr const uint8_t* " + baseName + "PermutationsScripts[] = {\n"
+    for idx in range(permutationsCnt):
+        tableStr += "        " + GetPermutationName(shaderName, idx) + "Script,\n"
+    tableStr += "    };\n\n"
+    tableStr += "    constexpr uint32_t " + baseName + "PermutationsBytes[] = {\n"
+    for idx in range(permutationsCnt):
+        tableStr += "        sizeof(" + GetPermutationName(shaderName, idx) + "Script),\n"
+    tableStr += "    };\n"
+    return tableStr
+
+
 def GeneratePreShaderArrayStr():
     preShadersStr = "// ATTENTION: This file is generated from HLSL shaders and the GenerateShaderHeader.py. Don't edit it manually!\n"
     preShadersStr += "#pragma once\n\n"
@@ -30,70 +58,113 @@ def GeneratePreShaderArrayStr():
 
 
 def GenerateHeader(shaderFoldersPathsNameList, shadersPath):
-    generateHeaderHandle = open(shadersPath + "\\" + "g_prebuiltShaders.h", "w")
+    # Write into a temporary file first, so a failed generation doesn't leave a half written header behind.
+    headerPathName = os.path.join(shadersPath, "g_prebuiltShaders.h")
+    generateHeaderHandle = open(headerPathName + ".tmp", "w")
 
     generateHeaderHandle.write(GeneratePreShaderArrayStr())
 
     for shaderFolderPathName in shaderFoldersPathsNameList:
         fileGenerator = os.walk(shaderFolderPathName)
         filenames = next(fileGenerator)
-        for fileName in filenames[2]:
+        # The os.walk order depends on the file system. Sort it, so regenerating the header only changes the arrays of
+        # the changed shaders.
+        for fileName in sorted(filenames[2]):
             if ".spv" in fileName:
-                with open(shaderFolderPathName + "\\" + fileName, mode='rb') as file: # b is important -> binary
+                with open(os.path.join(shaderFolderPathName, fileName), mode='rb') as file: # b is important -> binary
                     fileContent = file.read()
                     hexStr = fileContent.hex()
                     arrayStr = GenerateShaderFormatedArray(hexStr, fileName.rsplit(".")[0] + "Script")
                     generateHeaderHandle.write(arrayStr)
                     generateHeaderHandle.write("\n")
+
+        # The tables refer to the permutations' arrays, so they are after all arrays of the folder.
+        for fileName in sorted(filenames[2]):
+            if fileName in shaderPermutations:
+                permutationsCnt = 1 << len(shaderPermutations[fileName])
+                generateHeaderHandle.write(GeneratePermutationsTableStr(fileName, permutationsCnt))
+                generateHeaderHandle.write("\n")
     
     generateHeaderHandle.write("}")
     generateHeaderHandle.close()
+    os.replace(headerPathName + ".tmp", headerPathName)
 
 
+# Prefer the DXC of the Vulkan SDK, because the one in the Windows SDK cannot generate SPIR-V.
 def SelectDxc():
-    pathEnvStr = os.environ['PATH']
-    pathEnvStrList = pathEnvStr.rsplit(';')
-    foundVulkanSDK = False
-    dxcCmdStr = ''
-    for path in pathEnvStrList:
-        if 'VulkanSDK' in path:
-            foundVulkanSDK = True
-            dxcCmdStr = path
+    dxcName = "dxc.exe" if os.name == "nt" else "dxc"
+    vulkanSdkPath = os.environ.get("VULKAN_SDK")
+    if vulkanSdkPath is not None:
+        for binFolderName in ["Bin", "bin"]:
+            dxcPathName = os.path.join(vulkanSdkPath, binFolderName, dxcName)
+            if os.path.isfile(dxcPathName):
+                return dxcPathName
+
+    dxcPathName = shutil.which(dxcName)
+    if dxcPathName is None:
+        sys.exit('Cannot find the dxc. Set the VULKAN_SDK environment variable or put the dxc in the PATH.')
+
+    return dxcPathName
 
-    if foundVulkanSDK is False:
-        sys.exit('Cannot find the Vulkan SDK in the PATH environment variable.')
 
-    return dxcCmdStr + '\\dxc.exe'
+def SelectGlslc():
+    glslcPathName = shutil.which("glslc")
+    if glslcPathName is None:
+        sys.exit('Cannot find the glslc. Put the Vulkan SDK\'s glslc in the PATH.')
 
+    return glslcPathName
 
-def CompileShaderHlsl(shaderPathName, folderPath, shaderType):
+
+def CompileShaderHlsl(shaderPathName, folderPath, shaderType, defines=[], outputPathName=""):
     shaderFlag = ""
     if shaderType == "vert":
         shaderFlag = "vs_6_1"
     elif shaderType == "frag":
         shaderFlag = "ps_6_1"
+    elif shaderType == "comp":
+        shaderFlag = "cs_6_1"
     else:
         sys.exit('Unrecogonized hlsl shader type.')
+
+    if outputPathName == "":
+        outputPathName = shaderPathName + ".spv"
+
+    defineArgs = []
+    for define in defines:
+        defineArgs += ['-D', define]
     
     subprocess.check_output([
-        "C:\\VulkanSDK\\1.3.236.0\\Bin\\dxc.exe",
+        SelectDxc(),
         '-spirv',
         '-T', shaderFlag,
         '-E', 'main',
-        '-I', folderPath + "\\..\\shared",
+        '-I', os.path.join(folderPath, "..", "shared"),
         '-fspv-target-env=vulkan1.3',
         '-fspv-extension=SPV_KHR_ray_query',
         '-fspv-extension=SPV_KHR_ray_tracing',
         '-fspv-extension=SPV_KHR_multiview',
         '-fspv-extension=SPV_KHR_shader_draw_parameters',
-        '-fspv-extension=SPV_EXT_descriptor_indexing',
+        '-fspv-extension=SPV_EXT_descriptor_indexing'] + defineArgs + [
         shaderPathName,
-        '-Fo', shaderPathName + ".spv"
+        '-Fo', outputPathName
     ])
 
 
+# Compile all permutations of a shader. The i-th permutation is <name>_p<i>.hlsl.spv.
+def CompileShaderHlslPermutations(Path, fileName, shaderType):
+    defines = shaderPermutations[fileName]
+    for permutationIdx in range(1 << len(defines)):
+        permutationDefines = []
+        for bit in range(len(defines)):
+            if permutationIdx & (1 << bit):
+                permutationDefines.append(defines[bit])
+
+        outputPathName = os.path.join(Path, GetPermutationName(fileName, permutationIdx) + ".hlsl.spv")
+        CompileShaderHlsl(os.path.join(Path, fileName), Path, shaderType, permutationDefines, outputPathName)
+
+
 def CompileShaderGlsl(ShaderPathName, shaderType):
-    result = subprocess.run(["glslc.exe", "-o", ShaderPathName + ".spv", "-fshader-stage=" + shaderType, ShaderPathName])
+    subprocess.check_output([SelectGlslc(), "-o", ShaderPathName + ".spv", "-fshader-stage=" + shaderType, ShaderPathName])
 
 
 def DeleteSpirvInFolder(Path):
@@ -101,7 +172,7 @@ def DeleteSpirvInFolder(Path):
     filenames = next(fileGenerator)
     for fileName in filenames[2]:
         if ".spv" in fileName:
-            os.remove(Path + "\\" + fileName)
+            os.remove(os.path.join(Path, fileName))
 
 
 def CompileShadersInFolder(Path, FolderName):
@@ -109,27 +180,33 @@ def CompileShadersInFolder(Path, FolderName):
     filenames = next(fileGenerator)
     for fileName in filenames[2]:
         if "Vert" in fileName and "glsl" in fileName:
-            CompileShaderGlsl(Path + "\\" + fileName, "vert")
+            CompileShaderGlsl(os.path.join(Path, fileName), "vert")
         elif "Frag" in fileName and "glsl" in fileName:
-            CompileShaderGlsl(Path + "\\" + fileName, "frag")
+            CompileShaderGlsl(os.path.join(Path, fileName), "frag")
         elif "vert" in fileName and "hlsl" in fileName:
-            CompileShaderHlsl(Path + "\\" + fileName, Path, "vert")
+            CompileShaderHlsl(os.path.join(Path, fileName), Path, "vert")
+        elif "frag" in fileName and "hlsl" in fileName and fileName in shaderPermutations:
+            CompileShaderHlslPermutations(Path, fileName, "frag")
         elif "frag" in fileName and "hlsl" in fileName:
-            CompileShaderHlsl(Path + "\\" + fileName, Path, "frag")
+            CompileShaderHlsl(os.path.join(Path, fileName), Path, "frag")
+        elif "comp" in fileName and "hlsl" in fileName:
+            CompileShaderHlsl(os.path.join(Path, fileName), Path, "comp")
 
 
 if __name__ == "__main__":
-    file_path = os.path.realpath(__file__)
-    idx = max(file_path.rfind('/'), file_path.rfind('\\'))
-    folder_path = file_path[:idx]
-    shadersPath = folder_path + "\\..\\shaders"
+    folder_path = os.path.dirname(os.path.realpath(__file__))
+    shadersPath = os.path.join(folder_path, "..", "shaders")
     generator = os.walk(shadersPath)
 
+    # Find the compilers before deleting any SPIR-V, so a missing compiler doesn't leave the shaders half compiled.
+    SelectDxc()
+    SelectGlslc()
+
     folders = next(generator)
     shaderFoldersPathsNameList = []
-    for folderName in folders[1]:
-        DeleteSpirvInFolder(shadersPath + "\\" + folderName)
-        CompileShadersInFolder(shadersPath + "\\" + folderName, folderName)
-        shaderFolderName = shadersPath + "\\" + folderName
+    for folderName in sorted(folders[1]):
+        shaderFolderName = os.path.join(shadersPath, folderName)
+        DeleteSpirvInFolder(shaderFolderName)
+        CompileShadersInFolder(shaderFolderName, folderName)
         shaderFoldersPathsNameList.append(shaderFolderName)
     GenerateHeader(shaderFoldersPathsNameList, shadersPath)